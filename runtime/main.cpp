@@ -0,0 +1,51 @@
+#include <iostream>
+#include <sstream>
+
+#include <bytecode.hpp>
+#include <Options.hpp>
+#include <jit/JitEngine.hpp>
+
+using namespace am2017s;
+
+// written by jit::AotCompiler
+extern "C" u8 const aot_bytecode[];
+extern "C" u64 const aot_bytecode_size;
+extern "C" void* const aot_functions[];
+extern "C" u8 const aot_bounds_checks;
+extern "C" u32 const aot_optimization_level;
+extern "C" char const aot_passes[];
+
+/**
+ * The options `vm aot` compiled the program with, the JIT uses them for the functions it left out
+ */
+static
+Options aotOptions()
+{
+	Options options;
+	options.boundsChecks = aot_bounds_checks != 0;
+	options.optimizationLevel = aot_optimization_level;
+
+	std::stringstream list(aot_passes);
+	for(std::string pass; std::getline(list, pass, ',');)
+		options.passes.push_back(pass);
+
+	return options;
+}
+
+/**
+ * Entry point of the executables built by `vm aot`
+ */
+int main()
+{
+	try
+	{
+		jit::JitEngine engine(bytecode::loadBytecode(aot_bytecode, aot_bytecode_size), aotOptions());
+		engine.linkAheadOfTime(aot_functions);
+		return engine.execute();
+	}
+	catch(std::exception const& e)
+	{
+		std::cerr << "error: " << e.what() << "\n";
+		return 1;
+	}
+}
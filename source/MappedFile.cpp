@@ -0,0 +1,116 @@
+#include <stdexcept>
+
+#include <MappedFile.hpp>
+
+#if defined(_WIN64) || defined(__CYGWIN__)
+
+#include <Windows.h>
+
+namespace am2017s
+{
+	[[noreturn]]
+	static
+	void throwLastError(std::string const& filepath, char const* calledFunction)
+	{
+		throw std::runtime_error("failed to map '" + filepath + "': " + calledFunction + " failed with error "
+		                         + std::to_string(GetLastError()));
+	}
+
+	MappedFile::MappedFile(std::string const& filepath)
+		: _data(nullptr), _size(0)
+	{
+		auto file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		                        FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if(file == INVALID_HANDLE_VALUE)
+			throwLastError(filepath, "CreateFileA");
+
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			throwLastError(filepath, "GetFileSizeEx");
+		}
+
+		_size = size.QuadPart;
+
+		// empty files cannot be mapped
+		if(_size == 0)
+		{
+			CloseHandle(file);
+			return;
+		}
+
+		auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+
+		if(!mapping)
+			throwLastError(filepath, "CreateFileMappingA");
+
+		auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+
+		if(!view)
+			throwLastError(filepath, "MapViewOfFile");
+
+		_data = std::shared_ptr<void const>(view, [](void const* view) { UnmapViewOfFile(view); });
+	}
+}
+
+#else
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace am2017s
+{
+	[[noreturn]]
+	static
+	void throwLastError(std::string const& filepath, char const* calledFunction)
+	{
+		throw std::runtime_error("failed to map '" + filepath + "': " + calledFunction + ": " + std::strerror(errno));
+	}
+
+	MappedFile::MappedFile(std::string const& filepath)
+		: _data(nullptr), _size(0)
+	{
+		int fd = open(filepath.c_str(), O_RDONLY);
+		if(fd == -1)
+			throwLastError(filepath, "open");
+
+		struct stat info;
+		if(fstat(fd, &info) == -1)
+		{
+			close(fd);
+			throwLastError(filepath, "fstat");
+		}
+
+		_size = info.st_size;
+
+		// mmap refuses zero-length mappings
+		if(_size == 0)
+		{
+			close(fd);
+			return;
+		}
+
+		auto address = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		if(address == MAP_FAILED)
+			throwLastError(filepath, "mmap");
+
+		// the whole file is decoded front to back exactly once
+		madvise(address, _size, MADV_SEQUENTIAL);
+
+		auto size = _size;
+		_data = std::shared_ptr<void const>(address, [size](void const* address) { munmap(const_cast<void*>(address), size); });
+	}
+}
+
+#endif
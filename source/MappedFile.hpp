@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <types.hpp>
+
+namespace am2017s
+{
+	/**
+	 * A read-only view of a whole file that is mapped into the address space of the process.
+	 *
+	 * The mapping stays alive as long as any copy of the MappedFile exists.
+	 */
+	class MappedFile
+	{
+		std::shared_ptr<void const> _data;
+		i64 _size;
+
+	public:
+		explicit MappedFile(std::string const& filepath);
+
+		u8 const* data() const
+		{
+			return static_cast<u8 const*>(_data.get());
+		}
+
+		i64 size() const
+		{
+			return _size;
+		}
+
+		/**
+		 * Shares ownership of the mapping, e.g. with data that keeps pointing into the file
+		 */
+		std::shared_ptr<void const> const& handle() const
+		{
+			return _data;
+		}
+	};
+}
@@ -1,9 +1,79 @@
 #pragma once
 
+#include <cstddef>
+#include <string>
+#include <vector>
+
 namespace am2017s
 {
 	struct Options
 	{
 		bool debug = false;
+
+		/**
+		 * Let the interpreter use handlers specialized for the operand types
+		 */
+		bool quicken = true;
+
+		/**
+		 * Let the interpreter fuse frequent sequences of quickened handlers
+		 */
+		bool superinstructions = true;
+
+		/**
+		 * Let temporaries with disjoint lifetimes share a slot in interpreter frames
+		 */
+		bool compactFrames = true;
+
+		/**
+		 * Maximum size of the interpreter stack in bytes
+		 */
+		std::size_t stackSize = 64 << 20;
+
+		/**
+		 * Check every array index against the length in front of the array, both the interpreter and the JIT
+		 * stop the program with an error if it is out of bounds
+		 */
+		bool boundsChecks = false;
+
+		/**
+		 * Number of calls and loop iterations after which the tiered engine compiles a function
+		 */
+		unsigned tierThreshold = 1000;
+
+		/**
+		 * Number of threads compiling in the background, with none the JIT compiles on the thread that needs the code
+		 */
+		unsigned compileThreads = 0;
+
+		/**
+		 * Let the JIT compile every function main can reach before running it, instead of on their first call
+		 */
+		bool eager = false;
+
+		/**
+		 * Directory in which the JIT keeps compiled functions for later runs, none if empty
+		 */
+		std::string codeCache;
+
+		/**
+		 * Optimization passes the JIT runs: none at 0, the cheap ones at 1, all of them at 2
+		 */
+		unsigned optimizationLevel = 2;
+
+		/**
+		 * Passes turned on ("name") or off ("-name") on top of the optimization level, later entries win
+		 */
+		std::vector<std::string> passes;
+
+		/**
+		 * Verify the IR after every optimization pass
+		 */
+		bool verifyPasses = false;
+
+		/**
+		 * Print the total time of every optimization pass when the JIT shuts down
+		 */
+		bool timePasses = false;
 	};
 }
@@ -0,0 +1,260 @@
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include <TieredEngine.hpp>
+#include <jit/OsrBuilder.hpp>
+#include <log/Logger.hpp>
+
+namespace am2017s
+{
+	using interpreter::Value;
+
+	/**
+	 * %rax and %xmm0 after a call to compiled code
+	 */
+	struct NativeResult
+	{
+		u64 integer;
+		u64 floating;
+	};
+
+	extern "C"
+	[[gnu::sysv_abi]]
+	void jit_interpret_stub() asm("jit_interpret_stub");
+
+	extern "C"
+	[[gnu::sysv_abi]]
+	void jit_interpret_member_stub() asm("jit_interpret_member_stub");
+
+	extern "C"
+	[[gnu::sysv_abi]]
+	NativeResult jit_call(void** fptable, void const* code, u64 const* registers) asm("jit_call");
+
+	// argument registers as saved by jit_interpret_stub and loaded by jit_call
+	static constexpr u16 INT_REGISTERS = 6;
+	static constexpr u16 FLOAT_REGISTERS = 8;
+
+	TieredEngine::TieredEngine(bytecode::Program program, Options const& options)
+		: JitEngine(program, options)
+		, _interpreter(std::move(program), options)
+	{
+		for(u16 i = 0; i != _program.functions.size(); ++i)
+		{
+			functionTable()[i] = _virtualFunctions.count(i) ? (void*) &jit_interpret_member_stub
+			                                                : (void*) &jit_interpret_stub;
+		}
+
+		_interpreter.tierTo(this, globals());
+	}
+
+	int TieredEngine::execute()
+	{
+		return _interpreter.execute();
+	}
+
+	bool TieredEngine::passedInRegisters(u16 index) const
+	{
+		return passedInRegisters(_program.functions.at(index).parameters);
+	}
+
+	bool TieredEngine::passedInRegisters(std::vector<bytecode::Local> const& parameters)
+	{
+		u16 ints = 0;
+		u16 floats = 0;
+
+		// same classification as the register allocator
+		for(auto const& parameter : parameters)
+		{
+			if(parameter.type.isFloatingPoint())
+				++floats;
+			else if(parameter.type.isInteger())
+				++ints;
+			else
+				return false;
+		}
+
+		return ints <= INT_REGISTERS && floats <= FLOAT_REGISTERS;
+	}
+
+	bool TieredEngine::compilable(u16 index)
+	{
+		if(!passedInRegisters(index))
+			return false;
+
+		for(auto const& instruction : _program.function(index).instructions)
+		{
+			switch(instruction.opcode)
+			{
+				case bytecode::Opcode::CALL:
+				case bytecode::Opcode::CALL_VOID:
+					if(!passedInRegisters(instruction.call.functionIdx))
+						return false;
+					break;
+
+				case bytecode::Opcode::MEMBER_CALL:
+				case bytecode::Opcode::VOID_MEMBER_CALL:
+					for(u16 callee : _virtualFunctions)
+						if(!passedInRegisters(callee))
+							return false;
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		return true;
+	}
+
+	interpreter::Tiering TieredEngine::tierUp(u16 index)
+	{
+		auto const& name = _program.functions[index].name;
+
+		if(!compilable(index))
+		{
+			Logger::log(Topic::COMPILE) << "Keeping function " << name << " interpreted: arguments on the stack" << std::endl;
+			return interpreter::Tiering::INTERPRETED;
+		}
+
+		try
+		{
+			request(index);
+		}
+		catch(std::exception const& e)
+		{
+			Logger::log(Topic::COMPILE) << "Keeping function " << name << " interpreted: " << e.what() << std::endl;
+			return interpreter::Tiering::INTERPRETED;
+		}
+
+		return poll(index);
+	}
+
+	interpreter::Tiering TieredEngine::poll(u16 index)
+	{
+		auto const& compiling = _requests.at(index);
+
+		if(compiling.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return interpreter::Tiering::COMPILING;
+
+		try
+		{
+			compiling.get();
+			return interpreter::Tiering::NATIVE;
+		}
+		catch(std::exception const& e)
+		{
+			Logger::log(Topic::COMPILE) << "Keeping function " << _program.functions[index].name << " interpreted: " << e.what() << std::endl;
+			return interpreter::Tiering::INTERPRETED;
+		}
+	}
+
+	Value TieredEngine::callNative(u16 index, Value const* arguments)
+	{
+		return invoke(_program.functions[index], functionTable()[index], arguments);
+	}
+
+	TieredEngine::LoopEntry& TieredEngine::loopEntry(u16 index, u16 header, u16 predecessor)
+	{
+		auto key = std::make_tuple(index, header, predecessor);
+
+		auto found = _loopEntries.find(key);
+		if(found != _loopEntries.end())
+			return found->second;
+
+		auto& entry = _loopEntries[key];
+		auto const& name = _program.functions[index].name;
+
+		try
+		{
+			auto osr = jit::OsrBuilder(_program.function(index), header, predecessor).run();
+
+			if(!passedInRegisters(osr.function.parameters))
+				throw std::runtime_error(std::to_string(osr.arguments.size()) + " live values do not fit in registers");
+
+			entry.prototype = std::move(osr.function);
+			entry.arguments = std::move(osr.arguments);
+		}
+		catch(std::exception const& e)
+		{
+			Logger::log(Topic::COMPILE) << "Keeping loop of " << name << " at block " << header << " interpreted: " << e.what() << std::endl;
+			return entry;
+		}
+
+		decodeCallees(index);
+		entry.code = start([this, &entry, name, header]() -> void*
+		{
+			try
+			{
+				Logger::log(Topic::COMPILE) << "Compiling loop entry of " << name << " at block " << header << std::endl;
+				return _fmgr.createEntry(generate(entry.prototype).bytes);
+			}
+			catch(std::exception const& e)
+			{
+				Logger::log(Topic::COMPILE) << "Keeping loop of " << name << " at block " << header << " interpreted: " << e.what() << std::endl;
+				return nullptr;
+			}
+		});
+
+		return entry;
+	}
+
+	bool TieredEngine::enterLoop(u16 index, u16 header, u16 predecessor, Value const* frame,
+	                             std::vector<u16> const& slots, Value& result)
+	{
+		auto& entry = loopEntry(index, header, predecessor);
+		if(!entry.code.valid() || entry.code.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+
+		void* code = entry.code.get();
+		if(!code)
+			return false;
+
+		std::vector<Value> arguments(entry.arguments.size());
+		for(std::size_t i = 0; i != arguments.size(); ++i)
+			arguments[i] = frame[slots[entry.arguments[i]]];
+
+		result = invoke(entry.prototype, code, arguments.data());
+		return true;
+	}
+
+	Value TieredEngine::invoke(bytecode::Function const& prototype, void const* code, Value const* arguments)
+	{
+		u64 registers[INT_REGISTERS + FLOAT_REGISTERS] = {};
+		u16 ints = 0;
+		u16 floats = 0;
+
+		for(u16 i = 0; i != prototype.parameters.size(); ++i)
+		{
+			if(prototype.parameters[i].type.isFloatingPoint())
+				registers[INT_REGISTERS + floats++] = arguments[i].l;
+			else
+				registers[ints++] = arguments[i].l;
+		}
+
+		NativeResult result = jit_call(functionTable(), code, registers);
+
+		Value value;
+		value.l = prototype.returnType.isFloatingPoint() ? result.floating : result.integer;
+		return value;
+	}
+
+	u64 TieredEngine::interpret(u16 index, u64 const* registers)
+	{
+		auto const& function = _program.functions.at(index);
+
+		std::vector<Value> arguments(function.parameters.size());
+		u16 ints = 0;
+		u16 floats = 0;
+
+		for(u16 i = 0; i != function.parameters.size(); ++i)
+		{
+			if(function.parameters[i].type.isFloatingPoint())
+				arguments[i].l = registers[INT_REGISTERS + floats++];
+			else
+				arguments[i].l = registers[ints++];
+		}
+
+		return _interpreter.call(index, arguments.data()).l;
+	}
+}
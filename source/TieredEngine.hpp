@@ -0,0 +1,85 @@
+#pragma once
+
+#include <future>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <bytecode.hpp>
+#include <Options.hpp>
+#include <interpreter/InterpretEngine.hpp>
+#include <jit/JitEngine.hpp>
+
+namespace am2017s
+{
+	/**
+	 * Mixed mode execution: every function starts out in the interpreter, which counts its calls and loop
+	 * iterations. Once a function reaches Options::tierThreshold it is compiled by the JIT and runs natively
+	 * from its next call on.
+	 *
+	 * Both tiers share the function table and the globals. Entries of functions without compiled code point
+	 * to jit_interpret_stub, so compiled code calls back into the interpreter, and the interpreter enters
+	 * compiled code through jit_call.
+	 * Only functions whose arguments (and those of their callees) fit in registers are compiled, functions the
+	 * JIT fails on stay interpreted.
+	 * With Options::compileThreads the compilation runs in the background, and the function stays interpreted
+	 * until its code is published.
+	 *
+	 * An activation that is still interpreted when its function gets hot moves to compiled code at the next
+	 * jump to a loop header (on-stack replacement): the rest of the function is compiled with an entry at
+	 * that header, which takes the values live there as its arguments.
+	 */
+	class TieredEngine : public jit::JitEngine, private interpreter::Tier
+	{
+		/**
+		 * Compiled code entering a function at a loop header, see OsrBuilder
+		 */
+		struct LoopEntry
+		{
+			bytecode::Function prototype;
+			std::vector<u16> arguments;
+
+			/**
+			 * Null if the compilation failed, invalid if the loop cannot be entered at all
+			 */
+			std::shared_future<void*> code;
+		};
+
+		interpreter::InterpretEngine _interpreter;
+
+		/**
+		 * Loop entries by function, header and predecessor
+		 */
+		std::map<std::tuple<u16, u16, u16>, LoopEntry> _loopEntries;
+
+		/**
+		 * Whether `parameters` are passed in registers only
+		 */
+		static bool passedInRegisters(std::vector<bytecode::Local> const& parameters);
+		bool passedInRegisters(u16 index) const;
+
+		/**
+		 * Whether function `index` and everything it calls can switch tiers
+		 */
+		bool compilable(u16 index);
+
+		/**
+		 * Runs `code` compiled for `prototype` from the interpreter
+		 */
+		interpreter::Value invoke(bytecode::Function const& prototype, void const* code, interpreter::Value const* arguments);
+
+		LoopEntry& loopEntry(u16 index, u16 header, u16 predecessor);
+
+		interpreter::Tiering tierUp(u16 index) override;
+		interpreter::Tiering poll(u16 index) override;
+		interpreter::Value callNative(u16 index, interpreter::Value const* arguments) override;
+		bool enterLoop(u16 index, u16 header, u16 predecessor, interpreter::Value const* frame,
+		               std::vector<u16> const& slots, interpreter::Value& result) override;
+
+	public:
+		TieredEngine(bytecode::Program program, Options const& options);
+
+		int execute() override;
+		u64 interpret(u16 index, u64 const* registers) override;
+	};
+}
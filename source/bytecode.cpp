@@ -1,9 +1,13 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <utility>
 
 #include <bytecode.hpp>
+#include <MappedFile.hpp>
 
 namespace am2017s { namespace bytecode { namespace internal
 {
@@ -18,44 +22,80 @@ namespace am2017s { namespace bytecode { namespace internal
 			throw BytecodeLoaderException("failed to load bytecode file");
 	}
 
-	template <typename T>
 	static
-	T doRead(std::istream& is, OverloadTag<T>)
+	void checkForErrors(MemoryReader const& reader, std::size_t bytesNeeded)
 	{
-		T value;
-		is.read(reinterpret_cast<char*>(&value), sizeof value);
+		if(reader.end - reader.cursor < (std::ptrdiff_t) bytesNeeded)
+			throw BytecodeLoaderException("failed to load bytecode file");
+	}
 
+	static
+	void readBytes(std::istream& is, void* into, std::size_t size)
+	{
+		is.read(static_cast<char*>(into), size);
 		checkForErrors(is);
+	}
+
+	static
+	void readBytes(MemoryReader& reader, void* into, std::size_t size)
+	{
+		checkForErrors(reader, size);
+		std::memcpy(into, reader.cursor, size);
+		reader.cursor += size;
+	}
+
+	template <typename Source, typename T>
+	static
+	T doRead(Source& is, OverloadTag<T>)
+	{
+		T value;
+		readBytes(is, &value, sizeof value);
 		return value;
 	}
 
+	template <typename Source>
 	static
-	std::string doRead(std::istream& is, OverloadTag<std::string>)
+	std::string doRead(Source& is, OverloadTag<std::string>)
 	{
 		auto length = read<u16>(is);
 
 		std::string result;
 		result.resize(length);
-		is.read(const_cast<char*>(result.data()), result.size());
-
-		checkForErrors(is);
+		readBytes(is, const_cast<char*>(result.data()), result.size());
 		return result;
 	}
 
-	template <typename T>
+	template <typename Source, typename T>
 	static
-	std::vector<T> doRead(std::istream& is, OverloadTag<std::vector<T>>)
+	std::vector<T> doRead(Source& is, OverloadTag<std::vector<T>>)
 	{
 		std::vector<T> result;
 
-		for(auto length = read<u16>(is); length--;)
+		auto length = read<u16>(is);
+		result.reserve(length);
+
+		while(length--)
 			result.push_back(read<T>(is));
 
 		return result;
 	}
 
+	// plain index lists are copied in one go when reading from memory
+	static
+	std::vector<u16> doRead(MemoryReader& reader, OverloadTag<std::vector<u16>>)
+	{
+		auto length = read<u16>(reader);
+		checkForErrors(reader, length * sizeof(u16));
+
+		std::vector<u16> result(length);
+		std::memcpy(result.data(), reader.cursor, length * sizeof(u16));
+		reader.cursor += length * sizeof(u16);
+		return result;
+	}
+
+	template <typename Source>
 	static
-	Type doRead(std::istream& is, OverloadTag<Type>)
+	Type doRead(Source& is, OverloadTag<Type>)
 	{
 		auto byte = read<u8>(is);
 
@@ -65,16 +105,18 @@ namespace am2017s { namespace bytecode { namespace internal
 		return result;
 	}
 
+	template <typename Source>
 	static
-	Field doRead(std::istream& is, OverloadTag<Field>) {
+	Field doRead(Source& is, OverloadTag<Field>) {
 		u8 typeId = read<u8>(is);
 		return {
 				typeId, read<std::string>(is)
 		};
 	}
 
+	template <typename Source>
 	static
-	StructType doRead(std::istream& is, OverloadTag<StructType>) {
+	StructType doRead(Source& is, OverloadTag<StructType>) {
 		return {
 			read<u8>(is),
 			read<std::string>(is),
@@ -83,8 +125,9 @@ namespace am2017s { namespace bytecode { namespace internal
 		};
 	}
 
+	template <typename Source>
 	static
-	Local doRead(std::istream& is, OverloadTag<Local>)
+	Local doRead(Source& is, OverloadTag<Local>)
 	{
 		Local result;
 		result.type = read<Type>(is);
@@ -92,8 +135,9 @@ namespace am2017s { namespace bytecode { namespace internal
 		return result;
 	}
 
+	template <typename Source>
 	static
-	Opcode doRead(std::istream& is, OverloadTag<Opcode>)
+	Opcode doRead(Source& is, OverloadTag<Opcode>)
 	{
 		auto op = static_cast<Opcode>(read<u8>(is));
 
@@ -145,8 +189,27 @@ namespace am2017s { namespace bytecode { namespace internal
 		throw BytecodeLoaderException("invalid opcode encountered " + std::to_string((u8) op));
 	}
 
+	/**
+	 * Appends a length prefixed list of `count * width` operands to the operand pool of a function
+	 */
+	template <typename Source>
 	static
-	Instruction doRead(std::istream& is, OverloadTag<Instruction>)
+	OperandList readOperands(Source& is, std::vector<u16>& operands, u16 width = 1)
+	{
+		OperandList list{(u32) operands.size(), read<u16>(is)};
+
+		if(list.count)
+		{
+			operands.resize(operands.size() + list.count * width);
+			readBytes(is, operands.data() + list.offset, list.count * width * sizeof(u16));
+		}
+
+		return list;
+	}
+
+	template <typename Source>
+	static
+	Instruction readInstruction(Source& is, std::vector<u16>& operands)
 	{
 		Instruction result(read<Opcode>(is));
 
@@ -244,19 +307,19 @@ namespace am2017s { namespace bytecode { namespace internal
 			break;
 
 		case Opcode::PHI:
-			result.phi.args = read<std::vector<PhiEdge>>(is);
+			result.phi.edges = readOperands(is, operands, 2);
 			break;
 
 		case Opcode::SPECIAL:
 		case Opcode::SPECIAL_VOID:
 			result.call.functionIdx = read<u8>(is);
-			result.call.args = read<std::vector<u16>>(is);
+			result.call.args = readOperands(is, operands);
 			break;
 
 		case Opcode::CALL:
 		case Opcode::CALL_VOID:
 			result.call.functionIdx = read<u16>(is);
-			result.call.args = read<std::vector<u16>>(is);
+			result.call.args = readOperands(is, operands);
 			break;
 
 		case Opcode::RET_VOID:
@@ -292,15 +355,14 @@ namespace am2017s { namespace bytecode { namespace internal
 			break;
 
 		case Opcode::VOID_MEMBER_CALL:
-			result.member_call.functionIdx = read<u8>(is);
-			result.member_call.args = read<std::vector<u16>>(is);
-			result.member_call.ptrIdx = result.member_call.args[0];
-			break;
-
 		case Opcode::MEMBER_CALL:
 			result.member_call.functionIdx = read<u8>(is);
-			result.member_call.args = read<std::vector<u16>>(is);
-			result.member_call.ptrIdx = result.member_call.args[0];
+			result.member_call.args = readOperands(is, operands);
+
+			if(result.member_call.args.count == 0)
+				throw BytecodeLoaderException("member call without receiver");
+
+			result.member_call.ptrIdx = operands[result.member_call.args.offset];
 			break;
 
 		default:
@@ -310,25 +372,27 @@ namespace am2017s { namespace bytecode { namespace internal
 		return result;
 	}
 
+	template <typename Source>
 	static
-	Block doRead(std::istream& is, OverloadTag<Block>) {
+	Block doRead(Source& is, OverloadTag<Block>) {
 		Block block;
 		block.instructionCount = read<u16>(is);
 		block.successors = read<std::vector<u16>>(is);
 		return block;
 	}
 
-	static
-	PhiEdge doRead(std::istream& is, OverloadTag<PhiEdge>) {
-		return {read<u16>(is), read<u16>(is)};
-	}
-
 	template <typename T>
 	T read(std::istream& is)
 	{
 		return doRead(is, OverloadTag<T>());
 	}
 
+	template <typename T>
+	T read(MemoryReader& reader)
+	{
+		return doRead(reader, OverloadTag<T>());
+	}
+
 	u16 countTemporaries(std::vector<Local>& parameters, std::vector<Instruction>& instructions)
 	{
 		u16 result = parameters.size();
@@ -409,34 +473,157 @@ namespace am2017s { namespace bytecode { namespace internal
 		}
 	}
 
+	template <typename Source>
 	static
-	void read(std::istream& is, Function& function)
+	void readPrototype(Source& is, Function& function)
 	{
 		function.name         = read<std::string>(is);
 		function.parameters   = read<std::vector<Local>>(is);
 		function.returnType   = read<Type>(is);
 //		function.variables    = read<std::vector<Local>>(is);
+	}
+
+	template <typename Source>
+	static
+	void readBody(Source& is, Function& function)
+	{
 		function.blocks       = read<std::vector<Block>>(is);
 
 		setBlockPredecessors(function.blocks);
 
-		function.instructions = read<std::vector<Instruction>>(is);
+		auto instructionCount = read<u16>(is);
+
+		function.operands.clear();
+		function.instructions.clear();
+		function.instructions.reserve(instructionCount);
+
+		while(instructionCount--)
+			function.instructions.push_back(readInstruction(is, function.operands));
+
 		function.temporyCount = countTemporaries(function.parameters, function.instructions);
 	}
 
-	void read(std::istream& is, Program& program)
+	static
+	void checkCallTargets(Function const& function, std::size_t functionCount)
+	{
+		for(auto const& instruction : function.instructions)
+		{
+			bool call = instruction.opcode == Opcode::CALL || instruction.opcode == Opcode::CALL_VOID;
+			if(call && instruction.call.functionIdx >= functionCount)
+				throw BytecodeLoaderException("function '" + function.name + "' calls a function that does not exist");
+		}
+	}
+
+	static
+	void countCallSites(Function const& function, std::vector<u32>& callSites)
+	{
+		checkCallTargets(function, callSites.size());
+
+		for(auto const& instruction : function.instructions)
+		{
+			if(instruction.opcode == Opcode::CALL || instruction.opcode == Opcode::CALL_VOID)
+				callSites[instruction.call.functionIdx]++;
+		}
+	}
+
+	template <typename Source>
+	static
+	void read(Source& is, Function& function)
+	{
+		readPrototype(is, function);
+		readBody(is, function);
+	}
+
+	static
+	void skipLine(std::istream& is)
+	{
+		is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+	}
+
+	static
+	void skipLine(MemoryReader& reader)
+	{
+		auto newline = static_cast<u8 const*>(std::memchr(reader.cursor, '\n', reader.end - reader.cursor));
+		reader.cursor = newline ? newline + 1 : reader.end;
+	}
+
+	template <typename Source>
+	static
+	u16 readMagic(Source& is)
 	{
 		auto magic = read<u16>(is);
 		if(magic == ('#' | ('!' << 8)))
 		{
-			is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+			skipLine(is);
 			magic = read<u16>(is);
 		}
 
-		if(magic != 1706) {
+		if(magic != PLAIN_MAGIC && magic != INDEXED_MAGIC) {
 			throw BytecodeLoaderException("Magic constant did not appear as expected");
 		}
 
+		return magic;
+	}
+
+	static
+	void readIndexedFunctions(MemoryReader& reader, Program& program)
+	{
+		struct BodyRange
+		{
+			u32 offset;
+			u32 size;
+		};
+
+		auto functionCount = read<u16>(reader);
+		program.functions.resize(functionCount);
+		program.callSites.resize(functionCount);
+
+		std::vector<BodyRange> ranges(functionCount);
+		for(u16 i = 0; i != functionCount; ++i)
+		{
+			readPrototype(reader, program.functions[i]);
+			ranges[i].offset = read<u32>(reader);
+			ranges[i].size = read<u32>(reader);
+			program.callSites[i] = read<u32>(reader);
+		}
+
+		// the bodies fill the rest of the image
+		auto bodies = reader.cursor;
+		u64 sectionSize = reader.end - reader.cursor;
+
+		for(u16 i = 0; i != functionCount; ++i)
+		{
+			auto& function = program.functions[i];
+
+			if((u64) ranges[i].offset + ranges[i].size > sectionSize)
+				throw BytecodeLoaderException("body of function '" + function.name + "' lies outside of the image");
+
+			function.encodedBody = bodies + ranges[i].offset;
+			function.encodedBodyEnd = function.encodedBody + ranges[i].size;
+		}
+
+		reader.cursor = reader.end;
+	}
+
+	static
+	void readIndexedFunctions(std::istream& is, Program& program)
+	{
+		// bodies are decoded lazily, so they have to outlive the stream
+		auto image = std::make_shared<std::string>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+		auto data = reinterpret_cast<u8 const*>(image->data());
+
+		MemoryReader reader{data, data + image->size()};
+		readIndexedFunctions(reader, program);
+
+		program.image = image;
+	}
+
+	template <typename Source>
+	static
+	void readProgram(Source& is, Program& program)
+	{
+		auto magic = readMagic(is);
+
 		program.globals = read<std::vector<Field>>(is);
 
 		std::vector<StructType> types = read<std::vector<StructType>>(is);
@@ -444,12 +631,34 @@ namespace am2017s { namespace bytecode { namespace internal
 			program.types.emplace(type.id, type);
 		}
 
+		if(magic == INDEXED_MAGIC)
+		{
+			readIndexedFunctions(is, program);
+			return;
+		}
+
 		auto functionCount = read<u16>(is);
+		program.functions.reserve(functionCount);
+
 		for(Function function; functionCount--;)
 		{
 			read(is, function);
 			program.functions.push_back(std::move(function));
 		}
+
+		program.callSites.assign(program.functions.size(), 0);
+		for(auto const& function : program.functions)
+			countCallSites(function, program.callSites);
+	}
+
+	void read(std::istream& is, Program& program)
+	{
+		readProgram(is, program);
+	}
+
+	void read(MemoryReader& reader, Program& program)
+	{
+		readProgram(reader, program);
 	}
 
 	void assignTypesToTemporaries(Program& p, Function& f)
@@ -570,8 +779,12 @@ namespace am2017s { namespace bytecode { namespace internal
 				break;
 
 			case Opcode::PHI:
-				f.temporaryTypes[currentTemporary].isArray = f.temporaryTypes[instr.phi.args.front().temp].isArray;
-				f.temporaryTypes[currentTemporary].baseType = f.temporaryTypes[instr.phi.args.front().temp].baseType;
+				if(instr.phi.edges.count == 0)
+				{
+					throw BytecodeLoaderException("phi without incoming edges");
+				}
+
+				f.temporaryTypes[currentTemporary] = f.temporaryTypes[instr.phi.edge(f.operands, 0).temp];
 				currentTemporary++;
 				break;
 
@@ -621,29 +834,193 @@ namespace am2017s { namespace bytecode { namespace internal
 			offset += global.getSize();
 		}
 
+		for(auto& type : program.types) {
+			type.second.pack();
+		}
+
+		// lazily decoded functions are checked by Program::function
 		for(Function& f : program.functions)
 		{
-			assignTypesToTemporaries(program, f);
+			if(f.isDecoded())
+				assignTypesToTemporaries(program, f);
 		}
 	}
+
+	static
+	bool isIndexed(u8 const* data, std::size_t size)
+	{
+		MemoryReader reader{data, data + size};
+		return readMagic(reader) == INDEXED_MAGIC;
+	}
+
+	static
+	Program loadImage(u8 const* data, std::size_t size, std::shared_ptr<void const> owner)
+	{
+		MemoryReader reader{data, data + size};
+
+		Program program;
+		read(reader, program);
+
+		if(reader.cursor != reader.end)
+			throw BytecodeLoaderException("unexpected trailing bytes after last function");
+
+		staticAnalysis(program);
+
+		if(std::any_of(program.functions.begin(), program.functions.end(), [](Function const& f) { return !f.isDecoded(); }))
+			program.image = std::move(owner);
+
+		return program;
+	}
+
+	template <typename T>
+	static
+	void write(std::string& into, T value)
+	{
+		into.append(reinterpret_cast<char const*>(&value), sizeof value);
+	}
+
+	static
+	void write(std::string& into, u8 const* begin, u8 const* end)
+	{
+		into.append(reinterpret_cast<char const*>(begin), end - begin);
+	}
 }
 
+	Function& Program::function(u16 idx)
+	{
+		Function& f = functions.at(idx);
+
+		if(!f.isDecoded())
+		{
+			internal::MemoryReader reader{f.encodedBody, f.encodedBodyEnd};
+			internal::readBody(reader, f);
+
+			if(reader.cursor != reader.end)
+				throw BytecodeLoaderException("unexpected trailing bytes after body of function '" + f.name + "'");
+
+			// the call sites stored in the index do not vouch for the body
+			internal::checkCallTargets(f, functions.size());
+			internal::assignTypesToTemporaries(*this, f);
+
+			f.encodedBody = f.encodedBodyEnd = nullptr;
+		}
+
+		return f;
+	}
+
+	u32 Program::globalsSize() const
+	{
+		if(globals.empty())
+			return 0;
+
+		return globals.back().offset + (u32) globals.back().getSize();
+	}
+
 	Program loadBytecode(std::string const& filepath)
 	{
-		std::ifstream file(filepath, std::ios::binary);
-		am2017s::bytecode::internal::checkForErrors(file);
+		MappedFile file(filepath);
+
+		try
+		{
+			return internal::loadImage(file.data(), file.size(), file.handle());
+		}
+		catch(BytecodeLoaderException const&)
+		{
+			throw BytecodeLoaderException("failed to read file '" + filepath + "'");
+		}
+	}
+
+	Program loadBytecode(u8 const* data, std::size_t size)
+	{
+		if(!internal::isIndexed(data, size))
+			return internal::loadImage(data, size, nullptr);
+
+		// lazily decoded bodies must not depend on the lifetime of the caller's buffer
+		auto image = std::make_shared<std::vector<u8>>(data, data + size);
+		return internal::loadImage(image->data(), image->size(), image);
+	}
+
+	Program loadBytecode(std::istream& is)
+	{
+		internal::checkForErrors(is);
 
 		Program program;
-		am2017s::bytecode::internal::read(file, program);
+		internal::read(is, program);
 
-		if(file.peek() != EOF)
-			throw BytecodeLoaderException("failed to read file '" + filepath + "'");
+		if(is.peek() != EOF)
+			throw BytecodeLoaderException("unexpected trailing bytes after last function");
 
 		internal::staticAnalysis(program);
 
 		return program;
 	}
 
+	std::string packBytecode(u8 const* data, std::size_t size)
+	{
+		using namespace internal;
+
+		MemoryReader reader{data, data + size};
+		std::string result;
+
+		if(readMagic(reader) != PLAIN_MAGIC)
+			throw BytecodeLoaderException("image is already indexed");
+
+		// keep a shebang line, but replace the magic number following it
+		write(result, data, reader.cursor - sizeof(u16));
+		write<u16>(result, INDEXED_MAGIC);
+
+		auto declarations = reader.cursor;
+		read<std::vector<Field>>(reader);
+		read<std::vector<StructType>>(reader);
+		write(result, declarations, reader.cursor);
+
+		auto functionCount = read<u16>(reader);
+		write<u16>(result, functionCount);
+
+		struct Entry
+		{
+			u8 const* prototype;
+			u8 const* prototypeEnd;
+			u32 offset;
+			u32 size;
+		};
+
+		// the call sites of a function are only known once all bodies have been read
+		std::vector<Entry> entries;
+		std::vector<u32> callSites(functionCount, 0);
+		std::string bodies;
+
+		for(Function function; entries.size() != functionCount;)
+		{
+			Entry entry;
+			entry.prototype = reader.cursor;
+			readPrototype(reader, function);
+			entry.prototypeEnd = reader.cursor;
+
+			auto body = reader.cursor;
+			readBody(reader, function);
+			countCallSites(function, callSites);
+
+			entry.offset = bodies.size();
+			entry.size = reader.cursor - body;
+			write(bodies, body, reader.cursor);
+			entries.push_back(entry);
+		}
+
+		if(reader.cursor != reader.end)
+			throw BytecodeLoaderException("unexpected trailing bytes after last function");
+
+		for(u16 i = 0; i != functionCount; ++i)
+		{
+			write(result, entries[i].prototype, entries[i].prototypeEnd);
+			write<u32>(result, entries[i].offset);
+			write<u32>(result, entries[i].size);
+			write<u32>(result, callSites[i]);
+		}
+
+		return result + bodies;
+	}
+
 	template <typename Cont, typename F, typename G>
 	void forEachWithBetween(Cont const& cont, F&& f, G&& g)
 	{
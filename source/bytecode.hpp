@@ -5,8 +5,10 @@
 #include <new>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <map>
+#include <memory>
 
 #include <types.hpp>
 #include <exception/InvalidResultException.hpp>
@@ -124,7 +126,7 @@ namespace am2017s { namespace bytecode
 			return baseType <= 6 || baseType >= 9;
 		}
 
-		bool operator==(const Type& other)
+		bool operator==(const Type& other) const
 		{
 			return isArray == other.isArray &&
 			       (baseType == other.baseType || baseType == (u8) BaseType::VOID || other.baseType == (u8) BaseType::VOID);
@@ -219,7 +221,12 @@ namespace am2017s { namespace bytecode
 		GLOB_STORE = 104,
 
 		VOID_MEMBER_CALL = 105,
-		MEMBER_CALL = 106
+		MEMBER_CALL = 106,
+
+		/**
+		 * Inserted by the vm with Options::boundsChecks, never part of a bytecode file
+		 */
+		BOUNDS_CHECK = 200
 	};
 
 	struct UnaryOp
@@ -273,11 +280,34 @@ namespace am2017s { namespace bytecode
 		u16 conditionIdx;
 	};
 
+	/**
+	 * @brief run of variable length operands inside of the operand pool of a function
+	 */
+	struct OperandList
+	{
+		u32 offset;
+		u16 count;
+	};
+
+	/**
+	 * @brief non-owning view of an OperandList
+	 */
+	struct OperandRange
+	{
+		u16 const* first;
+		u16 const* last;
+
+		u16 const* begin() const { return first; }
+		u16 const* end() const { return last; }
+		u16 size() const { return last - first; }
+		u16 operator[](u16 idx) const { return first[idx]; }
+	};
+
 	struct CallOp
 	{
 		u16 dstIdx;
 		u16 functionIdx;
-		std::vector<u16> args;
+		OperandList args;
 	};
 
 	struct MemberCallOp
@@ -285,7 +315,7 @@ namespace am2017s { namespace bytecode
 		u16 dstIdx;
 		u16 ptrIdx;
 		u8 functionIdx;
-		std::vector<u16> args;
+		OperandList args;
 	};
 
 	struct PhiEdge {
@@ -296,13 +326,23 @@ namespace am2017s { namespace bytecode
 	struct PhiOp
 	{
 		u16 dstIdx;
-		std::vector<PhiEdge> args;
+
+		/**
+		 * @brief `count` edges, each stored as a (temp, block) pair of operands
+		 */
+		OperandList edges;
 
 	public:
-		u16 inputOf(u16 block) const {
-			for(auto edge : args) {
-				if(edge.block == block) {
-					return edge.temp;
+		PhiEdge edge(std::vector<u16> const& operands, u16 idx) const {
+			u16 const* pair = operands.data() + edges.offset + 2 * idx;
+			return {pair[0], pair[1]};
+		}
+
+		u16 inputOf(std::vector<u16> const& operands, u16 block) const {
+			for(u16 idx = 0; idx != edges.count; ++idx) {
+				auto e = edge(operands, idx);
+				if(e.block == block) {
+					return e.temp;
 				}
 			}
 
@@ -327,6 +367,29 @@ namespace am2017s { namespace bytecode
 		u16 value;
 	};
 
+	/**
+	 * @brief traps unless the index is within the array, or every index of [index, limit) if the range is not
+	 *        empty
+	 */
+	struct BoundsCheckOp {
+		static constexpr u16 NO_LIMIT = 0xffff;
+
+		/**
+		 * @brief index of temporary, that points to the array
+		 */
+		u16 arrayIdx;
+
+		/**
+		 * @brief index of temporary, that holds the index (or the start of the range)
+		 */
+		u16 indexIdx;
+
+		/**
+		 * @brief index of temporary, that holds the end of the range, NO_LIMIT to check a single index
+		 */
+		u16 limitIdx;
+	};
+
 	enum SpecialCallIdx
 	{
 		BEGIN = 0,
@@ -355,14 +418,41 @@ namespace am2017s { namespace bytecode
 			AllocOp obj_alloc;
 			AccessOp access;
 			GlobalAccessOp global;
+			BoundsCheckOp check;
 		};
 
+		/**
+		 * Whether the instruction has no effect besides its result and cannot trap, so it can be dropped if
+		 * the result is unused. Divisions trap on zero, array and object accesses on null references.
+		 */
 		bool isPure() const {
-			// todo implement
-			return true;
+			switch(opcode) {
+				case Opcode::NOP:
+				case Opcode::LOAD:
+				case Opcode::CONST:
+				case Opcode::ADD:
+				case Opcode::SUB:
+				case Opcode::MUL:
+				case Opcode::NEG:
+				case Opcode::GT:
+				case Opcode::GTE:
+				case Opcode::EQ:
+				case Opcode::NEQ:
+				case Opcode::LTE:
+				case Opcode::LT:
+				case Opcode::AND:
+				case Opcode::OR:
+				case Opcode::NOT:
+				case Opcode::PHI:
+				case Opcode::GLOB_LOAD:
+					return true;
+
+				default:
+					return false;
+			}
 		}
 
-		std::vector<u16> inputOperands() const {
+		std::vector<u16> inputOperands(std::vector<u16> const& operands) const {
 			std::vector<u16> inputOperands;
 			switch(opcode) {
 				case Opcode::NOP:
@@ -396,13 +486,21 @@ namespace am2017s { namespace bytecode
 					break;
 
 				case Opcode::OBJ_LOAD:
-					inputOperands.push_back(access.ptrIdx);;
+					inputOperands.push_back(access.ptrIdx);
+					break;
 
 				case Opcode::OBJ_STORE:
 					inputOperands.push_back(access.ptrIdx);
 					inputOperands.push_back(access.valueIdx);
 					break;
 
+				case Opcode::GLOB_LOAD:
+					break;
+
+				case Opcode::GLOB_STORE:
+					inputOperands.push_back(global.value);
+					break;
+
 				case Opcode::GOTO:
 					break;
 				case Opcode::IF_GOTO:
@@ -410,11 +508,14 @@ namespace am2017s { namespace bytecode
 					break;
 
 				CALL_INSTRUCTIONS
-					inputOperands.insert(inputOperands.end(), call.args.begin(), call.args.end());
+					inputOperands.insert(inputOperands.end(), operands.begin() + call.args.offset,
+					                     operands.begin() + call.args.offset + call.args.count);
 					break;
 
 				MEMBER_CALL_INSTRUCTINS
-					inputOperands.insert(inputOperands.end(), member_call.args.begin(), member_call.args.end());
+					inputOperands.push_back(member_call.ptrIdx);
+					inputOperands.insert(inputOperands.end(), operands.begin() + member_call.args.offset,
+					                     operands.begin() + member_call.args.offset + member_call.args.count);
 					break;
 
 				OPCODE_INSTRUCTIONS
@@ -422,8 +523,16 @@ namespace am2017s { namespace bytecode
 
 				PHI_INSTRUCTIONS
 					// not considered in this step
-					for(auto& edge : phi.args) {
-						inputOperands.push_back(edge.temp);
+					for(u16 idx = 0; idx != phi.edges.count; ++idx) {
+						inputOperands.push_back(phi.edge(operands, idx).temp);
+					}
+					break;
+
+				case Opcode::BOUNDS_CHECK:
+					inputOperands.push_back(check.arrayIdx);
+					inputOperands.push_back(check.indexIdx);
+					if(check.limitIdx != BoundsCheckOp::NO_LIMIT) {
+						inputOperands.push_back(check.limitIdx);
 					}
 					break;
 
@@ -434,110 +543,141 @@ namespace am2017s { namespace bytecode
 			return inputOperands;
 		}
 
-		Instruction() {}
-		Instruction(Opcode op) : opcode(op) {
-			switch(opcode)
-			{
+		/**
+		 * Calls `f` with a reference to every temporary inputOperands() lists, so they can be renamed
+		 */
+		template<typename F>
+		void forEachInput(std::vector<u16>& operands, F f) {
+			switch(opcode) {
+				BINARY_INSTRUCTIONS
+					f(binary.lsrcIdx);
+					f(binary.rsrcIdx);
+					break;
+
+				UNARY_INSTRUCTIONS
+					f(unary.srcIdx);
+					break;
+
+				case Opcode::STORE_IDX:
+					f(array.valueIdx);
+				case Opcode::LOAD_IDX:
+					f(array.indexIdx);
+				case Opcode::LENGTH:
+					f(array.memoryIdx);
+					break;
+
+				ALLOCATE_INSTRUCTIONS
+					f(alloc.sizeIdx);
+					break;
+
+				case Opcode::OBJ_STORE:
+					f(access.valueIdx);
+				case Opcode::OBJ_LOAD:
+					f(access.ptrIdx);
+					break;
+
+				case Opcode::GLOB_STORE:
+					f(global.value);
+					break;
+
+				case Opcode::IF_GOTO:
+					f(jump.conditionIdx);
+					break;
+
 				CALL_INSTRUCTIONS
-					createCallOp();
+					for(u16 idx = 0; idx != call.args.count; ++idx) {
+						f(operands[call.args.offset + idx]);
+					}
 					break;
+
 				MEMBER_CALL_INSTRUCTINS
-					createMemberCallOp();
+					f(member_call.ptrIdx);
+					for(u16 idx = 0; idx != member_call.args.count; ++idx) {
+						f(operands[member_call.args.offset + idx]);
+					}
 					break;
+
 				PHI_INSTRUCTIONS
-					createPhiOp();
+					for(u16 idx = 0; idx != phi.edges.count; ++idx) {
+						f(operands[phi.edges.offset + 2 * idx]);
+					}
+					break;
+
+				case Opcode::BOUNDS_CHECK:
+					f(check.arrayIdx);
+					f(check.indexIdx);
+					if(check.limitIdx != BoundsCheckOp::NO_LIMIT) {
+						f(check.limitIdx);
+					}
+					break;
+
 				default:
 					break;
 			}
 		}
 
-		Instruction(Instruction const& old)
-				: opcode(old.opcode), id(old.id)
-		{
-			switch(opcode)
-			{
-			BINARY_INSTRUCTIONS
-				new (&binary) BinaryOp(old.binary);
-				break;
-			UNARY_INSTRUCTIONS
-				new (&unary) UnaryOp(old.unary);
-				break;
-			CONST_INSTRUCTIONS
-				new (&constant) ConstOp(old.constant);
-				break;
-			ARRAY_INSTRUCTIONS
-				new (&array) ArrayOp(old.array);
-				break;
-			ALLOCATE_INSTRUCTIONS
-				new (&alloc) NewOp(old.alloc);
-				break;
-			JUMP_INSTRUCTIONS
-				new (&jump) GotoOp(old.jump);
-				break;
-			CALL_INSTRUCTIONS
-				new (&call) CallOp(old.call);
-				break;
-			MEMBER_CALL_INSTRUCTINS
-				new (&member_call) MemberCallOp(old.member_call);
-				break;
-			OPCODE_INSTRUCTIONS
-				break;
-			PHI_INSTRUCTIONS
-				new (&phi) PhiOp(old.phi);
-				break;
-			OBJ_ALLOCATE_INSTRUCTIONS
-				new (&obj_alloc) AllocOp(old.obj_alloc);
-				break;
-			OBJ_ACCESS_INSTRUCTIONS
-				new (&access) AccessOp(old.access);
-				break;
-			GLOB_ACCESS_INSTRUCTIONS
-				new (&global) GlobalAccessOp(old.global);
-				break;
+		/**
+		 * Calls `f` with a reference to the temporary dstIdx() returns, if there is one
+		 */
+		template<typename F>
+		void forDestination(F f) {
+			switch(opcode) {
+				case Opcode::LOAD:
+				case Opcode::NEG:
+				case Opcode::NOT:
+					f(unary.dstIdx);
+					break;
 
-			case Opcode::NOP:
-				break;
+				BINARY_INSTRUCTIONS
+					f(binary.dstIdx);
+					break;
 
-			default:
-				throw std::runtime_error("opcode not handled in copy constructor");
-			}
-		}
+				case Opcode::CONST:
+					f(constant.dstIdx);
+					break;
 
-		Instruction& operator = (Instruction const& other)
-		{
-			if(this == &other)
-				return *this;
+				case Opcode::LENGTH:
+				case Opcode::LOAD_IDX:
+					f(array.valueIdx);
+					break;
 
-			this->~Instruction();
-			return *new (this) Instruction(other);
-		}
+				case Opcode::NEW:
+					f(alloc.dstIdx);
+					break;
 
-		~Instruction()
-		{
-			switch(opcode)
-			{
-			CALL_INSTRUCTIONS
-				call.~CallOp();
-				break;
-			PHI_INSTRUCTIONS
-				phi.~PhiOp();
-				break;
-			default: break;
-			}
-		}
+				case Opcode::CALL:
+				case Opcode::SPECIAL:
+					f(call.dstIdx);
+					break;
 
-		void createCallOp() {
-			new (&call) CallOp;
-		}
+				case Opcode::PHI:
+					f(phi.dstIdx);
+					break;
 
-		void createMemberCallOp() {
-			new (&member_call) MemberCallOp;
-		}
+				case Opcode::ALLOCATE:
+					f(obj_alloc.dstIdx);
+					break;
+
+				case Opcode::OBJ_LOAD:
+					f(access.valueIdx);
+					break;
+
+				case Opcode::GLOB_LOAD:
+					f(global.value);
+					break;
+
+				case Opcode::MEMBER_CALL:
+					f(member_call.dstIdx);
+					break;
 
-		void createPhiOp() {
-			new (&phi) PhiOp;
+				default:
+					break;
+			}
 		}
 
+		Instruction() = default;
+		Instruction(Opcode op) : opcode(op) {}
+
 		Optional<u16> dstIdx() const
 		{
 			switch(opcode)
@@ -592,9 +732,24 @@ namespace am2017s { namespace bytecode
 
 			case Opcode::ALLOCATE:
 				return obj_alloc.dstIdx;
+			case Opcode::OBJ_LOAD:
+				return access.valueIdx;
 			case Opcode::OBJ_STORE:
 				break;
 
+			case Opcode::GLOB_LOAD:
+				return global.value;
+			case Opcode::GLOB_STORE:
+				break;
+
+			case Opcode::MEMBER_CALL:
+				return member_call.dstIdx;
+			case Opcode::VOID_MEMBER_CALL:
+				break;
+
+			case Opcode::BOUNDS_CHECK:
+				break;
+
 			default:
 				throw std::runtime_error("opcode not handled in dstIdx()");
 
@@ -604,6 +759,8 @@ namespace am2017s { namespace bytecode
 		}
 	};
 
+	static_assert(std::is_trivially_copyable<Instruction>::value, "instructions are copied as plain bytes");
+
 	struct Field {
 		u8 typeId;
 		std::string name;
@@ -648,12 +805,19 @@ namespace am2017s { namespace bytecode
 		StructType(u8 id, const std::string &name, const std::vector<Field> &fields, std::vector<u16> const& vTable)
 			: id(id), name(name), fields(fields), vTable(vTable) {}
 
-		u16 getSize() {
-			if(_size != 0) {
-				return _size;
+		/**
+		 * Assigns the field offsets, done once at load time so that packed types can be shared read-only
+		 */
+		void pack() {
+			_size = calculateSize();
+		}
+
+		u16 getSize() const {
+			if(_size == 0) {
+				throw TypeNotPackedException("type " + std::to_string(id) + " not yet packed");
 			}
 
-			return _size = calculateSize();
+			return _size;
 		}
 
 		u16 calculateSize() {
@@ -691,10 +855,33 @@ namespace am2017s { namespace bytecode
 		Type returnType;
 		std::vector<Local> variables;
 		std::vector<Instruction> instructions;
+
+		/**
+		 * Call arguments and phi edges of all instructions, referenced through OperandLists
+		 */
+		std::vector<u16> operands;
+
 		std::vector<Block> blocks;
 		u16 temporyCount;
 		std::vector<Type> temporaryTypes;
 
+		/**
+		 * Byte range of the still encoded blocks and instructions inside of an indexed image.
+		 * Both are null once the body has been decoded (or if it was decoded eagerly).
+		 */
+		u8 const* encodedBody = nullptr;
+		u8 const* encodedBodyEnd = nullptr;
+
+		bool isDecoded() const
+		{
+			return encodedBody == nullptr;
+		}
+
+		OperandRange operandsOf(OperandList list) const
+		{
+			return {operands.data() + list.offset, operands.data() + list.offset + list.count};
+		}
+
 		Local const& local(u16 idx)
 		{
 			if(parameters.size() > idx) {
@@ -716,18 +903,80 @@ namespace am2017s { namespace bytecode
 	{
 		std::vector<Field> globals;
 		std::map<u8, StructType> types;
+
+		/**
+		 * Prototypes (name, parameters, return type) are always available. Bodies of functions loaded from an
+		 * indexed image are only decoded by `function(idx)`.
+		 */
 		std::vector<Function> functions;
+
+		/**
+		 * How many CALL and CALL_VOID instructions call each function. Counted while loading plain images and
+		 * stored in the index of indexed images, so it is known before any body is decoded.
+		 */
+		std::vector<u32> callSites;
+
+		/**
+		 * Keeps the indexed image alive as long as function bodies may still be decoded from it
+		 */
+		std::shared_ptr<void const> image;
+
+		/**
+		 * Returns the function with the given index and decodes and type checks its body on first access
+		 */
+		Function& function(u16 idx);
+
+		/**
+		 * Returns the number of bytes the globals take up, packed at their `Field::offset`
+		 */
+		u32 globalsSize() const;
 	};
 
+	/**
+	 * Magic numbers of the supported container versions.
+	 *
+	 * PLAIN images store all functions back to back and are decoded completely at load time.
+	 * INDEXED images store the function prototypes together with a table of body offsets and call site counts,
+	 * so function bodies can be decoded lazily.
+	 */
+	enum : u16
+	{
+		PLAIN_MAGIC   = 1706,
+		INDEXED_MAGIC = 1707,
+	};
+
+	/**
+	 * Maps the given file into memory and decodes it in place
+	 */
 	Program loadBytecode(std::string const& filepath);
+	Program loadBytecode(u8 const* data, std::size_t size);
+	Program loadBytecode(std::istream& is);
+
+	/**
+	 * Converts a plain image into an indexed one. Function bodies are copied without being re-encoded.
+	 */
+	std::string packBytecode(u8 const* data, std::size_t size);
 
 	namespace internal
 	{
+		/**
+		 * Cursor into an in-memory (usually mapped) bytecode image
+		 */
+		struct MemoryReader
+		{
+			u8 const* cursor;
+			u8 const* end;
+		};
+
 		void read(std::istream& is, am2017s::bytecode::Program& program);
+		void read(MemoryReader& reader, am2017s::bytecode::Program& program);
 
 		template <typename T>
 		T read(std::istream& is);
 
+		template <typename T>
+		T read(MemoryReader& reader);
+
 		u16 countTemporaries(std::vector<Local>& parameters, std::vector<Instruction>& instructions);
 
 		void assignTypesToTemporaries(Program &p, Function& f);
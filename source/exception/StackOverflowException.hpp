@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <exception>
+#include <stdexcept>
+
+namespace am2017s { namespace interpreter {
+
+class StackOverflowException : public std::runtime_error {
+
+public:
+	StackOverflowException(std::string what) : std::runtime_error(what) {}
+};
+
+}}
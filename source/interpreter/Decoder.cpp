@@ -0,0 +1,643 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include <interpreter/Decoder.hpp>
+#include <interpreter/SlotAllocator.hpp>
+#include <log/Logger.hpp>
+
+namespace am2017s { namespace interpreter {
+
+Decoder::Decoder(bytecode::Program& _program, bytecode::Function const& _function, bool _compactFrames) :
+program(_program), function(_function), compactFrames(_compactFrames) {
+	u32 start = 0;
+	for(auto const& block : function.blocks) {
+		blockStarts.push_back(start);
+		start += block.instructionCount;
+	}
+	blockStarts.push_back(start);
+}
+
+static
+u8 operationType(bytecode::Type type) {
+	if(type.isArray || type.baseType > (u8) bytecode::BaseType::FLP64) {
+		return REFERENCE_TYPE;
+	}
+
+	return type.baseType;
+}
+
+static
+Handler binaryHandler(bytecode::Opcode opcode) {
+	switch(opcode) {
+		case bytecode::Opcode::ADD: return Handler::ADD;
+		case bytecode::Opcode::SUB: return Handler::SUB;
+		case bytecode::Opcode::MUL: return Handler::MUL;
+		case bytecode::Opcode::DIV: return Handler::DIV;
+		case bytecode::Opcode::MOD: return Handler::MOD;
+		case bytecode::Opcode::AND: return Handler::AND;
+		case bytecode::Opcode::OR:  return Handler::OR;
+		case bytecode::Opcode::GT:  return Handler::GT;
+		case bytecode::Opcode::GTE: return Handler::GTE;
+		case bytecode::Opcode::LT:  return Handler::LT;
+		case bytecode::Opcode::LTE: return Handler::LTE;
+		case bytecode::Opcode::EQ:  return Handler::EQ;
+		case bytecode::Opcode::NEQ: return Handler::NEQ;
+		default:
+			throw std::logic_error("not a binary opcode");
+	}
+}
+
+static
+Value constantValue(bytecode::ConstOp const& constant) {
+	Value value;
+	value.l = 0;
+
+	switch((bytecode::BaseType) constant.type.baseType) {
+		case bytecode::BaseType::BOOL:
+			value.b = (bool) constant.value;
+			break;
+
+		case bytecode::BaseType::INT8:
+			value.byte = (i8) constant.value;
+			break;
+
+		case bytecode::BaseType::INT16:
+		case bytecode::BaseType::CHAR:
+			value.s = (i16) constant.value;
+			break;
+
+		case bytecode::BaseType::INT32:
+			value.i = (i32) constant.value;
+			break;
+
+		case bytecode::BaseType::INT64:
+			value.l = constant.value;
+			break;
+
+		case bytecode::BaseType::FLP32: {
+			u32 bits = (u32) constant.value;
+			std::memcpy(&value.f, &bits, sizeof value.f);
+			break;
+		}
+
+		case bytecode::BaseType::FLP64:
+			std::memcpy(&value.d, &constant.value, sizeof value.d);
+			break;
+
+		default:
+			// null ptr
+			break;
+	}
+
+	return value;
+}
+
+void Decoder::collectPredecessors() {
+	auto const& blocks = function.blocks;
+	predecessors.assign(blocks.size(), {});
+
+	auto addEdge = [&](u16 from, u16 to) {
+		if(to >= blocks.size()) {
+			throw std::runtime_error("jump to non-existing block " + std::to_string(to) + " in " + function.name);
+		}
+
+		auto& list = predecessors[to];
+		if(std::find(list.begin(), list.end(), from) == list.end()) {
+			list.push_back(from);
+		}
+	};
+
+	u32 rip = 0;
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		for(u16 i = 0; i != blocks[block].instructionCount; ++i, ++rip) {
+			auto const& instr = function.instructions[rip];
+			if(instr.opcode == bytecode::Opcode::GOTO || instr.opcode == bytecode::Opcode::IF_GOTO) {
+				addEdge(block, instr.jump.branchIdx);
+			}
+		}
+
+		if(fallsThrough(block) && block + 1 != blocks.size()) {
+			addEdge(block, block + 1);
+		}
+	}
+}
+
+u16 Decoder::slotOf(u16 block, u16 predecessor) const {
+	auto const& list = predecessors[block];
+	return std::find(list.begin(), list.end(), predecessor) - list.begin();
+}
+
+bool Decoder::hasPhis(u16 block) const {
+	auto begin = function.instructions.begin() + blockStarts[block];
+	auto end = function.instructions.begin() + blockStarts[block + 1];
+
+	return std::any_of(begin, end, [](bytecode::Instruction const& instr) { return instr.opcode == bytecode::Opcode::PHI; });
+}
+
+bool Decoder::fallsThrough(u16 block) const {
+	if(function.blocks[block].instructionCount == 0) {
+		return true;
+	}
+
+	switch(function.instructions[blockStarts[block + 1] - 1].opcode) {
+		case bytecode::Opcode::GOTO:
+		case bytecode::Opcode::RETURN:
+		case bytecode::Opcode::RET_VOID:
+			return false;
+
+		default:
+			return true;
+	}
+}
+
+DecodedFunction Decoder::run() && {
+	auto const& blocks = function.blocks;
+
+	u32 instructionCount = 0;
+	for(auto const& block : blocks) {
+		instructionCount += block.instructionCount;
+	}
+
+	if(instructionCount != function.instructions.size()) {
+		throw std::runtime_error("blocks of " + function.name + " do not cover its instructions");
+	}
+
+	collectPredecessors();
+
+	DecodedFunction result;
+	result.parameterCount = function.parameters.size();
+	result.code.reserve(function.instructions.size() + blocks.size() + 1);
+
+	std::vector<u16> slots(function.temporyCount);
+	if(compactFrames) {
+		slots = SlotAllocator(function).run();
+	} else {
+		std::iota(slots.begin(), slots.end(), 0);
+	}
+
+	result.frameSize = std::max<u16>(result.parameterCount, slots.empty() ? 0 : *std::max_element(slots.begin(), slots.end()) + 1);
+
+	Logger::log(Topic::FRAMES) << "frame of " << function.name << ": " << function.temporyCount << " temporaries in "
+	                           << result.frameSize << " slots" << std::endl;
+
+	auto slot = [&](u16 temporary) {
+		return slots.at(temporary);
+	};
+
+	// results of void calls go to an extra slot that is never read
+	auto discarded = [&]() {
+		if(result.frameSize == result.discardSlot) {
+			result.frameSize++;
+		}
+		return result.discardSlot;
+	};
+	result.discardSlot = result.frameSize;
+
+	// pointers into `code` and `operands` are patched in once both have their final size
+	std::vector<std::pair<u32, u16>> jumps;
+	std::vector<std::pair<u32, u32>> operandLists;
+
+	// copies a list of arguments into `operands`, translated to slots
+	auto arguments = [&](bytecode::OperandList list) {
+		operandLists.emplace_back(result.code.size(), result.operands.size());
+		for(u16 temporary : function.operandsOf(list)) {
+			result.operands.push_back(slot(temporary));
+		}
+	};
+
+	auto typeOf = [&](u16 temporary) {
+		return operationType(function.temporaryTypes.at(temporary));
+	};
+
+	u32 rip = 0;
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		result.blockStarts.push_back(result.code.size());
+
+		for(u16 i = 0; i != blocks[block].instructionCount; ++i) {
+			auto const& instr = function.instructions[rip++];
+			bool last = i + 1 == blocks[block].instructionCount;
+
+			DecodedInstruction d{};
+
+			switch(instr.opcode) {
+				case bytecode::Opcode::NOP:
+					continue;
+
+				case bytecode::Opcode::CONST:
+					d.kind = Handler::CONST;
+					d.dst = slot(instr.constant.dstIdx);
+					d.value = constantValue(instr.constant);
+					break;
+
+				case bytecode::Opcode::ADD:
+				case bytecode::Opcode::SUB:
+				case bytecode::Opcode::MUL:
+				case bytecode::Opcode::DIV:
+				case bytecode::Opcode::MOD:
+				case bytecode::Opcode::AND:
+				case bytecode::Opcode::OR:
+				case bytecode::Opcode::GT:
+				case bytecode::Opcode::GTE:
+				case bytecode::Opcode::LT:
+				case bytecode::Opcode::LTE:
+				case bytecode::Opcode::EQ:
+				case bytecode::Opcode::NEQ:
+					d.kind = binaryHandler(instr.opcode);
+					d.type = typeOf(instr.binary.lsrcIdx);
+					d.dst = slot(instr.binary.dstIdx);
+					d.a = slot(instr.binary.lsrcIdx);
+					d.b = slot(instr.binary.rsrcIdx);
+					break;
+
+				case bytecode::Opcode::NEG:
+				case bytecode::Opcode::NOT:
+					d.kind = instr.opcode == bytecode::Opcode::NEG ? Handler::NEG : Handler::NOT;
+					d.type = typeOf(instr.unary.dstIdx);
+					d.dst = slot(instr.unary.dstIdx);
+					d.a = slot(instr.unary.srcIdx);
+					break;
+
+				case bytecode::Opcode::NEW:
+					d.kind = Handler::NEW;
+					d.type = instr.alloc.type.baseType;
+					d.dst = slot(instr.alloc.dstIdx);
+					d.a = slot(instr.alloc.sizeIdx);
+					d.offset = instr.alloc.type.size();
+					break;
+
+				case bytecode::Opcode::LENGTH:
+					d.kind = Handler::LENGTH;
+					d.dst = slot(instr.array.valueIdx);
+					d.a = slot(instr.array.memoryIdx);
+					break;
+
+				case bytecode::Opcode::LOAD_IDX:
+				case bytecode::Opcode::STORE_IDX:
+					d.kind = instr.opcode == bytecode::Opcode::LOAD_IDX ? Handler::LOAD_IDX : Handler::STORE_IDX;
+					d.type = typeOf(instr.array.valueIdx);
+					d.dst = slot(instr.array.valueIdx);
+					d.a = slot(instr.array.memoryIdx);
+					d.b = slot(instr.array.indexIdx);
+					break;
+
+				case bytecode::Opcode::GOTO:
+					d.kind = Handler::GOTO;
+					d.b = slotOf(instr.jump.branchIdx, block);
+					jumps.emplace_back(result.code.size(), instr.jump.branchIdx);
+					break;
+
+				case bytecode::Opcode::IF_GOTO:
+					d.kind = Handler::IF_GOTO;
+					d.a = slot(instr.jump.conditionIdx);
+					d.b = slotOf(instr.jump.branchIdx, block);
+					d.dst = last && block + 1 != blocks.size() ? slotOf(block + 1, block) : 0;
+					jumps.emplace_back(result.code.size(), instr.jump.branchIdx);
+					break;
+
+				case bytecode::Opcode::PHI: {
+					d.kind = Handler::PHI;
+					d.dst = slot(instr.phi.dstIdx);
+					operandLists.emplace_back(result.code.size(), result.operands.size());
+
+					for(u16 predecessor : predecessors[block]) {
+						u16 input = d.dst;
+						for(u16 edge = 0; edge != instr.phi.edges.count; ++edge) {
+							if(instr.phi.edge(function.operands, edge).block == predecessor) {
+								input = slot(instr.phi.edge(function.operands, edge).temp);
+								break;
+							}
+						}
+
+						result.operands.push_back(input);
+					}
+				}
+					break;
+
+				case bytecode::Opcode::CALL:
+				case bytecode::Opcode::CALL_VOID:
+					if(instr.call.functionIdx >= program.functions.size()) {
+						throw std::runtime_error("call to non-existing function " + std::to_string(instr.call.functionIdx));
+					}
+
+					d.kind = Handler::CALL;
+					d.dst = instr.opcode == bytecode::Opcode::CALL ? slot(instr.call.dstIdx) : discarded();
+					d.a = instr.call.functionIdx;
+					arguments(instr.call.args);
+					break;
+
+				case bytecode::Opcode::SPECIAL_VOID:
+					d.kind = Handler::SPECIAL_VOID;
+					d.a = instr.call.functionIdx;
+					arguments(instr.call.args);
+					break;
+
+				case bytecode::Opcode::RETURN:
+					d.kind = Handler::RET;
+					d.a = slot(instr.unary.srcIdx);
+					break;
+
+				case bytecode::Opcode::RET_VOID:
+					d.kind = Handler::RET_VOID;
+					break;
+
+				case bytecode::Opcode::ALLOCATE: {
+					auto& type = program.types.at(instr.obj_alloc.typeId);
+					d.kind = Handler::ALLOCATE;
+					d.dst = slot(instr.obj_alloc.dstIdx);
+					d.a = type.getSize();
+					d.vTable = type.vTable.data();
+				}
+					break;
+
+				case bytecode::Opcode::OBJ_LOAD:
+				case bytecode::Opcode::OBJ_STORE: {
+					auto const& type = program.types.at(instr.access.typeId);
+
+					d.kind = instr.opcode == bytecode::Opcode::OBJ_LOAD ? Handler::OBJ_LOAD : Handler::OBJ_STORE;
+					d.type = typeOf(instr.access.valueIdx);
+					d.dst = slot(instr.access.valueIdx);
+					d.a = slot(instr.access.ptrIdx);
+					d.offset = type.getOffset(instr.access.fieldIdx);
+				}
+					break;
+
+				case bytecode::Opcode::GLOB_LOAD:
+				case bytecode::Opcode::GLOB_STORE:
+					d.kind = instr.opcode == bytecode::Opcode::GLOB_LOAD ? Handler::GLOB_LOAD : Handler::GLOB_STORE;
+					d.type = typeOf(instr.global.value);
+					d.dst = slot(instr.global.value);
+					d.offset = program.globals.at(instr.global.globalIdx).offset;
+					break;
+
+				case bytecode::Opcode::MEMBER_CALL:
+				case bytecode::Opcode::VOID_MEMBER_CALL:
+					d.kind = Handler::MEMBER_CALL;
+					d.dst = instr.opcode == bytecode::Opcode::MEMBER_CALL ? slot(instr.member_call.dstIdx) : discarded();
+					d.a = slot(instr.member_call.ptrIdx);
+					d.b = instr.member_call.functionIdx;
+					arguments(instr.member_call.args);
+					break;
+
+				case bytecode::Opcode::BOUNDS_CHECK: {
+					bool range = instr.check.limitIdx != bytecode::BoundsCheckOp::NO_LIMIT;
+
+					d.kind = Handler::BOUNDS_CHECK;
+					d.a = slot(instr.check.arrayIdx);
+					d.b = slot(instr.check.indexIdx);
+					d.dst = range ? slot(instr.check.limitIdx) : 0;
+					d.offset = range;
+				}
+					break;
+
+				default:
+					throw std::runtime_error("opcode " + std::to_string((u8) instr.opcode) + " is not supported by the interpreter");
+			}
+
+			result.code.push_back(d);
+		}
+
+		// the phis of the next block have to learn where control came from
+		if(fallsThrough(block) && block + 1 != blocks.size() && hasPhis(block + 1)) {
+			DecodedInstruction d{};
+			d.kind = Handler::GOTO;
+			d.b = slotOf(block + 1, block);
+			jumps.emplace_back(result.code.size(), block + 1);
+			result.code.push_back(d);
+		}
+	}
+
+	// falling off the end of a function returns
+	DecodedInstruction end{};
+	end.kind = Handler::RET_VOID;
+	result.code.push_back(end);
+
+	for(auto jump : jumps) {
+		result.code[jump.first].target = result.code.data() + result.blockStarts[jump.second];
+	}
+
+	for(auto list : operandLists) {
+		result.code[list.first].operands = result.operands.data() + list.second;
+	}
+
+	result.slots = std::move(slots);
+	return result;
+}
+
+/**
+ * Position of a type within the TYPED_ARITHMETIC variants, or -1 if there is none.
+ * Booleans are handled as bytes and references as 64 bit integers.
+ */
+static
+i8 arithmeticVariant(u8 type) {
+	switch(type) {
+		case (u8) bytecode::BaseType::BOOL:
+		case (u8) bytecode::BaseType::INT8:  return 0;
+		case (u8) bytecode::BaseType::CHAR:
+		case (u8) bytecode::BaseType::INT16: return 1;
+		case (u8) bytecode::BaseType::INT32: return 2;
+		case (u8) bytecode::BaseType::INT64: return 3;
+		case (u8) bytecode::BaseType::FLP32: return 4;
+		case (u8) bytecode::BaseType::FLP64: return 5;
+		case REFERENCE_TYPE:                 return 3;
+		default:                             return -1;
+	}
+}
+
+static
+i8 integerVariant(u8 type) {
+	i8 variant = arithmeticVariant(type);
+	return variant < 4 ? variant : -1;
+}
+
+/**
+ * Memory accesses only depend on the width of the value
+ */
+static
+i8 widthVariant(u8 type) {
+	switch(type) {
+		case (u8) bytecode::BaseType::FLP32: return 2;
+		case (u8) bytecode::BaseType::FLP64: return 3;
+		default:                             return integerVariant(type);
+	}
+}
+
+static
+Handler quickened(Handler kind, u8 type) {
+	Handler first;
+	i8 variant;
+
+	switch(kind) {
+		case Handler::ADD: first = Handler::ADD_I8; variant = arithmeticVariant(type); break;
+		case Handler::SUB: first = Handler::SUB_I8; variant = arithmeticVariant(type); break;
+		case Handler::MUL: first = Handler::MUL_I8; variant = arithmeticVariant(type); break;
+		case Handler::DIV: first = Handler::DIV_I8; variant = arithmeticVariant(type); break;
+		case Handler::NEG: first = Handler::NEG_I8; variant = arithmeticVariant(type); break;
+		case Handler::GT:  first = Handler::GT_I8;  variant = arithmeticVariant(type); break;
+		case Handler::GTE: first = Handler::GTE_I8; variant = arithmeticVariant(type); break;
+		case Handler::LT:  first = Handler::LT_I8;  variant = arithmeticVariant(type); break;
+		case Handler::LTE: first = Handler::LTE_I8; variant = arithmeticVariant(type); break;
+		case Handler::EQ:  first = Handler::EQ_I8;  variant = arithmeticVariant(type); break;
+		case Handler::NEQ: first = Handler::NEQ_I8; variant = arithmeticVariant(type); break;
+
+		case Handler::MOD: first = Handler::MOD_I8; variant = integerVariant(type); break;
+		case Handler::AND: first = Handler::AND_I8; variant = integerVariant(type); break;
+		case Handler::OR:  first = Handler::OR_I8;  variant = integerVariant(type); break;
+
+		case Handler::LOAD_IDX:  first = Handler::LOAD_IDX_I8;  variant = widthVariant(type); break;
+		case Handler::STORE_IDX: first = Handler::STORE_IDX_I8; variant = widthVariant(type); break;
+		case Handler::OBJ_LOAD:  first = Handler::OBJ_LOAD_I8;  variant = widthVariant(type); break;
+		case Handler::OBJ_STORE: first = Handler::OBJ_STORE_I8; variant = widthVariant(type); break;
+
+		default:
+			return kind;
+	}
+
+	// arithmetic on references and the like stays generic and fails at run time
+	if(variant < 0) {
+		return kind;
+	}
+
+	// references can only be compared and moved around
+	bool memory = kind == Handler::LOAD_IDX || kind == Handler::STORE_IDX
+	           || kind == Handler::OBJ_LOAD || kind == Handler::OBJ_STORE;
+
+	if(type == REFERENCE_TYPE && !memory && kind != Handler::EQ && kind != Handler::NEQ) {
+		return kind;
+	}
+
+	return (Handler) ((u8) first + variant);
+}
+
+void quicken(DecodedFunction& function) {
+	for(DecodedInstruction& instr : function.code) {
+		instr.kind = quickened(instr.kind, instr.type);
+	}
+}
+
+#define TYPED_ARITHMETIC_NAMES(op) #op "_I8", #op "_I16", #op "_I32", #op "_I64", #op "_F32", #op "_F64"
+#define TYPED_INTEGER_NAMES(op)    #op "_I8", #op "_I16", #op "_I32", #op "_I64"
+#define SUPERINSTRUCTION_NAME(name, first, rest, body) #name,
+
+char const* nameOf(Handler handler) {
+	static char const* const names[] = {
+			"CONST", "ADD", "SUB", "MUL", "DIV", "MOD", "NEG", "NOT", "AND", "OR",
+			"GT", "GTE", "LT", "LTE", "EQ", "NEQ", "NEW", "LENGTH", "LOAD_IDX", "STORE_IDX",
+			"GOTO", "IF_GOTO", "PHI", "CALL", "SPECIAL_VOID", "RET", "RET_VOID",
+			"ALLOCATE", "OBJ_LOAD", "OBJ_STORE", "GLOB_LOAD", "GLOB_STORE", "MEMBER_CALL", "BOUNDS_CHECK",
+
+			TYPED_ARITHMETIC_NAMES(ADD),
+			TYPED_ARITHMETIC_NAMES(SUB),
+			TYPED_ARITHMETIC_NAMES(MUL),
+			TYPED_ARITHMETIC_NAMES(DIV),
+			TYPED_INTEGER_NAMES(MOD),
+			TYPED_INTEGER_NAMES(AND),
+			TYPED_INTEGER_NAMES(OR),
+			TYPED_ARITHMETIC_NAMES(NEG),
+			TYPED_ARITHMETIC_NAMES(GT),
+			TYPED_ARITHMETIC_NAMES(GTE),
+			TYPED_ARITHMETIC_NAMES(LT),
+			TYPED_ARITHMETIC_NAMES(LTE),
+			TYPED_ARITHMETIC_NAMES(EQ),
+			TYPED_ARITHMETIC_NAMES(NEQ),
+			TYPED_INTEGER_NAMES(LOAD_IDX),
+			TYPED_INTEGER_NAMES(STORE_IDX),
+			TYPED_INTEGER_NAMES(OBJ_LOAD),
+			TYPED_INTEGER_NAMES(OBJ_STORE),
+
+			SUPERINSTRUCTIONS(SUPERINSTRUCTION_NAME)
+	};
+
+	static_assert(sizeof names / sizeof *names == (size_t) Handler::COUNT, "every handler needs a name");
+
+	return names[(u8) handler];
+}
+
+#define SUPERINSTRUCTION_ENTRY(name, first, rest, body) {Handler::first, Handler::rest, Handler::name},
+
+Handler fused(Handler first, Handler rest) {
+	static constexpr struct {
+		Handler first, rest, fused;
+	} superinstructions[] = {
+			SUPERINSTRUCTIONS(SUPERINSTRUCTION_ENTRY)
+	};
+
+	for(auto& superinstruction : superinstructions) {
+		if(superinstruction.first == first && superinstruction.rest == rest) {
+			return superinstruction.fused;
+		}
+	}
+
+	return Handler::COUNT;
+}
+
+/**
+ * @return index into `code` after the last instruction of `block`
+ */
+static
+u32 blockEnd(DecodedFunction const& function, std::size_t block) {
+	return block + 1 < function.blockStarts.size() ? function.blockStarts[block + 1] : function.code.size();
+}
+
+void fuse(DecodedFunction& function) {
+	auto& code = function.code;
+
+	for(std::size_t block = 0; block != function.blockStarts.size(); ++block) {
+		u32 start = function.blockStarts[block];
+
+		// backwards, so that a fused successor can grow into a longer sequence
+		for(u32 i = blockEnd(function, block); i-- > start + 1;) {
+			Handler superinstruction = fused(code[i - 1].kind, code[i].kind);
+
+			if(superinstruction != Handler::COUNT) {
+				code[i - 1].kind = superinstruction;
+			}
+		}
+	}
+}
+
+/**
+ * @return whether nothing after `handler` in the same block is reachable from it
+ */
+static
+bool leavesBlock(Handler handler) {
+	return handler == Handler::GOTO || handler == Handler::RET || handler == Handler::RET_VOID;
+}
+
+void SequenceProfile::add(DecodedFunction const& function) {
+	for(std::size_t block = 0; block != function.blockStarts.size(); ++block) {
+		u32 start = function.blockStarts[block];
+		u32 end = blockEnd(function, block);
+
+		for(u32 i = start; i != end; ++i) {
+			std::vector<Handler> sequence{function.code[i].kind};
+
+			for(u32 j = i + 1; j != end && j != i + 3 && !leavesBlock(function.code[j - 1].kind); ++j) {
+				sequence.push_back(function.code[j].kind);
+				counts[sequence]++;
+			}
+		}
+	}
+}
+
+std::vector<std::pair<std::vector<Handler>, u64>> SequenceProfile::mostFrequent(std::size_t length, std::size_t limit) const {
+	std::vector<std::pair<std::vector<Handler>, u64>> result;
+
+	for(auto& entry : counts) {
+		if(entry.first.size() == length) {
+			result.push_back(entry);
+		}
+	}
+
+	std::stable_sort(result.begin(), result.end(), [](auto const& a, auto const& b) {
+		return a.second > b.second;
+	});
+
+	if(result.size() > limit) {
+		result.resize(limit);
+	}
+
+	return result;
+}
+
+}}
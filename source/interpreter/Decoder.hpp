@@ -0,0 +1,266 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <bytecode.hpp>
+#include <interpreter/Superinstructions.hpp>
+
+namespace am2017s { namespace interpreter {
+
+union Value {
+	bool b;
+	i8 byte;
+	i16 s;
+	i32 i;
+	i64 l;
+
+	float f;
+	double d;
+
+	void* ref;
+};
+
+/**
+ * Operation type of array and struct references in DecodedInstruction::type
+ */
+constexpr u8 REFERENCE_TYPE = 0xFF;
+
+#define TYPED_ARITHMETIC(op) op##_I8, op##_I16, op##_I32, op##_I64, op##_F32, op##_F64
+#define TYPED_INTEGER(op)    op##_I8, op##_I16, op##_I32, op##_I64
+#define SUPERINSTRUCTION(name, first, rest, body) name,
+
+/**
+ * Handlers of the interpreter. The order has to match the label table in InterpretEngine::executeFunction.
+ *
+ * The generic handlers switch on DecodedInstruction::type, the typed ones are picked by `quicken`. Typed
+ * memory accesses only care about the width, e.g. f64 values are loaded by LOAD_IDX_I64. The
+ * superinstructions are picked by `fuse`.
+ */
+enum class Handler : u8 {
+	CONST,
+	ADD,
+	SUB,
+	MUL,
+	DIV,
+	MOD,
+	NEG,
+	NOT,
+	AND,
+	OR,
+	GT,
+	GTE,
+	LT,
+	LTE,
+	EQ,
+	NEQ,
+	NEW,
+	LENGTH,
+	LOAD_IDX,
+	STORE_IDX,
+	GOTO,
+	IF_GOTO,
+	PHI,
+	CALL,
+	SPECIAL_VOID,
+	RET,
+	RET_VOID,
+	ALLOCATE,
+	OBJ_LOAD,
+	OBJ_STORE,
+	GLOB_LOAD,
+	GLOB_STORE,
+	MEMBER_CALL,
+	BOUNDS_CHECK,
+
+	TYPED_ARITHMETIC(ADD),
+	TYPED_ARITHMETIC(SUB),
+	TYPED_ARITHMETIC(MUL),
+	TYPED_ARITHMETIC(DIV),
+	TYPED_INTEGER(MOD),
+	TYPED_INTEGER(AND),
+	TYPED_INTEGER(OR),
+	TYPED_ARITHMETIC(NEG),
+	TYPED_ARITHMETIC(GT),
+	TYPED_ARITHMETIC(GTE),
+	TYPED_ARITHMETIC(LT),
+	TYPED_ARITHMETIC(LTE),
+	TYPED_ARITHMETIC(EQ),
+	TYPED_ARITHMETIC(NEQ),
+	TYPED_INTEGER(LOAD_IDX),
+	TYPED_INTEGER(STORE_IDX),
+	TYPED_INTEGER(OBJ_LOAD),
+	TYPED_INTEGER(OBJ_STORE),
+
+	SUPERINSTRUCTIONS(SUPERINSTRUCTION)
+
+	COUNT
+};
+
+#undef TYPED_ARITHMETIC
+#undef TYPED_INTEGER
+#undef SUPERINSTRUCTION
+
+char const* nameOf(Handler handler);
+
+/**
+ * An instruction whose operands have been resolved ahead of time.
+ *
+ * `dst`, `a` and `b` hold frame slots unless noted otherwise:
+ *  - CONST:        dst, value
+ *  - binary ops:   dst = a op b
+ *  - NEG, NOT:     dst = op a
+ *  - NEW:          dst, a = element count, offset = element size
+ *  - LENGTH:       dst, a = array
+ *  - LOAD_IDX:     dst = a[b]
+ *  - STORE_IDX:    a[b] = dst
+ *  - GOTO:         target, b = predecessor slot in the target block
+ *  - IF_GOTO:      a = condition, target, b = slot in the target block, dst = slot in the fall through block
+ *  - PHI:          dst = operands[predecessor slot]
+ *  - CALL:         dst (discardSlot for void calls), a = function index, operands = arguments
+ *  - SPECIAL_VOID: a = builtin, operands = arguments
+ *  - RET:          a
+ *  - ALLOCATE:     dst, a = object size, vTable
+ *  - OBJ_LOAD:     dst = *(a + offset)
+ *  - OBJ_STORE:    *(a + offset) = dst
+ *  - GLOB_LOAD:    dst = *(globals + offset)
+ *  - GLOB_STORE:   *(globals + offset) = dst
+ *  - MEMBER_CALL:  dst, a = receiver, b = vTable slot, operands = arguments
+ *  - BOUNDS_CHECK: a = array, b = index, offset = 1 if every index of [b, dst) is checked instead
+ */
+struct DecodedInstruction {
+	/**
+	 * @brief address of the label executing this instruction (direct threading)
+	 */
+	void const* handler;
+
+	Handler kind;
+
+	/**
+	 * @brief BaseType the operation works on, REFERENCE_TYPE for arrays and structs
+	 */
+	u8 type;
+
+	u16 dst;
+	u16 a;
+	u16 b;
+
+	union {
+		Value value;
+		DecodedInstruction const* target;
+		u16 const* operands;
+		u32 offset;
+		void const* vTable;
+	};
+};
+
+static_assert(sizeof(DecodedInstruction) == 24, "decoded instructions should stay compact");
+
+struct DecodedFunction {
+	std::vector<DecodedInstruction> code;
+
+	/**
+	 * @brief phi inputs (indexed by predecessor slot) and call arguments
+	 */
+	std::vector<u16> operands;
+
+	/**
+	 * @brief index into `code` of the first instruction of each block
+	 */
+	std::vector<u32> blockStarts;
+
+	/**
+	 * @brief position of the function in the program
+	 */
+	u16 index;
+
+	u16 frameSize;
+	u16 parameterCount;
+
+	/**
+	 * @brief receives the results of void calls
+	 */
+	u16 discardSlot;
+
+	/**
+	 * @brief frame slot of every temporary
+	 */
+	std::vector<u16> slots;
+
+	DecodedFunction() = default;
+
+	// `code` points into itself and into `operands`
+	DecodedFunction(DecodedFunction&&) = default;
+	DecodedFunction(DecodedFunction const&) = delete;
+	DecodedFunction& operator=(DecodedFunction const&) = delete;
+};
+
+/**
+ * Translates a bytecode function into the stream executed by the interpreter.
+ *
+ * Jump targets are resolved to instruction pointers, phi edges to predecessor slots (the jump into a block
+ * tells the phis which slot to read), and field accesses to byte offsets. Handler addresses are left empty;
+ * the engine fills them in from its label table.
+ */
+class Decoder {
+private:
+	bytecode::Program& program;
+	bytecode::Function const& function;
+	bool compactFrames;
+
+	/**
+	 * @brief distinct predecessors of every block, the position of a block in this list is its slot
+	 */
+	std::vector<std::vector<u16>> predecessors;
+
+	/**
+	 * @brief index of the first instruction of every block, followed by the number of instructions
+	 */
+	std::vector<u32> blockStarts;
+
+	void collectPredecessors();
+	u16 slotOf(u16 block, u16 predecessor) const;
+	bool hasPhis(u16 block) const;
+	bool fallsThrough(u16 block) const;
+
+public:
+	/**
+	 * @param _compactFrames let temporaries share frame slots (see SlotAllocator), otherwise every temporary
+	 *                       gets its own
+	 */
+	Decoder(bytecode::Program& _program, bytecode::Function const& _function, bool _compactFrames = false);
+	DecodedFunction run() &&;
+};
+
+/**
+ * Replaces generic handlers by ones specialized for the operand type, so they do not need to switch on it
+ */
+void quicken(DecodedFunction& function);
+
+/**
+ * @return the superinstruction for `first` directly followed by `rest`, Handler::COUNT if there is none
+ */
+Handler fused(Handler first, Handler rest);
+
+/**
+ * Replaces sequences of handlers within a block by superinstructions. Expects a quickened function.
+ */
+void fuse(DecodedFunction& function);
+
+/**
+ * Counts how often sequences of handlers follow each other within a block, to find superinstructions
+ */
+class SequenceProfile {
+private:
+	std::map<std::vector<Handler>, u64> counts;
+
+public:
+	void add(DecodedFunction const& function);
+
+	/**
+	 * @return the `limit` most frequent sequences of `length` handlers, most frequent first
+	 */
+	std::vector<std::pair<std::vector<Handler>, u64>> mostFrequent(std::size_t length, std::size_t limit) const;
+};
+
+}}
@@ -1,13 +1,36 @@
+#include <algorithm>
+#include <cstring>
+
 #include <interpreter/InterpretEngine.hpp>
 #include <jit/allocator/memory/HeapAllocator.hpp>
+#include <jit/optimizations/BoundsCheckElimination.hpp>
 #include <jit/SpecialFunctions.hpp>
 
 
 namespace am2017s { namespace interpreter {
 
 InterpretEngine::InterpretEngine(bytecode::Program program, Options const& options) :
-program(std::move(program)), options(options) {
+program(std::move(program)), options(options), stack(options.stackSize) {
+	globalStorage.resize((this->program.globalsSize() + 7) / 8);
+	globals = (u8*) globalStorage.data();
+}
 
+void InterpretEngine::tierTo(Tier* tier, u8* sharedGlobals) {
+	this->tier = tier;
+	globals = sharedGlobals;
+}
+
+void InterpretEngine::reset() {
+
+	// functions are decoded when they are called for the first time
+	code.clear();
+	code.resize(program.functions.size());
+
+	hotness.assign(program.functions.size(), 0);
+	tiering.assign(program.functions.size(), Tiering::COUNTING);
+
+	std::memset(globals, 0, program.globalsSize());
+	stack.clear();
 }
 
 static
@@ -19,81 +42,160 @@ u16 findMain(std::vector<bytecode::Function> const& functions) {
 	throw std::logic_error("main function not found");
 }
 
-static
-u16 blockIdxForInstruction(u16 instrId, std::vector<bytecode::Block> const& blocks) {
-	u16 instrs = 0;
-	for(u16 blockIdx = 0; blockIdx != blocks.size(); ++blockIdx) {
-		instrs += blocks[blockIdx].instructionCount;
-		if(instrs > instrId) {
-			return blockIdx;
+DecodedFunction const& InterpretEngine::decoded(u16 idx) {
+	auto& slot = code[idx];
+
+	if(!slot) {
+		if(options.boundsChecks) {
+			bytecode::Function checked = program.function(idx);
+			jit::insertBoundsChecks(checked);
+			slot = std::make_unique<DecodedFunction>(Decoder(program, checked, options.compactFrames).run());
+		} else {
+			slot = std::make_unique<DecodedFunction>(Decoder(program, program.function(idx), options.compactFrames).run());
+		}
+
+		if(options.quicken) {
+			quicken(*slot);
+
+			if(options.superinstructions) {
+				fuse(*slot);
+			}
 		}
+
+		for(DecodedInstruction& instr : slot->code) {
+			instr.handler = handlers[(u8) instr.kind];
+		}
+
+		slot->index = idx;
+	}
+
+	return *slot;
+}
+
+bool InterpretEngine::hot(u16 idx) {
+	switch(tiering[idx]) {
+		case Tiering::NATIVE:
+			return true;
+
+		case Tiering::INTERPRETED:
+			return false;
+
+		case Tiering::COMPILING:
+			tiering[idx] = tier->poll(idx);
+			return tiering[idx] == Tiering::NATIVE;
+
+		case Tiering::COUNTING:
+			if(++hotness[idx] < options.tierThreshold) {
+				return false;
+			}
+
+			tiering[idx] = tier->tierUp(idx);
+			return tiering[idx] == Tiering::NATIVE;
+	}
+
+	return false;
+}
+
+bool InterpretEngine::enterLoop(DecodedFunction const& function, DecodedInstruction const* jump, Value const* frame,
+                                Value& result) {
+	auto blockOf = [&](DecodedInstruction const* instr) {
+		auto const& starts = function.blockStarts;
+		return (u16) (std::upper_bound(starts.begin(), starts.end(), instr - function.code.data()) - starts.begin() - 1);
+	};
+
+	return tier->enterLoop(function.index, blockOf(jump->target), blockOf(jump), frame, function.slots, result);
+}
+
+Value InterpretEngine::callNative(u16 idx, Value const* frame, u16 const* arguments) {
+	// the tier is done with the arguments once the compiled code runs, so nested calls may reuse them
+	nativeArguments.resize(program.functions[idx].parameters.size());
+	for(std::size_t i = 0; i != nativeArguments.size(); ++i) {
+		nativeArguments[i] = frame[arguments[i]];
 	}
 
-	throw std::runtime_error("no block could be found");
+	return tier->callNative(idx, nativeArguments.data());
 }
 
-#define DISPATCH        { prev = rip; goto *labels[(u8)(++rip)->opcode];};
-#define DISPATCH_DIRECT { goto *labels[(u8)(  rip)->opcode];};
+#define DISPATCH        { goto *(++rip)->handler; };
+#define DISPATCH_DIRECT { goto *rip->handler; };
+
+// jumps backwards are loop iterations, which make a function hot as well. Once it is, the rest of the
+// activation may continue in compiled code.
+#define JUMP(slot) { \
+	edge = (slot); \
+	if(tiered && rip->target <= rip && hot(function->index)) { \
+		Value osrResult; \
+		if(enterLoop(*function, rip, values, osrResult)) { \
+			RETURN(osrResult); \
+		} \
+	} \
+	rip = rip->target; \
+	DISPATCH_DIRECT; \
+};
 
 #define CMP(op) { \
-	auto instr = rip->binary; \
-	switch((bytecode::BaseType) function.temporaryTypes[instr.lsrcIdx].baseType) { \
-		case bytecode::BaseType::INT8: \
-		values[instr.dstIdx].b = values[instr.lsrcIdx].byte op values[instr.rsrcIdx].byte; \
+	auto instr = *rip; \
+	switch(instr.type) { \
+		case (u8) bytecode::BaseType::INT8: \
+		values[instr.dst].b = values[instr.a].byte op values[instr.b].byte; \
 		break; \
 \
-		case bytecode::BaseType::INT16: \
-		case bytecode::BaseType::CHAR: \
-		values[instr.dstIdx].b = values[instr.lsrcIdx].s op values[instr.rsrcIdx].s; \
+		case (u8) bytecode::BaseType::INT16: \
+		case (u8) bytecode::BaseType::CHAR: \
+		values[instr.dst].b = values[instr.a].s op values[instr.b].s; \
 		break; \
 \
-		case bytecode::BaseType::INT32: \
-		values[instr.dstIdx].b = values[instr.lsrcIdx].i op values[instr.rsrcIdx].i; \
+		case (u8) bytecode::BaseType::INT32: \
+		values[instr.dst].b = values[instr.a].i op values[instr.b].i; \
 		break; \
 \
-		case bytecode::BaseType::INT64: \
-		values[instr.dstIdx].b = values[instr.lsrcIdx].l op values[instr.rsrcIdx].l; \
+		case (u8) bytecode::BaseType::INT64: \
+		values[instr.dst].b = values[instr.a].l op values[instr.b].l; \
 		break; \
 \
-		case bytecode::BaseType::FLP32: \
-		values[instr.dstIdx].b = values[instr.lsrcIdx].f op values[instr.rsrcIdx].f; \
+		case (u8) bytecode::BaseType::FLP32: \
+		values[instr.dst].b = values[instr.a].f op values[instr.b].f; \
 		break; \
 \
-		case bytecode::BaseType::FLP64: \
-		values[instr.dstIdx].b = values[instr.lsrcIdx].d op values[instr.rsrcIdx].d; \
+		case (u8) bytecode::BaseType::FLP64: \
+		values[instr.dst].b = values[instr.a].d op values[instr.b].d; \
+		break; \
+\
+		case (u8) bytecode::BaseType::BOOL: \
+		values[instr.dst].b = values[instr.a].b op values[instr.b].b; \
 		break; \
 \
 		default: \
-		values[instr.dstIdx].b = values[instr.lsrcIdx].ref op values[instr.rsrcIdx].ref; \
+		values[instr.dst].b = values[instr.a].ref op values[instr.b].ref; \
 	} \
 }
 
 #define BINARY(op) { \
-	auto instr = rip->binary; \
-	switch((bytecode::BaseType) function.temporaryTypes[instr.lsrcIdx].baseType) { \
-		case bytecode::BaseType::INT8: \
-		values[instr.dstIdx].byte = values[instr.lsrcIdx].byte op values[instr.rsrcIdx].byte; \
+	auto instr = *rip; \
+	switch(instr.type) { \
+		case (u8) bytecode::BaseType::INT8: \
+		values[instr.dst].byte = values[instr.a].byte op values[instr.b].byte; \
 		break; \
 \
-		case bytecode::BaseType::INT16: \
-		case bytecode::BaseType::CHAR: \
-		values[instr.dstIdx].s = values[instr.lsrcIdx].s op values[instr.rsrcIdx].s; \
+		case (u8) bytecode::BaseType::INT16: \
+		case (u8) bytecode::BaseType::CHAR: \
+		values[instr.dst].s = values[instr.a].s op values[instr.b].s; \
 		break; \
 \
-		case bytecode::BaseType::INT32: \
-		values[instr.dstIdx].i = values[instr.lsrcIdx].i op values[instr.rsrcIdx].i; \
+		case (u8) bytecode::BaseType::INT32: \
+		values[instr.dst].i = values[instr.a].i op values[instr.b].i; \
 		break; \
 \
-		case bytecode::BaseType::INT64: \
-		values[instr.dstIdx].l = values[instr.lsrcIdx].l op values[instr.rsrcIdx].l; \
+		case (u8) bytecode::BaseType::INT64: \
+		values[instr.dst].l = values[instr.a].l op values[instr.b].l; \
 		break; \
 \
-		case bytecode::BaseType::FLP32: \
-		values[instr.dstIdx].s = values[instr.lsrcIdx].f op values[instr.rsrcIdx].f; \
+		case (u8) bytecode::BaseType::FLP32: \
+		values[instr.dst].f = values[instr.a].f op values[instr.b].f; \
 		break; \
 \
-		case bytecode::BaseType::FLP64: \
-		values[instr.dstIdx].d = values[instr.lsrcIdx].d op values[instr.rsrcIdx].d; \
+		case (u8) bytecode::BaseType::FLP64: \
+		values[instr.dst].d = values[instr.a].d op values[instr.b].d; \
 		break; \
 \
 		default: \
@@ -102,23 +204,27 @@ u16 blockIdxForInstruction(u16 instrId, std::vector<bytecode::Block> const& bloc
 }
 
 #define BINARYINT(op) { \
-	auto instr = rip->binary; \
-	switch((bytecode::BaseType) function.temporaryTypes[instr.lsrcIdx].baseType) { \
-		case bytecode::BaseType::INT8: \
-		values[instr.dstIdx].byte = values[instr.lsrcIdx].byte op values[instr.rsrcIdx].byte; \
+	auto instr = *rip; \
+	switch(instr.type) { \
+		case (u8) bytecode::BaseType::BOOL: \
+		values[instr.dst].b = values[instr.a].b op values[instr.b].b; \
 		break; \
 \
-		case bytecode::BaseType::INT16: \
-		case bytecode::BaseType::CHAR: \
-		values[instr.dstIdx].s = values[instr.lsrcIdx].s op values[instr.rsrcIdx].s; \
+		case (u8) bytecode::BaseType::INT8: \
+		values[instr.dst].byte = values[instr.a].byte op values[instr.b].byte; \
 		break; \
 \
-		case bytecode::BaseType::INT32: \
-		values[instr.dstIdx].i = values[instr.lsrcIdx].i op values[instr.rsrcIdx].i; \
+		case (u8) bytecode::BaseType::INT16: \
+		case (u8) bytecode::BaseType::CHAR: \
+		values[instr.dst].s = values[instr.a].s op values[instr.b].s; \
 		break; \
 \
-		case bytecode::BaseType::INT64: \
-		values[instr.dstIdx].l = values[instr.lsrcIdx].l op values[instr.rsrcIdx].l; \
+		case (u8) bytecode::BaseType::INT32: \
+		values[instr.dst].i = values[instr.a].i op values[instr.b].i; \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT64: \
+		values[instr.dst].l = values[instr.a].l op values[instr.b].l; \
 		break; \
 \
 		default: \
@@ -126,131 +232,276 @@ u16 blockIdxForInstruction(u16 instrId, std::vector<bytecode::Block> const& bloc
 	} \
 }
 
-void InterpretEngine::executeFunction(u16 idx, u16* args, Value* prevFrame, u16 retIdx) {
+/**
+ * Loads `values[rip->dst]` from `address`, with the width of the operation type
+ */
+#define LOAD_FROM(address) { \
+	auto& instr = *rip; \
+	void* offset = (address); \
+	switch(instr.type) { \
+		case (u8) bytecode::BaseType::BOOL: \
+		values[instr.dst].b = *((u8*)(offset)); \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT8: \
+		values[instr.dst].byte = *((u8*)(offset)); \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT16: \
+		case (u8) bytecode::BaseType::CHAR: \
+		values[instr.dst].s = *((i16*)(offset)); \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT32: \
+		values[instr.dst].i = *((i32*)(offset)); \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT64: \
+		values[instr.dst].l = *((i64*)(offset)); \
+		break; \
+\
+		case (u8) bytecode::BaseType::FLP32: \
+		values[instr.dst].f = *((float*)(offset)); \
+		break; \
+\
+		case (u8) bytecode::BaseType::FLP64: \
+		values[instr.dst].d = *((double*)(offset)); \
+		break; \
+\
+		default: \
+		values[instr.dst].ref = (void*) *((i64*)(offset)); \
+	} \
+}
 
-	bytecode::Function &function = program.functions.at(idx);
-	Value* values = (Value*) malloc(sizeof(Value) * function.temporyCount);
+/**
+ * Stores `values[rip->dst]` to `address`, with the width of the operation type
+ */
+#define STORE_TO(address) { \
+	auto& instr = *rip; \
+	void* offset = (address); \
+	switch(instr.type) { \
+		case (u8) bytecode::BaseType::BOOL: \
+		*((u8*)(offset)) = (u8) values[instr.dst].b; \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT8: \
+		*((u8*)(offset)) = values[instr.dst].byte; \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT16: \
+		case (u8) bytecode::BaseType::CHAR: \
+		*((i16*)(offset)) = values[instr.dst].s; \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT32: \
+		*((i32*)(offset)) = values[instr.dst].i; \
+		break; \
+\
+		case (u8) bytecode::BaseType::INT64: \
+		*((i64*)(offset)) = values[instr.dst].l; \
+		break; \
+\
+		case (u8) bytecode::BaseType::FLP32: \
+		*((float*)(offset)) = values[instr.dst].f; \
+		break; \
+\
+		case (u8) bytecode::BaseType::FLP64: \
+		*((double*)(offset)) = values[instr.dst].d; \
+		break; \
+\
+		default: \
+		*(i64*)(offset) = (i64) values[instr.dst].ref; \
+	} \
+}
 
-	for(int i = 0; i != function.parameters.size(); ++i) {
-		values[i] = prevFrame[args[i]];
-	}
+#define TYPED_ARITHMETIC_LABELS(op) &&op##_i8, &&op##_i16, &&op##_i32, &&op##_i64, &&op##_f32, &&op##_f64
+#define TYPED_INTEGER_LABELS(op)    &&op##_i8, &&op##_i16, &&op##_i32, &&op##_i64
+
+#define CONST_BODY \
+	values[rip->dst] = rip->value;
+
+#define TYPED_BINARY_BODY(member, op) \
+	values[rip->dst].member = values[rip->a].member op values[rip->b].member;
+
+#define TYPED_CMP_BODY(member, op) \
+	values[rip->dst].b = values[rip->a].member op values[rip->b].member;
+
+#define TYPED_LOAD_IDX_BODY(member, type) \
+	values[rip->dst].member = ((type*) values[rip->a].ref)[values[rip->b].i];
+
+#define TYPED_BINARY(label, member, op)      label: TYPED_BINARY_BODY(member, op) DISPATCH;
+#define TYPED_CMP(label, member, op)         label: TYPED_CMP_BODY(member, op) DISPATCH;
+#define TYPED_LOAD_IDX(label, member, type)  label: TYPED_LOAD_IDX_BODY(member, type) DISPATCH;
+
+#define TYPED_NEG(label, member) \
+	label: values[rip->dst].member = -values[rip->a].member; DISPATCH;
+
+#define TYPED_STORE_IDX(label, member, type) \
+	label: ((type*) values[rip->a].ref)[values[rip->b].i] = values[rip->dst].member; DISPATCH;
+
+#define TYPED_OBJ_LOAD(label, member, type) \
+	label: values[rip->dst].member = *(type*) ((u8*) values[rip->a].ref + rip->offset); DISPATCH;
+
+#define TYPED_OBJ_STORE(label, member, type) \
+	label: *(type*) ((u8*) values[rip->a].ref + rip->offset) = values[rip->dst].member; DISPATCH;
+
+// the handler of the rest is a constant, so this is a direct jump
+#define SUPERINSTRUCTION_LABEL(name, first, rest, body) &&fused_##name,
+#define SUPERINSTRUCTION_HANDLER(name, first, rest, body) \
+	fused_##name: body ++rip; goto *labels[(u8) Handler::rest];
+
+#define TYPED_ARITHMETIC_HANDLERS(name, handler, op) \
+	handler(name##_i8, byte, op) \
+	handler(name##_i16, s, op) \
+	handler(name##_i32, i, op) \
+	handler(name##_i64, l, op) \
+	handler(name##_f32, f, op) \
+	handler(name##_f64, d, op)
+
+#define TYPED_INTEGER_HANDLERS(name, handler, op) \
+	handler(name##_i8, byte, op) \
+	handler(name##_i16, s, op) \
+	handler(name##_i32, i, op) \
+	handler(name##_i64, l, op)
+
+#define TYPED_MEMORY_HANDLERS(name, handler) \
+	handler(name##_i8, byte, i8) \
+	handler(name##_i16, s, i16) \
+	handler(name##_i32, i, i32) \
+	handler(name##_i64, l, i64)
+
+/**
+ * Enters `callee` with the arguments `args` of the current frame. The caller continues after `rip` on return.
+ * Hot callees run their compiled code instead when tiered.
+ */
+#define CALL(callee, args) { \
+	u16 calleeIdx = (callee); \
+	if(tiered && hot(calleeIdx)) { \
+		values[rip->dst] = callNative(calleeIdx, values, (args)); \
+		DISPATCH; \
+	} \
+	DecodedFunction const* target = &decoded(calleeIdx); \
+	Value* frame = stack.push({rip, function, values, rip->dst}, target->frameSize); \
+	u16 const* arguments = (args); \
+	for(int i = 0; i != target->parameterCount; ++i) { \
+		frame[i] = values[arguments[i]]; \
+	} \
+	function = target; \
+	values = frame; \
+	rip = target->code.data(); \
+	DISPATCH_DIRECT; \
+}
+
+/**
+ * Pops the current frame and continues in the caller, or leaves the interpreter if there is none
+ */
+#define RETURN(value) { \
+	Value result = (value); \
+	Frame caller = stack.pop(function->frameSize); \
+	if(!caller.returnPc) { \
+		return result; \
+	} \
+	caller.values[caller.returnSlot] = result; \
+	RESUME(caller); \
+}
+
+#define RETURN_VOID { \
+	Frame caller = stack.pop(function->frameSize); \
+	if(!caller.returnPc) { \
+		return Value{}; \
+	} \
+	RESUME(caller); \
+}
 
-	auto prev = function.instructions.data();
-	auto rip = function.instructions.data();
+#define RESUME(caller) { \
+	function = caller.function; \
+	values = caller.values; \
+	rip = caller.returnPc; \
+	DISPATCH; \
+}
 
+Value InterpretEngine::executeFunction(u16 idx, Value const* arguments) {
+
+	// same order as `Handler`
 	static constexpr void* const labels[] = {
-			&&nop,        // 0
-			&&invalid,      // 1
-			&&invalid,      // 2
-			&&constant,   // 3
+			&&constant,
 			&&add,
 			&&sub,
 			&&mul,
 			&&div,
 			&&mod,
 			&&neg,
-			&&gt,      // 10
-			&&invalid,
+			&&not_,
+			&&and_,
+			&&or_,
+			&&gt,
+			&&gte,
+			&&lt,
+			&&lte,
 			&&eq,
 			&&neq,
-			&&lte,
-			&&lt,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&not_,      // 20
 			&&new_,
-			&&goto_,
-			&&ifgoto,     // 23
-			&&invalid,
 			&&length,
+			&&loadidx,
+			&&storeidx,
+			&&goto_,
+			&&ifgoto,
 			&&phi,
-			&&invalid,
 			&&call,
-			&&invalid,
-			&&call,      // 30
 			&&specialcall,
-			&&retvoid,    // 32
-			&&ret,        // 33
-			&&allocate,   // 34
-			&&load,       // 35
-			&&store,      // 36
+			&&ret,
+			&&retvoid,
+			&&allocate,
+			&&load,
+			&&store,
 			&&load_global,
 			&&store_global,
-			&&call_member_void,
-			&&call_member,// 40
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,      // 50
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,
-			&&invalid,      // 60
-			&&invalid,
-			&&invalid,
-			&&loadidx,
-			&&storeidx,
+			&&call_member,
+			&&bounds_check,
+
+			TYPED_ARITHMETIC_LABELS(add),
+			TYPED_ARITHMETIC_LABELS(sub),
+			TYPED_ARITHMETIC_LABELS(mul),
+			TYPED_ARITHMETIC_LABELS(div),
+			TYPED_INTEGER_LABELS(mod),
+			TYPED_INTEGER_LABELS(and),
+			TYPED_INTEGER_LABELS(or),
+			TYPED_ARITHMETIC_LABELS(neg),
+			TYPED_ARITHMETIC_LABELS(gt),
+			TYPED_ARITHMETIC_LABELS(gte),
+			TYPED_ARITHMETIC_LABELS(lt),
+			TYPED_ARITHMETIC_LABELS(lte),
+			TYPED_ARITHMETIC_LABELS(eq),
+			TYPED_ARITHMETIC_LABELS(neq),
+			TYPED_INTEGER_LABELS(loadidx),
+			TYPED_INTEGER_LABELS(storeidx),
+			TYPED_INTEGER_LABELS(load),
+			TYPED_INTEGER_LABELS(store),
+
+			SUPERINSTRUCTIONS(SUPERINSTRUCTION_LABEL)
 	};
 
-	DISPATCH_DIRECT;
-
-invalid:
-	std::cout << "Invalid opcode: " << std::to_string((u8)rip->opcode) << std::endl;
-	throw std::runtime_error("Invalid opcode");
+	static_assert(sizeof labels / sizeof *labels == (size_t) Handler::COUNT, "every handler needs a label");
 
-nop: DISPATCH;
+	handlers = labels;
 
-constant: {
-		auto& instr = rip->constant;
-		switch((bytecode::BaseType)instr.type.baseType) {
-			case bytecode::BaseType::BOOL:
-				values[instr.dstIdx].b = (bool) instr.value;
-				break;
+	bool const tiered = tier != nullptr;
 
-			case bytecode::BaseType::INT8:
-				values[instr.dstIdx].byte = (u8) instr.value;
-				break;
+	// the outermost frame has no caller
+	DecodedInstruction const* rip = nullptr;
+	DecodedFunction const* function = &decoded(idx);
+	Value* values = stack.push({nullptr, nullptr, nullptr, 0}, function->frameSize);
+	std::copy(arguments, arguments + function->parameterCount, values);
 
-			case bytecode::BaseType::INT16:
-			case bytecode::BaseType::CHAR:
-				values[instr.dstIdx].s = (i16) instr.value;
-				break;
+	// predecessor slot of the current block, set by every jump. Calls leave it alone: they never happen
+	// before the phis of a block, and the callee's jumps do not matter once it returned.
+	u16 edge = 0;
 
-			case bytecode::BaseType::INT32:
-				values[instr.dstIdx].i = (i32) instr.value;
-				break;
-
-			case bytecode::BaseType::INT64:
-				values[instr.dstIdx].l = (i64) instr.value;
-				break;
-
-			case bytecode::BaseType::FLP32:
-				values[instr.dstIdx].f = reinterpret_cast<float&>(instr.value);
-				break;
-
-			case bytecode::BaseType::FLP64:
-				values[instr.dstIdx].d = reinterpret_cast<double&>(instr.value);
-				break;
+	rip = function->code.data();
+	DISPATCH_DIRECT;
 
-			default:
-				// null ptr
-				values[instr.dstIdx].l = 0;
-		}
-	};
+constant:
+	CONST_BODY
 	DISPATCH;
 
 add: BINARY(+); DISPATCH;
@@ -258,34 +509,36 @@ sub: BINARY(-); DISPATCH;
 mul: BINARY(*); DISPATCH;
 div: BINARY(/); DISPATCH;
 mod: BINARYINT(%); DISPATCH;
+and_: BINARYINT(&); DISPATCH;
+or_: BINARYINT(|); DISPATCH;
 
 neg: {
-	auto& instr = rip->unary;
-	switch((bytecode::BaseType)function.temporaryTypes[instr.dstIdx].baseType) {
+	auto& instr = *rip;
+	switch(instr.type) {
 
-		case bytecode::BaseType::INT8:
-			values[instr.dstIdx].byte = -values[instr.srcIdx].byte;
+		case (u8) bytecode::BaseType::INT8:
+			values[instr.dst].byte = -values[instr.a].byte;
 			break;
 
-		case bytecode::BaseType::INT16:
-		case bytecode::BaseType::CHAR:
-			values[instr.dstIdx].s = -values[instr.srcIdx].s;
+		case (u8) bytecode::BaseType::INT16:
+		case (u8) bytecode::BaseType::CHAR:
+			values[instr.dst].s = -values[instr.a].s;
 			break;
 
-		case bytecode::BaseType::INT32:
-			values[instr.dstIdx].i = -values[instr.srcIdx].i;
+		case (u8) bytecode::BaseType::INT32:
+			values[instr.dst].i = -values[instr.a].i;
 			break;
 
-		case bytecode::BaseType::INT64:
-			values[instr.dstIdx].l = -values[instr.srcIdx].l;
+		case (u8) bytecode::BaseType::INT64:
+			values[instr.dst].l = -values[instr.a].l;
 			break;
 
-		case bytecode::BaseType::FLP32:
-			values[instr.dstIdx].f = -values[instr.srcIdx].f;
+		case (u8) bytecode::BaseType::FLP32:
+			values[instr.dst].f = -values[instr.a].f;
 			break;
 
-		case bytecode::BaseType::FLP64:
-			values[instr.dstIdx].d = -values[instr.srcIdx].d;
+		case (u8) bytecode::BaseType::FLP64:
+			values[instr.dst].d = -values[instr.a].d;
 			break;
 
 		default:
@@ -295,72 +548,43 @@ neg: {
 };
 
 gt: CMP(>) DISPATCH;
+gte: CMP(>=) DISPATCH;
 lt: CMP(<) DISPATCH;
 lte: CMP(<=) DISPATCH;
 eq: CMP(==) DISPATCH;
 neq: CMP(!=) DISPATCH;
 
 not_ : {
-	values[rip->unary.dstIdx].b = !values[rip->unary.srcIdx].b;
+	values[rip->dst].b = !values[rip->a].b;
 	DISPATCH;
 };
 
 new_: {
-	auto& instr = rip->alloc;
-	values[instr.dstIdx].ref = jit::allocator::allocate_array(nullptr, instr.type.size(), instr.type.baseType, values[instr.sizeIdx].i);
+	values[rip->dst].ref = jit::allocator::allocate_array(nullptr, rip->offset, rip->type, values[rip->a].i);
 	DISPATCH;
 };
 
-goto_: {
-	u16 instrs = 0;
-	for(u16 blockIdx = 0; blockIdx != rip->jump.branchIdx; ++blockIdx) {
-		instrs += function.blocks[blockIdx].instructionCount;
-	}
-
-	prev = rip;
-	rip = function.instructions.data() + instrs;
-	DISPATCH_DIRECT;
-};
+goto_: JUMP(rip->b);
 
 ifgoto: {
-		if(values[rip->jump.conditionIdx].b) {
-			u16 instrs = 0;
-			for(u16 blockIdx = 0; blockIdx != rip->jump.branchIdx; ++blockIdx) {
-				instrs += function.blocks[blockIdx].instructionCount;
-			}
-
-			prev = rip;
-			rip = function.instructions.data() + instrs;
-			DISPATCH_DIRECT;
+		if(values[rip->a].b) {
+			JUMP(rip->b);
 		} else {
+			edge = rip->dst;
 			DISPATCH;
 		}
 	};
 
-phi: {
-
-	u16 prevBlock = blockIdxForInstruction(prev->id, function.blocks);
-	for(bytecode::PhiEdge edge : rip->phi.args) {
-		if(edge.block == prevBlock) {
-			values[rip->phi.dstIdx] = values[edge.temp];
-			break;
-		}
-	}
-
-	// avoid setting `prev`
-	++rip;
-	DISPATCH_DIRECT;
-	};
-
-call: {
-	executeFunction(rip->call.functionIdx, rip->call.args.data(), values, rip->call.dstIdx);
+phi:
+	values[rip->dst] = values[rip->operands[edge]];
 	DISPATCH;
-};
+
+call: CALL(rip->a, rip->operands);
 
 specialcall: {
-	auto& instr = rip->call;
+	auto args = rip->operands;
 
-	switch(instr.functionIdx) {
+	switch(rip->a) {
 		case 0:
 			bytecode::special::begin_int(this);
 			break;
@@ -368,13 +592,13 @@ specialcall: {
 			bytecode::special::end_int(this);
 			break;
 		case 3:
-			bytecode::special::printa_int(nullptr, (i32*)values[instr.args[0]].ref);
+			bytecode::special::printa_int(nullptr, (i32*)values[args[0]].ref);
 			break;
 		case 4:
-			bytecode::special::print_double(nullptr, values[instr.args[0]].d);
+			bytecode::special::print_double(nullptr, values[args[0]].d);
 			break;
 		case 5:
-			bytecode::special::exit(nullptr, values[instr.args[0]].i);
+			bytecode::special::exit(nullptr, values[args[0]].i);
 			break;
 		default:
 			std::cout << "ignoring special call" << std::endl;
@@ -383,231 +607,178 @@ specialcall: {
 	DISPATCH;
 };
 
-retvoid: return;
+retvoid: RETURN_VOID;
 
-ret:
-	prevFrame[retIdx] = values[rip->unary.srcIdx];
-	return;
+ret: RETURN(values[rip->a]);
 
 allocate: {
-		program.types.at(rip->obj_alloc.typeId).calculateSize();
-		values[rip->obj_alloc.dstIdx].ref = jit::allocator::allocate(nullptr, program.types.at(rip->obj_alloc.typeId).getSize());
-		*((i64*)values[rip->obj_alloc.dstIdx].ref) = (i64)program.types.at(rip->obj_alloc.typeId).vTable.data();
+		values[rip->dst].ref = jit::allocator::allocate(nullptr, rip->a);
+		*((i64*)values[rip->dst].ref) = (i64)rip->vTable;
 
 		DISPATCH;
 	};
 
-load: {
-		auto& instr = rip->access;
-		void *offset = ((u8*)values[instr.ptrIdx].ref) + program.types.at(rip->access.typeId).getOffset(instr.fieldIdx);
-		switch((bytecode::BaseType) function.temporaryTypes[instr.valueIdx].baseType) {
-			case bytecode::BaseType::BOOL:
-				values[instr.valueIdx].b = *((u8*)(offset));
-				break;
-
-			case bytecode::BaseType::INT8:
-				values[instr.valueIdx].byte = (*((u8*)(offset)));
-				break;
-
-			case bytecode::BaseType::INT16:
-			case bytecode::BaseType::CHAR:
-				values[instr.valueIdx].s = *((i16*)(offset));
-				break;
-
-			case bytecode::BaseType::INT32:
-				values[instr.valueIdx].i = *((i32*)(offset));
-				break;
-
-			case bytecode::BaseType::INT64:
-				values[instr.valueIdx].l = *((i64*)(offset));
-				break;
-
-			case bytecode::BaseType::FLP32:
-				values[instr.valueIdx].f = *((float*)(offset));
-				break;
-
-			case bytecode::BaseType::FLP64:
-				values[instr.valueIdx].d = *((double*)(offset));
-				break;
-
-			default:
-				values[instr.valueIdx].ref = (void*) *((i64*)(offset));
-		}
-	DISPATCH;
-};
-
-store: {
-	auto& instr = rip->access;
-	program.types.at(rip->access.typeId).calculateSize();
-
-
-	void *offset = ((u8*)values[instr.ptrIdx].ref) + program.types.at(rip->access.typeId).getOffset(instr.fieldIdx);
-	switch((bytecode::BaseType) function.temporaryTypes[instr.valueIdx].baseType) {
-		case bytecode::BaseType::BOOL:
-			*((u8*)(offset)) = (u8) values[instr.valueIdx].b;
-			break;
-
-		case bytecode::BaseType::INT8:
-			(*((u8*)(offset))) = values[instr.valueIdx].byte;
-			break;
-
-		case bytecode::BaseType::INT16:
-		case bytecode::BaseType::CHAR:
-			*((i16*)(offset)) = values[instr.valueIdx].s;
-			break;
-
-		case bytecode::BaseType::INT32:
-			*((i32*)(offset)) = values[instr.valueIdx].i;
-			break;
-
-		case bytecode::BaseType::INT64:
-			*((i64*)(offset)) = values[instr.valueIdx].l;
-			break;
-
-		case bytecode::BaseType::FLP32:
-			*((float*)(offset)) = values[instr.valueIdx].f;
-			break;
-
-		case bytecode::BaseType::FLP64:
-			*((double*)(offset)) = values[instr.valueIdx].d;
-			break;
-
-		default:
-
-			*(i64*)(offset) = (i64)values[instr.valueIdx].ref;
-	}
-	DISPATCH;
-	};
+load: LOAD_FROM((u8*) values[rip->a].ref + rip->offset) DISPATCH;
+store: STORE_TO((u8*) values[rip->a].ref + rip->offset) DISPATCH;
 
 length: {
-	values[rip->array.valueIdx].i = ((i32*)(values[rip->array.memoryIdx].ref))[-1];
+	values[rip->dst].i = ((i32*)(values[rip->a].ref))[-1];
 		DISPATCH;
 	};
 
-load_global: {
-	values[rip->global.value] = global[rip->global.globalIdx];
-	DISPATCH;
-	};
-
-store_global:{
-	global[rip->global.globalIdx] = values[rip->global.value];
-	DISPATCH;
-	};
+load_global: LOAD_FROM(globals + rip->offset) DISPATCH;
+store_global: STORE_TO(globals + rip->offset) DISPATCH;
 
 call_member:
-call_member_void:
 	{
 
-		u16 *vTable = (u16 *) *((i64 *) (values[rip->member_call.ptrIdx].ref));
+		u16 *vTable = (u16 *) *((i64 *) (values[rip->a].ref));
 
-		u16 actualFunctionIdx = vTable[rip->member_call.functionIdx];
+		u16 actualFunctionIdx = vTable[rip->b];
 
-		executeFunction(actualFunctionIdx, rip->member_call.args.data(), values, rip->member_call.dstIdx);
+		CALL(actualFunctionIdx, rip->operands);
+	};
+
+bounds_check:
+	{
+		u32 length = ((i32*)(values[rip->a].ref))[-1];
+		i32 index = values[rip->b].i;
+
+		if(rip->offset == 0 ? (u32) index >= length
+		                    : index < values[rip->dst].i && ((u32) index >= length || (u32) values[rip->dst].i > length)) {
+			throw std::runtime_error("array index out of bounds");
+		}
+		DISPATCH;
 	};
-	DISPATCH;
 
 loadidx:
 	{
-		auto& instr = rip->array;
-		switch((bytecode::BaseType) function.temporaryTypes[instr.valueIdx].baseType) {
-			case bytecode::BaseType::BOOL:
-			values[instr.valueIdx].b = ((u8*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+		auto& instr = *rip;
+		switch(instr.type) {
+			case (u8) bytecode::BaseType::BOOL:
+			values[instr.dst].b = ((u8*)(values[instr.a].ref))[values[instr.b].i];
 			break;
 
-			case bytecode::BaseType::INT8:
-			values[instr.valueIdx].byte = ((u8*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+			case (u8) bytecode::BaseType::INT8:
+			values[instr.dst].byte = ((u8*)(values[instr.a].ref))[values[instr.b].i];
 			break;
 
-			case bytecode::BaseType::INT16:
-			case bytecode::BaseType::CHAR:
-			values[instr.valueIdx].s = ((u16*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+			case (u8) bytecode::BaseType::INT16:
+			case (u8) bytecode::BaseType::CHAR:
+			values[instr.dst].s = ((u16*)(values[instr.a].ref))[values[instr.b].i];
 			break;
 
-			case bytecode::BaseType::INT32:
-			values[instr.valueIdx].i = ((i32*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+			case (u8) bytecode::BaseType::INT32:
+			values[instr.dst].i = ((i32*)(values[instr.a].ref))[values[instr.b].i];
 			break;
 
-			case bytecode::BaseType::INT64:
-			values[instr.valueIdx].l = ((i64*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+			case (u8) bytecode::BaseType::INT64:
+			values[instr.dst].l = ((i64*)(values[instr.a].ref))[values[instr.b].i];
 			break;
 
-			case bytecode::BaseType::FLP32:
-			values[instr.valueIdx].f = ((float*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+			case (u8) bytecode::BaseType::FLP32:
+			values[instr.dst].f = ((float*)(values[instr.a].ref))[values[instr.b].i];
 			break;
 
-			case bytecode::BaseType::FLP64:
-			values[instr.valueIdx].d = ((double*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+			case (u8) bytecode::BaseType::FLP64:
+			values[instr.dst].d = ((double*)(values[instr.a].ref))[values[instr.b].i];
 			break;
 
 			default:
-			values[instr.valueIdx].ref = (void*)((i64*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i];
+			values[instr.dst].ref = (void*)((i64*)(values[instr.a].ref))[values[instr.b].i];
 		}
 
 		DISPATCH;
 	};
 
 storeidx: {
-	auto& instr = rip->array;
-	switch((bytecode::BaseType) function.temporaryTypes[instr.valueIdx].baseType) {
-		case bytecode::BaseType::BOOL:
-			((u8*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = values[instr.valueIdx].b;
+	auto& instr = *rip;
+	switch(instr.type) {
+		case (u8) bytecode::BaseType::BOOL:
+			((u8*)(values[instr.a].ref))[values[instr.b].i] = values[instr.dst].b;
 			break;
 
-		case bytecode::BaseType::INT8:
-			((u8*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = values[instr.valueIdx].byte;
+		case (u8) bytecode::BaseType::INT8:
+			((u8*)(values[instr.a].ref))[values[instr.b].i] = values[instr.dst].byte;
 			break;
 
-		case bytecode::BaseType::INT16:
-		case bytecode::BaseType::CHAR:
-			((i16*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = values[instr.valueIdx].s;
+		case (u8) bytecode::BaseType::INT16:
+		case (u8) bytecode::BaseType::CHAR:
+			((i16*)(values[instr.a].ref))[values[instr.b].i] = values[instr.dst].s;
 			break;
 
-		case bytecode::BaseType::INT32:
-			((i32*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = values[instr.valueIdx].i;
+		case (u8) bytecode::BaseType::INT32:
+			((i32*)(values[instr.a].ref))[values[instr.b].i] = values[instr.dst].i;
 			break;
 
-		case bytecode::BaseType::INT64:
-			((i64*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = values[instr.valueIdx].l;
+		case (u8) bytecode::BaseType::INT64:
+			((i64*)(values[instr.a].ref))[values[instr.b].i] = values[instr.dst].l;
 			break;
 
-		case bytecode::BaseType::FLP32:
-			((float*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = values[instr.valueIdx].f;
+		case (u8) bytecode::BaseType::FLP32:
+			((float*)(values[instr.a].ref))[values[instr.b].i] = values[instr.dst].f;
 			break;
 
-		case bytecode::BaseType::FLP64:
-			((double*)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = values[instr.valueIdx].d;
+		case (u8) bytecode::BaseType::FLP64:
+			((double*)(values[instr.a].ref))[values[instr.b].i] = values[instr.dst].d;
 			break;
 
 		default:
-			((i64**)(values[instr.memoryIdx].ref))[values[instr.indexIdx].i] = (i64*)values[instr.valueIdx].ref;
+			((i64**)(values[instr.a].ref))[values[instr.b].i] = (i64*)values[instr.dst].ref;
 	}
 
 	DISPATCH;
 	};
 
+	// quickened handlers
+	TYPED_ARITHMETIC_HANDLERS(add, TYPED_BINARY, +)
+	TYPED_ARITHMETIC_HANDLERS(sub, TYPED_BINARY, -)
+	TYPED_ARITHMETIC_HANDLERS(mul, TYPED_BINARY, *)
+	TYPED_ARITHMETIC_HANDLERS(div, TYPED_BINARY, /)
+	TYPED_INTEGER_HANDLERS(mod, TYPED_BINARY, %)
+	TYPED_INTEGER_HANDLERS(and, TYPED_BINARY, &)
+	TYPED_INTEGER_HANDLERS(or, TYPED_BINARY, |)
+
+	TYPED_NEG(neg_i8, byte)
+	TYPED_NEG(neg_i16, s)
+	TYPED_NEG(neg_i32, i)
+	TYPED_NEG(neg_i64, l)
+	TYPED_NEG(neg_f32, f)
+	TYPED_NEG(neg_f64, d)
+
+	TYPED_ARITHMETIC_HANDLERS(gt, TYPED_CMP, >)
+	TYPED_ARITHMETIC_HANDLERS(gte, TYPED_CMP, >=)
+	TYPED_ARITHMETIC_HANDLERS(lt, TYPED_CMP, <)
+	TYPED_ARITHMETIC_HANDLERS(lte, TYPED_CMP, <=)
+	TYPED_ARITHMETIC_HANDLERS(eq, TYPED_CMP, ==)
+	TYPED_ARITHMETIC_HANDLERS(neq, TYPED_CMP, !=)
+
+	TYPED_MEMORY_HANDLERS(loadidx, TYPED_LOAD_IDX)
+	TYPED_MEMORY_HANDLERS(storeidx, TYPED_STORE_IDX)
+	TYPED_MEMORY_HANDLERS(load, TYPED_OBJ_LOAD)
+	TYPED_MEMORY_HANDLERS(store, TYPED_OBJ_STORE)
+
+	SUPERINSTRUCTIONS(SUPERINSTRUCTION_HANDLER)
 }
 
 
-int InterpretEngine::execute() {
-
-	for(bytecode::Function& f : program.functions) {
-		for(bytecode::Instruction& i : f.instructions) {
-			if(((u8)i.opcode) >= 100) {
-				// make opcodes more compact 100 -> 34
-				i.opcode = (bytecode::Opcode) ((u8)i.opcode - 66);
-			}
-		}
+Value InterpretEngine::call(u16 idx, Value const* arguments) {
+	if(tier && hot(idx)) {
+		return tier->callNative(idx, arguments);
 	}
 
-	global = std::vector<Value>{program.globals.size()};
+	return executeFunction(idx, arguments);
+}
+
+int InterpretEngine::execute() {
+	reset();
 
 	auto idx = findMain(program.functions);
 
-	Value ret;
-	executeFunction(idx, nullptr, &ret, 0);
+	Value ret = executeFunction(idx, nullptr);
 
 	std::cout << "returned " << std::to_string(ret.i) << std::endl;
 	return ret.i;
 };
 
-}}
\ No newline at end of file
+}}
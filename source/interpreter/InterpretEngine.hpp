@@ -3,22 +3,62 @@
 #include <Engine.hpp>
 #include <bytecode.hpp>
 #include <Options.hpp>
+#include <interpreter/Decoder.hpp>
+#include <interpreter/ValueStack.hpp>
 #include <chrono>
+#include <memory>
 
 namespace am2017s { namespace interpreter {
 
 
-union Value {
-	bool b;
-	i8 byte;
-	i16 s;
-	i32 i;
-	i64 l;
+/**
+ * Where the calls of a function go
+ */
+enum class Tiering : u8 {
+	/**
+	 * interpreted until it gets hot
+	 */
+	COUNTING,
 
-	float f;
-	double d;
+	/**
+	 * interpreted while being compiled in the background
+	 */
+	COMPILING,
 
-	void* ref;
+	NATIVE,
+	INTERPRETED,
+};
+
+/**
+ * Compiled code the interpreter can hand hot functions to, see TieredEngine
+ */
+struct Tier {
+	/**
+	 * Called once function `idx` got hot. Returns NATIVE if it can be run by `callNative` from now on,
+	 * COMPILING if that is not known yet.
+	 */
+	virtual Tiering tierUp(u16 idx) = 0;
+
+	/**
+	 * Asked on every call of a COMPILING function `idx`, returns COMPILING until the compilation is done
+	 */
+	virtual Tiering poll(u16 idx) = 0;
+
+	/**
+	 * Runs the compiled code of function `idx`
+	 */
+	virtual Value callNative(u16 idx, Value const* arguments) = 0;
+
+	/**
+	 * Called on the jump from block `predecessor` to the loop `header` of function `idx` once the function
+	 * is hot. Returns whether the rest of the activation ran as compiled code (on-stack replacement), its
+	 * result is stored in `result`. `frame[slots[t]]` holds temporary t.
+	 */
+	virtual bool enterLoop(u16 idx, u16 header, u16 predecessor, Value const* frame, std::vector<u16> const& slots,
+	                       Value& result) = 0;
+
+protected:
+	~Tier() = default;
 };
 
 class InterpretEngine : public Engine {
@@ -30,9 +70,62 @@ private:
 	bytecode::Program program;
 	Options options;
 
-	std::vector<Value> global;
-
-	void executeFunction(u16 idx, u16 *args, Value *prevFrame, u16 retIdx);
+	/**
+	 * @brief globals packed at their Field::offset, either `globalStorage` or shared with compiled code
+	 */
+	u8* globals;
+	std::vector<u64> globalStorage;
+
+	/**
+	 * @brief receives hot functions, none unless running tiered
+	 */
+	Tier* tier = nullptr;
+
+	/**
+	 * @brief calls and loop iterations of every function until it reaches options.tierThreshold
+	 */
+	std::vector<u32> hotness;
+	std::vector<Tiering> tiering;
+	std::vector<Value> nativeArguments;
+
+	/**
+	 * @brief frames of the active calls
+	 */
+	ValueStack stack;
+
+	/**
+	 * @brief decoded functions, filled in on their first call
+	 */
+	std::vector<std::unique_ptr<DecodedFunction>> code;
+
+	/**
+	 * @brief label table of executeFunction, indexed by Handler
+	 */
+	void* const* handlers = nullptr;
+
+	DecodedFunction const& decoded(u16 idx);
+
+	/**
+	 * Counts a call or loop iteration of function `idx` and hands it to `tier` once it is hot.
+	 * Returns whether the function has compiled code.
+	 */
+	bool hot(u16 idx);
+
+	/**
+	 * Hands the current activation of `function` over to `tier` at the backward `jump`
+	 */
+	bool enterLoop(DecodedFunction const& function, DecodedInstruction const* jump, Value const* frame, Value& result);
+
+	/**
+	 * Runs the compiled code of function `idx` with the `arguments` slots of `frame`
+	 */
+	Value callNative(u16 idx, Value const* frame, u16 const* arguments);
+
+	/**
+	 * Runs function `idx` with `arguments`. Guest calls do not recurse, they push a Frame onto `stack` and
+	 * continue in the same dispatch loop.
+	 */
+	Value executeFunction(u16 idx, Value const* arguments);
 
 public:
 	Clock::time_point _beginReal;
@@ -40,6 +133,23 @@ public:
 	InterpretEngine(bytecode::Program program, Options const& options);
 	virtual int execute() override final;
 
+	/**
+	 * Lets hot functions run on `tier` and keeps the globals in `sharedGlobals`, which has to be
+	 * Program::globalsSize() bytes large
+	 */
+	void tierTo(Tier* tier, u8* sharedGlobals);
+
+	/**
+	 * Forgets all decoded functions and the contents of the stack and the globals
+	 */
+	void reset();
+
+	/**
+	 * Runs function `idx`, also while another function is being interpreted (e.g. when compiled code calls
+	 * back into the interpreter)
+	 */
+	Value call(u16 idx, Value const* arguments);
+
 };
 
 }}
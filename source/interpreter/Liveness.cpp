@@ -0,0 +1,88 @@
+#include <string>
+
+#include <interpreter/Liveness.hpp>
+
+namespace am2017s { namespace interpreter {
+
+Liveness::Liveness(bytecode::Function const& _function) : function(_function) {
+	u32 start = 0;
+	for(auto const& block : function.blocks) {
+		blockStarts.push_back(start);
+		start += block.instructionCount;
+	}
+
+	compute();
+}
+
+void Liveness::compute() {
+	auto const& blocks = function.blocks;
+	u16 temporaries = function.temporyCount;
+
+	auto checked = [&](u16 temporary) {
+		if(temporary >= temporaries) {
+			throw std::runtime_error("temporary " + std::to_string(temporary) + " out of range in " + function.name);
+		}
+		return temporary;
+	};
+
+	// used before being defined, defined, and used by the phis of a successor
+	std::vector<TemporarySet> gen(blocks.size(), TemporarySet(temporaries));
+	std::vector<TemporarySet> kill(blocks.size(), TemporarySet(temporaries));
+	std::vector<TemporarySet> phiUses(blocks.size(), TemporarySet(temporaries));
+
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		for(u32 i = blockStarts[block]; i != blockStarts[block] + blocks[block].instructionCount; ++i) {
+			auto const& instr = function.instructions[i];
+
+			if(instr.opcode == bytecode::Opcode::PHI) {
+				kill[block].insert(checked(instr.phi.dstIdx));
+
+				for(u16 edge = 0; edge != instr.phi.edges.count; ++edge) {
+					auto e = instr.phi.edge(function.operands, edge);
+					if(e.block < blocks.size()) {
+						phiUses[e.block].insert(checked(e.temp));
+					}
+				}
+
+				continue;
+			}
+
+			for(u16 input : instr.inputOperands(function.operands)) {
+				if(!kill[block].contains(checked(input))) {
+					gen[block].insert(input);
+				}
+			}
+
+			if(auto dst = instr.dstIdx()) {
+				kill[block].insert(checked(dst.value()));
+			}
+		}
+	}
+
+	liveOut.assign(blocks.size(), TemporarySet(temporaries));
+	liveIn.assign(blocks.size(), TemporarySet(temporaries));
+
+	for(bool changed = true; changed;) {
+		changed = false;
+
+		for(u16 block = blocks.size(); block-- != 0;) {
+			TemporarySet out = phiUses[block];
+			for(u16 successor : blocks[block].successors) {
+				if(successor < blocks.size()) {
+					out.insertAll(liveIn[successor]);
+				}
+			}
+
+			TemporarySet in = gen[block];
+			in.insertAll(out, kill[block]);
+
+			if(out != liveOut[block] || in != liveIn[block]) {
+				liveOut[block] = std::move(out);
+				liveIn[block] = std::move(in);
+				changed = true;
+			}
+		}
+	}
+}
+
+}}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+#include <bytecode.hpp>
+
+namespace am2017s { namespace interpreter {
+
+/**
+ * A set of temporaries, one bit each
+ */
+class TemporarySet {
+private:
+	std::vector<u64> words;
+
+public:
+	TemporarySet() = default;
+	explicit TemporarySet(u16 temporaries) : words((temporaries + 63) / 64) {}
+
+	bool contains(u16 temporary) const {
+		return words[temporary / 64] >> (temporary % 64) & 1;
+	}
+
+	void insert(u16 temporary) {
+		words[temporary / 64] |= u64(1) << (temporary % 64);
+	}
+
+	void erase(u16 temporary) {
+		words[temporary / 64] &= ~(u64(1) << (temporary % 64));
+	}
+
+	/**
+	 * Adds the temporaries of `other` that are not in `except`
+	 */
+	void insertAll(TemporarySet const& other, TemporarySet const& except) {
+		for(std::size_t word = 0; word != words.size(); ++word) {
+			words[word] |= other.words[word] & ~except.words[word];
+		}
+	}
+
+	void insertAll(TemporarySet const& other) {
+		for(std::size_t word = 0; word != words.size(); ++word) {
+			words[word] |= other.words[word];
+		}
+	}
+
+	template<typename F>
+	void forEach(F f) const {
+		for(std::size_t word = 0; word != words.size(); ++word) {
+			for(u64 rest = words[word]; rest; rest &= rest - 1) {
+				f((u16) (word * 64 + __builtin_ctzll(rest)));
+			}
+		}
+	}
+
+	bool operator==(TemporarySet const& other) const {
+		return words == other.words;
+	}
+
+	bool operator!=(TemporarySet const& other) const {
+		return words != other.words;
+	}
+};
+
+/**
+ * Temporaries live at the start and at the end of every block of a function.
+ *
+ * Phi inputs are live at the end of the predecessor they come from, the destinations of a block's phis are
+ * not live at its start.
+ */
+class Liveness {
+private:
+	bytecode::Function const& function;
+
+	void compute();
+
+public:
+	/**
+	 * @brief index of the first instruction of every block
+	 */
+	std::vector<u32> blockStarts;
+
+	std::vector<TemporarySet> liveIn;
+	std::vector<TemporarySet> liveOut;
+
+	explicit Liveness(bytecode::Function const& _function);
+};
+
+}}
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <limits>
+
+#include <interpreter/SlotAllocator.hpp>
+
+namespace am2017s { namespace interpreter {
+
+SlotAllocator::SlotAllocator(bytecode::Function const& _function) : function(_function), liveness(_function) {
+}
+
+void SlotAllocator::interfere(u16 a, u16 b) {
+	if(a != b) {
+		interferences[a].push_back(b);
+		interferences[b].push_back(a);
+	}
+}
+
+void SlotAllocator::buildInterferences() {
+	auto const& blocks = function.blocks;
+	interferences.assign(function.temporyCount, {});
+
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		TemporarySet live = liveness.liveOut[block];
+
+		u32 begin = liveness.blockStarts[block];
+		u32 end = begin + blocks[block].instructionCount;
+
+		u32 firstNonPhi = begin;
+		while(firstNonPhi != end && function.instructions[firstNonPhi].opcode == bytecode::Opcode::PHI) {
+			++firstNonPhi;
+		}
+
+		// everything live after an instruction overlaps with what it defines
+		for(u32 i = end; i-- != firstNonPhi;) {
+			auto const& instr = function.instructions[i];
+
+			if(auto dst = instr.dstIdx()) {
+				live.forEach([&](u16 temporary) { interfere(dst.value(), temporary); });
+				live.erase(dst.value());
+			}
+
+			for(u16 input : instr.inputOperands(function.operands)) {
+				live.insert(input);
+			}
+		}
+
+		// phis run one after the other, so each destination may still be needed as the input of a later one
+		for(u32 i = begin; i != firstNonPhi; ++i) {
+			auto const& phi = function.instructions[i].phi;
+
+			live.forEach([&](u16 temporary) { interfere(phi.dstIdx, temporary); });
+
+			for(u32 j = begin; j != firstNonPhi; ++j) {
+				auto const& other = function.instructions[j].phi;
+
+				interfere(phi.dstIdx, other.dstIdx);
+				for(u16 edge = 0; edge != other.edges.count; ++edge) {
+					interfere(phi.dstIdx, other.edge(function.operands, edge).temp);
+				}
+			}
+		}
+	}
+
+	for(auto& list : interferences) {
+		std::sort(list.begin(), list.end());
+		list.erase(std::unique(list.begin(), list.end()), list.end());
+	}
+}
+
+std::vector<u16> SlotAllocator::run() && {
+	buildInterferences();
+
+	constexpr u16 NONE = std::numeric_limits<u16>::max();
+	std::vector<u16> slots(function.temporyCount, NONE);
+
+	// the caller copies the arguments to the first slots
+	for(u16 i = 0; i != function.parameters.size(); ++i) {
+		slots[i] = i;
+	}
+
+	// takenBy[slot] == temporary while choosing the slot of that temporary
+	std::vector<u32> takenBy(function.temporyCount + 1, std::numeric_limits<u32>::max());
+
+	for(u16 temporary = 0; temporary != function.temporyCount; ++temporary) {
+		if(slots[temporary] != NONE) {
+			continue;
+		}
+
+		for(u16 other : interferences[temporary]) {
+			if(slots[other] != NONE) {
+				takenBy[slots[other]] = temporary;
+			}
+		}
+
+		u16 slot = 0;
+		while(takenBy[slot] == temporary) {
+			++slot;
+		}
+
+		slots[temporary] = slot;
+	}
+
+	return slots;
+}
+
+}}
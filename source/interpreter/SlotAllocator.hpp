@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include <bytecode.hpp>
+#include <interpreter/Liveness.hpp>
+
+namespace am2017s { namespace interpreter {
+
+/**
+ * Assigns the temporaries of a function to frame slots, so that temporaries whose lifetimes do not overlap
+ * share a slot.
+ *
+ * Temporaries interfere when one of them is defined while the other one is live (see Liveness). Phis are executed one after the other at the start of their block, so the
+ * destinations of a block's phis must not share a slot with each other or with any of the block's phi inputs.
+ * Parameters keep the slots the caller copies them to, the others get the lowest free slot in order of
+ * their index (a greedy coloring of the interference graph).
+ */
+class SlotAllocator {
+private:
+	bytecode::Function const& function;
+	Liveness liveness;
+
+	/**
+	 * @brief temporaries that are live at the same time as the indexed one
+	 */
+	std::vector<std::vector<u16>> interferences;
+
+	void buildInterferences();
+	void interfere(u16 a, u16 b);
+
+public:
+	explicit SlotAllocator(bytecode::Function const& _function);
+
+	/**
+	 * @return the slot of every temporary
+	 */
+	std::vector<u16> run() &&;
+};
+
+}}
@@ -0,0 +1,45 @@
+#pragma once
+
+/**
+ * Superinstructions of the interpreter, as X(NAME, FIRST, REST, BODY).
+ *
+ * `fuse` replaces FIRST by NAME when it is directly followed by REST in the same block. The handler of NAME
+ * runs BODY (the work of FIRST) and continues with the handler of REST without dispatching, so jumps and the
+ * phi edge are still handled by REST. REST may be a superinstruction itself, which builds triples.
+ *
+ * The entries were picked from `vm profile`, which lists the most frequent handler sequences of a set of
+ * programs. BODY is only expanded by InterpretEngine.
+ */
+#define SUPERINSTRUCTIONS(X) \
+	X(GT_I32_IF_GOTO,          GT_I32,         IF_GOTO,         TYPED_CMP_BODY(i, >)) \
+	X(GTE_I32_IF_GOTO,         GTE_I32,        IF_GOTO,         TYPED_CMP_BODY(i, >=)) \
+	X(LT_I32_IF_GOTO,          LT_I32,         IF_GOTO,         TYPED_CMP_BODY(i, <)) \
+	X(LTE_I32_IF_GOTO,         LTE_I32,        IF_GOTO,         TYPED_CMP_BODY(i, <=)) \
+	X(EQ_I32_IF_GOTO,          EQ_I32,         IF_GOTO,         TYPED_CMP_BODY(i, ==)) \
+	X(NEQ_I32_IF_GOTO,         NEQ_I32,        IF_GOTO,         TYPED_CMP_BODY(i, !=)) \
+	X(GT_I64_IF_GOTO,          GT_I64,         IF_GOTO,         TYPED_CMP_BODY(l, >)) \
+	X(GTE_I64_IF_GOTO,         GTE_I64,        IF_GOTO,         TYPED_CMP_BODY(l, >=)) \
+	X(LT_I64_IF_GOTO,          LT_I64,         IF_GOTO,         TYPED_CMP_BODY(l, <)) \
+	X(LTE_I64_IF_GOTO,         LTE_I64,        IF_GOTO,         TYPED_CMP_BODY(l, <=)) \
+	X(EQ_I64_IF_GOTO,          EQ_I64,         IF_GOTO,         TYPED_CMP_BODY(l, ==)) \
+	X(NEQ_I64_IF_GOTO,         NEQ_I64,        IF_GOTO,         TYPED_CMP_BODY(l, !=)) \
+	X(CONST_GT_I32_IF_GOTO,    CONST,          GT_I32_IF_GOTO,  CONST_BODY) \
+	X(CONST_GTE_I32_IF_GOTO,   CONST,          GTE_I32_IF_GOTO, CONST_BODY) \
+	X(CONST_LT_I32_IF_GOTO,    CONST,          LT_I32_IF_GOTO,  CONST_BODY) \
+	X(CONST_LTE_I32_IF_GOTO,   CONST,          LTE_I32_IF_GOTO, CONST_BODY) \
+	X(CONST_GT_I64_IF_GOTO,    CONST,          GT_I64_IF_GOTO,  CONST_BODY) \
+	X(CONST_GTE_I64_IF_GOTO,   CONST,          GTE_I64_IF_GOTO, CONST_BODY) \
+	X(CONST_LT_I64_IF_GOTO,    CONST,          LT_I64_IF_GOTO,  CONST_BODY) \
+	X(CONST_LTE_I64_IF_GOTO,   CONST,          LTE_I64_IF_GOTO, CONST_BODY) \
+	X(CONST_ADD_I32,           CONST,          ADD_I32,         CONST_BODY) \
+	X(CONST_SUB_I32,           CONST,          SUB_I32,         CONST_BODY) \
+	X(CONST_MUL_I32,           CONST,          MUL_I32,         CONST_BODY) \
+	X(CONST_ADD_I64,           CONST,          ADD_I64,         CONST_BODY) \
+	X(CONST_SUB_I64,           CONST,          SUB_I64,         CONST_BODY) \
+	X(CONST_MUL_I64,           CONST,          MUL_I64,         CONST_BODY) \
+	X(LOAD_IDX_I32_ADD_I32,    LOAD_IDX_I32,   ADD_I32,         TYPED_LOAD_IDX_BODY(i, i32)) \
+	X(LOAD_IDX_I32_SUB_I32,    LOAD_IDX_I32,   SUB_I32,         TYPED_LOAD_IDX_BODY(i, i32)) \
+	X(LOAD_IDX_I32_MUL_I32,    LOAD_IDX_I32,   MUL_I32,         TYPED_LOAD_IDX_BODY(i, i32)) \
+	X(LOAD_IDX_I64_ADD_I64,    LOAD_IDX_I64,   ADD_I64,         TYPED_LOAD_IDX_BODY(l, i64)) \
+	X(LOAD_IDX_I64_SUB_I64,    LOAD_IDX_I64,   SUB_I64,         TYPED_LOAD_IDX_BODY(l, i64)) \
+	X(LOAD_IDX_I64_MUL_I64,    LOAD_IDX_I64,   MUL_I64,         TYPED_LOAD_IDX_BODY(l, i64))
@@ -0,0 +1,10 @@
+#include <interpreter/ValueStack.hpp>
+
+namespace am2017s { namespace interpreter {
+
+// not value-initialized, so the pages are only committed once a frame reaches them
+ValueStack::ValueStack(std::size_t bytes) : values(new Value[bytes / sizeof(Value)]), capacity(bytes / sizeof(Value)) {
+
+}
+
+}}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <new>
+
+#include <exception/StackOverflowException.hpp>
+#include <interpreter/Decoder.hpp>
+
+namespace am2017s { namespace interpreter {
+
+/**
+ * Where to continue when a call returns, stored right below the values of the callee
+ */
+struct Frame {
+	/**
+	 * @brief the call instruction, nullptr for the outermost call
+	 */
+	DecodedInstruction const* returnPc;
+	DecodedFunction const* function;
+	Value* values;
+	u16 returnSlot;
+};
+
+/**
+ * The frames of all active interpreter calls, stacked in one contiguous block.
+ *
+ * The whole capacity is reserved up front but only touched as deep as the calls go, so calls do not
+ * allocate and the memory used is bounded by the call depth.
+ */
+class ValueStack {
+private:
+	static constexpr std::size_t RECORD_SIZE = (sizeof(Frame) + sizeof(Value) - 1) / sizeof(Value);
+
+	std::unique_ptr<Value[]> values;
+	std::size_t capacity;
+	std::size_t top = 0;
+
+public:
+	/**
+	 * @param bytes the maximum size of the stack
+	 */
+	explicit ValueStack(std::size_t bytes);
+
+	/**
+	 * @param caller where to continue once the new frame is popped
+	 * @return the values of the new frame
+	 */
+	Value* push(Frame const& caller, u16 frameSize) {
+		if(capacity - top < RECORD_SIZE + frameSize) {
+			throw StackOverflowException("interpreter stack overflow (" + std::to_string(capacity * sizeof(Value))
+			                             + " bytes), raise it with --stack-size");
+		}
+
+		Value* frame = values.get() + top + RECORD_SIZE;
+		new (frame - RECORD_SIZE) Frame(caller);
+		top += RECORD_SIZE + frameSize;
+		return frame;
+	}
+
+	/**
+	 * @return the caller passed to the matching push
+	 */
+	Frame pop(u16 frameSize) {
+		top -= RECORD_SIZE + frameSize;
+		return *reinterpret_cast<Frame const*>(values.get() + top);
+	}
+
+	/**
+	 * @brief drops all frames, e.g. after an exception unwound the calls
+	 */
+	void clear() {
+		top = 0;
+	}
+
+	/**
+	 * @return number of values currently in use
+	 */
+	std::size_t size() const {
+		return top;
+	}
+};
+
+}}
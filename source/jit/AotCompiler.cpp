@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include <jit/AotCompiler.hpp>
+#include <log/Logger.hpp>
+
+extern char** environ;
+
+namespace am2017s { namespace jit
+{
+	static
+	std::string quoted(std::string const& path)
+	{
+		std::string result = "\"";
+		for(char c : path)
+		{
+			if(c == '"' || c == '\\')
+				result += '\\';
+			result += c;
+		}
+
+		return result + "\"";
+	}
+
+	static
+	void emitBytes(std::ostream& os, u8 const* begin, u8 const* end)
+	{
+		for(std::size_t column = 0; begin != end; ++begin, ++column)
+		{
+			os << (column % 16 == 0 ? (column ? "\n\t.byte " : "\t.byte ") : ", ") << (unsigned) *begin;
+		}
+
+		os << "\n";
+	}
+
+	static
+	void run(std::vector<std::string> const& command)
+	{
+		std::vector<char*> argv;
+		for(auto const& argument : command)
+			argv.push_back(const_cast<char*>(argument.c_str()));
+		argv.push_back(nullptr);
+
+		pid_t pid;
+		if(posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+			throw std::runtime_error("failed to start '" + command[0] + "'");
+
+		int status;
+		if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			throw std::runtime_error("'" + command[0] + "' failed to link the executable");
+	}
+
+	AotCompiler::AotCompiler(std::string input, Options const& options)
+		: JitEngine(bytecode::loadBytecode(input), options)
+		, _input(std::move(input))
+	{
+	}
+
+	std::string AotCompiler::assembly()
+	{
+		auto count = (u16) _program.functions.size();
+
+		// decoding changes the program, so it cannot happen on a compiler thread, which may inline any callee
+		for(u16 i = 0; i != count; ++i)
+			_program.function(i);
+
+		std::vector<std::shared_future<CompiledCode>> compiled;
+		for(u16 i = 0; i != count; ++i)
+		{
+			auto const& func = _program.functions[i];
+
+			compiled.push_back(start([this, &func]()
+			{
+				Logger::log(Topic::COMPILE) << "Compiling function " << func.name << std::endl;
+				return generate(func);
+			}));
+		}
+
+		std::ostringstream os;
+		os << "\t.text\n";
+
+		std::vector<bool> present(count);
+		for(u16 i = 0; i != count; ++i)
+		{
+			CompiledCode code;
+
+			try
+			{
+				code = compiled[i].get();
+			}
+			catch(std::exception const& e)
+			{
+				Logger::err() << "warning: leaving function " << _program.functions[i].name << " to the JIT: " << e.what() << "\n";
+				continue;
+			}
+
+			present[i] = true;
+
+			auto relocations = code.relocations;
+			std::sort(relocations.begin(), relocations.end(),
+			          [](Relocation const& a, Relocation const& b) { return a.offset < b.offset; });
+
+			os << "\t.p2align 4\n";
+			os << "aot_function_" << i << ": # " << _program.functions[i].name << "\n";
+
+			u32 offset = 0;
+			for(auto const& relocation : relocations)
+			{
+				emitBytes(os, code.bytes.data() + offset, code.bytes.data() + relocation.offset);
+				os << "\t.quad aot_vtable_" << (unsigned) relocation.vTableOf << "\n";
+				offset = relocation.offset + sizeof(u64);
+			}
+
+			emitBytes(os, code.bytes.data() + offset, code.bytes.data() + code.bytes.size());
+		}
+
+		os << "\n\t.section .rodata\n";
+
+		// vTables hold u16 function indices, the code reads them with word loads
+		for(auto const& typePair : _program.types)
+		{
+			os << "\t.p2align 3\n";
+			os << "aot_vtable_" << (unsigned) typePair.first << ":\n";
+
+			for(u16 index : typePair.second.vTable)
+				os << "\t.short " << index << "\n";
+
+			os << "\t.zero 8\n";
+		}
+
+		os << "\t.p2align 3\n";
+		os << "\t.globl aot_functions\n";
+		os << "aot_functions:\n";
+		for(u16 i = 0; i != count; ++i)
+		{
+			if(present[i])
+				os << "\t.quad aot_function_" << i << "\n";
+			else
+				os << "\t.quad 0\n";
+		}
+
+		// functions left to the JIT are compiled at run time, with the options of the executable
+		os << "\t.globl aot_bounds_checks\n";
+		os << "aot_bounds_checks:\n";
+		os << "\t.byte " << (_options.boundsChecks ? 1 : 0) << "\n";
+
+		os << "\t.p2align 2\n";
+		os << "\t.globl aot_optimization_level\n";
+		os << "aot_optimization_level:\n";
+		os << "\t.long " << _options.optimizationLevel << "\n";
+
+		std::string passes;
+		for(auto const& pass : _options.passes)
+			passes += (passes.empty() ? "" : ",") + pass;
+
+		os << "\t.globl aot_passes\n";
+		os << "aot_passes:\n";
+		os << "\t.asciz " << quoted(passes) << "\n";
+
+		os << "\t.p2align 3\n";
+		os << "\t.globl aot_bytecode_size\n";
+		os << "aot_bytecode_size:\n";
+		os << "\t.quad " << std::filesystem::file_size(_input) << "\n";
+
+		os << "\t.globl aot_bytecode\n";
+		os << "aot_bytecode:\n";
+		os << "\t.incbin " << quoted(std::filesystem::absolute(_input).string()) << "\n";
+
+		os << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+
+		return os.str();
+	}
+
+	void AotCompiler::writeExecutable(std::string const& output, std::string const& runtime)
+	{
+		auto source = output + ".s";
+
+		{
+			std::ofstream file(source);
+			file << assembly();
+
+			if(!file)
+				throw std::runtime_error("failed to write '" + source + "'");
+		}
+
+		// vTable addresses are absolute, the executable cannot be position independent. The whole runtime is
+		// linked since passes register themselves from objects nothing else refers to.
+		run({"c++", "-no-pie", "-o", output, source, "-Wl,--whole-archive", runtime, "-Wl,--no-whole-archive", "-pthread"});
+
+		if(!_options.debug)
+			std::remove(source.c_str());
+	}
+}}
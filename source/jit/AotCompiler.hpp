@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include <jit/JitEngine.hpp>
+
+namespace am2017s { namespace jit
+{
+	/**
+	 * Compiles a whole program ahead of time into a native executable.
+	 *
+	 * Every function goes through the same pipeline as in the JIT. Its code is written to an assembly file
+	 * together with a table of all functions (aot_functions), read-only copies of the vTables that relocations
+	 * refer to, and the bytecode itself (aot_bytecode). The system compiler assembles the file and links it
+	 * against the vm runtime library, whose main loads the bytecode into a JitEngine, links in the table and runs
+	 * main just like `vm jit` does. Functions that fail to compile ahead of time are left to the JIT, which
+	 * compiles them with the bounds checks, optimization level and passes stored next to the bytecode
+	 * (aot_bounds_checks, aot_optimization_level, aot_passes).
+	 */
+	class AotCompiler : public JitEngine
+	{
+		std::string _input;
+
+	public:
+		AotCompiler(std::string input, Options const& options);
+
+		std::string assembly();
+
+		/**
+		 * Writes the executable `output`, linked against the runtime library `runtime`
+		 */
+		void writeExecutable(std::string const& output, std::string const& runtime);
+	};
+}}
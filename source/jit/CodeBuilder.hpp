@@ -31,7 +31,25 @@ namespace am2017s::jit::internal
 		GTE = 0x0F9D,
 		LTE = 0x0F9E,
 		GT = 0x0F9F,
+
+		// unsigned
+		BELOW = 0x0F92,
+		ABOVE_EQUAL = 0x0F93,
+		BELOW_EQUAL = 0x0F96,
+		ABOVE = 0x0F97,
+
+		PARITY = 0x0F9A,
+		NO_PARITY = 0x0F9B,
 	};
+
+	/**
+	 * The condition that holds whenever `on` does not, conditions come in pairs that differ in the lowest bit
+	 */
+	inline
+	Comparison inverse(Comparison on)
+	{
+		return (Comparison) (on ^ 1);
+	}
 }
 
 namespace am2017s::jit
@@ -264,6 +282,69 @@ namespace am2017s::jit
 			}
 		}
 
+		/**
+		 * An instruction of group 1 (add, or, adc, sbb, and, sub, xor, cmp) with an immediate operand,
+		 * `extension` is the opcode extension that selects it
+		 */
+		void immediate(u8 extension, RegMemOp rm, i32 imm, OperandSize size)
+		{
+			prefixes(size, NONE, rm);
+
+			if(size == BYTE) {
+				opcode(0x80); // /extension ib
+				operands(RegOp(extension), rm);
+				byte(imm);
+			} else if(internal::fitsInto<i8>(imm)) {
+				opcode(0x83); // /extension ib
+				operands(RegOp(extension), rm);
+				byte(imm);
+			} else {
+				opcode(0x81); // /extension iw or id
+				operands(RegOp(extension), rm);
+				if(size == WORD) {
+					word(imm);
+				} else {
+					dword(imm);
+				}
+			}
+		}
+
+		/**
+		 * A scalar SSE instruction `0F op` with `reg` in ModR/M.reg and `rm` in ModR/M.r/m, `prefix` (if not
+		 * zero) selects the precision, F3 for single and F2 for double
+		 */
+		void sse(u8 prefix, u8 op, XMMOp reg, RegMemOp rm)
+		{
+			if(prefix) {
+				byte(prefix);
+			}
+
+			auto x = !rm.isXMM() && rm.mem().index != NONE && isExtended(rm.mem().index);
+			auto b = rm.isXMM() ? isExtended(rm.xmm()) : rm.mem().base != NONE && isExtended(rm.mem().base);
+			rex(false, isExtended(reg), x, b);
+			opcode(0x0F, op);
+
+			if(rm.isXMM()) {
+				modrm(0b11, reg, rm.xmm());
+			} else {
+				operands((RegOp) reg, rm.mem());
+			}
+		}
+
+		/**
+		 * The mandatory prefix of the scalar single or double precision form
+		 */
+		static u8 precision(OperandSize size)
+		{
+			if(size == DWORD) {
+				return 0xF3;
+			} else if(size == QWORD) {
+				return 0xF2;
+			}
+
+			throw std::runtime_error("no floating point operations of size " + std::to_string(size));
+		}
+
 	public:
 		std::vector<u8> build();
 
@@ -284,6 +365,26 @@ namespace am2017s::jit
 			return _buf.size();
 		}
 
+		/**
+		 * Pads with int3 up to the next multiple of `boundary`
+		 */
+		void align(u32 boundary)
+		{
+			while(offset() % boundary != 0) {
+				byte(0xCC);
+			}
+		}
+
+		/**
+		 * Data in the code, the lowest `size` bytes of `value`
+		 */
+		void data(i64 value, OperandSize size)
+		{
+			for(u8 i = 0; i != size; ++i) {
+				byte(value >> (i * 8));
+			}
+		}
+
 		void ret()
 		{
 			opcode(0xC3);
@@ -391,13 +492,38 @@ namespace am2017s::jit
 			}
 			else
 			{
-				// mov imm64
-				rex(true, false, false, isExtended(dst));
-				opcode(0xB8 | (dst & 0b111));
-				qword(imm);
+				movimm64(imm, dst);
+			}
+		}
+
+		/**
+		 * mov imm, the immediate is sign extended for QWORD stores
+		 */
+		void movimm(i32 imm, MemOp dst, OperandSize size)
+		{
+			prefixes(size, NONE, dst);
+			opcode(size == BYTE ? 0xC6 : 0xC7); // /0
+			operands(RegOp(0), dst);
+
+			if(size == BYTE) {
+				byte(imm);
+			} else if(size == WORD) {
+				word(imm);
+			} else {
+				dword(imm);
 			}
 		}
 
+		/**
+		 * mov imm64, also for small values. The immediate makes up the last 8 bytes.
+		 */
+		void movimm64(i64 imm, RegOp dst)
+		{
+			rex(true, false, false, isExtended(dst));
+			opcode(0xB8 | (dst & 0b111));
+			qword(imm);
+		}
+
 		void movf(XMMOp src, XMMOp dst, OperandSize size = QWORD) {
 			opcode(0xF3);
 			rex(false, isExtended(dst), false, isExtended(src));
@@ -508,12 +634,9 @@ namespace am2017s::jit
 			operands(dst, src);
 		}
 
-		void add(RegOp toThis, i16 that)
+		void add(RegMemOp toThis, i32 that, OperandSize size = QWORD)
 		{
-			rex(true, isExtended(toThis), false, false);
-			opcode(0x81);
-			modrm(0b11, 0, toThis & 0b111);
-			dword(that);
+			immediate(0, toThis, that, size);
 		}
 
 		// todo untested
@@ -525,49 +648,50 @@ namespace am2017s::jit
 			sib64(RSP, 0, 0b100, src * 8);
 		}
 
-		void addf(XMMOp src, XMMOp dst, OperandSize size = QWORD) {
-			if(size == DWORD) {
-				opcode(0xF3);
-			} else if(size == QWORD) {
-				opcode(0xF2);
-			}
-
-			rex(false, isExtended(dst), false, isExtended(dst));
-			opcode(0x0F, 0x58);
+		void addf(RegMemOp src, XMMOp dst, OperandSize size = QWORD) {
+			sse(precision(size), 0x58, dst, src);
+		}
 
-			modrm(0b11, dst, src);
+		void subf(RegMemOp src, XMMOp dst, OperandSize size = QWORD) {
+			sse(precision(size), 0x5C, dst, src);
 		}
 
-		void mulf(XMMOp src, XMMOp dst, OperandSize size = QWORD) {
-			if(size == DWORD) {
-				opcode(0xF3);
-			} else if(size == QWORD) {
-				opcode(0xF2);
-			}
+		void mulf(RegMemOp src, XMMOp dst, OperandSize size = QWORD) {
+			sse(precision(size), 0x59, dst, src);
+		}
 
-			rex(false, isExtended(dst), false, isExtended(src));
-			opcode(0x0F, 0x59);
+		void divf(RegMemOp src, XMMOp dst, OperandSize size = QWORD) {
+			sse(precision(size), 0x5E, dst, src);
+		}
 
-			modrm(0b11, dst, src);
+		/**
+		 * xorps, the same for both precisions since it works on all bits of the registers
+		 */
+		void xorf(XMMOp src, XMMOp dst) {
+			sse(0, 0x57, dst, src);
 		}
 
-		void divf(XMMOp srcA, RegMemOp srcB, OperandSize size) {
-			if(size == DWORD) {
-				opcode(0xF3);
-			} else if(size == QWORD) {
-				opcode(0xF2);
-			} else {
-				throw std::runtime_error("no such float for divf");
-			}
+		/**
+		 * Compares `a` with `b` like an unsigned cmp (CF for below, ZF for equal), unordered operands set
+		 * ZF, PF and CF
+		 */
+		void ucomis(XMMOp a, RegMemOp b, OperandSize size = QWORD) {
+			// 66 selects ucomisd, no prefix ucomiss
+			sse(size == QWORD ? 0x66 : 0, 0x2E, a, b);
+		}
 
-			rex(false, isExtended(srcA), false, false);
-			opcode(0x0F, 0x5E);
+		/**
+		 * movss or movsd `dst, [rip + disp32]`, returns the offset of the displacement
+		 */
+		u32 movf_riprel(XMMOp dst, OperandSize size = QWORD) {
+			byte(precision(size));
+			rex(false, isExtended(dst), false, false);
+			opcode(0x0F, 0x10);
+			modrm(0b00, dst, 0b101);
 
-			if(srcB.isXMM()) {
-				modrm(0b11, srcA, srcB.xmm());
-			} else {
-				throw std::runtime_error("divf for srcB in mem not yet implemented");
-			}
+			auto offptr = offset();
+			dword(0);
+			return offptr;
 		}
 
 		void sub(RegOp src, RegOp dst, OperandSize size = QWORD)
@@ -584,12 +708,9 @@ namespace am2017s::jit
 			operands(dst, src);
 		}
 
-		void sub(RegOp fromThis, i16 that)
+		void sub(RegMemOp fromThis, i32 that, OperandSize size = QWORD)
 		{
-			rex(true, isExtended(fromThis), false, false);
-			opcode(0x81);
-			modrm(0b11, 5, fromThis & 0b111);
-			dword(that);
+			immediate(5, fromThis, that, size);
 		}
 
 		void imul(RegOp src, RegOp dst)
@@ -600,11 +721,46 @@ namespace am2017s::jit
 		}
 
 		void imul(RegOp reg, RegMemOp rm) {
-			rex(true, isExtended(reg), false, false);
+			prefixes(QWORD, reg, rm);
 			opcode(0x0F, 0xAF);
 			operands(reg, rm);
 		}
 
+		/**
+		 * reg = reg * imm
+		 */
+		void imul(RegOp reg, i32 imm, OperandSize size = QWORD) {
+			prefixes(size, reg, reg);
+			if(internal::fitsInto<i8>(imm)) {
+				opcode(0x6B);
+				operands(reg, reg);
+				byte(imm);
+			} else {
+				opcode(0x69);
+				operands(reg, reg);
+				dword(imm);
+			}
+		}
+
+		/**
+		 * Signed RDX:RAX = RAX * factor (EDX:EAX for DWORD)
+		 */
+		void imul(RegMemOp factor, OperandSize size = QWORD) {
+			prefixes(size, NONE, factor);
+			opcode(0xF7);
+			operands(RegOp(5), factor);
+		}
+
+		/**
+		 * dst = base + index * scale
+		 */
+		void lea(RegOp base, RegOp index, u8 scale, RegOp dst, OperandSize size = QWORD) {
+			MemOp address(base, index, scale, 0);
+			prefixes(size, dst, address);
+			opcode(0x8D);
+			operands(dst, address);
+		}
+
 		// todo this is always 64b
 		void idiv(RegOp divider, OperandSize size = QWORD)
 		{
@@ -636,6 +792,17 @@ namespace am2017s::jit
 			return offptr;
 		}
 
+		/**
+		 * Jumps if `on` holds, the Jcc opcodes are those of SETcc minus 0x10
+		 */
+		u32 jcc_riprel(internal::Comparison on)
+		{
+			dopcode((u16) on - 0x10);
+			auto offptr = offset();
+			dword(0);
+			return offptr;
+		}
+
 		void call(RegOp through)
 		{
 			opcode(0xFF);
@@ -675,15 +842,18 @@ namespace am2017s::jit
 			operands(a, b);
 		}
 
-		// todo untested
 		void cmp(RegMemOp a, RegOp b, OperandSize size = QWORD)
 		{
 			prefixes(size, b, a);
-			rex(true, isExtended(b), false, isExtended(RSP));
 			opcode(0x39);
 			operands(b, a);
 		}
 
+		void cmp(RegMemOp a, i32 b, OperandSize size = QWORD)
+		{
+			immediate(7, a, b, size);
+		}
+
 		// todo untested
 		void lor(RegOp src, RegOp dst, OperandSize size = QWORD)
 		{
@@ -734,29 +904,62 @@ namespace am2017s::jit
 			dword(that);
 		}
 
-		void shr(RegOp reg, u8 count)
+		void shl(RegOp reg, u8 count, OperandSize size = QWORD)
 		{
-			rex(true, isExtended(reg), false, false);
+			prefixes(size, NONE, reg);
+			opcode(0xC1); // 4 ib
+			modrm(0b11, 4, reg & 0b111);
+			byte(count);
+		}
+
+		void shr(RegOp reg, u8 count, OperandSize size = QWORD)
+		{
+			prefixes(size, NONE, reg);
 			opcode(0xC1); // 5 ib
 			modrm(0b11, 5, reg & 0b111);
 			byte(count);
 		}
 
-		void andimm(RegOp reg, u8 b)
+		void sar(RegOp reg, u8 count, OperandSize size = QWORD)
+		{
+			prefixes(size, NONE, reg);
+			opcode(0xC1); // 7 ib
+			modrm(0b11, 7, reg & 0b111);
+			byte(count);
+		}
+
+		void andimm(RegOp reg, i32 mask, OperandSize size = QWORD)
 		{
-			rex(true, isExtended(reg), false, false);
-			opcode(0x83);
-			modrm(0b11, 4, reg);
-			byte(b);
+			prefixes(size, NONE, reg);
+			if(internal::fitsInto<i8>(mask)) {
+				opcode(0x83); // 4 ib
+				modrm(0b11, 4, reg & 0b111);
+				byte(mask);
+			} else {
+				opcode(0x81); // 4 id
+				modrm(0b11, 4, reg & 0b111);
+				dword(mask);
+			}
 		}
 
 		void set(internal::Comparison on, RegOp dst)
 		{
-			rex(false, false, false, isExtended(dst));
+			// without REX, the low bytes of RSP, RBP, RSI and RDI encode AH, CH, DH and BH
+			if(dst > RBX)
+				force_rex(false, false, false, isExtended(dst));
+			else
+				rex(false, false, false, isExtended(dst));
 			dopcode((u16) on);
 			modrm(0b11, 0, dst & 0b111);
 		}
 
+		void set(internal::Comparison on, MemOp dst)
+		{
+			prefixes(BYTE, NONE, dst);
+			dopcode((u16) on);
+			operands(RegOp(0), dst);
+		}
+
 		void set(internal::Comparison on, i32 dst)
 		{
 			dopcode((u16) on);
@@ -773,6 +976,14 @@ namespace am2017s::jit
 			byte(1);
 		}
 
+		void test(MemOp src)
+		{
+			prefixes(BYTE, NONE, src);
+			opcode(0xF6); // /0 ib
+			operands(RegOp(0), src);
+			byte(1);
+		}
+
 		void test(i32 dst)
 		{
 			// REX is not needed for this instruction
@@ -831,5 +1042,13 @@ namespace am2017s::jit
 			rex(true, false, false, false);
 			opcode(0x99);
 		}
+
+		/**
+		 * Sign extends EAX into EDX
+		 */
+		void cdq()
+		{
+			opcode(0x99);
+		}
 	};
 }
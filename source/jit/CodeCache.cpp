@@ -0,0 +1,401 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include <unistd.h>
+
+#include <jit/CodeCache.hpp>
+
+namespace am2017s { namespace jit
+{
+	namespace
+	{
+		constexpr u32 MAGIC = 0x434A4943; // "CIJC"
+		constexpr u32 FORMAT = 1;
+
+		/**
+		 * Version of the code the JIT emits. Has to be bumped whenever the same bytecode and pipeline compile to
+		 * different machine code, entries of other versions are never loaded.
+		 */
+		constexpr u32 CODEGEN = 1;
+
+		/**
+		 * 64 bit FNV-1a
+		 */
+		class Hash
+		{
+			u64 _value = 0xCBF29CE484222325;
+
+		public:
+			Hash& bytes(void const* data, std::size_t size)
+			{
+				for(auto byte = (u8 const*) data; size--; ++byte)
+					_value = (_value ^ *byte) * 0x100000001B3;
+
+				return *this;
+			}
+
+			template<typename T>
+			Hash& operator<<(T value)
+			{
+				static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "only hash plain values");
+				return bytes(&value, sizeof value);
+			}
+
+			Hash& operator<<(std::string const& value)
+			{
+				*this << (u64) value.size();
+				return bytes(value.data(), value.size());
+			}
+
+			Hash& operator<<(bytecode::Type type)
+			{
+				return *this << type.isArray << type.baseType;
+			}
+
+			Hash& operator<<(bytecode::OperandList list)
+			{
+				return *this << list.offset << list.count;
+			}
+
+			u64 value() const
+			{
+				return _value;
+			}
+		};
+
+		// only the operands an opcode actually has, the others are uninitialized
+		void hashInstruction(Hash& hash, bytecode::Instruction const& instr)
+		{
+			using bytecode::Opcode;
+
+			hash << instr.opcode;
+
+			switch(instr.opcode)
+			{
+				case Opcode::NOP:
+				case Opcode::RET_VOID:
+					break;
+
+				case Opcode::ADD:
+				case Opcode::SUB:
+				case Opcode::MUL:
+				case Opcode::DIV:
+				case Opcode::MOD:
+				case Opcode::GT:
+				case Opcode::GTE:
+				case Opcode::EQ:
+				case Opcode::NEQ:
+				case Opcode::LTE:
+				case Opcode::LT:
+				case Opcode::AND:
+				case Opcode::OR:
+					hash << instr.binary.dstIdx << instr.binary.lsrcIdx << instr.binary.rsrcIdx;
+					break;
+
+				case Opcode::NEG:
+				case Opcode::NOT:
+					hash << instr.unary.dstIdx << instr.unary.srcIdx;
+					break;
+
+				case Opcode::RETURN:
+					hash << instr.unary.srcIdx;
+					break;
+
+				case Opcode::CONST:
+					hash << instr.constant.dstIdx << instr.constant.type << instr.constant.value;
+					break;
+
+				case Opcode::LOAD_IDX:
+				case Opcode::STORE_IDX:
+					hash << instr.array.indexIdx;
+				case Opcode::LENGTH:
+					hash << instr.array.memoryIdx << instr.array.valueIdx;
+					break;
+
+				case Opcode::NEW:
+					hash << instr.alloc.dstIdx << instr.alloc.type << instr.alloc.sizeIdx;
+					break;
+
+				case Opcode::IF_GOTO:
+					hash << instr.jump.conditionIdx;
+				case Opcode::GOTO:
+					hash << instr.jump.branchIdx;
+					break;
+
+				case Opcode::CALL:
+				case Opcode::SPECIAL:
+					hash << instr.call.dstIdx;
+				case Opcode::CALL_VOID:
+				case Opcode::SPECIAL_VOID:
+					hash << instr.call.functionIdx << instr.call.args;
+					break;
+
+				case Opcode::MEMBER_CALL:
+					hash << instr.member_call.dstIdx;
+				case Opcode::VOID_MEMBER_CALL:
+					hash << instr.member_call.ptrIdx << instr.member_call.functionIdx << instr.member_call.args;
+					break;
+
+				case Opcode::PHI:
+					hash << instr.phi.dstIdx << instr.phi.edges;
+					break;
+
+				case Opcode::ALLOCATE:
+					hash << instr.obj_alloc.dstIdx << instr.obj_alloc.typeId;
+					break;
+
+				case Opcode::OBJ_LOAD:
+				case Opcode::OBJ_STORE:
+					hash << instr.access.ptrIdx << instr.access.typeId << instr.access.fieldIdx << instr.access.valueIdx;
+					break;
+
+				case Opcode::GLOB_LOAD:
+				case Opcode::GLOB_STORE:
+					hash << instr.global.globalIdx << instr.global.value;
+					break;
+
+				case Opcode::BOUNDS_CHECK:
+					hash << instr.check.arrayIdx << instr.check.indexIdx << instr.check.limitIdx;
+					break;
+
+				default:
+					throw std::runtime_error("opcode " + std::to_string((u8) instr.opcode) + " cannot be cached");
+			}
+		}
+
+		// callees the engine has not decoded yet are hashed by their encoding
+		void hashBody(Hash& hash, bytecode::Function const& function)
+		{
+			hash << function.name;
+
+			if(!function.isDecoded())
+			{
+				hash << (u64) (function.encodedBodyEnd - function.encodedBody);
+				hash.bytes(function.encodedBody, function.encodedBodyEnd - function.encodedBody);
+				return;
+			}
+
+			hash << function.temporyCount << (u64) function.blocks.size();
+
+			for(auto const& block : function.blocks)
+			{
+				hash << block.instructionCount << (u64) block.successors.size();
+				hash.bytes(block.successors.data(), block.successors.size() * sizeof(u16));
+			}
+
+			hash << (u64) function.instructions.size();
+			for(auto const& instruction : function.instructions)
+				hashInstruction(hash, instruction);
+
+			hash << (u64) function.operands.size();
+			hash.bytes(function.operands.data(), function.operands.size() * sizeof(u16));
+
+			for(auto type : function.temporaryTypes)
+				hash << type;
+		}
+
+		template<typename T>
+		void write(std::ostream& os, T value)
+		{
+			os.write((char const*) &value, sizeof value);
+		}
+
+		template<typename T>
+		T read(std::istream& is)
+		{
+			T value{};
+			is.read((char*) &value, sizeof value);
+			return value;
+		}
+	}
+
+	CodeCache::CodeCache(std::string directory, bytecode::Program const& program, std::string const& pipeline,
+	                     unsigned calleeDepth)
+		: _directory(std::move(directory)), _program(program), _calleeDepth(calleeDepth)
+	{
+		std::filesystem::create_directories(_directory);
+
+		Hash hash;
+		hash << FORMAT << CODEGEN << pipeline;
+
+		for(auto const& global : program.globals)
+			hash << global.typeId << global.offset;
+
+		for(auto const& typePair : program.types)
+		{
+			auto const& type = typePair.second;
+			hash << type.id << type.getSize() << (u64) type.fields.size();
+
+			for(auto const& field : type.fields)
+				hash << field.typeId << field.offset;
+
+			hash << (u64) type.vTable.size();
+			hash.bytes(type.vTable.data(), type.vTable.size() * sizeof(u16));
+		}
+
+		// calls depend on the signature of the callee
+		for(auto const& function : program.functions)
+		{
+			hash << function.name << function.returnType << (u64) function.parameters.size();
+
+			for(auto const& parameter : function.parameters)
+				hash << parameter.type;
+		}
+
+		// the inliner takes larger callees if they are called only once
+		for(u32 count : program.callSites)
+			hash << count;
+
+		_programKey = hash.value();
+	}
+
+	u64 CodeCache::keyOf(bytecode::Function const& function) const
+	{
+		Hash hash;
+		hash << _programKey;
+		hashBody(hash, function);
+
+		// the inliner may copy the bodies of callees into the function
+		std::set<u16> seen;
+		std::vector<bytecode::Function const*> level{&function};
+
+		for(unsigned depth = 0; depth != _calleeDepth && !level.empty(); ++depth)
+		{
+			std::vector<bytecode::Function const*> next;
+			for(auto caller : level)
+			{
+				if(!caller->isDecoded())
+					continue;
+
+				for(auto const& instruction : caller->instructions)
+				{
+					if((instruction.opcode == bytecode::Opcode::CALL || instruction.opcode == bytecode::Opcode::CALL_VOID)
+					   && seen.insert(instruction.call.functionIdx).second)
+					{
+						auto const& callee = _program.functions.at(instruction.call.functionIdx);
+						hash << instruction.call.functionIdx;
+						hashBody(hash, callee);
+						next.push_back(&callee);
+					}
+				}
+			}
+			level = std::move(next);
+		}
+
+		return hash.value();
+	}
+
+	std::string CodeCache::pathOf(u64 key) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof name, "%016llx.code", (unsigned long long) key);
+		return _directory + "/" + name;
+	}
+
+	// an entry is the magic number, the key, the relocations and the code, followed by a hash of all of these
+	bool CodeCache::load(u64 key, CompiledCode& code) const
+	{
+		std::ifstream file(pathOf(key), std::ios::binary);
+		if(!file)
+			return false;
+
+		std::string entry((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if(entry.size() < sizeof(u64))
+			return false;
+
+		u64 checksum;
+		std::memcpy(&checksum, entry.data() + entry.size() - sizeof checksum, sizeof checksum);
+		entry.resize(entry.size() - sizeof checksum);
+
+		if(Hash().bytes(entry.data(), entry.size()).value() != checksum)
+			return false;
+
+		std::istringstream is(entry);
+		if(read<u32>(is) != MAGIC || read<u64>(is) != key)
+			return false;
+
+		CompiledCode loaded;
+		loaded.relocations.resize(read<u32>(is));
+		for(auto& relocation : loaded.relocations)
+		{
+			relocation.offset = read<u32>(is);
+			relocation.vTableOf = read<u8>(is);
+		}
+
+		loaded.bytes.resize(read<u32>(is));
+		is.read((char*) loaded.bytes.data(), loaded.bytes.size());
+
+		if(!is || is.peek() != EOF)
+			return false;
+
+		for(auto const& relocation : loaded.relocations)
+		{
+			auto type = _program.types.find(relocation.vTableOf);
+			if(type == _program.types.end() || (u64) relocation.offset + sizeof(u64) > loaded.bytes.size())
+				return false;
+
+			u64 address = (u64) type->second.vTable.data();
+			std::memcpy(loaded.bytes.data() + relocation.offset, &address, sizeof address);
+		}
+
+		code = std::move(loaded);
+		return true;
+	}
+
+	void CodeCache::store(u64 key, CompiledCode const& code) const
+	{
+		// relocated addresses are meaningless to other processes
+		auto bytes = code.bytes;
+		for(auto const& relocation : code.relocations)
+			std::memset(bytes.data() + relocation.offset, 0, sizeof(u64));
+
+		std::ostringstream os;
+		write<u32>(os, MAGIC);
+		write<u64>(os, key);
+
+		write<u32>(os, code.relocations.size());
+		for(auto const& relocation : code.relocations)
+		{
+			write<u32>(os, relocation.offset);
+			write<u8>(os, relocation.vTableOf);
+		}
+
+		write<u32>(os, bytes.size());
+		os.write((char const*) bytes.data(), bytes.size());
+
+		auto entry = os.str();
+		write<u64>(os, Hash().bytes(entry.data(), entry.size()).value());
+		entry = os.str();
+
+		auto path = pathOf(key);
+		auto temporary = path + "." + std::to_string(getpid()) + "."
+		                 + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+		{
+			std::ofstream file(temporary, std::ios::binary);
+			file.write(entry.data(), entry.size());
+
+			if(!file)
+			{
+				std::remove(temporary.c_str());
+				throw std::runtime_error("failed to write '" + temporary + "'");
+			}
+		}
+
+		// atomically replaces an entry another process may have written in the meantime
+		if(std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+			throw std::runtime_error("failed to rename '" + temporary + "' to '" + path + "'");
+		}
+	}
+}}
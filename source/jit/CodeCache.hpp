@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include <bytecode.hpp>
+#include <jit/CompiledCode.hpp>
+
+namespace am2017s { namespace jit
+{
+	/**
+	 * Keeps compiled functions in a directory, so later runs of a program skip the compiler.
+	 *
+	 * Functions are keyed by a hash of their bytecode and that of the callees the inliner may copy into them,
+	 * the layout of the program (globals, struct types, function prototypes and call sites), the optimization
+	 * pipeline and the version of the code generator, any change to them leads to a different key. Every entry
+	 * is a file that is written under a temporary name and renamed into place, so processes sharing the
+	 * directory see either a complete entry or none. Entries failing their checksum are ignored.
+	 */
+	class CodeCache
+	{
+		std::string _directory;
+		bytecode::Program const& _program;
+		u64 _programKey;
+		unsigned _calleeDepth;
+
+		std::string pathOf(u64 key) const;
+
+	public:
+		/**
+		 * `pipeline` names the optimization passes the code is compiled with, see PassManager::pipeline, and
+		 * `calleeDepth` how many levels of calls they inline, see PassManager::inlineDepth
+		 */
+		CodeCache(std::string directory, bytecode::Program const& program, std::string const& pipeline,
+		          unsigned calleeDepth);
+
+		u64 keyOf(bytecode::Function const& function) const;
+
+		/**
+		 * Reads the entry for `key` into `code` with the relocations applied for this process. Returns
+		 * false if there is no valid entry.
+		 */
+		bool load(u64 key, CompiledCode& code) const;
+
+		void store(u64 key, CompiledCode const& code) const;
+	};
+}}
@@ -0,0 +1,46 @@
+#include <jit/CompileQueue.hpp>
+
+namespace am2017s { namespace jit
+{
+	CompileQueue::CompileQueue(unsigned threads)
+	{
+		for(unsigned i = 0; i != threads; ++i)
+			_workers.emplace_back(&CompileQueue::work, this);
+	}
+
+	CompileQueue::~CompileQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+			_jobs.clear();
+		}
+
+		_available.notify_all();
+
+		for(auto& worker : _workers)
+			worker.join();
+	}
+
+	void CompileQueue::work()
+	{
+		for(;;)
+		{
+			std::function<void()> job;
+
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_available.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+
+				if(_stopping)
+					return;
+
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+
+			// exceptions end up in the job's future
+			job();
+		}
+	}
+}}
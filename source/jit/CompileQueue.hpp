@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace am2017s { namespace jit
+{
+	/**
+	 * A pool of threads compiling in the background.
+	 *
+	 * Jobs run in the order they were submitted. Jobs that have not started when the queue is destroyed are
+	 * dropped, their futures report a broken promise.
+	 */
+	class CompileQueue
+	{
+		std::mutex _mutex;
+		std::condition_variable _available;
+		std::deque<std::function<void()>> _jobs;
+		bool _stopping = false;
+
+		std::vector<std::thread> _workers;
+
+		void work();
+
+	public:
+		explicit CompileQueue(unsigned threads);
+		~CompileQueue();
+
+		CompileQueue(CompileQueue const&) = delete;
+		CompileQueue& operator=(CompileQueue const&) = delete;
+
+		template<typename Job>
+		auto submit(Job job) -> std::shared_future<decltype(job())>
+		{
+			auto task = std::make_shared<std::packaged_task<decltype(job())()>>(std::move(job));
+			std::shared_future<decltype(job())> result = task->get_future().share();
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_jobs.emplace_back([task]() { (*task)(); });
+			}
+
+			_available.notify_one();
+			return result;
+		}
+	};
+}}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include <types.hpp>
+
+namespace am2017s { namespace jit
+{
+	/**
+	 * A qword in compiled code holding the address of the vTable of struct type `vTableOf`
+	 */
+	struct Relocation
+	{
+		u32 offset;
+		u8 vTableOf;
+	};
+
+	/**
+	 * Machine code of a function, everything but its relocations is independent of where it is placed and of
+	 * the process it was compiled in (calls go through the function table in %rbp)
+	 */
+	struct CompiledCode
+	{
+		std::vector<u8> bytes;
+		std::vector<Relocation> relocations;
+	};
+}}
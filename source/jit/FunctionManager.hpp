@@ -2,6 +2,7 @@
 
 #include <cstring>
 #include <map>
+#include <mutex>
 #include <vector>
 
 #include <types.hpp>
@@ -10,19 +11,43 @@
 
 namespace am2017s { namespace jit
 {
+	/**
+	 * Owns the compiled code, safe to use from several compiler threads
+	 */
 	class FunctionManager
 	{
+		std::mutex _mutex;
 		CodeHeap _heap;
 		std::map<u16, CodeSegment> _functions;
+		std::vector<CodeSegment> _entries;
 
-	public:
-		void* create(u16 index, std::vector<u8> const& code)
+		CodeSegment place(std::vector<u8> const& code)
 		{
+			std::lock_guard<std::mutex> lock(_mutex);
 			auto segment = _heap.allocate(code.size());
 			std::memcpy(segment.address(), code.data(), code.size());
 			segment.markExecutable();
+			return segment;
+		}
+
+	public:
+		void* create(u16 index, std::vector<u8> const& code)
+		{
+			auto segment = place(code);
+			std::lock_guard<std::mutex> lock(_mutex);
 			_functions[index] = segment;
 			return segment.address();
 		}
+
+		/**
+		 * Keeps code that is not the body of a function, e.g. the entries for on-stack replacement
+		 */
+		void* createEntry(std::vector<u8> const& code)
+		{
+			auto segment = place(code);
+			std::lock_guard<std::mutex> lock(_mutex);
+			_entries.push_back(segment);
+			return segment.address();
+		}
 	};
 }}
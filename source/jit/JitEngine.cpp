@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <iostream>
+#include <set>
 #include <stdexcept>
 #include <utility>
 
@@ -6,10 +11,10 @@
 #include <fstream>
 #include <jit/lifetime/LifetimeAnalyzer.hpp>
 #include <jit/allocator/register/RegisterAllocator.hpp>
-#include <jit/optimizations/Optimizer.hpp>
 #include <jit/architecture/Architecture.hpp>
 #include <jit/lir/LIRCompiler.hpp>
 #include <jit/machine/MachineCompiler.hpp>
+#include <jit/optimizations/Loops.hpp>
 
 #include <jit/SpecialFunctions.hpp>
 
@@ -38,6 +43,23 @@ namespace am2017s { namespace jit
 		return engine->compile(index);
 	}
 
+	extern "C"
+	[[gnu::sysv_abi]]
+	u64 jit_interpret(JitEngine* engine, u16 index, u64 const* registers) asm("jit_interpret");
+	u64 jit_interpret(JitEngine* engine, u16 index, u64 const* registers)
+	{
+		// exceptions cannot unwind through compiled frames
+		try
+		{
+			return engine->interpret(index, registers);
+		}
+		catch(std::exception const& e)
+		{
+			std::cerr << "error: " << e.what() << "\n";
+			std::exit(1);
+		}
+	}
+
 	static
 	u16 findMain(std::vector<bytecode::Function> const& functions)
 	{
@@ -52,18 +74,21 @@ namespace am2017s { namespace jit
 		: _program(std::move(program))
 		, _functionTable(_program.functions.size() + 1 /* JitEngine */ + 1 /* global */ + SPECIAL_FUNCTIONS, reinterpret_cast<void*>(jit_stub))
 		, _options(options)
+		, _passes(options)
+		, _cache(options.codeCache.empty() ? nullptr : std::make_unique<CodeCache>(options.codeCache, _program, _passes.pipeline(), _passes.inlineDepth()))
+		, _queue(options.compileThreads ? std::make_unique<CompileQueue>(options.compileThreads) : nullptr)
 	{
-		std::set<u16> virtualFunctionIndices;
 		for(auto typePair : _program.types) {
 			for(auto fIdx : typePair.second.vTable) {
-				virtualFunctionIndices.insert(fIdx);
+				_virtualFunctions.insert(fIdx);
 			}
 		}
 
-		for(auto fIdx : virtualFunctionIndices) {
+		for(auto fIdx : _virtualFunctions) {
 			_functionTable[fIdx + 1 /* JitEngine */ + 1 /* global */ + SPECIAL_FUNCTIONS] = (void*) &jit_member_stub;
 		}
 
+		_functionTable[SPECIAL_FUNCTIONS - 1 /* JitEngine */ - SPECIAL_F_IDX_BOUNDS_ERROR] = (void*) SPECIAL_F_PTR_BOUNDS_ERROR;
 		_functionTable[SPECIAL_FUNCTIONS - 1 /* JitEngine */ - SPECIAL_F_IDX_EXIT        ] = (void*) SPECIAL_F_PTR_EXIT;
 		_functionTable[SPECIAL_FUNCTIONS - 1 /* JitEngine */ - SPECIAL_F_IDX_PRINT_DOUBLE] = (void*) SPECIAL_F_PTR_PRINT_DOUBLE;
 		_functionTable[SPECIAL_FUNCTIONS - 1 /* JitEngine */ - SPECIAL_F_IDX_PRINTA_INT  ] = (void*) SPECIAL_F_PTR_PRINTA_INT;
@@ -72,19 +97,47 @@ namespace am2017s { namespace jit
 		_functionTable[SPECIAL_FUNCTIONS - 1 /* JitEngine */ - SPECIAL_F_IDX_START       ] = (void*) SPECIAL_F_PTR_START;
 		_functionTable[SPECIAL_FUNCTIONS - 1 /* JitEngine */ - SPECIAL_F_IDX_END         ] = (void*) SPECIAL_F_PTR_END;
 		_functionTable[SPECIAL_FUNCTIONS - 1 /* JitEngine */ - SPECIAL_F_IDX_ALLOCATE    ] = (void*) SPECIAL_F_PTR_ALLOCATE;
-		_functionTable[SPECIAL_FUNCTIONS] = malloc(100); // todo calculate size of global
+		_functionTable[SPECIAL_FUNCTIONS] = std::calloc(std::max(_program.globalsSize(), 8u), 1);
 		_functionTable[SPECIAL_FUNCTIONS + 1] = this;
 
 
 		Logger::log(Topic::ADDRESS) << "JitEngine* : " << this << std::endl;
 	}
 
+	JitEngine::~JitEngine()
+	{
+		_queue.reset();
+		std::free(globals());
+
+		if(_options.timePasses)
+			_passes.printTimes(std::cerr);
+	}
+
+	void** JitEngine::functionTable()
+	{
+		return _functionTable.data() + SPECIAL_FUNCTIONS + 1 /* global */ + 1 /* JitEngine */;
+	}
+
+	u8* JitEngine::globals()
+	{
+		return (u8*) _functionTable[SPECIAL_FUNCTIONS];
+	}
+
+	u64 JitEngine::interpret(u16 index, u64 const*)
+	{
+		throw std::logic_error("function " + _program.functions.at(index).name + " has no interpreter to run on");
+	}
+
 	int JitEngine::execute()
 	{
 		auto idx = findMain(_program.functions);
+
+		if(_options.eager)
+			compileAll(idx);
+
 		compile(idx);
 
-		void **fptable = _functionTable.data() + SPECIAL_FUNCTIONS + 1 /* global */ + 1 /* JitEngine */;
+		void **fptable = functionTable();
 
 		Logger::log(Topic::ADDRESS) << "Invoking main method, passing function table: " << fptable << std::endl;
 
@@ -104,29 +157,228 @@ namespace am2017s { namespace jit
 			file << b;
 	}
 
-	void* JitEngine::compile(u16 index)
+	void JitEngine::publish(u16 index, void* address)
+	{
+		__atomic_store_n(&functionTable()[index], address, __ATOMIC_RELEASE);
+	}
+
+	std::shared_future<void*> JitEngine::request(u16 index)
 	{
 		if(index >= _program.functions.size())
 			throw std::logic_error("invalid function index");
 
-		Logger::log(Topic::COMPILE) << "Compiling function " << _program.functions[index].name << std::endl;
+		auto found = _requests.find(index);
+		if(found != _requests.end())
+			return found->second;
+
+		// decoding a lazily loaded function changes the program, so it cannot happen on a compiler thread
+		auto const& func = _program.function(index);
+		decodeCallees(index);
+
+		auto job = [this, index, &func]()
+		{
+			auto address = _fmgr.create(index, generateCached(func).bytes);
+
+			if(_options.debug)
+			{
+				Logger::log(Topic::ADDRESS) << "Produced code for function " << func.name << " (at address " << address << ")" << std::endl;
+			}
+
+			publish(index, address);
+			return address;
+		};
+
+		return _requests[index] = start(job);
+	}
+
+	void JitEngine::decodeCallees(u16 index)
+	{
+		std::set<u16> decoded{index};
+		std::vector<u16> level{index};
+
+		for(unsigned depth = 0; depth != _passes.inlineDepth() && !level.empty(); ++depth)
+		{
+			std::vector<u16> next;
+			for(u16 caller : level)
+			{
+				for(auto const& instruction : _program.function(caller).instructions)
+				{
+					if((instruction.opcode == bytecode::Opcode::CALL || instruction.opcode == bytecode::Opcode::CALL_VOID)
+					   && decoded.insert(instruction.call.functionIdx).second)
+					{
+						_program.function(instruction.call.functionIdx);
+						next.push_back(instruction.call.functionIdx);
+					}
+				}
+			}
+			level = std::move(next);
+		}
+	}
+
+	void JitEngine::linkAheadOfTime(void* const* code)
+	{
+		for(u16 i = 0; i != _program.functions.size(); ++i)
+		{
+			if(!code[i])
+				continue;
+
+			publish(i, code[i]);
+
+			std::promise<void*> linked;
+			linked.set_value(code[i]);
+			_requests[i] = linked.get_future().share();
+		}
+	}
+
+	void JitEngine::compileAll(u16 main)
+	{
+		auto beginReal = Clock::now();
+		auto beginCpu = std::clock();
+
+		std::vector<bool> found(_program.functions.size());
+		std::vector<u16> reachable;
+
+		auto reach = [&](u16 index)
+		{
+			if(!found.at(index))
+			{
+				found[index] = true;
+				reachable.push_back(index);
+			}
+		};
+
+		reach(main);
+		for(auto fIdx : _virtualFunctions)
+			reach(fIdx);
+
+		// compiler threads start on the first functions while the rest of the call graph is walked
+		for(std::size_t next = 0; next != reachable.size(); ++next)
+		{
+			u16 index = reachable[next];
+			request(index);
+
+			for(auto const& instruction : _program.function(index).instructions)
+			{
+				if(instruction.opcode == bytecode::Opcode::CALL || instruction.opcode == bytecode::Opcode::CALL_VOID)
+					reach(instruction.call.functionIdx);
+			}
+		}
+
+		std::size_t failed = 0;
+		for(u16 index : reachable)
+		{
+			try
+			{
+				request(index).get();
+			}
+			catch(std::exception const& e)
+			{
+				++failed;
+				Logger::log(Topic::COMPILE) << "Could not compile function " << _program.functions[index].name << ": " << e.what() << std::endl;
+			}
+		}
+
+		auto real = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - beginReal).count() / 1000.0;
+		auto cpu = (std::clock() - beginCpu) * 1000.0 / CLOCKS_PER_SEC;
+
+		std::cerr << "compiled " << reachable.size() - failed << " of " << reachable.size() << " functions in "
+		          << real << " ms (" << cpu << " ms cpu)\n";
+	}
+
+	void* JitEngine::compile(u16 index)
+	{
+		auto compiling = request(index);
+
+		if(_queue)
+		{
+			for(auto const& instruction : _program.function(index).instructions)
+			{
+				if(instruction.opcode == bytecode::Opcode::CALL || instruction.opcode == bytecode::Opcode::CALL_VOID)
+					request(instruction.call.functionIdx);
+			}
+		}
+
+		return compiling.get();
+	}
+
+	CompiledCode JitEngine::generateCached(bytecode::Function const& func)
+	{
+		CompiledCode code;
+		u64 key = 0;
+		bool cacheable = false;
+
+		if(_cache)
+		{
+			try
+			{
+				key = _cache->keyOf(func);
+
+				if(_cache->load(key, code))
+				{
+					Logger::log(Topic::COMPILE) << "Loading function " << func.name << " from the code cache" << std::endl;
+					return code;
+				}
+
+				cacheable = true;
+			}
+			catch(std::exception const& e)
+			{
+				Logger::log(Topic::COMPILE) << "Not caching function " << func.name << ": " << e.what() << std::endl;
+			}
+		}
+
+		Logger::log(Topic::COMPILE) << "Compiling function " << func.name << std::endl;
+		code = generate(func);
+
+		if(cacheable)
+		{
+			try
+			{
+				_cache->store(key, code);
+			}
+			catch(std::exception const& e)
+			{
+				Logger::log(Topic::COMPILE) << "Not caching function " << func.name << ": " << e.what() << std::endl;
+			}
+		}
 
-		bytecode::Function const& func = _program.functions[index];
-		auto skip = Optimizer(func).run();
+		return code;
+	}
+
+	CompiledCode JitEngine::generate(bytecode::Function const& original)
+	{
+		bytecode::Function func = original;
+		_passes.run(_program, func);
 
 		// translate to LIR
-		LIRCompiler<AMD64> lirCompiler(this, _program, _program.types, func, skip);
+		LIRCompiler<AMD64> lirCompiler(this, _program, _program.types, func);
 		lirCompiler.run();
+		_passes.run(lirCompiler, func);
 
 		auto liveIntervals = LifetimeAnalyzer(func, lirCompiler.blocks, lirCompiler.numberOfLIRs()).run();
-		allocator::RegisterAllocation<AMD64> allocation(_program.functions[index],
+
+		// the register allocator keeps values used inside of loops in registers
+		Dominators dominators(func);
+		Loops loops(func, dominators);
+		std::vector<u16> loopDepths;
+		for(auto const& block : lirCompiler.blocks)
+		{
+			if(!block.lirs.empty())
+			{
+				loopDepths.resize(std::max<std::size_t>(loopDepths.size(), block.toLIR() + 1), 0);
+				std::fill(loopDepths.begin() + block.fromLIR(), loopDepths.begin() + block.toLIR() + 1, loops.depth[block.index]);
+			}
+		}
+
+		allocator::RegisterAllocation<AMD64> allocation(func,
 		                                                liveIntervals,
 		                                                lirCompiler.usages,
 		                                                lirCompiler.fixedToVR,
 		                                                lirCompiler.fixedXMMToVR,
 		                                                lirCompiler.overflowArgToVR,
 		                                                lirCompiler.vrTypes,
-		                                                lirCompiler.hintSame);
+		                                                lirCompiler.hintSame,
+		                                                std::move(loopDepths));
 		allocation.run();
 
 		MachineCompiler machine(lirCompiler.blocks,
@@ -141,16 +393,12 @@ namespace am2017s { namespace jit
 //		auto allocations = performRegisterAllocation(func, lifetimes);
 //		auto code = compileFunction(func, allocations);
 
-		auto code = machine.builder.build();
-		auto address = _fmgr.create(index, code);
+		CompiledCode code{machine.builder.build(), std::move(machine.relocations)};
 
 		if(_options.debug)
-		{
-			writeDebugFile(code, _program.functions[index]);
-			Logger::log(Topic::ADDRESS) << "Produced code for function " << _program.functions[index].name << " (at address " << address << ")" << std::endl;
-		}
+			writeDebugFile(code.bytes, func);
 
-		return _functionTable[index + 1 /* JitEngine */ + 1 /* global */ + SPECIAL_FUNCTIONS] = address;
+		return code;
 	}
 
 i32 JitEngine::specialFunctionIndex(u16 index) {
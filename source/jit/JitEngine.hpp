@@ -1,14 +1,22 @@
 #pragma once
 
 #include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <set>
 #include <time.h>
 
 #include <bytecode.hpp>
 #include <Engine.hpp>
 #include <Options.hpp>
+#include <jit/CodeCache.hpp>
 #include <jit/CodeHeap.hpp>
+#include <jit/CompiledCode.hpp>
+#include <jit/CompileQueue.hpp>
 #include <jit/FunctionManager.hpp>
 #include <jit/architecture/Architecture.hpp>
+#include <jit/optimizations/PassManager.hpp>
 
 namespace am2017s { namespace jit
 {
@@ -16,17 +24,122 @@ namespace am2017s { namespace jit
 	{
 		using Clock = std::chrono::high_resolution_clock;
 
+	protected:
 		bytecode::Program _program;
 		FunctionManager _fmgr;
 		std::vector<void*> _functionTable;
 
+		/**
+		 * Functions called through a vTable, they receive their index in %rax
+		 */
+		std::set<u16> _virtualFunctions;
+
 		Options _options;
 
+		/**
+		 * Optimizations run on every function before it is translated to machine code
+		 */
+		PassManager _passes;
+
+		/**
+		 * Compiled code of earlier runs, if Options::codeCache is set
+		 */
+		std::unique_ptr<CodeCache> _cache;
+
+		/**
+		 * Compilations that were started, by function index. Only used by the thread running the program.
+		 */
+		std::map<u16, std::shared_future<void*>> _requests;
+
+		/**
+		 * Runs compilations in the background if Options::compileThreads is set, declared after everything the
+		 * compiler threads use so that they are done before it goes away
+		 */
+		std::unique_ptr<CompileQueue> _queue;
+
+		/**
+		 * The table passed to compiled code in %rbp, entry `i` belongs to function `i`
+		 */
+		void** functionTable();
+
+		/**
+		 * The memory holding the globals, Program::globalsSize() bytes large
+		 */
+		u8* globals();
+
+		/**
+		 * Translates `func` to machine code that expects the function table in %rbp
+		 */
+		CompiledCode generate(bytecode::Function const& func);
+
+		/**
+		 * Decodes the bodies of the functions that the inliner may copy into function `index`. Decoding changes
+		 * the program, so it has to happen before the compilation is handed to a compiler thread.
+		 */
+		void decodeCallees(u16 index);
+
+		/**
+		 * Takes the code of `func` from the code cache if it is there, and compiles and caches it otherwise
+		 */
+		CompiledCode generateCached(bytecode::Function const& func);
+
+		/**
+		 * Makes compiled code call `address` for function `index`. The store is atomic, compiled code running
+		 * on another thread sees either the old or the new entry.
+		 */
+		void publish(u16 index, void* address);
+
+		/**
+		 * Runs `job` on a compiler thread, or right away if there are none
+		 */
+		template<typename Job>
+		auto start(Job job) -> std::shared_future<decltype(job())>
+		{
+			if(_queue)
+				return _queue->submit(std::move(job));
+
+			std::packaged_task<decltype(job())()> task(std::move(job));
+			auto done = task.get_future().share();
+			task();
+			return done;
+		}
+
 	public:
 		JitEngine(bytecode::Program program, Options const& options);
-		virtual int execute() override final;
+		virtual ~JitEngine();
+		virtual int execute() override;
+
+		/**
+		 * Starts compiling function `index`, on a compiler thread if there are any. The code is published
+		 * into the function table once it is done. Repeated requests return the same future.
+		 */
+		std::shared_future<void*> request(u16 index);
+
+		/**
+		 * Takes the code of functions compiled ahead of time, `code[i]` is the code of function `i`. Functions
+		 * whose entry is null are left to the JIT.
+		 */
+		void linkAheadOfTime(void* const* code);
+
+		/**
+		 * Compiles the functions reachable from `main` through calls and all functions of vTables, and waits for
+		 * them. Functions that fail to compile keep their stub, and report the error once they are called.
+		 */
+		void compileAll(u16 main);
+
+		/**
+		 * Compiles function `index` and waits for its code. The functions it calls are requested as well, so
+		 * compiler threads can work on them while it runs.
+		 */
 		void* compile(u16 index);
 
+		/**
+		 * Runs function `index` for compiled code that called it through jit_interpret_stub.
+		 * `registers` holds the argument registers (%rdi, %rsi, %rdx, %rcx, %r8, %r9, %xmm0 - %xmm7),
+		 * the result is returned in %rax and %xmm0.
+		 */
+		virtual u64 interpret(u16 index, u64 const* registers);
+
 		clock_t _beginCpu;
 		Clock::time_point _beginReal;
 
@@ -0,0 +1,309 @@
+#include <limits>
+#include <map>
+#include <string>
+
+#include <interpreter/Liveness.hpp>
+#include <jit/OsrBuilder.hpp>
+
+namespace am2017s { namespace jit {
+
+namespace {
+
+constexpr u16 UNUSED = std::numeric_limits<u16>::max();
+
+}
+
+OsrBuilder::OsrBuilder(bytecode::Function const& _function, u16 _header, u16 _predecessor)
+	: function(_function), header(_header), predecessor(_predecessor) {
+}
+
+void OsrBuilder::findReachable() {
+	auto const& blocks = function.blocks;
+	reachable.assign(blocks.size(), false);
+
+	std::vector<u16> work{header};
+	reachable[header] = true;
+
+	while(!work.empty()) {
+		u16 block = work.back();
+		work.pop_back();
+
+		for(u16 successor : blocks[block].successors) {
+			if(successor < blocks.size() && !reachable[successor]) {
+				reachable[successor] = true;
+				work.push_back(successor);
+			}
+		}
+	}
+}
+
+OsrFunction OsrBuilder::run() && {
+	auto const& blocks = function.blocks;
+
+	if(header >= blocks.size() || predecessor >= blocks.size()) {
+		throw std::runtime_error("no loop entry from block " + std::to_string(predecessor) + " to " + std::to_string(header));
+	}
+
+	findReachable();
+	interpreter::Liveness liveness(function);
+
+	// temporaries defined by the blocks that are kept
+	std::vector<bool> defined(function.temporyCount);
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		if(!reachable[block]) {
+			continue;
+		}
+
+		for(u32 i = liveness.blockStarts[block]; i != liveness.blockStarts[block] + blocks[block].instructionCount; ++i) {
+			if(auto dst = function.instructions[i].dstIdx()) {
+				defined[dst.value()] = true;
+			}
+		}
+	}
+
+	OsrFunction result;
+	std::vector<u16> renamed(function.temporyCount, UNUSED);
+
+	auto parameter = [&](u16 temporary) {
+		result.arguments.push_back(temporary);
+		return (u16) (result.arguments.size() - 1);
+	};
+
+	liveness.liveIn[header].forEach([&](u16 temporary) {
+		if(defined[temporary]) {
+			throw std::runtime_error("temporary " + std::to_string(temporary) + " is defined again inside of the loop");
+		}
+
+		renamed[temporary] = parameter(temporary);
+	});
+
+	// what the header's phis get from the entry block
+	std::vector<u16> entryInputs;
+	std::map<u16, u16> passedInputs;
+
+	u32 headerStart = liveness.blockStarts[header];
+	for(u32 i = headerStart; i != headerStart + blocks[header].instructionCount; ++i) {
+		auto const& instr = function.instructions[i];
+		if(instr.opcode != bytecode::Opcode::PHI) {
+			break;
+		}
+
+		u16 input = instr.phi.inputOf(function.operands, predecessor);
+
+		if(defined[input]) {
+			auto passed = passedInputs.find(input);
+			if(passed == passedInputs.end()) {
+				passed = passedInputs.emplace(input, parameter(input)).first;
+			}
+			entryInputs.push_back(passed->second);
+		} else {
+			if(renamed[input] == UNUSED) {
+				renamed[input] = parameter(input);
+			}
+			entryInputs.push_back(renamed[input]);
+		}
+	}
+
+	u16 temporaries = result.arguments.size();
+	for(u16 temporary = 0; temporary != function.temporyCount; ++temporary) {
+		if(defined[temporary]) {
+			renamed[temporary] = temporaries++;
+		}
+	}
+
+	auto rename = [&](u16 temporary) {
+		if(temporary >= renamed.size() || renamed[temporary] == UNUSED) {
+			throw std::runtime_error("temporary " + std::to_string(temporary) + " is used but not live at the loop entry");
+		}
+		return renamed[temporary];
+	};
+
+	// the entry block comes first, the others keep their order so fall through stays intact
+	std::vector<u16> renumbered(blocks.size(), UNUSED);
+	u16 blockCount = 1;
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		if(reachable[block]) {
+			renumbered[block] = blockCount++;
+		}
+	}
+
+	bytecode::Function& f = result.function;
+	f.name = function.name + "@" + std::to_string(header);
+	f.returnType = function.returnType;
+	f.temporyCount = temporaries;
+	f.temporaryTypes.resize(temporaries);
+
+	for(u16 i = 0; i != result.arguments.size(); ++i) {
+		auto type = function.temporaryTypes[result.arguments[i]];
+		f.parameters.push_back({type, "osr" + std::to_string(i)});
+		f.temporaryTypes[i] = type;
+	}
+
+	for(u16 temporary = 0; temporary != function.temporyCount; ++temporary) {
+		if(defined[temporary]) {
+			f.temporaryTypes[renamed[temporary]] = function.temporaryTypes[temporary];
+		}
+	}
+
+	bytecode::Instruction entry(bytecode::Opcode::GOTO);
+	entry.id = 0;
+	entry.jump.branchIdx = renumbered[header];
+	f.instructions.push_back(entry);
+	f.blocks.push_back({1, {renumbered[header]}, {}});
+
+	auto copy = [&](bytecode::OperandList list) {
+		bytecode::OperandList copied{(u32) f.operands.size(), list.count};
+		for(u16 temporary : function.operandsOf(list)) {
+			f.operands.push_back(rename(temporary));
+		}
+		return copied;
+	};
+
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		if(!reachable[block]) {
+			continue;
+		}
+
+		u16 phis = 0;
+
+		for(u32 i = liveness.blockStarts[block]; i != liveness.blockStarts[block] + blocks[block].instructionCount; ++i) {
+			bytecode::Instruction instr = function.instructions[i];
+
+			switch(instr.opcode) {
+				case bytecode::Opcode::NOP:
+				case bytecode::Opcode::RET_VOID:
+					break;
+
+				case bytecode::Opcode::ADD:
+				case bytecode::Opcode::SUB:
+				case bytecode::Opcode::MUL:
+				case bytecode::Opcode::DIV:
+				case bytecode::Opcode::MOD:
+				case bytecode::Opcode::GT:
+				case bytecode::Opcode::GTE:
+				case bytecode::Opcode::EQ:
+				case bytecode::Opcode::NEQ:
+				case bytecode::Opcode::LTE:
+				case bytecode::Opcode::LT:
+				case bytecode::Opcode::AND:
+				case bytecode::Opcode::OR:
+					instr.binary.dstIdx = rename(instr.binary.dstIdx);
+					instr.binary.lsrcIdx = rename(instr.binary.lsrcIdx);
+					instr.binary.rsrcIdx = rename(instr.binary.rsrcIdx);
+					break;
+
+				case bytecode::Opcode::NEG:
+				case bytecode::Opcode::NOT:
+					instr.unary.dstIdx = rename(instr.unary.dstIdx);
+					instr.unary.srcIdx = rename(instr.unary.srcIdx);
+					break;
+
+				case bytecode::Opcode::RETURN:
+					instr.unary.srcIdx = rename(instr.unary.srcIdx);
+					break;
+
+				case bytecode::Opcode::CONST:
+					instr.constant.dstIdx = rename(instr.constant.dstIdx);
+					break;
+
+				case bytecode::Opcode::LOAD_IDX:
+				case bytecode::Opcode::STORE_IDX:
+					instr.array.indexIdx = rename(instr.array.indexIdx);
+				case bytecode::Opcode::LENGTH:
+					instr.array.memoryIdx = rename(instr.array.memoryIdx);
+					instr.array.valueIdx = rename(instr.array.valueIdx);
+					break;
+
+				case bytecode::Opcode::NEW:
+					instr.alloc.dstIdx = rename(instr.alloc.dstIdx);
+					instr.alloc.sizeIdx = rename(instr.alloc.sizeIdx);
+					break;
+
+				case bytecode::Opcode::IF_GOTO:
+					instr.jump.conditionIdx = rename(instr.jump.conditionIdx);
+				case bytecode::Opcode::GOTO:
+					instr.jump.branchIdx = renumbered[instr.jump.branchIdx];
+					break;
+
+				case bytecode::Opcode::CALL:
+				case bytecode::Opcode::SPECIAL:
+					instr.call.dstIdx = rename(instr.call.dstIdx);
+				case bytecode::Opcode::CALL_VOID:
+				case bytecode::Opcode::SPECIAL_VOID:
+					instr.call.args = copy(instr.call.args);
+					break;
+
+				case bytecode::Opcode::MEMBER_CALL:
+					instr.member_call.dstIdx = rename(instr.member_call.dstIdx);
+				case bytecode::Opcode::VOID_MEMBER_CALL:
+					instr.member_call.ptrIdx = rename(instr.member_call.ptrIdx);
+					instr.member_call.args = copy(instr.member_call.args);
+					break;
+
+				case bytecode::Opcode::PHI: {
+					bytecode::OperandList edges{(u32) f.operands.size(), 0};
+
+					// edges from blocks that are gone are dropped, the entry block is one more predecessor of the header
+					for(u16 edge = 0; edge != instr.phi.edges.count; ++edge) {
+						auto e = instr.phi.edge(function.operands, edge);
+						if(e.block < blocks.size() && reachable[e.block]) {
+							f.operands.push_back(rename(e.temp));
+							f.operands.push_back(renumbered[e.block]);
+							edges.count++;
+						}
+					}
+
+					if(block == header) {
+						f.operands.push_back(entryInputs[phis++]);
+						f.operands.push_back(0);
+						edges.count++;
+					}
+
+					instr.phi.dstIdx = rename(instr.phi.dstIdx);
+					instr.phi.edges = edges;
+				}
+					break;
+
+				case bytecode::Opcode::ALLOCATE:
+					instr.obj_alloc.dstIdx = rename(instr.obj_alloc.dstIdx);
+					break;
+
+				case bytecode::Opcode::OBJ_LOAD:
+				case bytecode::Opcode::OBJ_STORE:
+					instr.access.ptrIdx = rename(instr.access.ptrIdx);
+					instr.access.valueIdx = rename(instr.access.valueIdx);
+					break;
+
+				case bytecode::Opcode::GLOB_LOAD:
+				case bytecode::Opcode::GLOB_STORE:
+					instr.global.value = rename(instr.global.value);
+					break;
+
+				default:
+					throw std::runtime_error("opcode " + std::to_string((u8) instr.opcode) + " is not supported by on-stack replacement");
+			}
+
+			instr.id = f.instructions.size();
+			f.instructions.push_back(instr);
+		}
+
+		bytecode::Block copied{blocks[block].instructionCount, {}, {}};
+		for(u16 successor : blocks[block].successors) {
+			if(successor < blocks.size()) {
+				copied.successors.push_back(renumbered[successor]);
+			}
+		}
+
+		f.blocks.push_back(copied);
+	}
+
+	for(u16 block = 0; block != f.blocks.size(); ++block) {
+		for(u16 successor : f.blocks[block].successors) {
+			f.blocks[successor].predecessors.push_back(block);
+		}
+	}
+
+	return result;
+}
+
+}}
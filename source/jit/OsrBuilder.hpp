@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include <bytecode.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * A copy of a function that is entered at one of its loop headers, built by OsrBuilder
+ */
+struct OsrFunction {
+	bytecode::Function function;
+
+	/**
+	 * @brief temporaries of the original function whose values are the arguments of `function`
+	 */
+	std::vector<u16> arguments;
+};
+
+/**
+ * Builds the function used for on-stack replacement at the jump from `predecessor` to the loop `header`.
+ *
+ * The copy only keeps the blocks reachable from the header. A new entry block jumps to the header and takes
+ * the place of `predecessor` in its phis. Everything live at that point becomes a parameter: values live into
+ * the header are renamed to their parameter, the header's phi inputs coming from `predecessor` are passed
+ * as extra parameters since the loop defines them again.
+ * The compiled copy runs the rest of the activation and returns the function's result.
+ */
+class OsrBuilder {
+private:
+	bytecode::Function const& function;
+	u16 header;
+	u16 predecessor;
+
+	std::vector<bool> reachable;
+
+	void findReachable();
+
+public:
+	OsrBuilder(bytecode::Function const& _function, u16 _header, u16 _predecessor);
+
+	/**
+	 * Throws if a value live into the header is defined again inside the loop, there is no single
+	 * definition to rename it to
+	 */
+	OsrFunction run() &&;
+};
+
+}}
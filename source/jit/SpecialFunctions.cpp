@@ -82,4 +82,10 @@ void exit(jit::JitEngine* e, i32 code) {
 	std::exit(code);
 }
 
+[[gnu::sysv_abi]]
+void bounds_error(jit::JitEngine* e) {
+	std::cerr << "error: array index out of bounds" << std::endl;
+	std::exit(1);
+}
+
 }}}
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include <jit/JitEngine.hpp>
 #include <interpreter/InterpretEngine.hpp>
 
-#define SPECIAL_FUNCTIONS (8)
+#define SPECIAL_FUNCTIONS (9)
 
 #define SPECIAL_F_IDX_ALLOCATE         (0)
 #define SPECIAL_F_PTR_ALLOCATE         &am2017s::jit::allocator::allocate
@@ -22,6 +22,8 @@
 #define SPECIAL_F_PTR_PRINT_DOUBLE     &am2017s::bytecode::special::print_double;
 #define SPECIAL_F_IDX_EXIT             (7)
 #define SPECIAL_F_PTR_EXIT             &am2017s::bytecode::special::exit;
+#define SPECIAL_F_IDX_BOUNDS_ERROR     (8)
+#define SPECIAL_F_PTR_BOUNDS_ERROR     &am2017s::bytecode::special::bounds_error;
 ////// DONT FORGET TO CHANGE SPECIAL_FUNCTIONS
 ////// DONT FORGET TO CHANGE SPECIAL_FUNCTIONS
 ////// DONT FORGET TO CHANGE SPECIAL_FUNCTIONS
@@ -50,6 +52,12 @@ void printa_int(jit::JitEngine* e, i32* array);
 [[gnu::sysv_abi]]
 void exit(jit::JitEngine* e, i32 code);
 
+/**
+ * Called by compiled code when a bounds check fails, does not return
+ */
+[[gnu::sysv_abi]] [[noreturn]]
+void bounds_error(jit::JitEngine* e);
+
 [[gnu::sysv_abi]]
 void begin_int(interpreter::InterpretEngine* e);
 
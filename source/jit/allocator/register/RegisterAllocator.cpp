@@ -16,8 +16,14 @@ RegisterAllocation<Architecture>::RegisterAllocation(bytecode::Function const& _
                                                      std::map<XMMOp, lir::vr> const& _fixedXMMToVR,
                                                      std::map<u16, lir::vr> const& _overflowArgToVR,
                                                      std::map<lir::vr, bytecode::Type> const& vrTypes,
-                                                     std::set<std::set<lir::vr>> const& hintSame) :
-function(_function), lifespans(_lifespans), usages(_usages), fixedToVR(_fixedToVR), fixedXMMToVR(_fixedXMMToVR), overflowArgToVR(_overflowArgToVR), vrTypes(vrTypes), hintSame(hintSame) {}
+                                                     std::set<std::set<lir::vr>> const& hintSame,
+                                                     std::vector<u16> _loopDepths) :
+function(_function), lifespans(_lifespans), usages(_usages), fixedToVR(_fixedToVR), fixedXMMToVR(_fixedXMMToVR), overflowArgToVR(_overflowArgToVR), vrTypes(vrTypes), hintSame(hintSame), loopDepths(std::move(_loopDepths)) {}
+
+template <class Architecture>
+u16 RegisterAllocation<Architecture>::loopDepth(i32 position) const {
+	return position >= 0 && (std::size_t) position < loopDepths.size() ? loopDepths[position] : 0;
+}
 
 template <class Architecture>
 int RegisterAllocation<Architecture>::run() {
@@ -389,11 +395,16 @@ bool RegisterAllocation<Architecture>::tryAllocateFreeRegister(Interval& current
 	}
 }
 
-template<typename RegType>
-static RegType chooseBlockedRegister(std::map<RegType, i32> const &nextUsePos) {
+/**
+ * Chooses the register whose next use is in the shallowest loop and, among those, furthest away
+ */
+template<typename RegType, typename Depth>
+static RegType chooseBlockedRegister(std::map<RegType, i32> const &nextUsePos, Depth depth) {
 	return std::max_element(nextUsePos.begin(),
 	                        nextUsePos.end(),
-	                        [](auto lhs, auto rhs) { return lhs.second < rhs.second; })->first;
+	                        [depth](auto lhs, auto rhs) {
+		return depth(lhs.second) > depth(rhs.second) || (depth(lhs.second) == depth(rhs.second) && lhs.second < rhs.second);
+	})->first;
 }
 
 template<class Architecture>
@@ -449,11 +460,13 @@ void RegisterAllocation<Architecture>::allocateBlockedRegister(Interval& current
 		Logger::log(Topic::REG_LOG) << "not a single register available" << std::endl;
 	}
 
-	// reg = register with highest nextUsePos
-	RegType reg = chooseBlockedRegister(nextUsePos);
+	// reg = register with highest nextUsePos, values used in deeper loops keep their registers
+	auto depth = [this](i32 position) { return loopDepth(position); };
+	RegType reg = chooseBlockedRegister(nextUsePos, depth);
 
-	// if first usage of current is after nextUsePos[reg] then
-	if(!current.hasUsage() || current.firstUsage() > nextUsePos[reg]) {
+	// if first usage of current is after nextUsePos[reg] (or in a shallower loop) then
+	if(!current.hasUsage() || current.firstUsage() > nextUsePos[reg]
+	   || (current.firstUsage() > current.start() && depth(current.firstUsage()) < depth(nextUsePos[reg]))) {
 		// all other intervals are used before current,
 		// so it is best to spill current itself
 
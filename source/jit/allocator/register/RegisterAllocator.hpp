@@ -22,8 +22,15 @@ private:
 	std::map<lir::vr, bytecode::Type> const& vrTypes;
 	std::set<std::set<lir::vr>> const& hintSame;
 
+	/**
+	 * @brief loop depth of every LIR position, positions past the end are outside of loops
+	 */
+	std::vector<u16> loopDepths;
+
 	std::set<RegOp> usedRegisters;
 
+	u16 loopDepth(i32 position) const;
+
 
 
 public:
@@ -34,7 +41,8 @@ public:
 		                   std::map<XMMOp, lir::vr> const& fixedXMMToVR,
 		                   std::map<u16, lir::vr> const& _overflowArgToVR,
 		                   std::map<lir::vr, bytecode::Type> const& vrTypes,
-		               std::set<std::set<lir::vr>> const& hintSame);
+		               std::set<std::set<lir::vr>> const& hintSame,
+		               std::vector<u16> loopDepths = {});
 	int run();
 
 	std::vector<Interval> handled;
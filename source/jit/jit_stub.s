@@ -144,3 +144,121 @@ jit_member_stub:
 
 	# tail-call the compiled function
 	jmp RAX
+
+# [[gnu::sysv_abi]]
+# u64 jit_interpret(JitEngine* engine, u16 index, u64 const* registers)
+# engine in %rdi, index in %rsi, saved argument registers in %rdx, return value in %rax
+.extern jit_interpret
+
+# function pointer table entries of functions that are not compiled (yet) point here when running tiered
+# unlike jit_stub we do not tail-call anything, the interpreter runs the function and we return its result
+# 1. save all parameters destined for the function
+# 2. find out which function was called, the same way as jit_stub
+# 3. let the interpreter run it with the saved parameters
+# 4. return the result in both %rax and %xmm0, the caller knows which one it wants
+.globl jit_interpret_stub
+jit_interpret_stub:
+	sub RSP, 120      # 6 int params + 8 xmm params + stack (mis)alignment, see jit_stub
+	mov QWORD PTR[RSP], RDI
+	mov QWORD PTR[RSP +  8], RSI
+	mov QWORD PTR[RSP + 16], RDX
+	mov QWORD PTR[RSP + 24], RCX
+	mov QWORD PTR[RSP + 32], R8
+	mov QWORD PTR[RSP + 40], R9
+
+	movq QWORD PTR[RSP +  48], xmm0
+	movq QWORD PTR[RSP +  56], xmm1
+	movq QWORD PTR[RSP +  64], xmm2
+	movq QWORD PTR[RSP +  72], xmm3
+	movq QWORD PTR[RSP +  80], xmm4
+	movq QWORD PTR[RSP +  88], xmm5
+	movq QWORD PTR[RSP +  96], xmm6
+	movq QWORD PTR[RSP + 104], xmm7
+
+	mov RSI, QWORD PTR[RSP + 120] # load return address
+	mov ESI, DWORD PTR[RSI -   4] # get offset into function pointer table from call instruction of our caller
+	shr ESI, 3                   # compute index from offset
+	jmp interpret_saved
+
+.globl jit_interpret_member_stub
+jit_interpret_member_stub:
+	sub RSP, 120
+	mov QWORD PTR[RSP], RDI
+	mov QWORD PTR[RSP +  8], RSI
+	mov QWORD PTR[RSP + 16], RDX
+	mov QWORD PTR[RSP + 24], RCX
+	mov QWORD PTR[RSP + 32], R8
+	mov QWORD PTR[RSP + 40], R9
+
+	movq QWORD PTR[RSP +  48], xmm0
+	movq QWORD PTR[RSP +  56], xmm1
+	movq QWORD PTR[RSP +  64], xmm2
+	movq QWORD PTR[RSP +  72], xmm3
+	movq QWORD PTR[RSP +  80], xmm4
+	movq QWORD PTR[RSP +  88], xmm5
+	movq QWORD PTR[RSP +  96], xmm6
+	movq QWORD PTR[RSP + 104], xmm7
+
+	# the caller had the function index in %rax
+	mov RSI, RAX
+
+interpret_saved:
+	mov RDI, QWORD PTR[RBP - 8] # load JitEngine
+	mov RDX, RSP                # saved parameters
+	call jit_interpret
+
+	movq XMM0, RAX
+	add RSP, 120
+	ret
+
+# [[gnu::sysv_abi]]
+# NativeResult jit_call(void** fptable, void* code, u64 const* registers)
+# fptable in %rdi, code in %rsi, argument registers (6 int + 8 xmm, like jit_interpret) in %rdx
+# returns %rax and %xmm0 of the called function in %rax:%rdx
+.globl jit_call
+jit_call:
+	# compiled code may use all callee-saved registers and expects the function table in %rbp
+	push RBP
+	push RBX
+	push R12
+	push R13
+	push R14
+	push R15
+	sub RSP, 8        # align the stack for the call
+
+	mov RBP, RDI
+	mov RAX, RSI
+	mov R10, RDX
+
+	movq XMM0, QWORD PTR[R10 +  48]
+	movq XMM1, QWORD PTR[R10 +  56]
+	movq XMM2, QWORD PTR[R10 +  64]
+	movq XMM3, QWORD PTR[R10 +  72]
+	movq XMM4, QWORD PTR[R10 +  80]
+	movq XMM5, QWORD PTR[R10 +  88]
+	movq XMM6, QWORD PTR[R10 +  96]
+	movq XMM7, QWORD PTR[R10 + 104]
+
+	mov RDI, QWORD PTR[R10]
+	mov RSI, QWORD PTR[R10 +  8]
+	mov RDX, QWORD PTR[R10 + 16]
+	mov RCX, QWORD PTR[R10 + 24]
+	mov R8,  QWORD PTR[R10 + 32]
+	mov R9,  QWORD PTR[R10 + 40]
+
+	call RAX
+
+	movq RDX, XMM0
+
+	add RSP, 8
+	pop R15
+	pop R14
+	pop R13
+	pop R12
+	pop RBX
+	pop RBP
+
+	ret
+
+# no executable stack
+.section .note.GNU-stack,"",@progbits
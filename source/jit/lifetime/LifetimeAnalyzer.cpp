@@ -139,6 +139,11 @@ vector<Interval> LifetimeAnalyzer::run()&& {
 	}
 
 	for(u16 i = 0; i != _function.parameters.size(); ++i) {
+		// unused parameters arrive in their registers all the same, the allocator assigns them first
+		if(intervals[i].lifespans.empty()) {
+			intervals[i].addRange({-1, -1});
+		}
+
 		intervals[i].argument = true;
 		intervals[i].startingSpan().from = -1;
 	}
@@ -151,6 +156,11 @@ vector<Interval> LifetimeAnalyzer::run()&& {
 		Logger::log(Topic::LIFE_RANGES) << std::endl;
 	}
 
+	// virtual registers that instruction selection folded away are neither defined nor used
+	intervals.erase(std::remove_if(intervals.begin(), intervals.end(), [](Interval const& interval) {
+		return interval.lifespans.empty() && !interval.argument;
+	}), intervals.end());
+
 	std::vector<Interval> unionized = unionIntervals(intervals);
 
 	return unionized;
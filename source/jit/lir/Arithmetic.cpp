@@ -0,0 +1,86 @@
+#include <jit/lir/Arithmetic.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace am2017s { namespace jit { namespace lir {
+
+namespace {
+
+/**
+ * Computes the magic number in `U`, so that every step wraps around like the integers it divides
+ */
+template <typename U>
+MagicNumber magic(i64 divisor) {
+	constexpr u8 bits = sizeof(U) * 8;
+	constexpr U min = U(1) << (bits - 1);
+
+	U d = (U) divisor;
+	U ad = divisor < 0 ? U(0) - d : d;
+
+	U t = min + (d >> (bits - 1));
+	U anc = t - 1 - t % ad;
+
+	u8 p = bits - 1;
+	U q1 = min / anc, r1 = min - q1 * anc;
+	U q2 = min / ad, r2 = min - q2 * ad;
+	U delta;
+
+	do {
+		++p;
+
+		q1 *= 2;
+		r1 *= 2;
+		if(r1 >= anc) {
+			++q1;
+			r1 -= anc;
+		}
+
+		q2 *= 2;
+		r2 *= 2;
+		if(r2 >= ad) {
+			++q2;
+			r2 -= ad;
+		}
+
+		delta = ad - r2;
+	} while(q1 < delta || (q1 == delta && r1 == 0));
+
+	U multiplier = q2 + 1;
+	if(divisor < 0) {
+		multiplier = U(0) - multiplier;
+	}
+
+	// sign extended to the width of the field
+	using S = typename std::make_signed<U>::type;
+	return {(i64) (S) multiplier, (u8) (p - bits)};
+}
+
+}
+
+MagicNumber signedMagic(i64 divisor, u8 bits) {
+	if(divisor == 0 || divisor == 1 || divisor == -1) {
+		throw std::invalid_argument("no magic number for division by " + std::to_string(divisor));
+	}
+
+	if(bits == 32) {
+		return magic<u32>(divisor);
+	} else if(bits == 64) {
+		return magic<u64>(divisor);
+	}
+
+	throw std::invalid_argument("no magic numbers for " + std::to_string(bits) + " bit division");
+}
+
+bool isPowerOfTwo(i64 value, u8& exponent) {
+	u64 magnitude = value < 0 ? 0 - (u64) value : (u64) value;
+	if(magnitude == 0 || (magnitude & (magnitude - 1)) != 0) {
+		return false;
+	}
+
+	exponent = (u8) __builtin_ctzll(magnitude);
+	return true;
+}
+
+}}}
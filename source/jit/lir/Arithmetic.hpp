@@ -0,0 +1,27 @@
+#pragma once
+
+#include <types.hpp>
+
+namespace am2017s { namespace jit { namespace lir {
+
+/**
+ * Replaces a signed division by a constant: the quotient is the high half of `x * multiplier`, corrected by
+ * the sign of the multiplier and the divisor, shifted right by `shift` and rounded towards zero
+ */
+struct MagicNumber {
+	i64 multiplier;
+	u8 shift;
+};
+
+/**
+ * The magic number of the signed division of `bits` (32 or 64) wide integers by `divisor`, following
+ * Hacker's Delight, chapter 10. `divisor` must not be 0, 1 or -1.
+ */
+MagicNumber signedMagic(i64 divisor, u8 bits);
+
+/**
+ * Whether the magnitude of `value` is a power of two, 2^`exponent`
+ */
+bool isPowerOfTwo(i64 value, u8& exponent);
+
+}}}
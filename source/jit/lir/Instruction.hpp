@@ -32,11 +32,28 @@ enum Operation {
 	ALLOC,
 	MOV_MEM,
 	CALL_IDX_IN_REG,
+	BOUNDS_CHECK,
+	SHL,
+	SAR,
+	SHR,
+	AND,
+	MUL_IMM,
+	LEA,
+	MUL_HIGH,
+	CDQ,
+	SEXT,
+	ADD_IMM,
+	SUB_IMM,
+	CMP_IMM,
+	JCC,
 
 	FMOV,
 	FADD,
-
-	MOV_I2F,
+	FSUB,
+	FMUL,
+	FDIV,
+	FXOR,
+	FCMP,
 
 	NOP
 };
@@ -62,11 +79,28 @@ static std::string opToString(Operation op) {
 		case ALLOC: return "alloc";
 		case MOV_MEM: return "mov";
 		case CALL_IDX_IN_REG: return "call";
+		case BOUNDS_CHECK: return "boundscheck";
+		case SHL: return "shl";
+		case SAR: return "sar";
+		case SHR: return "shr";
+		case AND: return "and";
+		case MUL_IMM: return "mul";
+		case LEA: return "lea";
+		case MUL_HIGH: return "mulh";
+		case CDQ: return "cdq";
+		case SEXT: return "sext";
+		case ADD_IMM: return "add";
+		case SUB_IMM: return "sub";
+		case CMP_IMM: return "cmp";
+		case JCC: return "jcc";
 
 		case FMOV: return "fmov";
 		case FADD: return "fadd";
-
-		case MOV_I2F: return "mov2f";
+		case FSUB: return "fsub";
+		case FMUL: return "fmul";
+		case FDIV: return "fdiv";
+		case FXOR: return "fxor";
+		case FCMP: return "fcmp";
 
 		case NOP: return "[invalid]";
 	}
@@ -76,6 +110,9 @@ static std::string opToString(Operation op) {
 
 using vr = u16;
 
+/**
+ * FMOV with `isImm` loads the float with the bits `imm` from the constant pool of the function
+ */
 struct MovOp {
 	bool isImm;
 	i64 imm; // we need to use the biggest possible type here
@@ -84,6 +121,12 @@ struct MovOp {
 
 	OperandSize size;
 
+	/**
+	 * `imm` is the address of the vTable of struct type `vTableOf`, which differs between processes
+	 */
+	bool isVTable = false;
+	u8 vTableOf = 0;
+
 	friend std::ostream& operator<<(std::ostream& os, const MovOp& obj)
 	{
 		if(obj.isImm) {
@@ -108,6 +151,12 @@ struct MovMemOp {
 
 	bool toMem;
 
+	/**
+	 * Stores `imm` instead of `a`, sign extended for QWORD stores
+	 */
+	bool isImm = false;
+	i32 imm = 0;
+
 	void printPtr(std::ostream& os) const {
 		os << "PTR[i" << base << " + ";
 		if(isIndexed) {
@@ -117,7 +166,10 @@ struct MovMemOp {
 	}
 
 	friend std::ostream& operator<<(std::ostream& os, const MovMemOp& obj) {
-		if(obj.toMem) {
+		if(obj.toMem && obj.isImm) {
+			obj.printPtr(os);
+			return os << ", $" << obj.imm;
+		} else if(obj.toMem) {
 			obj.printPtr(os);
 			return os << ", i" << obj.a;
 		} else {
@@ -170,10 +222,29 @@ enum FlagOpMode {
 	LT, LTE, EQ, NEQ, GTE, GT
 };
 
+static std::string modeToString(FlagOpMode mode) {
+	switch(mode) {
+		case LT: return "lt";
+		case LTE: return "lte";
+		case EQ: return "eq";
+		case NEQ: return "neq";
+		case GTE: return "gte";
+		case GT: return "gt";
+	}
+
+	return "[invalid]";
+}
+
 struct FlagOp {
 	vr reg;
 	FlagOpMode mode;
 
+	/**
+	 * The flags are those of an FCMP, whose left operand is never less than the right one: LT and LTE are
+	 * compared as GT and GTE with swapped operands
+	 */
+	bool floating = false;
+
 	friend std::ostream& operator<<(std::ostream& os, const FlagOp& obj)
 	{
 		return os << "i" << obj.reg;
@@ -204,6 +275,11 @@ struct TernaryOp {
 	vr srcA;
 	vr srcB;
 
+	/**
+	 * Width of the integer operation, idiv and the one operand imul divide and multiply 64 bit by default
+	 */
+	OperandSize size = QWORD;
+
 	friend std::ostream& operator<<(std::ostream& os, const TernaryOp& obj)
 	{
 		os << "{";
@@ -214,9 +290,45 @@ struct TernaryOp {
 	}
 };
 
+/**
+ * `dst = dst op imm` in the width `size`: shifts by `imm` bits, masks, adds, subtracts or multiplies with the
+ * sign extended `imm`. CMP_IMM only compares `dst` with `imm`.
+ */
+struct ImmediateOp {
+	vr dst;
+	i32 imm;
+	OperandSize size;
+
+	friend std::ostream& operator<<(std::ostream& os, const ImmediateOp& obj)
+	{
+		return os << "i" << obj.dst << ", $" << obj.imm;
+	}
+};
+
+/**
+ * `dst = base + index * scale`
+ */
+struct LeaOp {
+	vr dst;
+	vr base;
+	vr index;
+	u8 scale;
+
+	friend std::ostream& operator<<(std::ostream& os, const LeaOp& obj)
+	{
+		return os << "i" << obj.dst << ", PTR[i" << obj.base << " + (i" << obj.index << " * $"
+		          << std::to_string(obj.scale) << ")]";
+	}
+};
+
 struct JumpOp {
 	u16 target;
 
+	/**
+	 * JCC jumps if the flags of the preceding CMP satisfy `condition`
+	 */
+	FlagOpMode condition;
+
 	friend std::ostream& operator<<(std::ostream& os, const JumpOp& obj)
 	{
 		return os << "block " << obj.target;
@@ -270,6 +382,25 @@ struct AllocOp {
 	}
 };
 
+/**
+ * Traps unless `index` is below `length`, or unless [index, limit) is empty or below `length` if `isRange`
+ */
+struct BoundsCheckOp {
+	vr index;
+	vr limit;
+	bool isRange;
+	vr length;
+
+	friend std::ostream& operator<<(std::ostream& os, const BoundsCheckOp& obj)
+	{
+		os << "i" << obj.index;
+		if(obj.isRange) {
+			os << " ... i" << obj.limit;
+		}
+		return os << ", length i" << obj.length;
+	}
+};
+
 struct Instruction {
 
 	Operation operation;
@@ -288,20 +419,35 @@ struct Instruction {
 		AllocOp alloc;
 		MovMemOp memmov;
 		RegCallOp reg_call;
+		BoundsCheckOp check;
+		ImmediateOp immediate;
+		LeaOp lea;
 	};
 
 	Instruction() {
 		operation = NOP;
 	}
 	Instruction(Operation op, u16 _id) : operation(op), id(_id) {
+		if(op == MOV || op == FMOV) {
+			new(&mov) MovOp;
+		}
+
+		if(op == SET || op == TEST) {
+			new(&flag) FlagOp;
+		}
+
 		if(op == PHI) {
 			new(&phi) PhiOp;
 		}
 
-		if(op == DIV) {
+		if(op == DIV || op == MUL_HIGH) {
 			new(&ternary) TernaryOp;
 		}
 
+		if(op == MOV_MEM) {
+			new(&memmov) MovMemOp;
+		}
+
 		if(op == CALL) {
 			new(&call) CallOp;
 		}
@@ -316,26 +462,44 @@ struct Instruction {
 		id = old.id;
 		switch(operation) {
 			case MOV:
-			case FMOV:
-			case MOV_I2F: new(&mov) MovOp(old.mov); break;
+			case FMOV: new(&mov) MovOp(old.mov); break;
 			case PHI: new(&phi) PhiOp(old.phi); break;
-			case CMP: new(&cmp) CmpOp(old.cmp); break;
+			case CMP:
+			case FCMP: new(&cmp) CmpOp(old.cmp); break;
 			case TEST:
 			case SET: new(&flag) FlagOp(old.flag); break;
 			case MUL:
 			case CQO:
+			case CDQ:
 			case SUB:
 			case ADD:
-			case FADD: new(&binary) BinaryOp(old.binary); break;
-			case DIV: new(&ternary) TernaryOp(old.ternary); break;
+			case FADD:
+			case FSUB:
+			case FMUL:
+			case FDIV:
+			case FXOR: new(&binary) BinaryOp(old.binary); break;
+			case DIV:
+			case MUL_HIGH: new(&ternary) TernaryOp(old.ternary); break;
 			case NEG:
-			case NOT: new(&unary) UnaryOp(old.unary); break;
+			case NOT:
+			case SEXT: new(&unary) UnaryOp(old.unary); break;
+			case SHL:
+			case SAR:
+			case SHR:
+			case AND:
+			case MUL_IMM:
+			case ADD_IMM:
+			case SUB_IMM:
+			case CMP_IMM: new(&immediate) ImmediateOp(old.immediate); break;
+			case LEA: new(&lea) LeaOp(old.lea); break;
 			case JMP:
-			case JNZ: new(&jump) JumpOp(old.jump); break;
+			case JNZ:
+			case JCC: new(&jump) JumpOp(old.jump); break;
 			case CALL: new(&call) CallOp(old.call); break;
 			case ALLOC: new(&alloc) AllocOp(old.alloc); break;
 			case MOV_MEM: new(&memmov) MovMemOp(old.memmov); break;
 			case CALL_IDX_IN_REG: new(&reg_call) RegCallOp(old.reg_call); break;
+			case BOUNDS_CHECK: new(&check) BoundsCheckOp(old.check); break;
 			case RET: break;
 			case NOP: break;
 		}
@@ -345,7 +509,7 @@ struct Instruction {
 			phi.~PhiOp();
 		}
 
-		if(operation == DIV) {
+		if(operation == DIV || operation == MUL_HIGH) {
 			ternary.~TernaryOp();
 		}
 
@@ -369,28 +533,46 @@ struct Instruction {
 	std::vector<vr> dst() const {
 		switch(operation) {
 			case MOV:
-			case FMOV:
-			case MOV_I2F: return {mov.dst};
+			case FMOV: return {mov.dst};
 			case PHI: return {phi.dst};
-			case CMP: return {};
+			case CMP:
+			case FCMP: return {};
 			case TEST: return {};
 			case SET: return {flag.reg};
 			case MUL: return {binary.dst};
 			case CQO:
+			case CDQ:
 			case SUB:
 			case ADD:
-			case FADD: return {binary.dst};
-			case DIV: return ternary.dst;
+			case FADD:
+			case FSUB:
+			case FMUL:
+			case FDIV:
+			case FXOR: return {binary.dst};
+			case DIV:
+			case MUL_HIGH: return ternary.dst;
 			case NEG:
-			case NOT: return {unary.dst};
+			case NOT:
+			case SEXT: return {unary.dst};
+			case SHL:
+			case SAR:
+			case SHR:
+			case AND:
+			case MUL_IMM:
+			case ADD_IMM:
+			case SUB_IMM: return {immediate.dst};
+			case CMP_IMM: return {};
+			case LEA: return {lea.dst};
 			case JMP:
-			case JNZ: return {};
+			case JNZ:
+			case JCC: return {};
 			case RET: return {};
 			case CALL: if(call.isVoid) { return {}; } else { return {call.dst}; };
 			case ALLOC: return {alloc.dst};
 			case MOV_MEM:
 				if(memmov.toMem) { return {}; } else { return {memmov.a}; }
 			case CALL_IDX_IN_REG: if(reg_call.isVoid) { return {}; } else { return {reg_call.dst}; }
+			case BOUNDS_CHECK: return {};
 			default:
 				throw InvalidResultException();
 		}
@@ -401,7 +583,6 @@ struct Instruction {
 		switch(operation) {
 			case MOV:
 			case FMOV:
-			case MOV_I2F:
 				if(mov.isImm) return {};
 				else          return {mov.src};
 			case PHI:
@@ -410,6 +591,7 @@ struct Instruction {
 				}
 				return input;
 			case CMP:
+			case FCMP:
 				return {cmp.l, cmp.r};
 			case TEST:
 				return {flag.reg};
@@ -417,18 +599,37 @@ struct Instruction {
 				return {};
 			case NEG:
 			case NOT:
+			case SEXT:
 				return {unary.dst};
+			case SHL:
+			case SAR:
+			case SHR:
+			case AND:
+			case MUL_IMM:
+			case ADD_IMM:
+			case SUB_IMM:
+			case CMP_IMM:
+				return {immediate.dst};
+			case LEA:
+				return {lea.base, lea.index};
 			case CQO:
+			case CDQ:
 				return {binary.src};
 			case DIV:
+			case MUL_HIGH:
 				return {ternary.srcA, ternary.srcB};
 			case MUL:
 			case SUB:
 			case ADD:
 			case FADD:
+			case FSUB:
+			case FMUL:
+			case FDIV:
+			case FXOR:
 				return {binary.src, binary.dst};
 			case JMP:
 			case JNZ:
+			case JCC:
 				return {};
 			case RET:
 				return {};
@@ -443,7 +644,7 @@ struct Instruction {
 
 				input.push_back(memmov.base);
 
-				if(memmov.toMem) {
+				if(memmov.toMem && !memmov.isImm) {
 					input.push_back(memmov.a);
 				}
 
@@ -451,6 +652,11 @@ struct Instruction {
 
 			case CALL_IDX_IN_REG:
 				return reg_call.args;
+			case BOUNDS_CHECK:
+				if(check.isRange) {
+					return {check.index, check.limit, check.length};
+				}
+				return {check.index, check.length};
 			default:
 				std::cerr << "Fallthrough in lir::Instruction.input()" << std::endl;
 				throw InvalidResultException();
@@ -475,31 +681,51 @@ struct Instruction {
 		switch(that.operation) {
 			case MOV:
 			case FMOV:
-			case MOV_I2F:
 				return s << that.mov;
 			case PHI:
 				return s << that.phi;
 			case CMP:
+			case FCMP:
 				return s << that.cmp;
 			case TEST:
 			case SET:
 				return s << that.flag;
 			case NEG:
 			case NOT:
+			case SEXT:
 				return s << that.unary;
+			case SHL:
+			case SAR:
+			case SHR:
+			case AND:
+			case MUL_IMM:
+			case ADD_IMM:
+			case SUB_IMM:
+			case CMP_IMM:
+				return s << that.immediate;
+			case LEA:
+				return s << that.lea;
 			case MUL:
 			case SUB:
 			case ADD:
 			case FADD:
+			case FSUB:
+			case FMUL:
+			case FDIV:
+			case FXOR:
 				return s << that.binary;
 			case DIV:
+			case MUL_HIGH:
 				return s << that.ternary;
 			case JMP:
 			case JNZ:
 				return s << that.jump;
+			case JCC:
+				return s << modeToString(that.jump.condition) << ", " << that.jump;
 			case RET:
 				break;
 			case CQO:
+			case CDQ:
 				return s;
 			case CALL:
 				return s << that.call;
@@ -509,6 +735,8 @@ struct Instruction {
 				return s << that.memmov;
 			case CALL_IDX_IN_REG:
 				return s << that.reg_call;
+			case BOUNDS_CHECK:
+				return s << that.check;
 			default:
 				throw InvalidResultException();
 		}
@@ -4,6 +4,7 @@
 #include <log/Logger.hpp>
 #include <jit/JitEngine.hpp>
 #include <jit/SpecialFunctions.hpp>
+#include <jit/lir/Arithmetic.hpp>
 
 #include <algorithm>
 #include <iterator>
@@ -13,13 +14,64 @@ namespace jit {
 
 using lir::Operation;
 
+namespace {
+
+/**
+ * Width in bits of the integers whose arithmetic with constants is lowered, 0 for all other types
+ */
+u8 loweredWidth(bytecode::Type type) {
+	if(type.isArray) {
+		return 0;
+	}
+
+	switch((bytecode::BaseType) type.baseType) {
+		case bytecode::BaseType::INT32: return 32;
+		case bytecode::BaseType::INT64: return 64;
+		default: return 0;
+	}
+}
+
+bool isComparison(bytecode::Opcode opcode) {
+	switch(opcode) {
+		case bytecode::Opcode::GT:
+		case bytecode::Opcode::GTE:
+		case bytecode::Opcode::EQ:
+		case bytecode::Opcode::NEQ:
+		case bytecode::Opcode::LTE:
+		case bytecode::Opcode::LT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+lir::FlagOpMode flagMode(bytecode::Opcode comparison) {
+	switch(comparison) {
+		case bytecode::Opcode::GT: return lir::FlagOpMode::GT;
+		case bytecode::Opcode::GTE: return lir::FlagOpMode::GTE;
+		case bytecode::Opcode::EQ: return lir::FlagOpMode::EQ;
+		case bytecode::Opcode::NEQ: return lir::FlagOpMode::NEQ;
+		case bytecode::Opcode::LTE: return lir::FlagOpMode::LTE;
+		case bytecode::Opcode::LT: return lir::FlagOpMode::LT;
+		default: throw std::runtime_error("Invalid opcode in comparison operator switch");
+	}
+}
+
+/**
+ * `value` truncated to `width` bits and sign extended again
+ */
+i64 truncate(i64 value, u8 width) {
+	return width == 32 ? (i64) (i32) value : value;
+}
+
+}
+
 template<class Architecture>
 LIRCompiler<Architecture>::LIRCompiler(JitEngine* engine,
                                        am2017s::bytecode::Program const& program,
-                                       std::map<u8, am2017s::bytecode::StructType>& _types,
-                                       const am2017s::bytecode::Function& _function,
-                                       std::vector<bool>& _skip)
-		: engine(engine), program(program), types(_types), function(_function), skip(_skip) {}
+                                       std::map<u8, am2017s::bytecode::StructType> const& _types,
+                                       const am2017s::bytecode::Function& _function)
+		: engine(engine), program(program), types(_types), function(_function) {}
 
 template<class Architecture>
 void LIRCompiler<Architecture>::analyseBlocks() {
@@ -31,6 +83,35 @@ void LIRCompiler<Architecture>::analyseBlocks() {
 		block.index = (u16) blocks.size();
 		blocks.push_back(block);
 	}
+
+	std::vector<u16> uses(function.temporyCount, 0);
+	for (auto const& instruction : function.instructions) {
+		if (instruction.opcode == bytecode::Opcode::CONST && instruction.constant.type.isInteger()) {
+			constants[instruction.constant.dstIdx] = instruction.constant.value;
+		}
+
+		for (u16 operand : instruction.inputOperands(function.operands)) {
+			++uses[operand];
+		}
+	}
+
+	for (auto& block : blocks) {
+		if (block.instructionBegin() == block.instructionEnd()) {
+			continue;
+		}
+
+		auto const& jump = *block.instructionReverseBegin();
+		if (jump.opcode != bytecode::Opcode::IF_GOTO || uses[jump.jump.conditionIdx] != 1) {
+			continue;
+		}
+
+		for (auto it = block.instructionBegin(); it != block.instructionEnd(); ++it) {
+			if (isComparison(it->opcode) && it->binary.dstIdx == jump.jump.conditionIdx &&
+			    !function.temporaryTypes.at(it->binary.lsrcIdx).isFloatingPoint()) {
+				fusedComparisons[jump.jump.conditionIdx] = &*it;
+			}
+		}
+	}
 }
 
 template<class Architecture>
@@ -57,7 +138,6 @@ void LIRCompiler<Architecture>::compileFunction() {
 
 	for (auto b = blocks.begin(); b != blocks.end(); ++b) {
 		for (auto it = b->instructionBegin(); it != b->instructionEnd(); ++it) {
-			// todo handle skips
 			compileInstruction(*it, &instructionCount, b->lirs);
 		}
 	}
@@ -107,10 +187,295 @@ void LIRCompiler<Architecture>::compileFunction() {
 template <class Architecture>
 bool
 LIRCompiler<Architecture>::isIntegerOp(bytecode::Instruction const& instruction) const {
-	vector<u16> const& inputOperands = instruction.inputOperands();
+	vector<u16> const& inputOperands = instruction.inputOperands(function.operands);
 	return std::all_of(inputOperands.begin(), inputOperands.end(), [=](u16 operand) { return function.temporaryTypes.at(operand).isInteger(); });
 }
 
+template<class Architecture>
+void LIRCompiler<Architecture>::emitMove(lir::vr dst, lir::vr src, OperandSize size, u16* id,
+                                         vector<lir::Instruction>& lirs) {
+	lir::Instruction i{Operation::MOV, (*id)++};
+	i.mov.isImm = false;
+
+	i.mov.src = src;
+	use(i.mov.src, id, false);
+	i.mov.size = size;
+
+	i.mov.dst = dst;
+	use(i.mov.dst, id, true);
+
+	lirs.push_back(i);
+}
+
+template<class Architecture>
+void LIRCompiler<Architecture>::emitConstant(lir::vr dst, i64 value, u16* id, vector<lir::Instruction>& lirs) {
+	lir::Instruction i{Operation::MOV, (*id)++};
+	i.mov.isImm = true;
+	i.mov.imm = value;
+	i.mov.size = vrTypes.at(dst).size();
+
+	i.mov.dst = dst;
+	use(i.mov.dst, id, true);
+
+	lirs.push_back(i);
+}
+
+template<class Architecture>
+void LIRCompiler<Architecture>::emitUnary(lir::Operation operation, lir::vr dst, u16* id,
+                                          vector<lir::Instruction>& lirs) {
+	lir::Instruction i{operation, (*id)++};
+	i.unary.dst = dst;
+	use(i.unary.dst, id, true);
+
+	lirs.push_back(i);
+}
+
+template<class Architecture>
+void LIRCompiler<Architecture>::emitBinary(lir::Operation operation, lir::vr dst, lir::vr src, u16* id,
+                                           vector<lir::Instruction>& lirs) {
+	lir::Instruction i{operation, (*id)++};
+	i.binary.dst = dst;
+	use(i.binary.dst, id, true);
+
+	i.binary.src = src;
+	use(i.binary.src, id, false);
+
+	lirs.push_back(i);
+}
+
+template<class Architecture>
+void LIRCompiler<Architecture>::emitImmediate(lir::Operation operation, lir::vr dst, i32 imm, u16* id,
+                                              vector<lir::Instruction>& lirs) {
+	lir::Instruction i{operation, (*id)++};
+	i.immediate.dst = dst;
+	use(i.immediate.dst, id, true);
+	i.immediate.imm = imm;
+	i.immediate.size = vrTypes.at(dst).size();
+
+	lirs.push_back(i);
+}
+
+template<class Architecture>
+void LIRCompiler<Architecture>::compileFloatingPointOp(lir::Operation operation,
+                                                       bytecode::Instruction const& instruction, u16* id,
+                                                       vector<lir::Instruction>& lirs) {
+	lir::vr dst = vrForTemporary(instruction.binary.dstIdx);
+
+	lir::Instruction i{Operation::FMOV, (*id)++};
+	i.mov.isImm = false;
+
+	i.mov.src = vrForTemporary(instruction.binary.lsrcIdx);
+	use(i.mov.src, id, false);
+	i.mov.size = vrTypes.at(i.mov.src).size();
+
+	i.mov.dst = dst;
+	use(i.mov.dst, id, true);
+
+	lirs.push_back(i);
+
+	emitBinary(operation, dst, vrForTemporary(instruction.binary.rsrcIdx), id, lirs);
+}
+
+template<class Architecture>
+bool LIRCompiler<Architecture>::emitMultiplication(lir::vr dst, lir::vr src, i64 factor, u16* id,
+                                                   vector<lir::Instruction>& lirs) {
+	OperandSize size = vrTypes.at(dst).size();
+	u64 magnitude = factor < 0 ? 0 - (u64) factor : (u64) factor;
+	u8 shift = magnitude == 0 ? (u8) 0 : (u8) __builtin_ctzll(magnitude);
+	u64 odd = magnitude >> shift;
+
+	u8 exponent;
+
+	if(magnitude == 0) {
+		emitConstant(dst, 0, id, lirs);
+		return true;
+	} else if(odd == 1) {
+		// x * 2^k = x << k
+		emitMove(dst, src, size, id, lirs);
+		if(shift != 0) {
+			emitImmediate(Operation::SHL, dst, shift, id, lirs);
+		}
+	} else if(odd == 3 || odd == 5 || odd == 9) {
+		// x * 3 * 2^k = (x + x * 2) << k
+		lir::Instruction i{Operation::LEA, (*id)++};
+		i.lea.base = src;
+		use(i.lea.base, id, true);
+		i.lea.index = src;
+		i.lea.scale = (u8) (odd - 1);
+		i.lea.dst = dst;
+		use(i.lea.dst, id, true);
+		lirs.push_back(i);
+
+		if(shift != 0) {
+			emitImmediate(Operation::SHL, dst, shift, id, lirs);
+		}
+	} else if(shift == 0 && (lir::isPowerOfTwo((i64) (magnitude - 1), exponent) ||
+	                         lir::isPowerOfTwo((i64) (magnitude + 1), exponent))) {
+		// x * (2^k + 1) = (x << k) + x, x * (2^k - 1) = (x << k) - x
+		emitMove(dst, src, size, id, lirs);
+		emitImmediate(Operation::SHL, dst, exponent, id, lirs);
+		emitBinary(((u64) 1 << exponent) < magnitude ? Operation::ADD : Operation::SUB, dst, src, id, lirs);
+	} else if(factor == (i32) factor) {
+		emitMove(dst, src, size, id, lirs);
+		emitImmediate(Operation::MUL_IMM, dst, (i32) factor, id, lirs);
+		return true;
+	} else {
+		return false;
+	}
+
+	if(factor < 0) {
+		emitUnary(Operation::NEG, dst, id, lirs);
+	}
+
+	return true;
+}
+
+template<class Architecture>
+bool LIRCompiler<Architecture>::compileConstantMultiplication(bytecode::Instruction const& instruction, u16* id,
+                                                              vector<lir::Instruction>& lirs) {
+	lir::vr dst = vrForTemporary(instruction.binary.dstIdx);
+	u8 width = loweredWidth(vrTypes.at(dst));
+	if(width == 0 || !isIntegerOp(instruction)) {
+		return false;
+	}
+
+	// multiplication commutes, the constant may be either operand
+	u16 factorIdx = instruction.binary.rsrcIdx, srcIdx = instruction.binary.lsrcIdx;
+	if(!constants.count(factorIdx)) {
+		std::swap(factorIdx, srcIdx);
+	}
+
+	if(!constants.count(factorIdx)) {
+		return false;
+	}
+
+	if(!emitMultiplication(dst, vrForTemporary(srcIdx), truncate(constants.at(factorIdx), width), id, lirs)) {
+		return false;
+	}
+
+	if(width == 32) {
+		emitUnary(Operation::SEXT, dst, id, lirs);
+	}
+
+	return true;
+}
+
+template<class Architecture>
+bool LIRCompiler<Architecture>::compileConstantDivision(bytecode::Instruction const& instruction, u16* id,
+                                                        vector<lir::Instruction>& lirs) {
+	lir::vr dst = vrForTemporary(instruction.binary.dstIdx);
+	lir::vr src = vrForTemporary(instruction.binary.lsrcIdx);
+	u8 width = loweredWidth(vrTypes.at(dst));
+	if(width == 0 || !isIntegerOp(instruction) || !constants.count(instruction.binary.rsrcIdx)) {
+		return false;
+	}
+
+	i64 divisor = truncate(constants.at(instruction.binary.rsrcIdx), width);
+	if(divisor == 0 || divisor == -1) {
+		return false;
+	}
+
+	bool modulo = instruction.opcode == bytecode::Opcode::MOD;
+	if(modulo && divisor == 1) {
+		emitConstant(dst, 0, id, lirs);
+		return true;
+	}
+
+	OperandSize size = vrTypes.at(dst).size();
+	bytecode::Type type = vrTypes.at(dst);
+
+	// the quotient rounded towards zero, in a temporary for the remainder
+	lir::vr quotient = modulo ? vr(type) : dst;
+
+	u8 exponent;
+	if(divisor == 1) {
+		emitMove(dst, src, size, id, lirs);
+	} else if(lir::isPowerOfTwo(divisor, exponent)) {
+		// negative numbers are rounded towards zero by adding 2^k - 1 before shifting them: the sign,
+		// shifted logically into the lowest k bits
+		emitMove(quotient, src, size, id, lirs);
+		if(exponent > 1) {
+			emitImmediate(Operation::SAR, quotient, width - 1, id, lirs);
+		}
+		emitImmediate(Operation::SHR, quotient, width - exponent, id, lirs);
+		emitBinary(Operation::ADD, quotient, src, id, lirs);
+
+		if(modulo) {
+			// the remainder is what the rounded multiple of 2^k lacks, the sign of the divisor does not matter
+			if(exponent < 32) {
+				emitImmediate(Operation::AND, quotient, (i32) -((i64) 1 << exponent), id, lirs);
+			} else {
+				emitImmediate(Operation::SAR, quotient, exponent, id, lirs);
+				emitImmediate(Operation::SHL, quotient, exponent, id, lirs);
+			}
+
+			emitMove(dst, src, size, id, lirs);
+			emitBinary(Operation::SUB, dst, quotient, id, lirs);
+		} else {
+			emitImmediate(Operation::SAR, quotient, exponent, id, lirs);
+			if(divisor < 0) {
+				emitUnary(Operation::NEG, quotient, id, lirs);
+			}
+		}
+	} else {
+		lir::MagicNumber magic = lir::signedMagic(divisor, width);
+
+		// the high half of RAX * RDX ends up in RDX
+		emitMove(vrForFixed(RegOp::RAX), src, size, id, lirs);
+		emitConstant(vrForFixed(RegOp::RDX), magic.multiplier, id, lirs);
+
+		lir::Instruction i{Operation::MUL_HIGH, (*id)++};
+		i.ternary.dst = {vrForFixed(RegOp::RDX)};
+		use(vrForFixed(RegOp::RDX), id, true);
+
+		i.ternary.srcA = vrForFixed(RegOp::RAX);
+		use(i.ternary.srcA, id, true);
+
+		i.ternary.srcB = vrForFixed(RegOp::RDX);
+		i.ternary.size = size;
+
+		lirs.push_back(i);
+
+		emitMove(quotient, vrForFixed(RegOp::RDX), size, id, lirs);
+
+		// the multiplier wrapped around if its sign differs from the divisor's
+		if(divisor > 0 && magic.multiplier < 0) {
+			emitBinary(Operation::ADD, quotient, src, id, lirs);
+		} else if(divisor < 0 && magic.multiplier > 0) {
+			emitBinary(Operation::SUB, quotient, src, id, lirs);
+		}
+
+		if(magic.shift != 0) {
+			emitImmediate(Operation::SAR, quotient, magic.shift, id, lirs);
+		}
+
+		// adding one to negative quotients rounds them towards zero
+		lir::vr sign = vr(type);
+		emitMove(sign, quotient, size, id, lirs);
+		emitImmediate(Operation::SHR, sign, width - 1, id, lirs);
+		emitBinary(Operation::ADD, quotient, sign, id, lirs);
+
+		if(modulo) {
+			lir::vr product = vr(type);
+			if(!emitMultiplication(product, quotient, divisor, id, lirs)) {
+				lir::vr factor = vr(type);
+				emitConstant(factor, divisor, id, lirs);
+				emitMove(product, quotient, size, id, lirs);
+				emitBinary(Operation::MUL, product, factor, id, lirs);
+			}
+
+			emitMove(dst, src, size, id, lirs);
+			emitBinary(Operation::SUB, dst, product, id, lirs);
+		}
+	}
+
+	if(width == 32) {
+		emitUnary(Operation::SEXT, dst, id, lirs);
+	}
+
+	return true;
+}
+
 template<class Architecture>
 void
 LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instruction, u16* id,
@@ -127,42 +492,46 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 	case bytecode::Opcode::NOP:
 		break;
 
-	case bytecode::Opcode::CONST: {
-		i = {Operation::MOV, (*id)++};
-		lir::vr vrImm;
-
-		if(instruction.constant.type.isFloatingPoint()) {
-			vrImm = vr(bytecode::BaseType::INT64);
-		} else {
-			vrImm = vrForTemporary(instruction.constant.dstIdx);
-			i.mov.size = instruction.constant.type.size();
-		}
+	case bytecode::Opcode::CONST:
+		// floats are loaded from the constant pool
+		i = {instruction.constant.type.isFloatingPoint() ? Operation::FMOV : Operation::MOV, (*id)++};
+		i.mov.size = instruction.constant.type.size();
 
-		i.mov.dst = vrImm;
+		i.mov.dst = vrForTemporary(instruction.constant.dstIdx);
 		i.mov.isImm = true;
 		i.mov.imm = instruction.constant.value;
-		// todo if type fits into 32bit we don't need a register
+		// instruction selection folds constants that fit into 32 bits into the instructions using them
 		use(i.mov.dst, id, true);
 
 		lirs.push_back(i);
+		break;
 
-		if (instruction.constant.type.isFloatingPoint()) {
-			i = {Operation::MOV_I2F, (*id)++};
-			i.mov.isImm = false;
-			i.mov.src = vrImm;
-			use(i.mov.src, id, true);
+	case bytecode::Opcode::NEG:
+		if(!isIntegerOp(instruction)) {
+			// flips the sign bit, which negates zeros and NaNs as well
+			OperandSize size = vrTypes.at(vrForTemporary(instruction.unary.srcIdx)).size();
 
-			i.mov.dst = vrForTemporary(instruction.constant.dstIdx);
+			i = {Operation::FMOV, (*id)++};
+			i.mov.size = size;
+			i.mov.dst = vrForTemporary(instruction.unary.dstIdx);
+			i.mov.isImm = true;
+			i.mov.imm = size == DWORD ? (i64) 1 << 31 : (i64) ((u64) 1 << 63);
 			use(i.mov.dst, id, true);
 
-			i.mov.size = instruction.constant.type.size();
+			lirs.push_back(i);
+
+			i = {Operation::FXOR, (*id)++};
+			i.binary.dst = vrForTemporary(instruction.unary.dstIdx);
+			use(i.binary.dst, id, true);
+
+			// xorps reads 16 bytes from memory
+			i.binary.src = vrForTemporary(instruction.unary.srcIdx);
+			use(i.binary.src, id, true);
 
 			lirs.push_back(i);
+			break;
 		}
-	}
-		break;
 
-	case bytecode::Opcode::NEG:
 		i = {Operation::MOV, (*id)++};
 		i.mov.isImm = false;
 
@@ -208,31 +577,16 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 
 			lirs.push_back(i);
 		} else {
-			i = {Operation::FMOV, (*id)++};
-			i.mov.isImm = false;
-
-			i.mov.src = vrForTemporary(instruction.binary.lsrcIdx);
-			use(i.mov.src, id, false);
-			i.mov.size = vrTypes.at(i.mov.src).size();
-
-			i.mov.dst = vrForTemporary(instruction.binary.dstIdx);
-			use(i.mov.dst, id, true);
-
-			lirs.push_back(i);
-
-			i = {Operation::FADD, (*id)++};
-
-			i.binary.dst = vrForTemporary(instruction.binary.dstIdx);
-			use(i.binary.dst, id, true);
-
-			i.binary.src = vrForTemporary(instruction.binary.rsrcIdx);
-			use(i.binary.src, id, false);
-
-			lirs.push_back(i);
+			compileFloatingPointOp(Operation::FADD, instruction, id, lirs);
 		}
 		break;
 
 	case bytecode::Opcode::SUB:
+		if(!isIntegerOp(instruction)) {
+			compileFloatingPointOp(Operation::FSUB, instruction, id, lirs);
+			break;
+		}
+
 		i = {Operation::MOV, (*id)++};
 		i.mov.isImm = false;
 
@@ -256,6 +610,15 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 
 		break;
 	case bytecode::Opcode::MUL:
+		if(!isIntegerOp(instruction)) {
+			compileFloatingPointOp(Operation::FMUL, instruction, id, lirs);
+			break;
+		}
+
+		if(compileConstantMultiplication(instruction, id, lirs)) {
+			break;
+		}
+
 		i = {Operation::MOV, (*id)++};
 		i.mov.isImm = false;
 
@@ -279,38 +642,21 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 
 		break;
 	case bytecode::Opcode::DIV:
-		if(vrTypes.at(vrForTemporary(instruction.binary.lsrcIdx)).isFloatingPoint()) {
-			i = {Operation::MOV, (*id)++};
-			i.mov.isImm = false;
-
-			i.mov.src = vrForTemporary(instruction.binary.lsrcIdx);
-			use(i.mov.src, id, true);
-			i.mov.size = vrTypes.at(i.mov.src).size();
-
-			i.mov.dst = vrForTemporary(instruction.binary.dstIdx);
-			use(i.mov.dst, id, false);
-
-			lirs.push_back(i);
-
-			i = {Operation::DIV, (*id)++};
-			i.ternary.dst = {vrForTemporary(instruction.binary.dstIdx)};
-			use(vrForTemporary(instruction.binary.dstIdx), id, true);
-
-			i.ternary.srcA = vrForTemporary(instruction.binary.dstIdx);
-			use(i.ternary.srcA, id, true);
-
-			i.ternary.srcB = vrForTemporary(instruction.binary.rsrcIdx);
-			use(i.ternary.srcB, id, false);
-
-			lirs.push_back(i);
-
+		if(!isIntegerOp(instruction)) {
+			compileFloatingPointOp(Operation::FDIV, instruction, id, lirs);
 			break;
 		} else {
 			// we can handle division and mod the same because on amd64 they are the same operation
 			// which yields both results in different registers:
 			// no break here
 		}
-	case bytecode::Opcode::MOD:
+	case bytecode::Opcode::MOD: {
+		if(compileConstantDivision(instruction, id, lirs)) {
+			break;
+		}
+
+		// 32 bit integers use the 32 bit idiv, smaller ones are divided as 64 bit integers
+		bool dword = loweredWidth(vrTypes.at(vrForTemporary(instruction.binary.lsrcIdx))) == 32;
 
 		i = {Operation::MOV, (*id)++};
 		i.mov.isImm = false;
@@ -324,7 +670,7 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 
 		lirs.push_back(i);
 
-		i = {Operation::CQO, (*id)++};
+		i = {dword ? Operation::CDQ : Operation::CQO, (*id)++};
 		i.binary.src = vrForFixed(RegOp::RAX);
 		use(i.binary.src, id, true);
 
@@ -343,6 +689,8 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 		i.ternary.srcB = vrForTemporary(instruction.binary.rsrcIdx);
 		use(i.ternary.srcB, id, false);
 
+		i.ternary.size = dword ? DWORD : QWORD;
+
 		lirs.push_back(i);
 
 		i = {Operation::MOV, (*id)++};
@@ -359,6 +707,10 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 
 		lirs.push_back(i);
 
+		if(dword) {
+			emitUnary(Operation::SEXT, vrForTemporary(instruction.binary.dstIdx), id, lirs);
+		}
+	}
 		break;
 
 	case bytecode::Opcode::GT:
@@ -368,46 +720,42 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 	case bytecode::Opcode::EQ:
 	case bytecode::Opcode::NEQ:
 	case bytecode::Opcode::LTE:
-	case bytecode::Opcode::LT:
-		i = {Operation::CMP, (*id)++};
+	case bytecode::Opcode::LT: {
+		if(fusedComparisons.count(instruction.binary.dstIdx)) {
+			// compared right before the jump
+			break;
+		}
+
+		bool floating = !isIntegerOp(instruction);
+		lir::FlagOpMode mode = flagMode(instruction.opcode);
+		u16 l = instruction.binary.lsrcIdx;
+		u16 r = instruction.binary.rsrcIdx;
+
+		// ucomis sets the flags like an unsigned comparison, only `above` fails for unordered operands
+		if(floating && (mode == lir::LT || mode == lir::LTE)) {
+			std::swap(l, r);
+			mode = mode == lir::LT ? lir::GT : lir::GTE;
+		}
 
-		i.cmp.l = vrForTemporary(instruction.binary.lsrcIdx);
+		i = {floating ? Operation::FCMP : Operation::CMP, (*id)++};
+
+		i.cmp.l = vrForTemporary(l);
 		use(i.cmp.l, id, true);
 
-		i.cmp.r = vrForTemporary(instruction.binary.rsrcIdx);
+		i.cmp.r = vrForTemporary(r);
 		use(i.cmp.r, id, false);
 
 		lirs.push_back(i);
 
 		i = {Operation::SET, (*id)++};
-
-		switch (instruction.opcode) {
-		case bytecode::Opcode::GT:
-			i.flag.mode = lir::FlagOpMode::GT;
-			break;
-		case bytecode::Opcode::GTE:
-			i.flag.mode = lir::FlagOpMode::GTE;
-			break;
-		case bytecode::Opcode::EQ:
-			i.flag.mode = lir::FlagOpMode::EQ;
-			break;
-		case bytecode::Opcode::NEQ:
-			i.flag.mode = lir::FlagOpMode::NEQ;
-			break;
-		case bytecode::Opcode::LTE:
-			i.flag.mode = lir::FlagOpMode::LTE;
-			break;
-		case bytecode::Opcode::LT:
-			i.flag.mode = lir::FlagOpMode::LT;
-			break;
-		default:
-			throw std::runtime_error("Invalid opcode in comparison operator switch");
-		}
+		i.flag.mode = mode;
+		i.flag.floating = floating;
 
 		i.flag.reg = vrForTemporary(instruction.binary.dstIdx);
 		use(i.flag.reg, id, false);
 
 		lirs.push_back(i);
+	}
 		break;
 	case bytecode::Opcode::NOT:
 		i = {Operation::MOV, (*id)++};
@@ -462,6 +810,26 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 		lirs.push_back(i);
 		break;
 	case bytecode::Opcode::IF_GOTO:
+		if(fusedComparisons.count(instruction.jump.conditionIdx)) {
+			bytecode::Instruction const& comparison = *fusedComparisons.at(instruction.jump.conditionIdx);
+
+			i = {Operation::CMP, (*id)++};
+
+			i.cmp.l = vrForTemporary(comparison.binary.lsrcIdx);
+			use(i.cmp.l, id, true);
+
+			i.cmp.r = vrForTemporary(comparison.binary.rsrcIdx);
+			use(i.cmp.r, id, false);
+
+			lirs.push_back(i);
+
+			i = {Operation::JCC, (*id)++};
+			i.jump.target = instruction.jump.branchIdx;
+			i.jump.condition = flagMode(comparison.opcode);
+			lirs.push_back(i);
+			break;
+		}
+
 		i = {Operation::TEST, (*id)++};
 
 		i.flag.reg = vrForTemporary(instruction.jump.conditionIdx);
@@ -497,13 +865,13 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 
 
 
-		std::transform(instruction.phi.args.begin(), instruction.phi.args.end(), std::back_inserter(i.phi.edges),
-		               [=](auto edge) {
-			               return lir::PhiEdge{
-					               /* vreg  */ vrForPossiblyUnknownTemporary(edge.temp),
-					               /* block */ edge.block
-			               };
-		               });
+		for(u16 idx = 0; idx != instruction.phi.edges.count; ++idx) {
+			auto edge = instruction.phi.edge(function.operands, idx);
+			i.phi.edges.push_back(lir::PhiEdge{
+					/* vreg  */ vrForPossiblyUnknownTemporary(edge.temp),
+					/* block */ edge.block
+			});
+		}
 
 		std::set<lir::vr> sames;
 
@@ -522,7 +890,7 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 	case bytecode::Opcode::CALL_VOID:
 	case bytecode::Opcode::CALL: {
 		std::vector<lir::vr> vrArgs;
-		transformArguments(vrArgs, instruction.call.args);
+		transformArguments(vrArgs, function.operandsOf(instruction.call.args));
 		u16 dstIdx = (instruction.opcode == bytecode::Opcode::CALL_VOID ? (u16) -1 : instruction.call.dstIdx);
 		buildCall(lirs, instruction.call.functionIdx, false, 0, id, vrArgs, dstIdx);
 	}
@@ -530,7 +898,7 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 
 	case bytecode::Opcode::SPECIAL_VOID: {
 		std::vector<lir::vr> vrArgs;
-		transformArguments(vrArgs, instruction.call.args);
+		transformArguments(vrArgs, function.operandsOf(instruction.call.args));
 		buildCall(lirs,
 		          JitEngine::specialFunctionIndex(
 		                  bytecode::special::resolveSpecialBuiltinOpcodes((u8) instruction.call.functionIdx)),
@@ -608,6 +976,8 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 		i.mov.size = QWORD;
 		i.mov.isImm = true;
 		i.mov.imm = (i64) types.at(instruction.obj_alloc.typeId).vTable.data();
+		i.mov.isVTable = true;
+		i.mov.vTableOf = instruction.obj_alloc.typeId;
 
 		lir::vr vPTRVR = vr({bytecode::BaseType::INT64});
 		i.mov.dst = vPTRVR;
@@ -643,8 +1013,6 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 		i.memmov.base = vrForTemporary(instruction.access.ptrIdx);
 		use(i.memmov.base, id, true);
 
-		types.at(instruction.access.typeId).getSize();
-
 		i.memmov.offset = types.at(instruction.access.typeId).getOffset(instruction.access.fieldIdx);
 
 		i.memmov.size = types.at(instruction.access.typeId).getFieldSize(instruction.access.fieldIdx);
@@ -727,11 +1095,7 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 		lirs.push_back(loadFunctionIndex);
 
 		std::vector<lir::vr> vrArgs;
-		std::transform(instruction.member_call.args.begin(), instruction.member_call.args.end(),
-		               std::back_inserter(vrArgs),
-		               [=](u16 tmpIdx) {
-			               return vrForTemporary(tmpIdx);
-		               });
+		transformArguments(vrArgs, function.operandsOf(instruction.member_call.args));
 
 		u16 dstIdx = (instruction.opcode == bytecode::Opcode::VOID_MEMBER_CALL ? (u16) -1
 		                                                                       : instruction.member_call.dstIdx);
@@ -763,6 +1127,40 @@ LIRCompiler<Architecture>::compileInstruction(const bytecode::Instruction& instr
 	}
 		break;
 
+	// the length is stored in the 4 bytes in front of the elements
+	case bytecode::Opcode::BOUNDS_CHECK: {
+		lir::Instruction loadLength{Operation::MOV_MEM, (*id)++};
+		loadLength.memmov.toMem = false;
+		loadLength.memmov.isIndexed = false;
+
+		loadLength.memmov.base = vrForTemporary(instruction.check.arrayIdx);
+		use(loadLength.memmov.base, id, true);
+
+		loadLength.memmov.a = vr(bytecode::Type(bytecode::BaseType::INT32));
+		use(loadLength.memmov.a, id, true);
+
+		loadLength.memmov.offset = -4;
+		loadLength.memmov.size = DWORD;
+
+		lirs.push_back(loadLength);
+
+		i = {Operation::BOUNDS_CHECK, (*id)++};
+		i.check.length = loadLength.memmov.a;
+		use(i.check.length, id, true);
+
+		i.check.index = vrForTemporary(instruction.check.indexIdx);
+		use(i.check.index, id, true);
+
+		i.check.isRange = instruction.check.limitIdx != bytecode::BoundsCheckOp::NO_LIMIT;
+		if(i.check.isRange) {
+			i.check.limit = vrForTemporary(instruction.check.limitIdx);
+			use(i.check.limit, id, true);
+		}
+
+		lirs.push_back(i);
+	}
+		break;
+
 	default:
 		throw std::runtime_error("bytecode opcode not implemented " + std::to_string((u8) instruction.opcode));
 
@@ -960,7 +1358,7 @@ void LIRCompiler<Architecture>::buildCall(vector<lir::Instruction>& lirs,
 }
 
 template<class Architecture>
-void LIRCompiler<Architecture>::transformArguments(std::vector<lir::vr>& into, std::vector<u16> const& from) {
+void LIRCompiler<Architecture>::transformArguments(std::vector<lir::vr>& into, bytecode::OperandRange from) {
 	std::transform(from.begin(), from.end(), std::back_inserter(into),
 	               [=](u16 tmpIdx) {
 		               return vrForTemporary(tmpIdx);
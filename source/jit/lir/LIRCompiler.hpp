@@ -14,15 +14,25 @@ class LIRCompiler {
 private:
 	JitEngine* engine;
 	am2017s::bytecode::Program const& program;
-	std::map<u8, am2017s::bytecode::StructType>& types;
+	std::map<u8, am2017s::bytecode::StructType> const& types;
 	bytecode::Function const& function;
-	std::vector<bool>& skip;
 
 	lir::vr nextVR = 0;
 	lir::vr nextUnknownVR = (lir::vr)-1;
 	std::map<u16, lir::vr> temporaryToVR;
 	std::map<lir::vr, lir::vr> unknownToKnownVR;
 
+	/**
+	 * @brief values of the integer constants of the function by temporary
+	 */
+	std::map<u16, i64> constants;
+
+	/**
+	 * @brief comparisons whose only use is the conditional jump ending their block, by the temporary they
+	 * define. They are compiled together with the jump, which branches on the flags directly.
+	 */
+	std::map<u16, bytecode::Instruction const*> fusedComparisons;
+
 public:
 	u16 instructionCount;
 
@@ -51,7 +61,7 @@ private:
 	               u16* id, std::vector<lir::vr>& tmpArguments,
 	               u16 dstIdxOrVoid);
 
-	void transformArguments(std::vector<lir::vr>& into, std::vector<u16> const& from);
+	void transformArguments(std::vector<lir::vr>& into, bytecode::OperandRange from);
 
 	/**
 	 * Returns true iff all inputs of this instructions are integers
@@ -60,13 +70,44 @@ private:
 	 */
 	bool isIntegerOp(bytecode::Instruction const& instruction) const;
 
+	void emitMove(lir::vr dst, lir::vr src, OperandSize size, u16* id, vector<lir::Instruction>& lirs);
+	void emitConstant(lir::vr dst, i64 value, u16* id, vector<lir::Instruction>& lirs);
+	void emitUnary(lir::Operation operation, lir::vr dst, u16* id, vector<lir::Instruction>& lirs);
+	void emitBinary(lir::Operation operation, lir::vr dst, lir::vr src, u16* id, vector<lir::Instruction>& lirs);
+	void emitImmediate(lir::Operation operation, lir::vr dst, i32 imm, u16* id, vector<lir::Instruction>& lirs);
+
+	/**
+	 * Lowers a binary arithmetic instruction on floats to `dst = lsrc` and `operation dst, rsrc`
+	 */
+	void compileFloatingPointOp(lir::Operation operation, bytecode::Instruction const& instruction, u16* id,
+	                            vector<lir::Instruction>& lirs);
+
+	/**
+	 * Emits `dst = src * factor` with moves, shifts, lea, additions and the imul with an immediate, in the
+	 * width of `dst`. Returns false without emitting anything if that takes more than an imul.
+	 */
+	bool emitMultiplication(lir::vr dst, lir::vr src, i64 factor, u16* id, vector<lir::Instruction>& lirs);
+
+	/**
+	 * Lowers a MUL of a 32 or 64 bit integer and a constant without the imul of two registers.
+	 * Returns false if it has to use it.
+	 */
+	bool compileConstantMultiplication(bytecode::Instruction const& instruction, u16* id,
+	                                   vector<lir::Instruction>& lirs);
+
+	/**
+	 * Lowers a DIV or MOD of a 32 or 64 bit integer by a constant without idiv: powers of two become shifts
+	 * and masks, other divisors a multiplication with their magic number. Division by 0 and -1 keeps idiv
+	 * for its traps, then it returns false.
+	 */
+	bool compileConstantDivision(bytecode::Instruction const& instruction, u16* id, vector<lir::Instruction>& lirs);
+
 public:
 
 	LIRCompiler(JitEngine* engine,
 	            am2017s::bytecode::Program const& program,
-	            std::map<u8, am2017s::bytecode::StructType>& _types,
-	            const am2017s::bytecode::Function& _function,
-	            std::vector<bool>& _skip);
+	            std::map<u8, am2017s::bytecode::StructType> const& _types,
+	            const am2017s::bytecode::Function& _function);
 
 	void run();
 
@@ -93,9 +134,4 @@ public:
 template class LIRCompiler<AMD64>;
 #endif
 
-#ifdef TESTING
-#include <jit/allocator/TwoRegArchitecture.hpp>
-template class RegisterAllocation<TwoRegArchitecture>;
-#endif
-
 }}
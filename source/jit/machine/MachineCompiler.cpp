@@ -1,5 +1,6 @@
 #include <jit/machine/MachineCompiler.hpp>
 #include <jit/lifetime/LifetimeAnalyzer.hpp>
+#include <jit/SpecialFunctions.hpp>
 #include <log/Logger.hpp>
 #include <exception/NotImplementedException.hpp>
 
@@ -23,14 +24,13 @@ void MachineCompiler::run() {
 		for(u16 sIndex : predecessor.blockInfo.successors) {
 			Block const& successor = blocks[sIndex];
 
-			// todo make slot compatible (only reg for now)
 			for(Interval const& interval : intervals) {
 				if(interval.isFixed) {
 					continue;
 				}
 
 				if(interval.covers(successor.fromLIR())) {
-					RegOp moveFrom;
+					RegMemOp moveFrom;
 
 					// if it starts at begin of successor then
 					// first check if the interval starts exactly at the start position
@@ -40,7 +40,7 @@ void MachineCompiler::run() {
 						if(interval.phi) {
 							lir::Instruction const& phi = interval.definingPhi;
 							lir::vr operand = phi.phi.inputOf(predecessor.index);
-							moveFrom = intervalFor(predecessor.toLIR(), operand)._reg;
+							moveFrom = operandFor(predecessor.toLIR(), operand);
 						} else {
 							// if it's not a phi node than interval.covers(success.fromLIR()) should have been
 							// false in the first place so let's just continue
@@ -50,14 +50,22 @@ void MachineCompiler::run() {
 						// we come here if we extend a interval from one block to another
 						// e.g. if the predecessor block has multiple children that all inherit
 						// a variable or if the predecessor block is daisy-chained to the successor
-						moveFrom = intervalFor(predecessor.toLIR(), interval.vr)._reg;
+						moveFrom = operandFor(predecessor.toLIR(), interval.vr);
 					}
 
-					RegOp moveTo = intervalFor(successor.fromLIR(), interval.vr)._reg;
+					RegMemOp moveTo = operandFor(successor.fromLIR(), interval.vr);
+
+					if(!(moveFrom == moveTo)) {
+						lir::Instruction const& jump = predecessor.lirs.back();
 
-					if(moveFrom != moveTo) {
 						// if the edge instruction relates to a conditional jump
-						if(predecessor.lirs.back().operation == lir::Operation::JNZ) {
+						if(jump.operation == lir::Operation::JCC) {
+							// the moves of a fallthrough go in front of the successor, those of a jump to a
+							// successor with other predecessors in front of the jump itself
+							if(jump.jump.target == sIndex && successor.blockInfo.predecessors.size() == 1) {
+								conditionalEdgeInstructionsAtTarget[successor.index] = predecessor.index;
+							}
+						} else if(jump.operation == lir::Operation::JNZ) {
 							// there's a simple solution if the successor has only one parent: put the
 							// edge instructions at the beginning of the successor
 							if(successor.blockInfo.predecessors.size() == 1) {
@@ -138,6 +146,12 @@ void MachineCompiler::run() {
 	std::map<u16, std::set<std::pair<u32, u32>>> insertBlockAddressAt;
 	std::map<u16, u32> blockAddresses;
 
+	// jumps to the call of bounds_error that follows the code of the blocks
+	std::vector<u32> boundsErrorJumps;
+
+	// loads of float constants by their size and bits, from the constant pool that follows the code
+	std::map<std::pair<OperandSize, i64>, std::vector<u32>> constantLoads;
+
 	u16 prevBlock = (u16)-1;
 	for(Block const& block : blocks) {
 
@@ -175,9 +189,23 @@ void MachineCompiler::run() {
 			switch(instruction.operation) {
 				case lir::FMOV:
 				case lir::MOV:
-					if(instruction.mov.isImm) {
+					if(instruction.operation == lir::FMOV && instruction.mov.isImm) {
+						// guaranteed to be in an xmm
+						XMMOp dst = operandFor(id, instruction.mov.dst).xmm();
+						OperandSize size = instruction.mov.size;
+						constantLoads[{size, instruction.mov.imm}].push_back(builder.movf_riprel(dst, size));
+					} else if(instruction.mov.isImm && instruction.mov.isVTable) {
 						Interval const& dst = intervalFor(id, instruction.mov.dst);
-						builder.movimm(instruction.mov.imm, dst._reg);
+						builder.movimm64(instruction.mov.imm, dst._reg);
+						relocations.push_back({builder.offset() - 8, instruction.mov.vTableOf});
+					} else if(instruction.mov.isImm) {
+						RegMemOp dst = operandFor(id, instruction.mov.dst);
+						if(dst.isMem()) {
+							// instruction selection only moves 32 bit immediates into spilled registers
+							builder.movimm((i32) instruction.mov.imm, dst.mem(), QWORD);
+						} else {
+							builder.movimm(instruction.mov.imm, dst.reg());
+						}
 					} else {
 						RegMemOp src = operandFor(id, instruction.mov.src);
 						RegMemOp dst = operandFor(id, instruction.mov.dst);
@@ -194,19 +222,44 @@ void MachineCompiler::run() {
 					builder.cmp(left.reg(), right);
 				}
 					break;
+				case lir::FCMP:
+				{
+					// left is guaranteed to be in an xmm
+					XMMOp left = operandFor(id, instruction.cmp.l).xmm();
+					RegMemOp right = operandFor(id, instruction.cmp.r);
+					builder.ucomis(left, right, vrTypes.at(instruction.cmp.l).size());
+				}
+					break;
+				case lir::CMP_IMM:
+				{
+					// reg or mem
+					RegMemOp left = operandFor(id, instruction.immediate.dst);
+					builder.cmp(left, instruction.immediate.imm, instruction.immediate.size);
+				}
+					break;
 				case lir::SET:
 				{
-					// todo distinguish reg/mem
+					// reg or mem
 					RegMemOp reg = operandFor(id, instruction.flag.reg);
-					switch(instruction.flag.mode) {
-						case lir::LT: builder.set(jit::internal::Comparison::LT, reg.reg()); break;
-						case lir::LTE: builder.set(jit::internal::Comparison::LTE, reg.reg()); break;
-						case lir::EQ: builder.set(jit::internal::Comparison::EQ, reg.reg()); break;
-						case lir::NEQ: builder.set(jit::internal::Comparison::NEQ, reg.reg()); break;
-						case lir::GTE: builder.set(jit::internal::Comparison::GTE, reg.reg()); break;
-						case lir::GT: builder.set(jit::internal::Comparison::GT, reg.reg()); break;
+					lir::FlagOpMode mode = instruction.flag.mode;
+					jit::internal::Comparison on = comparison(mode, instruction.flag.floating);
+
+					if(reg.isMem()) {
+						builder.set(on, reg.mem());
+					} else {
+						builder.set(on, reg.reg());
 					}
 
+					if(instruction.flag.floating && (mode == lir::EQ || mode == lir::NEQ)) {
+						// unordered operands set the parity flag, they are never equal
+						u32 ordered = builder.jcc_riprel(jit::internal::Comparison::NO_PARITY);
+						if(reg.isMem()) {
+							builder.movimm(mode == lir::NEQ, reg.mem(), BYTE);
+						} else {
+							builder.movimm(mode == lir::NEQ, reg.reg());
+						}
+						builder.quad(builder.offset() - (ordered + 4), ordered);
+					}
 				}
 					break;
 				case lir::NEG:
@@ -215,6 +268,7 @@ void MachineCompiler::run() {
 					RegMemOp reg = operandFor(id, instruction.unary.dst);
 					builder.neg(reg.reg(), vrTypes.at(instruction.unary.dst).size());
 				}
+					break;
 				case lir::NOT:
 				{
 					// guaranteed to be in reg
@@ -223,12 +277,33 @@ void MachineCompiler::run() {
 				}
 					break;
 				case lir::TEST:
-					// todo distinguish reg/mem
-					if(!operandFor(id, instruction.flag.reg).isReg()) {
-						throw new std::runtime_error("test not implemented for mem operands yet");
+				{
+					// reg or mem
+					RegMemOp flag = operandFor(id, instruction.flag.reg);
+					if(flag.isMem()) {
+						builder.test(flag.mem());
+					} else {
+						builder.test(flag.reg());
 					}
-
-					builder.test(operandFor(id, instruction.flag.reg).reg());
+				}
+					break;
+				case lir::JCC:
+				{
+					jit::internal::Comparison on = comparison(instruction.jump.condition);
+					u16 target = instruction.jump.target;
+
+					if(!edgeInstructions[block.index][target].empty() && !conditionalEdgeInstructionsAtTarget.count(target)) {
+						// skip the moves and the jump when the condition does not hold
+						u32 skip = builder.jcc_riprel(jit::internal::inverse(on));
+						insertEdgeInstructions(edgeInstructions, sortedInstructions, block.index, target);
+						offset = builder.jmp_riprel();
+						insertBlockAddressAt[target].insert({builder.offset(), offset});
+						builder.quad(builder.offset() - (skip + 4), skip);
+					} else {
+						offset = builder.jcc_riprel(on);
+						insertBlockAddressAt[target].insert({builder.offset(), offset});
+					}
+				}
 					break;
 				case lir::JMP:
 					insertEdgeInstructions(edgeInstructions, sortedInstructions, block.index, instruction.jump.target);
@@ -246,7 +321,6 @@ void MachineCompiler::run() {
 					insertBlockAddressAt[instruction.jump.target].insert({builder.offset(), offset});
 					break;
 				case lir::ADD:
-				case lir::FADD:
 				{
 					// reg or mem
 					RegMemOp src = operandFor(id, instruction.binary.src);
@@ -255,8 +329,6 @@ void MachineCompiler::run() {
 
 					if(src.isReg() && dst.isReg()) {
 						builder.add(src.reg(), dst.reg());
-					} else if(src.isXMM() && dst.isXMM()) {
-						builder.addf(src.xmm(), dst.xmm(), vrTypes.at(instruction.binary.src).size());
 					} else if(src.isMem() && dst.isReg()) {
 						builder.add(src.mem(), dst.reg());
 					} else {
@@ -281,23 +353,32 @@ void MachineCompiler::run() {
 					// srcB is guaranteed to be in register
 					RegMemOp src = operandFor(id, instruction.binary.src);
 
-					if((src.isReg() && dst.isReg()) || (src.isMem() && dst.isReg())) {
-						builder.imul(dst.reg(), src);
-					} else if(src.isXMM() && dst.isXMM()) {
-						builder.mulf(src.xmm(), dst.xmm(), vrTypes.at(instruction.binary.dst).size());
-					}
-
+					builder.imul(dst.reg(), src);
 				}
 					break;
 
 				case lir::DIV:
+					builder.idiv(operandFor(id, instruction.ternary.srcB), instruction.ternary.size);
+					break;
+
+				case lir::FADD:
+				case lir::FSUB:
+				case lir::FMUL:
+				case lir::FDIV:
+				case lir::FXOR:
 				{
-					RegMemOp srcB = operandFor(id, instruction.ternary.srcB);
-					if(vrTypes.at(instruction.ternary.srcB).isInteger()) {
-						builder.idiv(srcB);
-					} else {
-						RegMemOp srcA = operandFor(id, instruction.ternary.srcA);
-						builder.divf(srcA.xmm(), srcB, vrTypes.at(instruction.ternary.srcB).size());
+					// xmm or mem, FXOR guarantees an xmm
+					RegMemOp src = operandFor(id, instruction.binary.src);
+					// always xmm
+					XMMOp dst = operandFor(id, instruction.binary.dst).xmm();
+					OperandSize size = vrTypes.at(instruction.binary.dst).size();
+
+					switch(instruction.operation) {
+						case lir::FADD: builder.addf(src, dst, size); break;
+						case lir::FSUB: builder.subf(src, dst, size); break;
+						case lir::FMUL: builder.mulf(src, dst, size); break;
+						case lir::FDIV: builder.divf(src, dst, size); break;
+						default: builder.xorf(src.xmm(), dst); break;
 					}
 				}
 					break;
@@ -313,6 +394,54 @@ void MachineCompiler::run() {
 					builder.cqo();
 					break;
 
+				case lir::CDQ:
+					builder.cdq();
+					break;
+
+				case lir::MUL_HIGH:
+					builder.imul(operandFor(id, instruction.ternary.srcB), instruction.ternary.size);
+					break;
+
+				case lir::SHL:
+				case lir::SAR:
+				case lir::SHR:
+				case lir::AND:
+				case lir::MUL_IMM:
+				case lir::ADD_IMM:
+				case lir::SUB_IMM:
+				{
+					// guaranteed to be in reg
+					RegOp reg = operandFor(id, instruction.immediate.dst).reg();
+					OperandSize size = instruction.immediate.size;
+					i32 imm = instruction.immediate.imm;
+
+					switch(instruction.operation) {
+						case lir::SHL: builder.shl(reg, (u8) imm, size); break;
+						case lir::SAR: builder.sar(reg, (u8) imm, size); break;
+						case lir::SHR: builder.shr(reg, (u8) imm, size); break;
+						case lir::AND: builder.andimm(reg, imm, size); break;
+						case lir::ADD_IMM: builder.add(reg, imm, size); break;
+						case lir::SUB_IMM: builder.sub(reg, imm, size); break;
+						default: builder.imul(reg, imm, size); break;
+					}
+				}
+					break;
+
+				case lir::LEA:
+					// all guaranteed to be in reg
+					builder.lea(operandFor(id, instruction.lea.base).reg(), operandFor(id, instruction.lea.index).reg(),
+					            instruction.lea.scale, operandFor(id, instruction.lea.dst).reg(),
+					            vrTypes.at(instruction.lea.dst).size());
+					break;
+
+				case lir::SEXT:
+				{
+					// guaranteed to be in reg
+					RegOp reg = operandFor(id, instruction.unary.dst).reg();
+					builder.movsxd(reg, reg, DWORD);
+				}
+					break;
+
 				case lir::CALL:
 				{
 					builder.call(RegOp::RBP, instruction.call.function * 8);
@@ -331,6 +460,11 @@ void MachineCompiler::run() {
 						              instruction.memmov.offset);
 					}
 
+					if(instruction.memmov.isImm) {
+						builder.movimm(instruction.memmov.imm, memOp, instruction.memmov.size);
+						break;
+					}
+
 					// a is guaranteed to be in register
 					RegMemOp const& reg = operandFor(id, instruction.memmov.a);
 
@@ -371,17 +505,34 @@ void MachineCompiler::run() {
 				}
 					break;
 
-				case lir::NOP:
-					break;
-
-				case lir::MOV_I2F:
+				case lir::BOUNDS_CHECK:
 				{
-					RegOp src = operandFor(id, instruction.mov.src).reg();
-					XMMOp dst = operandFor(id, instruction.mov.dst).xmm();
+					// all operands are guaranteed to be in registers, the length is sign extended and never
+					// negative, so a negative index compares above it
+					RegOp index = operandFor(id, instruction.check.index).reg();
+					RegOp length = operandFor(id, instruction.check.length).reg();
 
-					builder.movd(src, dst, instruction.mov.size);
-					break;
+					if(instruction.check.isRange) {
+						RegOp limit = operandFor(id, instruction.check.limit).reg();
+
+						builder.cmp(index, limit);
+						u32 empty = builder.jcc_riprel(jit::internal::Comparison::GTE);
+
+						builder.cmp(index, length);
+						boundsErrorJumps.push_back(builder.jcc_riprel(jit::internal::Comparison::ABOVE_EQUAL));
+						builder.cmp(limit, length);
+						boundsErrorJumps.push_back(builder.jcc_riprel(jit::internal::Comparison::ABOVE));
+
+						builder.quad(builder.offset() - (empty + 4), empty);
+					} else {
+						builder.cmp(index, length);
+						boundsErrorJumps.push_back(builder.jcc_riprel(jit::internal::Comparison::ABOVE_EQUAL));
+					}
 				}
+					break;
+
+				case lir::NOP:
+					break;
 
 				default:
 				 throw std::runtime_error("LIR opcode not implemented!");
@@ -391,6 +542,37 @@ void MachineCompiler::run() {
 		prevBlock = block.index;
 	}
 
+	if(!boundsErrorJumps.empty()) {
+		u32 boundsError = builder.offset();
+
+		builder.mov(RegMemOp(MemOp{RBP, -8}), RDI, QWORD);
+		builder.andimm(RSP, -16);
+		builder.call(RBP, JitEngine::specialFunctionIndex(SPECIAL_F_IDX_BOUNDS_ERROR) * 8);
+
+		for(u32 jump : boundsErrorJumps) {
+			builder.quad(boundsError - (jump + 4), jump);
+		}
+	}
+
+	if(!constantLoads.empty()) {
+		// doubles first, which keeps every constant aligned to its size
+		builder.align(8);
+		for(OperandSize size : {QWORD, DWORD}) {
+			for(auto const& pair : constantLoads) {
+				if(pair.first.first != size) {
+					continue;
+				}
+
+				u32 constant = builder.offset();
+				builder.data(pair.first.second, size);
+
+				for(u32 load : pair.second) {
+					builder.quad(constant - (load + 4), load);
+				}
+			}
+		}
+	}
+
 	for(auto& pair : insertBlockAddressAt) {
 		u16 blockIndex = pair.first;
 		std::set<std::pair<u32, u32>>& ripAndInsertPoints = pair.second;
@@ -544,6 +726,9 @@ void MachineCompiler::insertEdgeInstructions(
 			} else if(pair.second.isReg()) {
 				// {mem, reg}
 				builder.mov(pair.first, pair.second.reg(), pair.size);
+			} else if(pair.first.isXMM() || pair.second.isXMM()) {
+				// {xmm, xmm}, {xmm, mem} or {mem, xmm}
+				builder.mov(pair.first, pair.second, pair.size);
 			} else {
 				// {mem, mem}
 				throw NotImplementedException();
@@ -553,6 +738,30 @@ void MachineCompiler::insertEdgeInstructions(
 
 }
 
+jit::internal::Comparison MachineCompiler::comparison(lir::FlagOpMode mode, bool floating) {
+	if(floating) {
+		switch(mode) {
+			case lir::EQ: return jit::internal::Comparison::EQ;
+			case lir::NEQ: return jit::internal::Comparison::NEQ;
+			case lir::GTE: return jit::internal::Comparison::ABOVE_EQUAL;
+			case lir::GT: return jit::internal::Comparison::ABOVE;
+			default: throw std::runtime_error("floats are compared with swapped operands instead of " +
+			                                  lir::modeToString(mode));
+		}
+	}
+
+	switch(mode) {
+		case lir::LT: return jit::internal::Comparison::LT;
+		case lir::LTE: return jit::internal::Comparison::LTE;
+		case lir::EQ: return jit::internal::Comparison::EQ;
+		case lir::NEQ: return jit::internal::Comparison::NEQ;
+		case lir::GTE: return jit::internal::Comparison::GTE;
+		case lir::GT: return jit::internal::Comparison::GT;
+	}
+
+	throw std::runtime_error("invalid comparison mode");
+}
+
 RegMemOp MachineCompiler::operandFor(u16 instructionId, lir::vr vr) {
 	Interval const& i = intervalFor(instructionId, vr);
 
@@ -2,6 +2,7 @@
 
 #include <jit/lifetime/LifetimeAnalyzer.hpp>
 #include <jit/CodeBuilder.hpp>
+#include <jit/CompiledCode.hpp>
 #include <jit/allocator/register/StackAllocator.hpp>
 
 namespace am2017s { namespace jit {
@@ -40,6 +41,11 @@ public:
 
 	CodeBuilder builder;
 
+	/**
+	 * Addresses in `builder`'s code that are only valid in this process
+	 */
+	std::vector<Relocation> relocations;
+
 	std::map<u16, std::map<u16, std::vector<SpillMovOp>>>
 	orderEdgeInstructions(std::map<u16, std::map<u16, std::vector<SpillMovOp>>> edgeInstructions);
 
@@ -52,6 +58,12 @@ public:
 	std::vector<SpillMovOp> topologicallySort(std::vector<SpillMovOp> vector);
 
 	RegMemOp operandFor(u16 instructionId, lir::vr vr);
+
+	/**
+	 * The signed condition code of a comparison, or the unsigned one for the flags of an FCMP. EQ and NEQ of
+	 * floats additionally need to check the parity flag.
+	 */
+	static jit::internal::Comparison comparison(lir::FlagOpMode mode, bool floating = false);
 };
 
 }}
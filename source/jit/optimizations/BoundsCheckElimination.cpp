@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+
+#include <jit/optimizations/BoundsCheckElimination.hpp>
+#include <jit/optimizations/Folding.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::BoundsCheckOp;
+using bytecode::Opcode;
+
+namespace {
+
+RegisterPass<BytecodePass, BoundsCheckElimination> registration("bce", 1, 500, DEF_USE | DOMINATORS | LOOPS, ALL_ANALYSES);
+
+bool isIndexType(bytecode::Type type) {
+	return !type.isArray && type.baseType >= (u8) bytecode::BaseType::INT8 && type.baseType <= (u8) bytecode::BaseType::INT64;
+}
+
+bytecode::Instruction boundsCheck(u16 array, u16 index, u16 limit) {
+	bytecode::Instruction check(Opcode::BOUNDS_CHECK);
+	check.check.arrayIdx = array;
+	check.check.indexIdx = index;
+	check.check.limitIdx = limit;
+	return check;
+}
+
+/**
+ * Rebuilds the instructions of `function` with `inserted[block]` added to every block, in front of its
+ * terminator or at its end if it falls through. Returns for every new instruction the old one it was, or
+ * DefUse::UNDEFINED if it was inserted.
+ */
+std::vector<u32> insert(bytecode::Function& function, std::vector<std::vector<bytecode::Instruction>> const& inserted) {
+	std::vector<bytecode::Instruction> instructions;
+	std::vector<u32> origins;
+	u32 start = 0;
+
+	for(u16 block = 0; block != function.blocks.size(); ++block) {
+		u32 end = start + function.blocks[block].instructionCount;
+		bool terminated = end != start && isTerminator(function.instructions[end - 1].opcode);
+
+		for(u32 i = start; i != end; ++i) {
+			if(i + 1 == end && terminated) {
+				instructions.insert(instructions.end(), inserted[block].begin(), inserted[block].end());
+				origins.resize(instructions.size(), DefUse::UNDEFINED);
+			}
+
+			instructions.push_back(function.instructions[i]);
+			origins.push_back(i);
+		}
+
+		if(!terminated) {
+			instructions.insert(instructions.end(), inserted[block].begin(), inserted[block].end());
+			origins.resize(instructions.size(), DefUse::UNDEFINED);
+		}
+
+		function.blocks[block].instructionCount += inserted[block].size();
+		start = end;
+	}
+
+	for(u32 i = 0; i != instructions.size(); ++i) {
+		instructions[i].id = i;
+	}
+
+	function.instructions = std::move(instructions);
+	return origins;
+}
+
+}
+
+void insertBoundsChecks(bytecode::Function& function) {
+	std::vector<bytecode::Instruction> instructions;
+	u32 start = 0;
+
+	for(auto& block : function.blocks) {
+		u32 end = start + block.instructionCount;
+
+		for(u32 i = start; i != end; ++i) {
+			auto const& instruction = function.instructions[i];
+
+			if(instruction.opcode == Opcode::LOAD_IDX || instruction.opcode == Opcode::STORE_IDX) {
+				instructions.push_back(boundsCheck(instruction.array.memoryIdx, instruction.array.indexIdx, BoundsCheckOp::NO_LIMIT));
+				block.instructionCount++;
+			}
+			instructions.push_back(instruction);
+		}
+
+		start = end;
+	}
+
+	for(u32 i = 0; i != instructions.size(); ++i) {
+		instructions[i].id = i;
+	}
+
+	function.instructions = std::move(instructions);
+}
+
+std::vector<BoundsCheckElimination::Fact> BoundsCheckElimination::edgeFacts(u16 block) const {
+	auto const& predecessors = function->blocks[block].predecessors;
+	if(predecessors.size() != 1) {
+		return {};
+	}
+
+	u16 predecessor = predecessors.front();
+	auto const& branch = function->instructions[defUse->blockStarts[predecessor] + function->blocks[predecessor].instructionCount - 1];
+	if(branch.opcode != Opcode::IF_GOTO) {
+		return {};
+	}
+
+	// both edges going to the same block say nothing
+	bool taken = branch.jump.branchIdx == block;
+	if(taken == (predecessor + 1 == block)) {
+		return {};
+	}
+
+	u32 definition = defUse->definitions[branch.jump.conditionIdx];
+	if(definition == DefUse::UNDEFINED) {
+		return {};
+	}
+
+	auto const& condition = function->instructions[definition];
+	u16 lhs = condition.binary.lsrcIdx;
+	u16 rhs = condition.binary.rsrcIdx;
+
+	switch(condition.opcode) {
+	case Opcode::LT:
+	case Opcode::LTE:
+	case Opcode::GT:
+	case Opcode::GTE:
+		if(!isIndexType(function->temporaryTypes[lhs])) {
+			return {};
+		}
+		break;
+	default:
+		return {};
+	}
+
+	// the false edge of a comparison is the opposite comparison with the operands swapped
+	bool less = condition.opcode == Opcode::LT || condition.opcode == Opcode::LTE;
+	bool strict = condition.opcode == Opcode::LT || condition.opcode == Opcode::GT;
+	if(!taken) {
+		less = !less;
+		strict = !strict;
+	}
+
+	if(less) {
+		return {{lhs, rhs, strict}};
+	} else {
+		return {{rhs, lhs, strict}};
+	}
+}
+
+std::vector<BoundsCheckElimination::Fact> BoundsCheckElimination::facts(u16 block) const {
+	std::vector<Fact> result;
+
+	for(u16 dominator = block; dominator != Dominators::NONE; dominator = dominators->idom[dominator]) {
+		auto facts = edgeFacts(dominator);
+		result.insert(result.end(), facts.begin(), facts.end());
+
+		if(dominators->idom[dominator] == dominator) {
+			break;
+		}
+	}
+
+	return result;
+}
+
+bool BoundsCheckElimination::nonNegative(u16 temporary, u16 block) {
+	if(!isIndexType(function->temporaryTypes[temporary])) {
+		return false;
+	}
+
+	// a counter that depends on itself is non-negative if every other value it takes is, other cycles prove
+	// nothing
+	u32 definition = defUse->definitions[temporary];
+	if(visiting[temporary]) {
+		return definition != DefUse::UNDEFINED && function->instructions[definition].opcode == Opcode::PHI;
+	}
+	visiting[temporary] = true;
+
+	bool result = false;
+
+	if(definition != DefUse::UNDEFINED) {
+		auto const& instruction = function->instructions[definition];
+		u16 defined = defUse->blockOf[definition];
+
+		switch(instruction.opcode) {
+		case Opcode::CONST:
+			result = isConstantType(instruction.constant.type) && truncate(instruction.constant.value, instruction.constant.type) >= 0;
+			break;
+
+		case Opcode::LENGTH:
+			result = true;
+			break;
+
+		case Opcode::PHI:
+			result = true;
+			for(u16 idx = 0; idx != instruction.phi.edges.count && result; ++idx) {
+				auto edge = instruction.phi.edge(function->operands, idx);
+				result = nonNegative(edge.temp, edge.block);
+			}
+			break;
+
+		// x + 1 cannot overflow if x is less than something
+		case Opcode::ADD: {
+			u16 lhs = instruction.binary.lsrcIdx;
+			u16 rhs = instruction.binary.rsrcIdx;
+			for(int swap = 0; swap != 2 && !result; ++swap, std::swap(lhs, rhs)) {
+				u32 one = defUse->definitions[rhs];
+				if(one == DefUse::UNDEFINED || function->instructions[one].opcode != Opcode::CONST
+				   || function->instructions[one].constant.value != 1) {
+					continue;
+				}
+
+				auto known = facts(defined);
+				result = nonNegative(lhs, defined) && std::any_of(known.begin(), known.end(), [&](Fact const& fact) {
+					return fact.lhs == lhs && fact.strict;
+				});
+			}
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	// 0 <= x, or anything non-negative that is less than x
+	if(!result) {
+		for(auto const& fact : facts(block)) {
+			if(fact.rhs == temporary && nonNegative(fact.lhs, block)) {
+				result = true;
+				break;
+			}
+		}
+	}
+
+	visiting[temporary] = false;
+	return result;
+}
+
+bool BoundsCheckElimination::isLength(u16 temporary, u16 array) const {
+	u32 definition = defUse->definitions[temporary];
+	if(definition != DefUse::UNDEFINED) {
+		auto const& instruction = function->instructions[definition];
+		if(instruction.opcode == Opcode::LENGTH && instruction.array.memoryIdx == array) {
+			return true;
+		}
+	}
+
+	u32 allocation = defUse->definitions[array];
+	if(allocation != DefUse::UNDEFINED) {
+		auto const& instruction = function->instructions[allocation];
+		if(instruction.opcode == Opcode::NEW && instruction.alloc.sizeIdx == temporary) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool BoundsCheckElimination::redundant(u32 i) {
+	auto const& check = function->instructions[i].check;
+	u16 block = defUse->blockOf[i];
+
+	if(check.limitIdx != BoundsCheckOp::NO_LIMIT) {
+		return false;
+	}
+
+	// a constant index into an array of constant size
+	u32 index = defUse->definitions[check.indexIdx];
+	u32 allocation = defUse->definitions[check.arrayIdx];
+	if(index != DefUse::UNDEFINED && allocation != DefUse::UNDEFINED
+	   && function->instructions[index].opcode == Opcode::CONST
+	   && function->instructions[allocation].opcode == Opcode::NEW) {
+		u32 size = defUse->definitions[function->instructions[allocation].alloc.sizeIdx];
+		auto const& constant = function->instructions[index].constant;
+
+		if(size != DefUse::UNDEFINED && function->instructions[size].opcode == Opcode::CONST && isConstantType(constant.type)) {
+			i64 value = truncate(constant.value, constant.type);
+			if(value >= 0 && value < function->instructions[size].constant.value) {
+				return true;
+			}
+		}
+	}
+
+	for(auto const& fact : facts(block)) {
+		if(fact.strict && fact.lhs == check.indexIdx && isLength(fact.rhs, check.arrayIdx)) {
+			return nonNegative(check.indexIdx, block);
+		}
+	}
+
+	return false;
+}
+
+bool BoundsCheckElimination::hoistable(u32 i, u16& preheader, u16& init, u16& end) const {
+	auto const& check = function->instructions[i].check;
+	u16 block = defUse->blockOf[i];
+	u16 loop = loops->innermost[block];
+
+	if(loop == Loops::NONE || check.limitIdx != BoundsCheckOp::NO_LIMIT) {
+		return false;
+	}
+
+	// the header also runs on the iteration that leaves the loop, with the counter at the end of the range
+	auto const& info = loops->loops[loop];
+	if(block == info.header) {
+		return false;
+	}
+
+	auto outside = [&](u16 temporary) {
+		u32 definition = defUse->definitions[temporary];
+		return definition == DefUse::UNDEFINED || !loops->contains(loop, defUse->blockOf[definition]);
+	};
+
+	// the index counts up by one from a value it has in front of the loop
+	u32 counter = defUse->definitions[check.indexIdx];
+	if(!outside(check.arrayIdx) || counter == DefUse::UNDEFINED || function->instructions[counter].opcode != Opcode::PHI
+	   || defUse->blockOf[counter] != info.header) {
+		return false;
+	}
+
+	preheader = Dominators::NONE;
+	for(u16 predecessor : function->blocks[info.header].predecessors) {
+		if(loops->contains(loop, predecessor)) {
+			continue;
+		}
+		if(preheader != Dominators::NONE || function->blocks[predecessor].successors.size() != 1) {
+			return false;
+		}
+		preheader = predecessor;
+	}
+	if(preheader == Dominators::NONE) {
+		return false;
+	}
+
+	auto const& phi = function->instructions[counter].phi;
+	init = phi.inputOf(function->operands, preheader);
+	for(u16 idx = 0; idx != phi.edges.count; ++idx) {
+		auto edge = phi.edge(function->operands, idx);
+		if(edge.block == preheader) {
+			continue;
+		}
+
+		u32 next = defUse->definitions[edge.temp];
+		if(next == DefUse::UNDEFINED || function->instructions[next].opcode != Opcode::ADD) {
+			return false;
+		}
+
+		auto const& add = function->instructions[next].binary;
+		u16 step = add.lsrcIdx == check.indexIdx ? add.rsrcIdx : add.lsrcIdx;
+		u32 one = defUse->definitions[step];
+		if((add.lsrcIdx != check.indexIdx && add.rsrcIdx != check.indexIdx) || one == DefUse::UNDEFINED
+		   || function->instructions[one].opcode != Opcode::CONST || function->instructions[one].constant.value != 1) {
+			return false;
+		}
+	}
+
+	// the header leaves the loop unless the counter is less than something that does not change in it
+	auto const& successors = function->blocks[info.header].successors;
+	if(successors.size() != 2) {
+		return false;
+	}
+	u16 body = loops->contains(loop, successors[0]) ? successors[0] : successors[1];
+	if(loops->contains(loop, successors[0]) == loops->contains(loop, successors[1])) {
+		return false;
+	}
+
+	auto bound = edgeFacts(body);
+	if(bound.empty() || !bound.front().strict || bound.front().lhs != check.indexIdx || !outside(bound.front().rhs)) {
+		return false;
+	}
+	end = bound.front().rhs;
+
+	// every iteration that starts reaches the check, and reaches it with the next value of the counter
+	for(u16 latch : info.latches) {
+		if(!dominators->dominates(block, latch)) {
+			return false;
+		}
+	}
+
+	for(u16 other : info.blocks) {
+		if(other != info.header && loops->innermost[other] != loop) {
+			return false;
+		}
+
+		auto const& successorsOf = function->blocks[other].successors;
+		if(other != info.header && (successorsOf.empty() || std::any_of(successorsOf.begin(), successorsOf.end(), [&](u16 successor) {
+			return !loops->contains(loop, successor);
+		}))) {
+			return false;
+		}
+
+		// a call or builtin may print or exit before the iteration that fails the hoisted check
+		u32 start = defUse->blockStarts[other];
+		for(u32 j = start; j != start + function->blocks[other].instructionCount; ++j) {
+			auto opcode = function->instructions[j].opcode;
+			if(isCall(opcode) || opcode == Opcode::SPECIAL || opcode == Opcode::SPECIAL_VOID) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool BoundsCheckElimination::run(bytecode::Function& _function, FunctionAnalyses& analyses) {
+	function = &_function;
+	defUse = &analyses.defUse();
+	dominators = &analyses.dominators();
+	loops = &analyses.loops();
+
+	visiting.assign(function->temporyCount, false);
+
+	std::vector<bool> removed(function->instructions.size(), false);
+	std::map<std::tuple<u16, u16, u16>, std::vector<u32>> kept;
+	std::vector<std::vector<bytecode::Instruction>> hoisted(function->blocks.size());
+	std::set<std::tuple<u16, u16, u16, u16>> ranges;
+	bool changed = false;
+
+	// dominating checks come first in reverse postorder
+	for(u16 block : dominators->reversePostorder) {
+		u32 start = defUse->blockStarts[block];
+		for(u32 i = start; i != start + function->blocks[block].instructionCount; ++i) {
+			auto const& instruction = function->instructions[i];
+			if(instruction.opcode != Opcode::BOUNDS_CHECK) {
+				continue;
+			}
+
+			auto const& check = instruction.check;
+			auto& same = kept[std::make_tuple(check.arrayIdx, check.indexIdx, check.limitIdx)];
+			bool dominated = std::any_of(same.begin(), same.end(), [&](u32 other) {
+				return dominators->dominates(defUse->blockOf[other], block);
+			});
+
+			u16 preheader, init, end;
+			if(dominated || redundant(i)) {
+				removed[i] = true;
+			} else if(hoistable(i, preheader, init, end)) {
+				removed[i] = true;
+				if(ranges.insert(std::make_tuple(preheader, check.arrayIdx, init, end)).second) {
+					hoisted[preheader].push_back(boundsCheck(check.arrayIdx, init, end));
+				}
+			} else {
+				same.push_back(i);
+			}
+
+			changed |= removed[i];
+		}
+	}
+
+	if(changed) {
+		auto origins = insert(*function, hoisted);
+
+		std::vector<bool> dropped(origins.size());
+		for(u32 i = 0; i != origins.size(); ++i) {
+			dropped[i] = origins[i] != DefUse::UNDEFINED && removed[origins[i]];
+		}
+		removeInstructions(*function, dropped);
+	}
+
+	return changed;
+}
+
+}}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Puts a BOUNDS_CHECK of the array and the index in front of every LOAD_IDX and STORE_IDX of `function`
+ */
+void insertBoundsChecks(bytecode::Function& function);
+
+/**
+ * Removes the bounds checks that insertBoundsChecks put in and that cannot fail, and moves those of loops
+ * that walk an array into a single check in front of the loop.
+ *
+ * A check cannot fail if an identical check dominates it, or if the index is known to be non-negative and
+ * less than the length of the array. Facts like `i < n` come from the comparisons of the branches that
+ * dominate a block, the length is known through LENGTH of the array or the size the array was created with.
+ * An index is non-negative if it is a non-negative constant, a length, or a loop counter that starts
+ * non-negative and is incremented by one while it is less than something else.
+ *
+ * A check of a counter `i` that counts up by one from `init` while `i < n` is replaced with a check of the
+ * range [init, n) in front of the loop if the loop checks every value: the check is executed in every
+ * iteration, the loop only ends at its header and it calls nothing.
+ */
+class BoundsCheckElimination : public BytecodePass {
+private:
+	/**
+	 * `lhs < rhs`, or `lhs <= rhs` if it is not strict
+	 */
+	struct Fact {
+		u16 lhs;
+		u16 rhs;
+		bool strict;
+	};
+
+	bytecode::Function* function = nullptr;
+	DefUse const* defUse = nullptr;
+	Dominators const* dominators = nullptr;
+	Loops const* loops = nullptr;
+
+	/**
+	 * @brief temporaries whose sign is being computed, they are assumed to be non-negative
+	 */
+	std::vector<bool> visiting;
+
+	/**
+	 * The fact the branch into `block` establishes, if it is the only way into it
+	 */
+	std::vector<Fact> edgeFacts(u16 block) const;
+
+	/**
+	 * The facts that hold at the start of `block`
+	 */
+	std::vector<Fact> facts(u16 block) const;
+
+	/**
+	 * Whether `temporary` holds a non-negative integer in `block`
+	 */
+	bool nonNegative(u16 temporary, u16 block);
+
+	/**
+	 * Whether `temporary` is the length of `array`
+	 */
+	bool isLength(u16 temporary, u16 array) const;
+
+	/**
+	 * Whether the check `i` cannot fail
+	 */
+	bool redundant(u32 i);
+
+	/**
+	 * Preheader that a check of the counter in check `i` moves to, and the start and end of the range it
+	 * checks. Returns false if it cannot move.
+	 */
+	bool hoistable(u32 i, u16& preheader, u16& init, u16& end) const;
+
+public:
+	bool run(bytecode::Function& function, FunctionAnalyses& analyses) override;
+};
+
+}}
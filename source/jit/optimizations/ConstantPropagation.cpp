@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include <jit/optimizations/ConstantPropagation.hpp>
+#include <jit/optimizations/Folding.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::Opcode;
+
+namespace {
+
+constexpr u16 UNUSED = std::numeric_limits<u16>::max();
+
+RegisterPass<BytecodePass, ConstantPropagation> registration("sccp", 1, 100, DEF_USE, ALL_ANALYSES);
+
+}
+
+ConstantPropagation::Value ConstantPropagation::meet(Value lhs, Value rhs) {
+	if(lhs.state == Value::TOP) {
+		return rhs;
+	}
+
+	if(rhs.state == Value::TOP || lhs == rhs) {
+		return lhs;
+	}
+
+	return {Value::BOTTOM, 0};
+}
+
+bytecode::Instruction const& ConstantPropagation::terminator(u16 block) const {
+	return function->instructions[defUse->blockStarts[block] + function->blocks[block].instructionCount - 1];
+}
+
+ConstantPropagation::Value ConstantPropagation::evaluate(bytecode::Instruction const& instruction, u16 block) const {
+	auto const& types = function->temporaryTypes;
+	Value const bottom{Value::BOTTOM, 0};
+
+	switch(instruction.opcode) {
+		case Opcode::CONST:
+			if(!isConstantType(instruction.constant.type)) {
+				return bottom;
+			}
+			return {Value::CONSTANT, truncate(instruction.constant.value, instruction.constant.type)};
+
+		BINARY_INSTRUCTIONS {
+			Value lhs = values[instruction.binary.lsrcIdx];
+			Value rhs = values[instruction.binary.rsrcIdx];
+
+			if(!isConstantType(types[instruction.binary.lsrcIdx]) || lhs.state == Value::BOTTOM || rhs.state == Value::BOTTOM) {
+				return bottom;
+			}
+
+			if(lhs.state == Value::TOP || rhs.state == Value::TOP) {
+				return {Value::TOP, 0};
+			}
+
+			if(auto result = fold(instruction.opcode, lhs.constant, rhs.constant)) {
+				return {Value::CONSTANT, truncate(result.value(), types[instruction.binary.dstIdx])};
+			}
+
+			return bottom;
+		}
+
+		case Opcode::NEG:
+		case Opcode::NOT: {
+			Value src = values[instruction.unary.srcIdx];
+			bytecode::Type type = types[instruction.unary.srcIdx];
+
+			if(!isConstantType(type) || (instruction.opcode == Opcode::NOT && type.baseType != (u8) bytecode::BaseType::BOOL)) {
+				return bottom;
+			}
+
+			if(src.state != Value::CONSTANT) {
+				return src;
+			}
+
+			i64 result = instruction.opcode == Opcode::NEG ? (i64) (0 - (u64) src.constant) : !src.constant;
+			return {Value::CONSTANT, truncate(result, types[instruction.unary.dstIdx])};
+		}
+
+		case Opcode::PHI: {
+			Value result{Value::TOP, 0};
+
+			for(u16 edge = 0; edge != instruction.phi.edges.count; ++edge) {
+				auto e = instruction.phi.edge(function->operands, edge);
+				if(executableEdges.count({e.block, block})) {
+					result = meet(result, values[e.temp]);
+				}
+			}
+
+			return result;
+		}
+
+		default:
+			return bottom;
+	}
+}
+
+std::vector<u16> ConstantPropagation::takenSuccessors(u16 block) const {
+	auto const& blocks = function->blocks;
+	auto const& last = terminator(block);
+
+	if(last.opcode == Opcode::IF_GOTO) {
+		Value condition = values[last.jump.conditionIdx];
+
+		if(condition.state == Value::TOP) {
+			return {};
+		}
+
+		if(condition.state == Value::CONSTANT) {
+			u16 target = condition.constant ? last.jump.branchIdx : (u16) (block + 1);
+			if(target >= blocks.size()) {
+				throw std::runtime_error("branch of block " + std::to_string(block) + " leaves " + function->name);
+			}
+			return {target};
+		}
+	}
+
+	std::vector<u16> successors;
+	for(u16 successor : blocks[block].successors) {
+		if(successor < blocks.size()) {
+			successors.push_back(successor);
+		}
+	}
+	return successors;
+}
+
+void ConstantPropagation::propagate() {
+	auto const& blocks = function->blocks;
+
+	values.assign(function->temporyCount, {Value::TOP, 0});
+	for(u16 parameter = 0; parameter != function->parameters.size(); ++parameter) {
+		values[parameter] = {Value::BOTTOM, 0};
+	}
+
+	executable.assign(blocks.size(), false);
+	executable[0] = true;
+
+	std::vector<bool> queued(blocks.size(), false);
+	std::vector<u16> work;
+
+	auto visit = [&](u16 block) {
+		if(!queued[block]) {
+			queued[block] = true;
+			work.push_back(block);
+		}
+	};
+
+	visit(0);
+
+	while(!work.empty()) {
+		u16 block = work.back();
+		work.pop_back();
+		queued[block] = false;
+
+		u32 start = defUse->blockStarts[block];
+		for(u32 i = start; i != start + blocks[block].instructionCount; ++i) {
+			auto const& instruction = function->instructions[i];
+			auto dst = instruction.dstIdx();
+			if(!dst) {
+				continue;
+			}
+
+			// TOP -> CONSTANT -> BOTTOM, so every temporary changes at most twice
+			Value value = meet(values.at(dst.value()), evaluate(instruction, block));
+			if(value == values[dst.value()]) {
+				continue;
+			}
+
+			values[dst.value()] = value;
+			for(u32 use : defUse->uses[dst.value()]) {
+				if(executable[defUse->blockOf[use]]) {
+					visit(defUse->blockOf[use]);
+				}
+			}
+		}
+
+		for(u16 successor : takenSuccessors(block)) {
+			if(executableEdges.emplace(block, successor).second) {
+				executable[successor] = true;
+				visit(successor);
+			}
+		}
+	}
+}
+
+bytecode::Function ConstantPropagation::rewrite() const {
+	auto const& blocks = function->blocks;
+
+	std::vector<u16> renumbered(blocks.size(), UNUSED);
+	u16 blockCount = 0;
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		if(executable[block]) {
+			renumbered[block] = blockCount++;
+		}
+	}
+
+	bytecode::Function f;
+	f.name = function->name;
+	f.parameters = function->parameters;
+	f.returnType = function->returnType;
+	f.variables = function->variables;
+	f.temporyCount = function->temporyCount;
+	f.temporaryTypes = function->temporaryTypes;
+	f.operands = function->operands;
+
+	auto constant = [&](u16 dst) {
+		bytecode::Instruction instruction(Opcode::CONST);
+		instruction.constant.dstIdx = dst;
+		instruction.constant.type = f.temporaryTypes[dst];
+		instruction.constant.value = encode(values[dst].constant, instruction.constant.type);
+		return instruction;
+	};
+
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		if(!executable[block]) {
+			continue;
+		}
+
+		u32 first = f.instructions.size();
+
+		// phis with a constant value become CONSTs behind the remaining phis
+		std::vector<bytecode::Instruction> constants;
+
+		u32 start = defUse->blockStarts[block];
+		for(u32 i = start; i != start + blocks[block].instructionCount; ++i) {
+			bytecode::Instruction instruction = function->instructions[i];
+			auto dst = instruction.dstIdx();
+
+			if(instruction.opcode == Opcode::PHI) {
+				if(values[dst.value()].state == Value::CONSTANT) {
+					constants.push_back(constant(dst.value()));
+					continue;
+				}
+
+				bytecode::OperandList edges{(u32) f.operands.size(), 0};
+				for(u16 edge = 0; edge != instruction.phi.edges.count; ++edge) {
+					auto e = instruction.phi.edge(function->operands, edge);
+					if(executableEdges.count({e.block, block})) {
+						f.operands.push_back(e.temp);
+						f.operands.push_back(renumbered[e.block]);
+						edges.count++;
+					}
+				}
+
+				instruction.phi.edges = edges;
+				f.instructions.push_back(instruction);
+				continue;
+			}
+
+			f.instructions.insert(f.instructions.end(), constants.begin(), constants.end());
+			constants.clear();
+
+			if(dst && instruction.opcode != Opcode::CONST && values[dst.value()].state == Value::CONSTANT) {
+				f.instructions.push_back(constant(dst.value()));
+				continue;
+			}
+
+			if(instruction.opcode == Opcode::IF_GOTO && values[instruction.jump.conditionIdx].state == Value::CONSTANT) {
+				u16 target = values[instruction.jump.conditionIdx].constant ? instruction.jump.branchIdx : (u16) (block + 1);
+				instruction = bytecode::Instruction(Opcode::GOTO);
+				instruction.jump.branchIdx = target;
+			}
+
+			if(instruction.opcode == Opcode::GOTO || instruction.opcode == Opcode::IF_GOTO) {
+				instruction.jump.branchIdx = renumbered[instruction.jump.branchIdx];
+			}
+
+			f.instructions.push_back(instruction);
+		}
+
+		f.instructions.insert(f.instructions.end(), constants.begin(), constants.end());
+
+		bytecode::Block copied{(u16) (f.instructions.size() - first), {}, {}};
+		for(u16 successor : takenSuccessors(block)) {
+			copied.successors.push_back(renumbered[successor]);
+		}
+
+		f.blocks.push_back(copied);
+	}
+
+	for(u16 block = 0; block != f.blocks.size(); ++block) {
+		for(u16 successor : f.blocks[block].successors) {
+			f.blocks[successor].predecessors.push_back(block);
+		}
+	}
+
+	for(u32 i = 0; i != f.instructions.size(); ++i) {
+		f.instructions[i].id = i;
+	}
+
+	return f;
+}
+
+bool ConstantPropagation::run(bytecode::Function& _function, FunctionAnalyses& analyses) {
+	function = &_function;
+	defUse = &analyses.defUse();
+
+	propagate();
+
+	bool changed = std::find(executable.begin(), executable.end(), false) != executable.end();
+
+	for(u32 i = 0; i != function->instructions.size() && !changed; ++i) {
+		auto const& instruction = function->instructions[i];
+		auto dst = instruction.dstIdx();
+
+		changed = (dst && instruction.opcode != Opcode::CONST && values[dst.value()].state == Value::CONSTANT)
+		          || (instruction.opcode == Opcode::IF_GOTO && values[instruction.jump.conditionIdx].state == Value::CONSTANT);
+	}
+
+	if(changed) {
+		_function = rewrite();
+	}
+
+	return changed;
+}
+
+}}
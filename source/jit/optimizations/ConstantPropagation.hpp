@@ -0,0 +1,53 @@
+#pragma once
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Sparse conditional constant propagation: finds the temporaries with a constant value and the blocks that
+ * can be reached at all, following only the edges a branch can take.
+ *
+ * Instructions computing a constant become CONSTs, phis with a constant value go behind the remaining phis
+ * of their block. Branches on a constant become GOTOs, blocks that are never reached are dropped together
+ * with the phi edges coming from them. The remaining blocks keep their order, so fall through stays intact.
+ */
+class ConstantPropagation : public BytecodePass {
+private:
+	/**
+	 * Lattice value of a temporary: TOP until a definition has been evaluated, BOTTOM if it is not constant
+	 */
+	struct Value {
+		enum State : u8 { TOP, CONSTANT, BOTTOM } state;
+		i64 constant;
+
+		bool operator==(Value const& other) const {
+			return state == other.state && (state != CONSTANT || constant == other.constant);
+		}
+	};
+
+	bytecode::Function const* function = nullptr;
+	DefUse const* defUse = nullptr;
+
+	std::vector<Value> values;
+	std::vector<bool> executable;
+	std::set<std::pair<u16, u16>> executableEdges;
+
+	static Value meet(Value lhs, Value rhs);
+
+	bytecode::Instruction const& terminator(u16 block) const;
+	Value evaluate(bytecode::Instruction const& instruction, u16 block) const;
+	std::vector<u16> takenSuccessors(u16 block) const;
+
+	void propagate();
+	bytecode::Function rewrite() const;
+
+public:
+	bool run(bytecode::Function& function, FunctionAnalyses& analyses) override;
+};
+
+}}
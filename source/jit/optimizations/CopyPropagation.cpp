@@ -0,0 +1,76 @@
+#include <limits>
+#include <numeric>
+
+#include <jit/optimizations/CopyPropagation.hpp>
+
+namespace am2017s { namespace jit {
+
+namespace {
+
+constexpr u16 UNUSED = std::numeric_limits<u16>::max();
+
+RegisterPass<BytecodePass, CopyPropagation> registration("copy-propagation", 1, 200, 0, ALL_ANALYSES);
+
+}
+
+bool CopyPropagation::run(bytecode::Function& function, FunctionAnalyses&) {
+	// temporary whose value every temporary has, the temporary itself unless it is a copy
+	std::vector<u16> copies(function.temporyCount);
+	std::iota(copies.begin(), copies.end(), 0);
+
+	auto resolve = [&](u16 temporary) {
+		while(copies[temporary] != temporary) {
+			temporary = copies[temporary];
+		}
+		return temporary;
+	};
+
+	std::vector<bool> removed(function.instructions.size(), false);
+	bool found = false;
+
+	for(bool changed = true; changed;) {
+		changed = false;
+
+		for(u32 i = 0; i != function.instructions.size(); ++i) {
+			auto const& instruction = function.instructions[i];
+			if(instruction.opcode != bytecode::Opcode::PHI || removed[i]) {
+				continue;
+			}
+
+			u16 dst = instruction.phi.dstIdx;
+			u16 single = UNUSED;
+			bool unique = true;
+
+			for(u16 edge = 0; edge != instruction.phi.edges.count && unique; ++edge) {
+				u16 input = resolve(instruction.phi.edge(function.operands, edge).temp);
+				if(input == dst) {
+					continue;
+				}
+
+				unique = single == UNUSED || single == input;
+				single = input;
+			}
+
+			if(unique && single != UNUSED) {
+				copies[dst] = single;
+				removed[i] = true;
+				changed = found = true;
+			}
+		}
+	}
+
+	if(!found) {
+		return false;
+	}
+
+	for(auto& instruction : function.instructions) {
+		instruction.forEachInput(function.operands, [&](u16& temporary) {
+			temporary = resolve(temporary);
+		});
+	}
+
+	removeInstructions(function, removed);
+	return true;
+}
+
+}}
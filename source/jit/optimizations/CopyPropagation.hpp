@@ -0,0 +1,16 @@
+#pragma once
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Removes phis that only ever see a single value besides themselves, their uses read that value instead.
+ * Removing one phi can make others trivial, e.g. the phis of nested loops that carry a value unchanged.
+ */
+class CopyPropagation : public BytecodePass {
+public:
+	bool run(bytecode::Function& function, FunctionAnalyses& analyses) override;
+};
+
+}}
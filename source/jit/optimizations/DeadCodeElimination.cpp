@@ -0,0 +1,70 @@
+#include <jit/optimizations/DeadCodeElimination.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::Opcode;
+
+namespace {
+
+RegisterPass<BytecodePass, DeadCodeElimination> registration("dce", 1, 900, DEF_USE, ALL_ANALYSES);
+
+}
+
+bool DeadCodeElimination::removable(bytecode::Function const& function, DefUse const& defUse,
+                                    bytecode::Instruction const& instruction) {
+	if(instruction.isPure()) {
+		return true;
+	}
+
+	if(instruction.opcode == Opcode::DIV || instruction.opcode == Opcode::MOD) {
+		return isTrapFreeDivision(function, defUse, instruction);
+	}
+
+	return false;
+}
+
+bool DeadCodeElimination::run(bytecode::Function& function, FunctionAnalyses& analyses) {
+	auto const& defUse = analyses.defUse();
+
+	std::vector<bool> live(function.instructions.size(), false);
+	std::vector<u32> work;
+
+	auto mark = [&](u32 i) {
+		if(!live[i]) {
+			live[i] = true;
+			work.push_back(i);
+		}
+	};
+
+	for(u32 i = 0; i != function.instructions.size(); ++i) {
+		if(!removable(function, defUse, function.instructions[i])) {
+			mark(i);
+		}
+	}
+
+	while(!work.empty()) {
+		u32 i = work.back();
+		work.pop_back();
+
+		for(u16 input : function.instructions[i].inputOperands(function.operands)) {
+			if(defUse.definitions[input] != DefUse::UNDEFINED) {
+				mark(defUse.definitions[input]);
+			}
+		}
+	}
+
+	std::vector<bool> removed(live.size());
+	bool changed = false;
+	for(u32 i = 0; i != live.size(); ++i) {
+		removed[i] = !live[i];
+		changed |= removed[i];
+	}
+
+	if(changed) {
+		removeInstructions(function, removed);
+	}
+
+	return changed;
+}
+
+}}
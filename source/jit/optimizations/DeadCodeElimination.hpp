@@ -0,0 +1,23 @@
+#pragma once
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Removes every instruction that has no side effects and whose result no instruction with side effects
+ * depends on. Liveness is propagated from the instructions with side effects, so values that are only used
+ * by each other, like a counter around a loop that is never read, are removed as well.
+ */
+class DeadCodeElimination : public BytecodePass {
+private:
+	/**
+	 * Whether `instruction` can be removed if its result is unused
+	 */
+	static bool removable(bytecode::Function const& function, DefUse const& defUse, bytecode::Instruction const& instruction);
+
+public:
+	bool run(bytecode::Function& function, FunctionAnalyses& analyses) override;
+};
+
+}}
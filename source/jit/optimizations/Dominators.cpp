@@ -0,0 +1,106 @@
+#include <jit/optimizations/Dominators.hpp>
+
+namespace am2017s { namespace jit {
+
+Dominators::Dominators(bytecode::Function const& function)
+	: idom(function.blocks.size(), NONE), children(function.blocks.size()),
+	  enter(function.blocks.size(), 0), leave(function.blocks.size(), 0) {
+	auto const& blocks = function.blocks;
+	if(blocks.empty()) {
+		return;
+	}
+
+	// postorder of the reachable blocks
+	std::vector<u16> postorder;
+	std::vector<bool> visited(blocks.size(), false);
+	std::vector<std::pair<u16, u16>> stack{{0, 0}};
+	visited[0] = true;
+
+	while(!stack.empty()) {
+		auto& top = stack.back();
+		auto const& successors = blocks[top.first].successors;
+
+		if(top.second == successors.size()) {
+			postorder.push_back(top.first);
+			stack.pop_back();
+			continue;
+		}
+
+		u16 successor = successors[top.second++];
+		if(!visited[successor]) {
+			visited[successor] = true;
+			stack.push_back({successor, 0});
+		}
+	}
+
+	reversePostorder.assign(postorder.rbegin(), postorder.rend());
+
+	std::vector<u32> order(blocks.size(), 0);
+	for(u32 i = 0; i != postorder.size(); ++i) {
+		order[postorder[i]] = i;
+	}
+
+	auto intersect = [&](u16 a, u16 b) {
+		while(a != b) {
+			while(order[a] < order[b]) {
+				a = idom[a];
+			}
+			while(order[b] < order[a]) {
+				b = idom[b];
+			}
+		}
+		return a;
+	};
+
+	idom[0] = 0;
+	for(bool changed = true; changed;) {
+		changed = false;
+
+		for(u16 block : reversePostorder) {
+			if(block == 0) {
+				continue;
+			}
+
+			u16 dominator = NONE;
+			for(u16 predecessor : blocks[block].predecessors) {
+				if(!visited[predecessor] || idom[predecessor] == NONE) {
+					continue;
+				}
+				dominator = dominator == NONE ? predecessor : intersect(predecessor, dominator);
+			}
+
+			if(idom[block] != dominator) {
+				idom[block] = dominator;
+				changed = true;
+			}
+		}
+	}
+
+	idom[0] = NONE;
+	for(u16 block = 1; block != blocks.size(); ++block) {
+		if(idom[block] != NONE) {
+			children[idom[block]].push_back(block);
+		}
+	}
+
+	// number the tree so that dominance is an interval check
+	u32 counter = 0;
+	std::vector<std::pair<u16, u16>> walk{{0, 0}};
+	enter[0] = ++counter;
+
+	while(!walk.empty()) {
+		auto& top = walk.back();
+
+		if(top.second == children[top.first].size()) {
+			leave[top.first] = ++counter;
+			walk.pop_back();
+			continue;
+		}
+
+		u16 child = children[top.first][top.second++];
+		enter[child] = ++counter;
+		walk.push_back({child, 0});
+	}
+}
+
+}}
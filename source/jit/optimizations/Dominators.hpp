@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <bytecode.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Dominator tree of the blocks of a function, computed with the iterative algorithm of Cooper, Harvey and
+ * Kennedy. Blocks that cannot be reached from the entry are not part of the tree.
+ */
+struct Dominators {
+	static constexpr u16 NONE = 0xffff;
+
+	/**
+	 * @brief reachable blocks in reverse postorder, starting with the entry
+	 */
+	std::vector<u16> reversePostorder;
+
+	/**
+	 * @brief immediate dominator of every block, NONE for the entry and unreachable blocks
+	 */
+	std::vector<u16> idom;
+
+	/**
+	 * @brief blocks every block immediately dominates, in ascending order
+	 */
+	std::vector<std::vector<u16>> children;
+
+	explicit Dominators(bytecode::Function const& function);
+
+	bool reachable(u16 block) const {
+		return enter[block] != 0;
+	}
+
+	/**
+	 * Whether every path from the entry to `b` passes through `a`, every block dominates itself
+	 */
+	bool dominates(u16 a, u16 b) const {
+		return reachable(a) && reachable(b) && enter[a] <= enter[b] && leave[b] <= leave[a];
+	}
+
+private:
+	/**
+	 * @brief preorder and postorder numbers of every block in the tree, starting at 1
+	 */
+	std::vector<u32> enter;
+	std::vector<u32> leave;
+};
+
+}}
@@ -0,0 +1,77 @@
+#include <jit/optimizations/Folding.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::BaseType;
+using bytecode::Opcode;
+
+bool isConstantType(bytecode::Type type) {
+	return !type.isArray && type.baseType >= (u8) BaseType::BOOL && type.baseType <= (u8) BaseType::INT64;
+}
+
+i64 truncate(i64 value, bytecode::Type type) {
+	switch((BaseType) type.baseType) {
+		case BaseType::BOOL:
+			return (u8) value;
+		case BaseType::INT8:
+			return (i8) value;
+		case BaseType::CHAR:
+		case BaseType::INT16:
+			return (i16) value;
+		case BaseType::INT32:
+			return (i32) value;
+		default:
+			return value;
+	}
+}
+
+i64 encode(i64 value, bytecode::Type type) {
+	switch((BaseType) type.baseType) {
+		case BaseType::BOOL:
+		case BaseType::INT8:
+			return (u8) value;
+		case BaseType::CHAR:
+		case BaseType::INT16:
+			return (u16) value;
+		default:
+			return value;
+	}
+}
+
+bool isTrapFreeDivisor(i64 divisor) {
+	return divisor != 0 && divisor != -1;
+}
+
+Optional<i64> fold(Opcode opcode, i64 lhs, i64 rhs) {
+	// wrap around instead of overflowing
+	u64 a = lhs;
+	u64 b = rhs;
+
+	switch(opcode) {
+		case Opcode::ADD: return (i64) (a + b);
+		case Opcode::SUB: return (i64) (a - b);
+		case Opcode::MUL: return (i64) (a * b);
+
+		case Opcode::DIV:
+		case Opcode::MOD:
+			if(!isTrapFreeDivisor(rhs)) {
+				return {};
+			}
+			return opcode == Opcode::DIV ? lhs / rhs : lhs % rhs;
+
+		case Opcode::GT:  return lhs >  rhs;
+		case Opcode::GTE: return lhs >= rhs;
+		case Opcode::EQ:  return lhs == rhs;
+		case Opcode::NEQ: return lhs != rhs;
+		case Opcode::LTE: return lhs <= rhs;
+		case Opcode::LT:  return lhs <  rhs;
+
+		case Opcode::AND: return lhs & rhs;
+		case Opcode::OR:  return lhs | rhs;
+
+		default:
+			return {};
+	}
+}
+
+}}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <bytecode.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Whether values of `type` are folded at compile time. Only integers and booleans are, floating point
+ * results depend on the rounding of the target.
+ */
+bool isConstantType(bytecode::Type type);
+
+/**
+ * The value a register of `type` holds, sign extended the way the interpreter reads it
+ */
+i64 truncate(i64 value, bytecode::Type type);
+
+/**
+ * The value of a CONST of `type` as the loader produces it
+ */
+i64 encode(i64 value, bytecode::Type type);
+
+/**
+ * Whether an integer division by `divisor` cannot trap. The most negative value divided by -1 overflows
+ * and traps just like a division by zero.
+ */
+bool isTrapFreeDivisor(i64 divisor);
+
+/**
+ * Evaluates a binary instruction on truncated operands, the result still has to be truncated to the type of
+ * its destination. Empty for operations that trap or cannot be folded.
+ */
+Optional<i64> fold(bytecode::Opcode opcode, i64 lhs, i64 rhs);
+
+}}
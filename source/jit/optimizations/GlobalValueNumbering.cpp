@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <numeric>
+
+#include <jit/optimizations/GlobalValueNumbering.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::Opcode;
+
+namespace {
+
+RegisterPass<BytecodePass, GlobalValueNumbering> registration("gvn", 2, 300, DEF_USE | DOMINATORS, ALL_ANALYSES);
+
+bool commutative(Opcode opcode) {
+	switch(opcode) {
+	case Opcode::ADD:
+	case Opcode::MUL:
+	case Opcode::EQ:
+	case Opcode::NEQ:
+	case Opcode::AND:
+	case Opcode::OR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+}
+
+void GlobalValueNumbering::kill(Memory& memory, Location const& stored) const {
+	for(auto it = memory.begin(); it != memory.end();) {
+		auto const& location = it->first;
+		bool killed = location.kind == stored.kind && (
+			location.kind == Location::FIELD ? mayAlias(*program, location.id, location.field, stored.id, stored.field)
+			                                 : location.id == stored.id);
+
+		it = killed ? memory.erase(it) : std::next(it);
+	}
+}
+
+GlobalValueNumbering::Memory GlobalValueNumbering::unchanged(Memory const& memory) const {
+	Memory kept;
+	if(callsAnywhere) {
+		return kept;
+	}
+
+	for(auto const& entry : memory) {
+		auto const& location = entry.first;
+		bool stored;
+
+		switch(location.kind) {
+		case Location::FIELD:
+			stored = std::any_of(storedFields.begin(), storedFields.end(), [&](std::pair<u16, u16> const& field) {
+				return mayAlias(*program, location.id, location.field, field.first, field.second);
+			});
+			break;
+		case Location::ELEMENT:
+			stored = storedElements.count(location.id) != 0;
+			break;
+		case Location::GLOBAL:
+			stored = storedGlobals.count(location.id) != 0;
+			break;
+		}
+
+		if(!stored) {
+			kept.insert(entry);
+		}
+	}
+
+	return kept;
+}
+
+void GlobalValueNumbering::replace(u32 i, u16 dst, u16 leader) {
+	removed[i] = true;
+	replacements[dst] = leader;
+	numbers[dst] = numbers[leader];
+}
+
+void GlobalValueNumbering::number(u32 i, u16 block, Memory& memory) {
+	auto const& instruction = function->instructions[i];
+	auto const& types = function->temporaryTypes;
+
+	// pure computations are looked up by opcode and the numbers of their operands
+	auto lookup = [&](u16 dst, std::vector<u64> key) {
+		auto found = expressions.find(key);
+		if(found != expressions.end()) {
+			replace(i, dst, found->second);
+		} else {
+			expressions.emplace(key, dst);
+			scope.push_back(std::move(key));
+		}
+	};
+
+	// loads are looked up in the known memory contents, stores replace them if the types agree
+	auto load = [&](u16 dst, Location const& location) {
+		auto found = memory.find(location);
+		if(found != memory.end()) {
+			replace(i, dst, found->second);
+		} else {
+			memory[location] = dst;
+		}
+	};
+
+	auto store = [&](Location const& location, u16 value, bytecode::Type const& type) {
+		kill(memory, location);
+
+		auto const& valueType = types[value];
+		if(valueType.isArray == type.isArray && valueType.baseType == type.baseType) {
+			memory[location] = replacements[value];
+		}
+	};
+
+	switch(instruction.opcode) {
+	case Opcode::CONST: {
+		auto const& constant = instruction.constant;
+		auto key = std::make_tuple(constant.type.isArray, constant.type.baseType, constant.value);
+
+		auto found = constants.find(key);
+		if(found == constants.end()) {
+			found = constants.emplace(key, function->temporyCount + constants.size()).first;
+		}
+		numbers[constant.dstIdx] = found->second;
+		break;
+	}
+
+	case Opcode::ADD:
+	case Opcode::SUB:
+	case Opcode::MUL:
+	case Opcode::DIV:
+	case Opcode::MOD:
+	case Opcode::GT:
+	case Opcode::GTE:
+	case Opcode::EQ:
+	case Opcode::NEQ:
+	case Opcode::LTE:
+	case Opcode::LT:
+	case Opcode::AND:
+	case Opcode::OR: {
+		auto const& binary = instruction.binary;
+		u64 lhs = numbers[binary.lsrcIdx], rhs = numbers[binary.rsrcIdx];
+		if(commutative(instruction.opcode) && rhs < lhs) {
+			std::swap(lhs, rhs);
+		}
+
+		// divisions trap the same way as the dominating one
+		lookup(binary.dstIdx, {(u64) instruction.opcode, lhs, rhs});
+		break;
+	}
+
+	case Opcode::NEG:
+	case Opcode::NOT:
+		lookup(instruction.unary.dstIdx, {(u64) instruction.opcode, numbers[instruction.unary.srcIdx]});
+		break;
+
+	case Opcode::LENGTH:
+		// arrays never change their length
+		lookup(instruction.array.valueIdx, {(u64) instruction.opcode, numbers[instruction.array.memoryIdx]});
+		break;
+
+	case Opcode::PHI: {
+		std::vector<u64> key{(u64) instruction.opcode, block};
+		for(u16 idx = 0; idx != instruction.phi.edges.count; ++idx) {
+			auto edge = instruction.phi.edge(function->operands, idx);
+			key.push_back(numbers[edge.temp]);
+			key.push_back(edge.block);
+		}
+
+		lookup(instruction.phi.dstIdx, std::move(key));
+		break;
+	}
+
+	case Opcode::OBJ_LOAD: {
+		auto const& access = instruction.access;
+		load(access.valueIdx, {Location::FIELD, numbers[access.ptrIdx], 0, access.typeId, access.fieldIdx});
+		break;
+	}
+
+	case Opcode::OBJ_STORE: {
+		auto const& access = instruction.access;
+		u8 fieldType = program->types.at(access.typeId).fields.at(access.fieldIdx).typeId;
+		store({Location::FIELD, numbers[access.ptrIdx], 0, access.typeId, access.fieldIdx}, access.valueIdx,
+		      bytecode::Type(fieldType));
+		break;
+	}
+
+	case Opcode::LOAD_IDX: {
+		auto const& array = instruction.array;
+		load(array.valueIdx, {Location::ELEMENT, numbers[array.memoryIdx], numbers[array.indexIdx],
+		                      types[array.memoryIdx].baseType, 0});
+		break;
+	}
+
+	case Opcode::STORE_IDX: {
+		auto const& array = instruction.array;
+		u8 elementType = types[array.memoryIdx].baseType;
+		store({Location::ELEMENT, numbers[array.memoryIdx], numbers[array.indexIdx], elementType, 0},
+		      array.valueIdx, bytecode::Type(elementType));
+		break;
+	}
+
+	case Opcode::GLOB_LOAD:
+		load(instruction.global.value, {Location::GLOBAL, 0, 0, instruction.global.globalIdx, 0});
+		break;
+
+	case Opcode::GLOB_STORE: {
+		u16 global = instruction.global.globalIdx;
+		store({Location::GLOBAL, 0, 0, global, 0}, instruction.global.value,
+		      bytecode::Type(program->globals.at(global).typeId));
+		break;
+	}
+
+	default:
+		if(isCall(instruction.opcode)) {
+			memory.clear();
+		}
+		break;
+	}
+}
+
+void GlobalValueNumbering::visit(u16 block, Memory memory) {
+	std::size_t mark = scope.size();
+
+	u32 start = defUse->blockStarts[block];
+	for(u32 i = start; i != start + function->blocks[block].instructionCount; ++i) {
+		number(i, block, memory);
+	}
+
+	for(u16 child : dominators->children[block]) {
+		if(function->blocks[child].predecessors.size() == 1) {
+			// the only predecessor of a child is the block that dominates it
+			visit(child, memory);
+		} else {
+			visit(child, unchanged(memory));
+		}
+	}
+
+	while(scope.size() != mark) {
+		expressions.erase(scope.back());
+		scope.pop_back();
+	}
+}
+
+bool GlobalValueNumbering::run(bytecode::Function& _function, FunctionAnalyses& analyses) {
+	function = &_function;
+	program = &analyses.program;
+	dominators = &analyses.dominators();
+	defUse = &analyses.defUse();
+
+	numbers.resize(function->temporyCount);
+	std::iota(numbers.begin(), numbers.end(), 0);
+	replacements.resize(function->temporyCount);
+	std::iota(replacements.begin(), replacements.end(), 0);
+	removed.assign(function->instructions.size(), false);
+
+	for(auto const& instruction : function->instructions) {
+		switch(instruction.opcode) {
+		case Opcode::OBJ_STORE:
+			storedFields.insert({instruction.access.typeId, instruction.access.fieldIdx});
+			break;
+		case Opcode::STORE_IDX:
+			storedElements.insert(function->temporaryTypes[instruction.array.memoryIdx].baseType);
+			break;
+		case Opcode::GLOB_STORE:
+			storedGlobals.insert(instruction.global.globalIdx);
+			break;
+		default:
+			callsAnywhere |= isCall(instruction.opcode);
+			break;
+		}
+	}
+
+	if(!function->blocks.empty()) {
+		visit(0, {});
+	}
+
+	if(std::none_of(removed.begin(), removed.end(), [](bool r) { return r; })) {
+		return false;
+	}
+
+	for(auto& instruction : function->instructions) {
+		instruction.forEachInput(function->operands, [&](u16& temp) {
+			temp = replacements[temp];
+		});
+	}
+
+	removeInstructions(*function, removed);
+	return true;
+}
+
+}}
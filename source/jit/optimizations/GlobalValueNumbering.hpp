@@ -0,0 +1,96 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Dominator based global value numbering: walks the dominator tree and removes every computation that a
+ * dominating instruction already did, its uses read the result of the dominating one instead.
+ *
+ * Arithmetic, comparisons, LENGTH and phis of the same block are numbered by their opcode and the numbers of
+ * their operands, constants by their type and value. Loads of fields, array elements and globals are looked
+ * up in a table of the memory contents that are known, which stores fill in and calls clear. A store to a
+ * field removes all fields that may share its bytes, an object of another type may be the same memory with
+ * a different layout. A block with a single predecessor starts with the contents known at the end of that
+ * predecessor, other blocks only keep what no store or call in the whole function changes.
+ */
+class GlobalValueNumbering : public BytecodePass {
+private:
+	/**
+	 * Memory a load reads from
+	 */
+	struct Location {
+		enum Kind : u8 { FIELD, ELEMENT, GLOBAL } kind;
+
+		/**
+		 * @brief value numbers of the object or array and of the index
+		 */
+		u64 base;
+		u64 index;
+
+		/**
+		 * @brief struct type and field, element type or global
+		 */
+		u16 id;
+		u16 field;
+
+		bool operator<(Location const& other) const {
+			return std::tie(kind, base, index, id, field)
+			       < std::tie(other.kind, other.base, other.index, other.id, other.field);
+		}
+	};
+
+	/**
+	 * Temporaries holding the contents of memory locations
+	 */
+	using Memory = std::map<Location, u16>;
+
+	bytecode::Function* function = nullptr;
+	bytecode::Program const* program = nullptr;
+	Dominators const* dominators = nullptr;
+	DefUse const* defUse = nullptr;
+
+	/**
+	 * @brief value number of every temporary, numbers of constants come after those of the temporaries
+	 */
+	std::vector<u64> numbers;
+	std::map<std::tuple<bool, u8, i64>, u64> constants;
+
+	/**
+	 * @brief leaders of the expressions of the dominating blocks, and the expressions every block added
+	 */
+	std::map<std::vector<u64>, u16> expressions;
+	std::vector<std::vector<u64>> scope;
+	std::vector<u16> replacements;
+	std::vector<bool> removed;
+
+	/**
+	 * What any store or call of the function may change
+	 */
+	bool callsAnywhere = false;
+	std::set<std::pair<u16, u16>> storedFields;
+	std::set<u16> storedElements;
+	std::set<u16> storedGlobals;
+
+	void kill(Memory& memory, Location const& stored) const;
+	Memory unchanged(Memory const& memory) const;
+
+	/**
+	 * Removes the instruction `i` that computes `dst` again, uses of `dst` read `leader`
+	 */
+	void replace(u32 i, u16 dst, u16 leader);
+	void number(u32 i, u16 block, Memory& memory);
+	void visit(u16 block, Memory memory);
+
+public:
+	bool run(bytecode::Function& function, FunctionAnalyses& analyses) override;
+};
+
+}}
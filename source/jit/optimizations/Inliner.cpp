@@ -0,0 +1,305 @@
+#include <jit/optimizations/BoundsCheckElimination.hpp>
+#include <jit/optimizations/Inliner.hpp>
+#include <log/Logger.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::Opcode;
+
+namespace {
+
+RegisterPass<BytecodePass, Inliner> registration("inline", 2, 50, 0, ALL_ANALYSES);
+
+}
+
+char const* Inliner::reject(bytecode::Function const& function, bytecode::Instruction const& call, u32 growth) const {
+	auto const& callee = program->functions.at(call.call.functionIdx);
+
+	if(!callee.isDecoded()) {
+		return "body not decoded";
+	}
+	if(callee.name == function.name) {
+		return "recursive";
+	}
+
+	u32 size = callee.instructions.size();
+	auto const& callSites = program->callSites;
+	bool singleCall = callSites.size() > call.call.functionIdx && callSites[call.call.functionIdx] == 1;
+	if(size > (singleCall ? maxSingleCallSize : maxSize)) {
+		return "too large";
+	}
+	if(growth + size > maxGrowth) {
+		return "caller too large";
+	}
+	if((u32) function.temporyCount + callee.temporyCount >= 0xffff
+	   || function.blocks.size() + callee.blocks.size() + 1 >= 0xffff) {
+		return "too many temporaries or blocks";
+	}
+
+	// the entry block of the callee is entered from the caller only, and the callee always ends in a jump
+	if(callee.blocks.empty() || !callee.blocks[0].predecessors.empty()) {
+		return "entry block is a loop header";
+	}
+	if(!isTerminator(callee.instructions.back().opcode)) {
+		return "falls off its end";
+	}
+
+	bool returns = false;
+	for(auto const& instruction : callee.instructions) {
+		if(instruction.opcode == Opcode::LOAD || instruction.opcode == Opcode::STORE) {
+			return "uses variables";
+		}
+		returns |= instruction.opcode == Opcode::RETURN || instruction.opcode == Opcode::RET_VOID;
+	}
+	if(!returns) {
+		return "never returns";
+	}
+
+	return nullptr;
+}
+
+void Inliner::inlineCall(bytecode::Function& function, u32 call, bytecode::Function const& callee) {
+	bytecode::Instruction const instruction = function.instructions[call];
+	auto args = function.operandsOf(instruction.call.args);
+	std::vector<u16> arguments(args.begin(), args.end());
+
+	// block of the call
+	u16 block = 0;
+	u32 start = 0;
+	while(start + function.blocks[block].instructionCount <= call) {
+		start += function.blocks[block++].instructionCount;
+	}
+
+	// the call's block keeps its number, the callee follows it, the rest of the block comes after the callee
+	u16 inserted = callee.blocks.size() + 1;
+	u16 rest = block + inserted;
+	auto asTarget = [&](u16 b) -> u16 { return b <= block ? b : b + inserted; };
+	auto asSource = [&](u16 b) -> u16 { return b < block ? b : b + inserted; };
+	auto calleeBlock = [&](u16 b) -> u16 { return block + 1 + b; };
+
+	std::vector<u16> temps(callee.temporyCount);
+	for(u16 temp = 0; temp != callee.temporyCount; ++temp) {
+		if(temp < callee.parameters.size()) {
+			temps[temp] = arguments.at(temp);
+		} else {
+			temps[temp] = function.temporyCount++;
+			function.temporaryTypes.push_back(callee.temporaryTypes[temp]);
+		}
+	}
+
+	auto& operands = function.operands;
+
+	// phi edges take two operands each
+	auto copyList = [&](bytecode::OperandList& list, std::vector<u16> const& from, u32 width = 1) {
+		u32 offset = operands.size();
+		operands.insert(operands.end(), from.begin() + list.offset, from.begin() + list.offset + width * list.count);
+		list.offset = offset;
+	};
+
+	auto renumberCaller = [&](bytecode::Instruction& copy) {
+		if(copy.opcode == Opcode::GOTO || copy.opcode == Opcode::IF_GOTO) {
+			copy.jump.branchIdx = asTarget(copy.jump.branchIdx);
+		} else if(copy.opcode == Opcode::PHI) {
+			for(u16 idx = 0; idx != copy.phi.edges.count; ++idx) {
+				u16& source = operands[copy.phi.edges.offset + 2 * idx + 1];
+				source = asSource(source);
+			}
+		}
+	};
+
+	std::vector<bytecode::Block> blocks;
+	std::vector<bytecode::Instruction> instructions;
+
+	u32 at = 0;
+	for(u16 b = 0; b != function.blocks.size(); ++b) {
+		auto const& old = function.blocks[b];
+		u32 first = at;
+		u32 end = first + old.instructionCount;
+		at = end;
+
+		std::vector<u16> predecessors;
+		for(u16 predecessor : old.predecessors) {
+			predecessors.push_back(asSource(predecessor));
+		}
+		std::vector<u16> successors;
+		for(u16 successor : old.successors) {
+			successors.push_back(asTarget(successor));
+		}
+
+		if(b != block) {
+			for(u32 i = first; i != end; ++i) {
+				instructions.push_back(function.instructions[i]);
+				renumberCaller(instructions.back());
+			}
+			blocks.push_back({old.instructionCount, successors, predecessors});
+			continue;
+		}
+
+		// the part of the block in front of the call falls through to the callee
+		bytecode::Block head{0, {calleeBlock(0)}, predecessors};
+		for(u32 i = first; i != call; ++i, ++head.instructionCount) {
+			instructions.push_back(function.instructions[i]);
+			renumberCaller(instructions.back());
+		}
+		if(head.instructionCount == 0) {
+			bytecode::Instruction jump(Opcode::GOTO);
+			jump.jump.branchIdx = calleeBlock(0);
+			instructions.push_back(jump);
+			head.instructionCount++;
+		}
+		blocks.push_back(std::move(head));
+
+		std::vector<bytecode::PhiEdge> returned;
+		bytecode::Block tail{0, successors, {}};
+
+		u32 calleeAt = 0;
+		for(u16 c = 0; c != callee.blocks.size(); ++c) {
+			auto const& calleeBlockInfo = callee.blocks[c];
+			bytecode::Block copied{calleeBlockInfo.instructionCount, {}, {}};
+			for(u16 successor : calleeBlockInfo.successors) {
+				copied.successors.push_back(calleeBlock(successor));
+			}
+			for(u16 predecessor : calleeBlockInfo.predecessors) {
+				copied.predecessors.push_back(calleeBlock(predecessor));
+			}
+			if(c == 0) {
+				copied.predecessors.push_back(block);
+			}
+
+			for(u32 i = calleeAt; i != calleeAt + calleeBlockInfo.instructionCount; ++i) {
+				bytecode::Instruction copy = callee.instructions[i];
+
+				switch(copy.opcode) {
+				case Opcode::CALL:
+				case Opcode::CALL_VOID:
+				case Opcode::SPECIAL:
+				case Opcode::SPECIAL_VOID:
+					copyList(copy.call.args, callee.operands);
+					break;
+				case Opcode::MEMBER_CALL:
+				case Opcode::VOID_MEMBER_CALL:
+					copyList(copy.member_call.args, callee.operands);
+					break;
+				case Opcode::PHI:
+					copyList(copy.phi.edges, callee.operands, 2);
+					for(u16 idx = 0; idx != copy.phi.edges.count; ++idx) {
+						u16& source = operands[copy.phi.edges.offset + 2 * idx + 1];
+						source = calleeBlock(source);
+					}
+					break;
+				case Opcode::GOTO:
+				case Opcode::IF_GOTO:
+					copy.jump.branchIdx = calleeBlock(copy.jump.branchIdx);
+					break;
+				default:
+					break;
+				}
+
+				auto rename = [&](u16& temp) { temp = temps.at(temp); };
+				copy.forEachInput(operands, rename);
+				copy.forDestination(rename);
+
+				// returns jump to the rest of the caller's block
+				if(copy.opcode == Opcode::RETURN || copy.opcode == Opcode::RET_VOID) {
+					if(copy.opcode == Opcode::RETURN) {
+						returned.push_back({copy.unary.srcIdx, calleeBlock(c)});
+					}
+					tail.predecessors.push_back(calleeBlock(c));
+					copied.successors.push_back(rest);
+
+					copy = bytecode::Instruction(Opcode::GOTO);
+					copy.jump.branchIdx = rest;
+				}
+
+				instructions.push_back(copy);
+			}
+
+			calleeAt += calleeBlockInfo.instructionCount;
+			blocks.push_back(std::move(copied));
+		}
+
+		if(instruction.opcode == Opcode::CALL) {
+			bytecode::Instruction phi(Opcode::PHI);
+			phi.phi.dstIdx = instruction.call.dstIdx;
+			phi.phi.edges = {(u32) operands.size(), (u16) returned.size()};
+			for(auto const& edge : returned) {
+				operands.push_back(edge.temp);
+				operands.push_back(edge.block);
+			}
+			instructions.push_back(phi);
+			tail.instructionCount++;
+		}
+
+		for(u32 i = call + 1; i != end; ++i, ++tail.instructionCount) {
+			instructions.push_back(function.instructions[i]);
+			renumberCaller(instructions.back());
+		}
+		if(tail.instructionCount == 0) {
+			bytecode::Instruction jump(Opcode::GOTO);
+			jump.jump.branchIdx = tail.successors.at(0);
+			instructions.push_back(jump);
+			tail.instructionCount++;
+		}
+		blocks.push_back(std::move(tail));
+	}
+
+	for(u32 i = 0; i != instructions.size(); ++i) {
+		instructions[i].id = i;
+	}
+
+	function.blocks = std::move(blocks);
+	function.instructions = std::move(instructions);
+}
+
+bool Inliner::run(bytecode::Function& function, FunctionAnalyses& analyses) {
+	program = &analyses.program;
+
+	bool changed = false;
+	u32 growth = 0;
+
+	for(unsigned depth = 1; depth <= maxDepth; ++depth) {
+		std::vector<u32> calls;
+		for(u32 i = 0; i != function.instructions.size(); ++i) {
+			auto opcode = function.instructions[i].opcode;
+			if(opcode == Opcode::CALL || opcode == Opcode::CALL_VOID) {
+				calls.push_back(i);
+			}
+		}
+
+		// back to front, so inlining a call leaves the positions of the calls in front of it alone
+		bool inlined = false;
+		for(auto call = calls.rbegin(); call != calls.rend(); ++call) {
+			auto const& instruction = function.instructions[*call];
+			auto const& callee = program->functions.at(instruction.call.functionIdx);
+
+			if(char const* reason = reject(function, instruction, growth)) {
+				Logger::log(Topic::INLINE) << "not inlining " << callee.name << " into " << function.name << ": "
+				                           << reason << std::endl;
+				continue;
+			}
+
+			Logger::log(Topic::INLINE) << "inlining " << callee.name << " into " << function.name << " ("
+			                           << callee.instructions.size() << " instructions, depth " << depth << ")"
+			                           << std::endl;
+
+			growth += callee.instructions.size();
+			if(analyses.boundsChecks) {
+				bytecode::Function checked = callee;
+				insertBoundsChecks(checked);
+				inlineCall(function, *call, checked);
+			} else {
+				inlineCall(function, *call, callee);
+			}
+			inlined = true;
+		}
+
+		if(!inlined) {
+			break;
+		}
+		changed = true;
+	}
+
+	return changed;
+}
+
+}}
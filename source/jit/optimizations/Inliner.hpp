@@ -0,0 +1,54 @@
+#pragma once
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Replaces calls by the body of the function they call. The block of the call is split in two, the blocks
+ * of the callee go in between with their temporaries renamed to new ones of the caller and its parameters
+ * renamed to the arguments. Returns become jumps to the second half, which merges the returned values
+ * in a phi that takes the place of the call's result.
+ *
+ * Small functions are always inlined, functions with a single call site up to a larger size. Calls that
+ * inlining copied into the caller are inlined in turn, up to maxDepth levels. Recursive calls, callees whose
+ * body is not decoded and calls that would grow the caller past its budget stay calls. Every decision is
+ * logged under Topic::INLINE.
+ */
+class Inliner : public BytecodePass {
+public:
+	/**
+	 * @brief callees of up to this many instructions are inlined
+	 */
+	static constexpr u32 maxSize = 40;
+
+	/**
+	 * @brief callees with a single call site are inlined up to this many instructions
+	 */
+	static constexpr u32 maxSingleCallSize = 200;
+
+	/**
+	 * @brief levels of calls inlined into a function
+	 */
+	static constexpr unsigned maxDepth = 3;
+
+	/**
+	 * @brief number of instructions inlining may add to a function
+	 */
+	static constexpr u32 maxGrowth = 400;
+
+private:
+	bytecode::Program const* program = nullptr;
+
+	/**
+	 * Why the call at `call` cannot be inlined, nullptr if it can
+	 */
+	char const* reject(bytecode::Function const& function, bytecode::Instruction const& call, u32 growth) const;
+
+	static void inlineCall(bytecode::Function& function, u32 call, bytecode::Function const& callee);
+
+public:
+	bool run(bytecode::Function& function, FunctionAnalyses& analyses) override;
+};
+
+}}
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <jit/CodeBuilder.hpp>
+#include <jit/lir/LIRCompiler.hpp>
+#include <jit/optimizations/InstructionSelection.hpp>
+
+namespace am2017s { namespace jit {
+
+using lir::Operation;
+
+namespace {
+
+RegisterPass<LirPass, InstructionSelection> registration("isel", 1, 100, 0, 0);
+
+lir::Instruction immediate(Operation operation, u16 id, lir::vr reg, i32 imm) {
+	lir::Instruction folded{operation, id};
+	folded.immediate.dst = reg;
+	folded.immediate.imm = imm;
+	// like the register forms, which work on the sign extended values
+	folded.immediate.size = QWORD;
+	return folded;
+}
+
+bool reads(lir::Instruction const& instruction, lir::vr vr) {
+	std::vector<lir::vr> inputs = instruction.inputs();
+	std::vector<lir::vr> dst = instruction.dst();
+	return std::find(inputs.begin(), inputs.end(), vr) != inputs.end() ||
+	       std::find(dst.begin(), dst.end(), vr) != dst.end();
+}
+
+}
+
+bool InstructionSelection::run(LIRCompiler<AMD64>& lir) {
+	// virtual registers that are never written to besides holding a constant
+	std::set<lir::vr> fixed;
+	for(auto const& pair : lir.fixedToVR) {
+		fixed.insert(pair.second);
+	}
+	for(auto const& pair : lir.overflowArgToVR) {
+		fixed.insert(pair.second);
+	}
+
+	std::map<lir::vr, u32> definitions;
+	std::map<lir::vr, i32> constants;
+	for(auto const& block : lir.blocks) {
+		for(auto const& instruction : block.lirs) {
+			for(lir::vr dst : instruction.dst()) {
+				++definitions[dst];
+			}
+
+			if(instruction.operation == Operation::MOV && instruction.mov.isImm && !instruction.mov.isVTable &&
+			   internal::fitsInto<i32>(instruction.mov.imm)) {
+				constants[instruction.mov.dst] = (i32) instruction.mov.imm;
+			}
+		}
+	}
+
+	for(auto it = constants.begin(); it != constants.end();) {
+		if(definitions[it->first] != 1 || fixed.count(it->first) != 0 ||
+		   lir.vrTypes.at(it->first).isFloatingPoint()) {
+			it = constants.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	if(constants.empty()) {
+		return false;
+	}
+
+	auto constant = [&](lir::vr vr, i32& value) {
+		auto it = constants.find(vr);
+		if(it == constants.end()) {
+			return false;
+		}
+
+		value = it->second;
+		return true;
+	};
+
+	bool changed = false;
+	for(auto& block : lir.blocks) {
+		for(auto& instruction : block.lirs) {
+			lir::vr folded;
+			i32 value;
+
+			switch(instruction.operation) {
+			case Operation::ADD:
+			case Operation::SUB:
+			case Operation::MUL:
+				if(lir.vrTypes.at(instruction.binary.dst).isFloatingPoint() || !constant(instruction.binary.src, value)) {
+					continue;
+				}
+
+				folded = instruction.binary.src;
+				instruction = immediate(instruction.operation == Operation::ADD ? Operation::ADD_IMM :
+				                        instruction.operation == Operation::SUB ? Operation::SUB_IMM : Operation::MUL_IMM,
+				                        instruction.id, instruction.binary.dst, value);
+				break;
+
+			case Operation::CMP:
+				if(!constant(instruction.cmp.r, value)) {
+					continue;
+				}
+
+				folded = instruction.cmp.r;
+				instruction = immediate(Operation::CMP_IMM, instruction.id, instruction.cmp.l, value);
+
+				// cmp r/m, imm compares with a spilled value in place
+				lir.usages[instruction.immediate.dst][instruction.id].mustHaveReg = false;
+				break;
+
+			case Operation::MOV:
+				if(instruction.mov.isImm || lir.vrTypes.at(instruction.mov.dst).isFloatingPoint() ||
+				   !constant(instruction.mov.src, value)) {
+					continue;
+				}
+
+				folded = instruction.mov.src;
+				instruction.mov.isImm = true;
+				instruction.mov.imm = value;
+				break;
+
+			case Operation::MOV_MEM:
+				if(!instruction.memmov.toMem || instruction.memmov.isImm || !constant(instruction.memmov.a, value)) {
+					continue;
+				}
+
+				folded = instruction.memmov.a;
+				instruction.memmov.isImm = true;
+				instruction.memmov.imm = value;
+				break;
+
+			default:
+				continue;
+			}
+
+			if(!reads(instruction, folded)) {
+				lir.usages[folded].erase(instruction.id);
+			}
+			changed = true;
+		}
+	}
+
+	// constants that no instruction reads anymore are not loaded at all
+	std::set<lir::vr> read;
+	for(auto const& block : lir.blocks) {
+		for(auto const& instruction : block.lirs) {
+			std::vector<lir::vr> inputs = instruction.inputs();
+			read.insert(inputs.begin(), inputs.end());
+		}
+	}
+
+	for(auto& block : lir.blocks) {
+		auto unused = [&](lir::Instruction const& instruction) {
+			return instruction.operation == Operation::MOV && instruction.mov.isImm &&
+			       constants.count(instruction.mov.dst) != 0 && read.count(instruction.mov.dst) == 0;
+		};
+
+		// a block keeps at least one instruction, its position is where its lifetimes start and end
+		if((std::size_t) std::count_if(block.lirs.begin(), block.lirs.end(), unused) == block.lirs.size()) {
+			continue;
+		}
+
+		for(auto const& instruction : block.lirs) {
+			if(unused(instruction)) {
+				// the allocator looks up the usages of every interval, even if it has no lifespans
+				lir.usages[instruction.mov.dst].clear();
+			}
+		}
+
+		auto end = std::remove_if(block.lirs.begin(), block.lirs.end(), unused);
+		changed |= end != block.lirs.end();
+		block.lirs.erase(end, block.lirs.end());
+	}
+
+	return changed;
+}
+
+}}
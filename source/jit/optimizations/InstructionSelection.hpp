@@ -0,0 +1,17 @@
+#pragma once
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Folds constants that fit into 32 bits into the immediate forms of the instructions using them: additions,
+ * subtractions, multiplications, comparisons, moves and stores. Constants that nothing reads afterwards don't
+ * get a register anymore, and the left side of a comparison with an immediate may stay in its stack slot.
+ */
+class InstructionSelection : public LirPass {
+public:
+	bool run(LIRCompiler<AMD64>& lir) override;
+};
+
+}}
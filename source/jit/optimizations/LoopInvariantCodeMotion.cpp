@@ -0,0 +1,361 @@
+#include <algorithm>
+
+#include <jit/optimizations/LoopInvariantCodeMotion.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::Opcode;
+
+namespace {
+
+RegisterPass<BytecodePass, LoopInvariantCodeMotion> registration("licm", 2, 400, DEF_USE | LOOPS, ALL_ANALYSES);
+
+bool hasSideEffect(Opcode opcode) {
+	switch(opcode) {
+	case Opcode::STORE_IDX:
+	case Opcode::OBJ_STORE:
+	case Opcode::GLOB_STORE:
+	case Opcode::SPECIAL:
+	case Opcode::SPECIAL_VOID:
+	case Opcode::BOUNDS_CHECK:
+		return true;
+	default:
+		return isCall(opcode);
+	}
+}
+
+bool fallsThrough(bytecode::Instruction const& last) {
+	switch(last.opcode) {
+	case Opcode::GOTO:
+	case Opcode::RETURN:
+	case Opcode::RET_VOID:
+		return false;
+	default:
+		return true;
+	}
+}
+
+}
+
+bool LoopInvariantCodeMotion::hasPreheader(Loops::Loop const& loop) const {
+	auto const& instructions = function->instructions;
+	u16 header = loop.header;
+
+	// a latch right in front of the header has to jump over the preheader, which a branch cannot
+	if(header != 0 && std::count(loop.latches.begin(), loop.latches.end(), header - 1)) {
+		auto const& last = instructions[defUse->blockStarts[header] - 1];
+		if(last.opcode == Opcode::IF_GOTO) {
+			return false;
+		}
+	}
+
+	// the entry block has nothing to feed its phis
+	return header != 0 || instructions.front().opcode != Opcode::PHI;
+}
+
+LoopInvariantCodeMotion::Effects LoopInvariantCodeMotion::effects(Loops::Loop const& loop) const {
+	Effects effects;
+
+	for(u16 block : loop.blocks) {
+		u32 start = defUse->blockStarts[block];
+		for(u32 i = start; i != start + function->blocks[block].instructionCount; ++i) {
+			auto const& instruction = function->instructions[i];
+
+			if(instruction.opcode == Opcode::OBJ_STORE) {
+				effects.fields.insert({instruction.access.typeId, instruction.access.fieldIdx});
+			} else if(instruction.opcode == Opcode::GLOB_STORE) {
+				effects.globals.insert(instruction.global.globalIdx);
+			} else if(isCall(instruction.opcode)) {
+				effects.calls = true;
+			}
+		}
+	}
+
+	return effects;
+}
+
+bool LoopInvariantCodeMotion::cannotTrap(u32 i, u16 pointer, Loops::Loop const& loop) const {
+	u32 definition = defUse->definitions[pointer];
+	if(definition != DefUse::UNDEFINED) {
+		auto opcode = function->instructions[definition].opcode;
+		if(opcode == Opcode::ALLOCATE || opcode == Opcode::NEW) {
+			return true;
+		}
+	}
+
+	if(defUse->blockOf[i] != loop.header) {
+		return false;
+	}
+
+	for(u32 before = defUse->blockStarts[loop.header]; before != i; ++before) {
+		if(hasSideEffect(function->instructions[before].opcode)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool LoopInvariantCodeMotion::invariant(u32 i, u16 loop, Effects const& effects) const {
+	auto const& instruction = function->instructions[i];
+	auto const& info = loops->loops[loop];
+
+	switch(instruction.opcode) {
+	case Opcode::CONST:
+	case Opcode::ADD:
+	case Opcode::SUB:
+	case Opcode::MUL:
+	case Opcode::NEG:
+	case Opcode::GT:
+	case Opcode::GTE:
+	case Opcode::EQ:
+	case Opcode::NEQ:
+	case Opcode::LTE:
+	case Opcode::LT:
+	case Opcode::AND:
+	case Opcode::OR:
+	case Opcode::NOT:
+		break;
+
+	case Opcode::DIV:
+	case Opcode::MOD:
+		if(!isTrapFreeDivision(*function, *defUse, instruction)) {
+			return false;
+		}
+		break;
+
+	case Opcode::LENGTH:
+		if(!cannotTrap(i, instruction.array.memoryIdx, info)) {
+			return false;
+		}
+		break;
+
+	case Opcode::GLOB_LOAD:
+		if(effects.calls || effects.globals.count(instruction.global.globalIdx)) {
+			return false;
+		}
+		break;
+
+	case Opcode::OBJ_LOAD: {
+		auto const& access = instruction.access;
+		if(effects.calls || !cannotTrap(i, access.ptrIdx, info)) {
+			return false;
+		}
+
+		for(auto const& field : effects.fields) {
+			if(mayAlias(*program, access.typeId, access.fieldIdx, field.first, field.second)) {
+				return false;
+			}
+		}
+		break;
+	}
+
+	default:
+		return false;
+	}
+
+	// operands come from outside of the loop or move out of it themselves
+	for(u16 input : instruction.inputOperands(function->operands)) {
+		u32 definition = defUse->definitions[input];
+		if(definition != DefUse::UNDEFINED && targets[definition] == Loops::NONE
+		   && loops->contains(loop, defUse->blockOf[definition])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void LoopInvariantCodeMotion::rewrite() {
+	auto const& blocks = function->blocks;
+	u16 blockCount = blocks.size();
+
+	// loop whose preheader goes in front of every header, and the new number of every block
+	std::vector<u16> preheaderOf(blockCount, Loops::NONE);
+	for(u16 loop = 0; loop != hoisted.size(); ++loop) {
+		if(!hoisted[loop].empty()) {
+			preheaderOf[loops->loops[loop].header] = loop;
+		}
+	}
+
+	std::vector<u16> renumbered(blockCount);
+	for(u16 block = 0, next = 0; block != blockCount; ++block) {
+		if(preheaderOf[block] != Loops::NONE) {
+			next++;
+		}
+		renumbered[block] = next++;
+	}
+
+	// entries into a loop go to its preheader
+	auto entersFrom = [&](u16 from, u16 to) {
+		return preheaderOf[to] != Loops::NONE && !loops->contains(preheaderOf[to], from);
+	};
+	auto target = [&](u16 from, u16 to) -> u16 {
+		return entersFrom(from, to) ? renumbered[to] - 1 : renumbered[to];
+	};
+
+	std::vector<bytecode::Block> newBlocks;
+	std::vector<bytecode::Instruction> instructions;
+	auto& operands = function->operands;
+
+	auto phi = [&](u16 dst, std::vector<bytecode::PhiEdge> const& edges) {
+		bytecode::Instruction instruction(Opcode::PHI);
+		instruction.phi.dstIdx = dst;
+		instruction.phi.edges = {(u32) operands.size(), (u16) edges.size()};
+		for(auto const& edge : edges) {
+			operands.push_back(edge.temp);
+			operands.push_back(edge.block);
+		}
+		return instruction;
+	};
+
+	for(u16 block = 0; block != blockCount; ++block) {
+		u32 start = defUse->blockStarts[block];
+		u32 end = start + blocks[block].instructionCount;
+		bytecode::Block newBlock{0, {}, {}};
+
+		// values entering the header through several edges are merged in the preheader
+		std::vector<u16> entryTemps;
+
+		if(preheaderOf[block] != Loops::NONE) {
+			bytecode::Block preheader{0, {renumbered[block]}, {}};
+			for(u16 predecessor : blocks[block].predecessors) {
+				if(entersFrom(predecessor, block)) {
+					preheader.predecessors.push_back(renumbered[predecessor]);
+				}
+			}
+
+			for(u32 i = start; i != end && function->instructions[i].opcode == Opcode::PHI; ++i) {
+				auto const& instruction = function->instructions[i];
+				std::vector<bytecode::PhiEdge> entries;
+
+				for(u16 idx = 0; idx != instruction.phi.edges.count; ++idx) {
+					auto edge = instruction.phi.edge(operands, idx);
+					if(entersFrom(edge.block, block)) {
+						entries.push_back({edge.temp, renumbered[edge.block]});
+					}
+				}
+
+				if(entries.size() == 1) {
+					entryTemps.push_back(entries.front().temp);
+				} else {
+					u16 merged = function->temporyCount++;
+					function->temporaryTypes.push_back(function->temporaryTypes[instruction.phi.dstIdx]);
+					instructions.push_back(phi(merged, entries));
+					preheader.instructionCount++;
+					entryTemps.push_back(merged);
+				}
+			}
+
+			for(u32 i : hoisted[preheaderOf[block]]) {
+				instructions.push_back(function->instructions[i]);
+				preheader.instructionCount++;
+			}
+
+			newBlocks.push_back(std::move(preheader));
+			newBlock.predecessors.push_back(renumbered[block] - 1);
+		}
+
+		for(u16 predecessor : blocks[block].predecessors) {
+			if(!entersFrom(predecessor, block)) {
+				newBlock.predecessors.push_back(renumbered[predecessor]);
+			}
+		}
+		for(u16 successor : blocks[block].successors) {
+			newBlock.successors.push_back(target(block, successor));
+		}
+
+		for(u32 i = start, phis = 0; i != end; ++i) {
+			if(targets[i] != Loops::NONE) {
+				continue;
+			}
+
+			bytecode::Instruction instruction = function->instructions[i];
+
+			if(instruction.opcode == Opcode::PHI) {
+				std::vector<bytecode::PhiEdge> edges;
+				if(preheaderOf[block] != Loops::NONE) {
+					edges.push_back({entryTemps[phis++], (u16) (renumbered[block] - 1)});
+				}
+
+				for(u16 idx = 0; idx != instruction.phi.edges.count; ++idx) {
+					auto edge = instruction.phi.edge(operands, idx);
+					if(!entersFrom(edge.block, block)) {
+						edges.push_back({edge.temp, renumbered[edge.block]});
+					}
+				}
+
+				instruction = phi(instruction.phi.dstIdx, edges);
+			} else if(instruction.opcode == Opcode::GOTO || instruction.opcode == Opcode::IF_GOTO) {
+				instruction.jump.branchIdx = target(block, instruction.jump.branchIdx);
+			}
+
+			instructions.push_back(instruction);
+			newBlock.instructionCount++;
+		}
+
+		// a latch falling through to its header now has to jump over the preheader
+		u16 next = block + 1;
+		if(next != blockCount && preheaderOf[next] != Loops::NONE && !entersFrom(block, next)
+		   && std::count(blocks[block].successors.begin(), blocks[block].successors.end(), next)
+		   && (newBlock.instructionCount == 0 || fallsThrough(instructions.back()))) {
+			bytecode::Instruction jump(Opcode::GOTO);
+			jump.jump.branchIdx = renumbered[next];
+			instructions.push_back(jump);
+			newBlock.instructionCount++;
+		}
+
+		if(newBlock.instructionCount == 0) {
+			bytecode::Instruction jump(Opcode::GOTO);
+			jump.jump.branchIdx = newBlock.successors.at(0);
+			instructions.push_back(jump);
+			newBlock.instructionCount++;
+		}
+
+		newBlocks.push_back(std::move(newBlock));
+	}
+
+	for(u32 i = 0; i != instructions.size(); ++i) {
+		instructions[i].id = i;
+	}
+
+	function->blocks = std::move(newBlocks);
+	function->instructions = std::move(instructions);
+}
+
+bool LoopInvariantCodeMotion::run(bytecode::Function& _function, FunctionAnalyses& analyses) {
+	function = &_function;
+	program = &analyses.program;
+	defUse = &analyses.defUse();
+	loops = &analyses.loops();
+
+	targets.assign(function->instructions.size(), Loops::NONE);
+	hoisted.assign(loops->loops.size(), {});
+
+	bool changed = false;
+	for(u16 loop = 0; loop != loops->loops.size(); ++loop) {
+		auto const& info = loops->loops[loop];
+		if(!hasPreheader(info)) {
+			continue;
+		}
+
+		Effects loopEffects = effects(info);
+		for(u16 block : info.blocks) {
+			u32 start = defUse->blockStarts[block];
+			for(u32 i = start; i != start + function->blocks[block].instructionCount; ++i) {
+				if(targets[i] == Loops::NONE && invariant(i, loop, loopEffects)) {
+					targets[i] = loop;
+					hoisted[loop].push_back(i);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	if(changed) {
+		rewrite();
+	}
+
+	return changed;
+}
+
+}}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Loop invariant code motion: moves computations whose operands do not change inside a loop into a new
+ * preheader block in front of the loop header, which every entry into the loop passes and no back edge does.
+ * Loops are handled from the outside in, so a computation leaves as many loops as its operands allow.
+ *
+ * Arithmetic that cannot trap, global loads and field loads are moved if the loop contains no call and no
+ * store that may change the loaded value. LENGTH and field loads trap on null, they are only moved if the
+ * reference cannot be null or if the loop header executes them before anything with a side effect.
+ */
+class LoopInvariantCodeMotion : public BytecodePass {
+private:
+	/**
+	 * Memory that a loop may change
+	 */
+	struct Effects {
+		bool calls = false;
+		std::set<std::pair<u16, u16>> fields;
+		std::set<u16> globals;
+	};
+
+	bytecode::Function* function = nullptr;
+	bytecode::Program const* program = nullptr;
+	DefUse const* defUse = nullptr;
+	Loops const* loops = nullptr;
+
+	/**
+	 * @brief loop every instruction moves out of, Loops::NONE if it stays
+	 */
+	std::vector<u16> targets;
+
+	/**
+	 * @brief instructions moved out of every loop, in the order they are placed in its preheader
+	 */
+	std::vector<std::vector<u32>> hoisted;
+
+	/**
+	 * Whether a preheader can be placed right in front of the header of `loop`
+	 */
+	bool hasPreheader(Loops::Loop const& loop) const;
+
+	Effects effects(Loops::Loop const& loop) const;
+
+	/**
+	 * Whether the reference instruction `i` dereferences is non-null or checked at the start of the loop
+	 */
+	bool cannotTrap(u32 i, u16 pointer, Loops::Loop const& loop) const;
+	bool invariant(u32 i, u16 loop, Effects const& effects) const;
+
+	/**
+	 * Inserts the preheaders and moves the hoisted instructions into them
+	 */
+	void rewrite();
+
+public:
+	bool run(bytecode::Function& function, FunctionAnalyses& analyses) override;
+};
+
+}}
@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include <jit/optimizations/Loops.hpp>
+
+namespace am2017s { namespace jit {
+
+Loops::Loops(bytecode::Function const& function, Dominators const& dominators)
+	: innermost(function.blocks.size(), NONE), depth(function.blocks.size(), 0) {
+	auto const& blocks = function.blocks;
+
+	for(u16 header : dominators.reversePostorder) {
+		Loop loop{header, NONE, 0, {}, {}};
+		for(u16 predecessor : blocks[header].predecessors) {
+			if(dominators.dominates(header, predecessor)) {
+				loop.latches.push_back(predecessor);
+			}
+		}
+
+		if(loop.latches.empty()) {
+			continue;
+		}
+
+		// everything that reaches a latch without passing the header
+		std::vector<bool> member(blocks.size(), false);
+		member[header] = true;
+		std::vector<u16> work(loop.latches);
+		while(!work.empty()) {
+			u16 block = work.back();
+			work.pop_back();
+
+			if(member[block] || !dominators.reachable(block)) {
+				continue;
+			}
+			member[block] = true;
+			work.insert(work.end(), blocks[block].predecessors.begin(), blocks[block].predecessors.end());
+		}
+
+		for(u16 block : dominators.reversePostorder) {
+			if(member[block]) {
+				loop.blocks.push_back(block);
+			}
+		}
+
+		loops.push_back(std::move(loop));
+	}
+
+	// natural loops are either nested or disjoint, so enclosing loops are the larger ones
+	std::stable_sort(loops.begin(), loops.end(), [](Loop const& lhs, Loop const& rhs) {
+		return lhs.blocks.size() > rhs.blocks.size();
+	});
+
+	for(u16 idx = 0; idx != loops.size(); ++idx) {
+		auto& loop = loops[idx];
+		loop.parent = innermost[loop.header];
+		loop.depth = loop.parent == NONE ? 1 : loops[loop.parent].depth + 1;
+
+		for(u16 block : loop.blocks) {
+			innermost[block] = idx;
+			depth[block] = loop.depth;
+		}
+	}
+}
+
+bool Loops::contains(u16 loop, u16 block) const {
+	for(u16 current = innermost[block]; current != NONE; current = loops[current].parent) {
+		if(current == loop) {
+			return true;
+		}
+	}
+	return false;
+}
+
+}}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <bytecode.hpp>
+#include <jit/optimizations/Dominators.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Loop nesting forest of a function. Every edge to a block that dominates its source closes a loop, all
+ * such edges to the same header form one natural loop. Cycles without a dominating header (irreducible
+ * control flow) are not loops.
+ */
+struct Loops {
+	static constexpr u16 NONE = 0xffff;
+
+	struct Loop {
+		u16 header;
+
+		/**
+		 * @brief innermost loop containing this one, NONE for outermost loops
+		 */
+		u16 parent;
+
+		/**
+		 * @brief 1 for outermost loops
+		 */
+		u16 depth;
+
+		/**
+		 * @brief blocks of the loop and of the loops nested in it in reverse postorder, the header comes first
+		 */
+		std::vector<u16> blocks;
+
+		/**
+		 * @brief blocks of the loop that jump back to the header
+		 */
+		std::vector<u16> latches;
+	};
+
+	/**
+	 * @brief every loop comes before the loops nested in it
+	 */
+	std::vector<Loop> loops;
+
+	/**
+	 * @brief innermost loop of every block, NONE outside of loops
+	 */
+	std::vector<u16> innermost;
+
+	/**
+	 * @brief number of loops around every block
+	 */
+	std::vector<u16> depth;
+
+	Loops(bytecode::Function const& function, Dominators const& dominators);
+
+	bool contains(u16 loop, u16 block) const;
+};
+
+}}
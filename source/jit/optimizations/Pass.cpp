@@ -0,0 +1,157 @@
+#include <jit/optimizations/Folding.hpp>
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+DefUse::DefUse(bytecode::Function const& function)
+	: definitions(function.temporyCount, UNDEFINED), uses(function.temporyCount) {
+	u32 start = 0;
+	for(u16 block = 0; block != function.blocks.size(); ++block) {
+		blockStarts.push_back(start);
+		start += function.blocks[block].instructionCount;
+		blockOf.resize(start, block);
+	}
+
+	for(u32 i = 0; i != function.instructions.size(); ++i) {
+		auto const& instruction = function.instructions[i];
+
+		if(auto dst = instruction.dstIdx()) {
+			definitions.at(dst.value()) = i;
+		}
+
+		for(u16 input : instruction.inputOperands(function.operands)) {
+			uses.at(input).push_back(i);
+		}
+	}
+}
+
+DefUse const& FunctionAnalyses::defUse() {
+	if(!_defUse) {
+		_defUse = std::make_unique<DefUse>(function);
+	}
+	return *_defUse;
+}
+
+Dominators const& FunctionAnalyses::dominators() {
+	if(!_dominators) {
+		_dominators = std::make_unique<Dominators>(function);
+	}
+	return *_dominators;
+}
+
+Loops const& FunctionAnalyses::loops() {
+	if(!_loops) {
+		_loops = std::make_unique<Loops>(function, dominators());
+	}
+	return *_loops;
+}
+
+void FunctionAnalyses::compute(AnalysisSet analyses) {
+	if(analyses & DEF_USE) {
+		defUse();
+	}
+	if(analyses & DOMINATORS) {
+		dominators();
+	}
+	if(analyses & LOOPS) {
+		loops();
+	}
+}
+
+void FunctionAnalyses::invalidate(AnalysisSet analyses) {
+	if(analyses & DEF_USE) {
+		_defUse.reset();
+	}
+	if(analyses & (DOMINATORS | LOOPS)) {
+		_loops.reset();
+	}
+	if(analyses & DOMINATORS) {
+		_dominators.reset();
+	}
+}
+
+bool mayAlias(bytecode::Program const& program, u16 type, u16 field, u16 otherType, u16 otherField) {
+	if(type == otherType) {
+		return field == otherField;
+	}
+
+	auto const& lhs = program.types.at(type);
+	auto const& rhs = program.types.at(otherType);
+	u32 start = lhs.getOffset(field), end = start + lhs.getFieldSize(field);
+	u32 otherStart = rhs.getOffset(otherField), otherEnd = otherStart + rhs.getFieldSize(otherField);
+
+	return start < otherEnd && otherStart < end;
+}
+
+bool isCall(bytecode::Opcode opcode) {
+	switch(opcode) {
+	case bytecode::Opcode::CALL:
+	case bytecode::Opcode::CALL_VOID:
+	case bytecode::Opcode::MEMBER_CALL:
+	case bytecode::Opcode::VOID_MEMBER_CALL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool isTerminator(bytecode::Opcode opcode) {
+	switch(opcode) {
+	case bytecode::Opcode::GOTO:
+	case bytecode::Opcode::IF_GOTO:
+	case bytecode::Opcode::RETURN:
+	case bytecode::Opcode::RET_VOID:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool isTrapFreeDivision(bytecode::Function const& function, DefUse const& defUse,
+                        bytecode::Instruction const& instruction) {
+	if(function.temporaryTypes[instruction.binary.lsrcIdx].isFloatingPoint()) {
+		return true;
+	}
+
+	u32 definition = defUse.definitions[instruction.binary.rsrcIdx];
+	if(definition == DefUse::UNDEFINED || function.instructions[definition].opcode != bytecode::Opcode::CONST) {
+		return false;
+	}
+
+	auto const& divisor = function.instructions[definition].constant;
+	return isConstantType(divisor.type) && isTrapFreeDivisor(truncate(divisor.value, divisor.type));
+}
+
+void removeInstructions(bytecode::Function& function, std::vector<bool> const& removed) {
+	std::vector<bytecode::Instruction> instructions;
+	u32 start = 0;
+
+	for(auto& block : function.blocks) {
+		u16 kept = 0;
+
+		for(u32 i = start; i != start + block.instructionCount; ++i) {
+			if(!removed[i]) {
+				instructions.push_back(function.instructions[i]);
+				kept++;
+			}
+		}
+
+		if(kept == 0) {
+			bytecode::Instruction jump(bytecode::Opcode::GOTO);
+			jump.jump.branchIdx = block.successors.at(0);
+			instructions.push_back(jump);
+			kept++;
+		}
+
+		start += block.instructionCount;
+		block.instructionCount = kept;
+	}
+
+	for(u32 i = 0; i != instructions.size(); ++i) {
+		instructions[i].id = i;
+	}
+
+	function.instructions = std::move(instructions);
+}
+
+}}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <bytecode.hpp>
+#include <jit/optimizations/Dominators.hpp>
+#include <jit/optimizations/Loops.hpp>
+
+namespace am2017s { namespace jit {
+
+class AMD64;
+
+template <class Architecture>
+class LIRCompiler;
+
+/**
+ * Analyses of a function that passes share, see FunctionAnalyses
+ */
+enum Analysis : u8 {
+	/**
+	 * Definitions and uses of every temporary
+	 */
+	DEF_USE = 1 << 0,
+
+	/**
+	 * Dominator tree of the blocks
+	 */
+	DOMINATORS = 1 << 1,
+
+	/**
+	 * Loop nesting forest, computed from the dominators
+	 */
+	LOOPS = 1 << 2,
+
+	ALL_ANALYSES = 0xff
+};
+
+using AnalysisSet = u8;
+
+/**
+ * Where every temporary of a function is defined and used
+ */
+struct DefUse {
+	static constexpr u32 UNDEFINED = 0xffffffff;
+
+	/**
+	 * @brief index of the first instruction of every block
+	 */
+	std::vector<u32> blockStarts;
+
+	/**
+	 * @brief block of every instruction
+	 */
+	std::vector<u16> blockOf;
+
+	/**
+	 * @brief instruction defining every temporary, UNDEFINED for parameters
+	 */
+	std::vector<u32> definitions;
+
+	/**
+	 * @brief instructions reading every temporary, phis included
+	 */
+	std::vector<std::vector<u32>> uses;
+
+	explicit DefUse(bytecode::Function const& function);
+};
+
+/**
+ * Analyses of the function a pass manager works on. They are computed on first use and kept until a pass
+ * that changed the function invalidates them.
+ */
+class FunctionAnalyses {
+private:
+	bytecode::Function const& function;
+
+	std::unique_ptr<DefUse> _defUse;
+	std::unique_ptr<Dominators> _dominators;
+	std::unique_ptr<Loops> _loops;
+
+public:
+	/**
+	 * @brief the program the function belongs to, for its types, globals and callees
+	 */
+	bytecode::Program const& program;
+
+	/**
+	 * @brief whether the function has bounds checks, code copied into it needs them as well
+	 */
+	bool boundsChecks = false;
+
+	FunctionAnalyses(bytecode::Program const& _program, bytecode::Function const& _function)
+		: function(_function), program(_program) {}
+
+	DefUse const& defUse();
+	Dominators const& dominators();
+	Loops const& loops();
+
+	void compute(AnalysisSet analyses);
+	void invalidate(AnalysisSet analyses);
+};
+
+/**
+ * Whether field `field` of struct `type` may share bytes with field `otherField` of struct `otherType`. Any
+ * object may be accessed through a pointer of another type, fields of the same type only alias themselves.
+ */
+bool mayAlias(bytecode::Program const& program, u16 type, u16 field, u16 otherType, u16 otherField);
+
+/**
+ * Whether `opcode` calls a function of the program, which may read and write any memory. Builtins (SPECIAL and
+ * SPECIAL_VOID) are not calls, they do not touch the memory of the program.
+ */
+bool isCall(bytecode::Opcode opcode);
+
+/**
+ * Whether `opcode` ends a block
+ */
+bool isTerminator(bytecode::Opcode opcode);
+
+/**
+ * Whether the DIV or MOD `instruction` cannot trap. Floating point divisions never do, integer divisions only
+ * if their divisor is a CONST that isTrapFreeDivisor accepts.
+ */
+bool isTrapFreeDivision(bytecode::Function const& function, DefUse const& defUse,
+                        bytecode::Instruction const& instruction);
+
+/**
+ * Drops the instructions marked in `removed` and renumbers the rest. Blocks falling through that lose all
+ * of their instructions get a GOTO to their successor.
+ */
+void removeInstructions(bytecode::Function& function, std::vector<bool> const& removed);
+
+/**
+ * A transformation of a function in SSA form
+ */
+class BytecodePass {
+public:
+	virtual ~BytecodePass() = default;
+
+	/**
+	 * Returns whether `function` changed
+	 */
+	virtual bool run(bytecode::Function& function, FunctionAnalyses& analyses) = 0;
+};
+
+/**
+ * A transformation of the LIR of a function, after it has been lowered and before registers are allocated
+ */
+class LirPass {
+public:
+	virtual ~LirPass() = default;
+
+	/**
+	 * Returns whether the LIR changed
+	 */
+	virtual bool run(LIRCompiler<AMD64>& lir) = 0;
+};
+
+/**
+ * A pass as it is registered with the pass manager
+ */
+template <class P>
+struct PassInfo {
+	std::string name;
+
+	/**
+	 * @brief lowest optimization level (Options::optimizationLevel) that runs the pass
+	 */
+	unsigned level;
+
+	/**
+	 * @brief passes run in ascending order of their position
+	 */
+	unsigned position;
+
+	AnalysisSet required;
+	AnalysisSet invalidated;
+
+	std::function<std::unique_ptr<P>()> create;
+};
+
+/**
+ * All passes of one kind, filled by the RegisterPass objects of the passes before main runs
+ */
+template <class P>
+std::vector<PassInfo<P>>& registeredPasses() {
+	static std::vector<PassInfo<P>> passes;
+	return passes;
+}
+
+/**
+ * Registers pass `P` when the program starts, define one at namespace scope next to the pass:
+ *
+ *     static RegisterPass<BytecodePass, DeadCodeElimination> registration("dce", 1, 900, DEF_USE, DEF_USE);
+ */
+template <class Kind, class P>
+struct RegisterPass {
+	RegisterPass(std::string name, unsigned level, unsigned position, AnalysisSet required, AnalysisSet invalidated) {
+		registeredPasses<Kind>().push_back({std::move(name), level, position, required, invalidated, [] {
+			return std::unique_ptr<Kind>(new P());
+		}});
+	}
+};
+
+}}
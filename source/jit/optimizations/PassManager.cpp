@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <iomanip>
+#include <set>
+
+#include <jit/lir/LIRCompiler.hpp>
+#include <jit/optimizations/BoundsCheckElimination.hpp>
+#include <jit/optimizations/Inliner.hpp>
+#include <jit/optimizations/PassManager.hpp>
+#include <jit/optimizations/Verifier.hpp>
+#include <log/Logger.hpp>
+
+namespace am2017s { namespace jit {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * The passes of kind `P` the options turn on, in the order they run
+ */
+template <class P>
+std::vector<PassInfo<P>> select(Options const& options, std::set<std::string>& unknown) {
+	std::vector<PassInfo<P>> passes = registeredPasses<P>();
+	std::stable_sort(passes.begin(), passes.end(), [](PassInfo<P> const& a, PassInfo<P> const& b) {
+		return a.position < b.position;
+	});
+
+	std::vector<PassInfo<P>> selected;
+	for(auto const& pass : passes) {
+		bool enabled = pass.level <= options.optimizationLevel;
+
+		// later toggles win over earlier ones
+		for(auto const& toggle : options.passes) {
+			if(toggle == pass.name) {
+				enabled = true;
+			} else if(toggle == "-" + pass.name) {
+				enabled = false;
+			}
+		}
+
+		unknown.erase(pass.name);
+		if(enabled) {
+			selected.push_back(pass);
+		}
+	}
+
+	return selected;
+}
+
+}
+
+PassManager::PassManager(Options const& options) : verifyPasses(options.verifyPasses), boundsChecks(options.boundsChecks) {
+	std::set<std::string> unknown;
+	for(auto const& toggle : options.passes) {
+		unknown.insert(toggle.substr(toggle.compare(0, 1, "-") == 0));
+	}
+
+	bytecodePasses = select<BytecodePass>(options, unknown);
+	if(!boundsChecks) {
+		bytecodePasses.erase(std::remove_if(bytecodePasses.begin(), bytecodePasses.end(), [](PassInfo<BytecodePass> const& pass) {
+			return pass.name == "bce";
+		}), bytecodePasses.end());
+	}
+	lirPasses = select<LirPass>(options, unknown);
+
+	if(!unknown.empty()) {
+		throw std::runtime_error("unknown pass '" + *unknown.begin() + "'");
+	}
+}
+
+std::string PassManager::pipeline() const {
+	std::string names = boundsChecks ? "bounds-checks:" : "";
+
+	for(auto const& pass : bytecodePasses) {
+		names += pass.name + ",";
+	}
+
+	names += "lir:";
+	for(auto const& pass : lirPasses) {
+		names += pass.name + ",";
+	}
+
+	return names;
+}
+
+unsigned PassManager::inlineDepth() const {
+	bool inlines = std::any_of(bytecodePasses.begin(), bytecodePasses.end(), [](PassInfo<BytecodePass> const& pass) {
+		return pass.name == "inline";
+	});
+	return inlines ? Inliner::maxDepth : 0;
+}
+
+void PassManager::record(std::string const& pass, std::string const& function, std::chrono::nanoseconds elapsed, bool changed) {
+	Logger::log(Topic::PASSES) << pass << " on " << function << ": "
+	                           << std::chrono::duration<double, std::micro>(elapsed).count() << " us"
+	                           << (changed ? "" : ", unchanged") << std::endl;
+
+	std::lock_guard<std::mutex> lock(timesMutex);
+	auto& time = times[pass];
+	time.runs++;
+	time.total += elapsed;
+}
+
+void PassManager::run(bytecode::Program const& program, bytecode::Function& function) {
+	if(boundsChecks) {
+		insertBoundsChecks(function);
+	}
+
+	FunctionAnalyses analyses(program, function);
+	analyses.boundsChecks = boundsChecks;
+
+	auto check = [&](std::string const& when) {
+		try {
+			verify(function);
+		} catch(std::exception const& e) {
+			throw std::runtime_error("verifier failed " + when + ": " + e.what());
+		}
+	};
+
+	if(verifyPasses) {
+		check("before the first pass");
+	}
+
+	for(auto const& info : bytecodePasses) {
+		auto start = Clock::now();
+
+		analyses.compute(info.required);
+		bool changed = info.create()->run(function, analyses);
+		if(changed) {
+			analyses.invalidate(info.invalidated);
+		}
+
+		record(info.name, function.name, Clock::now() - start, changed);
+
+		if(verifyPasses) {
+			check("after " + info.name);
+		}
+	}
+}
+
+void PassManager::run(LIRCompiler<AMD64>& lir, bytecode::Function const& function) {
+	auto check = [&](std::string const& when) {
+		try {
+			verify(lir);
+		} catch(std::exception const& e) {
+			throw std::runtime_error("verifier failed " + when + ": " + e.what());
+		}
+	};
+
+	if(verifyPasses) {
+		check("after lowering to LIR");
+	}
+
+	for(auto const& info : lirPasses) {
+		auto start = Clock::now();
+		bool changed = info.create()->run(lir);
+		record(info.name, function.name, Clock::now() - start, changed);
+
+		if(verifyPasses) {
+			check("after " + info.name);
+		}
+	}
+}
+
+void PassManager::printTimes(std::ostream& os) const {
+	std::lock_guard<std::mutex> lock(timesMutex);
+
+	for(auto const& time : times) {
+		os << std::left << std::setw(20) << time.first << std::right << std::setw(8) << time.second.runs << " runs "
+		   << std::fixed << std::setprecision(3) << std::setw(10)
+		   << std::chrono::duration<double, std::milli>(time.second.total).count() << " ms\n";
+	}
+}
+
+}}
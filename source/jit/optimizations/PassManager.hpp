@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <Options.hpp>
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Runs the passes the options select over a function: the bytecode passes over its SSA form, the LIR passes
+ * once it has been lowered.
+ *
+ * Options::optimizationLevel selects the passes registered for that level and below, Options::passes turns
+ * single passes on ("name") or off ("-name") on top of that. Analyses a pass requires are computed before
+ * it runs, those it invalidates are dropped if it changed the function. Every run of a pass is timed and
+ * logged under Topic::PASSES. With Options::verifyPasses the IR is verified before the first and after
+ * every pass.
+ *
+ * With Options::boundsChecks every array access gets a bounds check before the first pass, and the checks
+ * that cannot fail are removed by the "bce" pass, which does not run otherwise.
+ *
+ * Compiler threads share the pass manager, every run creates its own pass objects.
+ */
+class PassManager {
+private:
+	struct Time {
+		u64 runs = 0;
+		std::chrono::nanoseconds total{0};
+	};
+
+	std::vector<PassInfo<BytecodePass>> bytecodePasses;
+	std::vector<PassInfo<LirPass>> lirPasses;
+	bool verifyPasses;
+	bool boundsChecks;
+
+	mutable std::mutex timesMutex;
+	std::map<std::string, Time> times;
+
+	void record(std::string const& pass, std::string const& function, std::chrono::nanoseconds elapsed, bool changed);
+
+public:
+	/**
+	 * Throws if Options::passes names a pass that does not exist
+	 */
+	explicit PassManager(Options const& options);
+
+	/**
+	 * The names of the passes that run, in order. Code compiled with a different pipeline differs.
+	 */
+	std::string pipeline() const;
+
+	/**
+	 * How deep calls are inlined, 0 if the inliner does not run. The code of a function depends on the
+	 * bodies of the functions it calls up to that depth.
+	 */
+	unsigned inlineDepth() const;
+
+	/**
+	 * Runs the bytecode passes over `function`, a function of `program`
+	 */
+	void run(bytecode::Program const& program, bytecode::Function& function);
+	/**
+	 * Runs the LIR passes over `lir`, the lowered `function`
+	 */
+	void run(LIRCompiler<AMD64>& lir, bytecode::Function const& function);
+
+	/**
+	 * Prints the number of runs and the total time of every pass that ran
+	 */
+	void printTimes(std::ostream& os) const;
+};
+
+}}
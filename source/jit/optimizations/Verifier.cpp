@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <string>
+
+#include <jit/lir/LIRCompiler.hpp>
+#include <jit/optimizations/Verifier.hpp>
+
+namespace am2017s { namespace jit {
+
+using bytecode::Opcode;
+
+namespace {
+
+bool contains(std::vector<u16> const& values, u16 value) {
+	return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+}
+
+void verify(bytecode::Function const& function) {
+	auto const& blocks = function.blocks;
+
+	auto fail = [&](std::string const& what) {
+		throw std::runtime_error(function.name + ": " + what);
+	};
+
+	u32 count = 0;
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		if(blocks[block].instructionCount == 0) {
+			fail("block " + std::to_string(block) + " is empty");
+		}
+		count += blocks[block].instructionCount;
+
+		for(u16 successor : blocks[block].successors) {
+			if(successor >= blocks.size() || !contains(blocks[successor].predecessors, block)) {
+				fail("edge from block " + std::to_string(block) + " to " + std::to_string(successor) + " is not a predecessor edge");
+			}
+		}
+
+		for(u16 predecessor : blocks[block].predecessors) {
+			if(predecessor >= blocks.size() || !contains(blocks[predecessor].successors, block)) {
+				fail("edge from block " + std::to_string(predecessor) + " to " + std::to_string(block) + " is not a successor edge");
+			}
+		}
+	}
+
+	if(count != function.instructions.size()) {
+		fail("blocks hold " + std::to_string(count) + " of " + std::to_string(function.instructions.size()) + " instructions");
+	}
+
+	std::vector<bool> defined(function.temporyCount, false);
+	for(u16 parameter = 0; parameter != function.parameters.size(); ++parameter) {
+		defined.at(parameter) = true;
+	}
+
+	for(auto const& instruction : function.instructions) {
+		if(auto dst = instruction.dstIdx()) {
+			if(dst.value() >= function.temporyCount || defined[dst.value()]) {
+				fail("temporary " + std::to_string(dst.value()) + " is defined twice or out of range");
+			}
+			defined[dst.value()] = true;
+		}
+	}
+
+	u32 i = 0;
+	for(u16 block = 0; block != blocks.size(); ++block) {
+		auto const& successors = blocks[block].successors;
+		bool phis = true;
+
+		for(u32 end = i + blocks[block].instructionCount; i != end; ++i) {
+			auto const& instruction = function.instructions[i];
+			std::string where = "instruction " + std::to_string(i) + " in block " + std::to_string(block);
+
+			for(u16 input : instruction.inputOperands(function.operands)) {
+				if(input >= function.temporyCount || !defined[input]) {
+					fail(where + " reads temporary " + std::to_string(input) + " which is never defined");
+				}
+			}
+
+			if(instruction.opcode == Opcode::PHI) {
+				if(!phis) {
+					fail(where + " is a phi after other instructions");
+				}
+
+				if(instruction.phi.edges.count != blocks[block].predecessors.size()) {
+					fail(where + " has " + std::to_string(instruction.phi.edges.count) + " edges for "
+					     + std::to_string(blocks[block].predecessors.size()) + " predecessors");
+				}
+
+				for(u16 edge = 0; edge != instruction.phi.edges.count; ++edge) {
+					if(!contains(blocks[block].predecessors, instruction.phi.edge(function.operands, edge).block)) {
+						fail(where + " has an edge from a block that is no predecessor");
+					}
+				}
+			} else {
+				phis = false;
+			}
+
+			bool last = i + 1 == end;
+			switch(instruction.opcode) {
+				case Opcode::IF_GOTO:
+					if(!contains(successors, block + 1)) {
+						fail(where + " falls through to a block that is no successor");
+					}
+				case Opcode::GOTO:
+					if(!contains(successors, instruction.jump.branchIdx)) {
+						fail(where + " jumps to block " + std::to_string(instruction.jump.branchIdx) + " which is no successor");
+					}
+				case Opcode::RETURN:
+				case Opcode::RET_VOID:
+					if(!last) {
+						fail(where + " ends its block early");
+					}
+					break;
+
+				default:
+					if(last && !contains(successors, block + 1)) {
+						fail(where + " falls through to a block that is no successor");
+					}
+					break;
+			}
+		}
+	}
+}
+
+void verify(LIRCompiler<AMD64>& lir) {
+	auto const& blocks = lir.blocks;
+	i32 previous = -1;
+
+	for(auto const& block : blocks) {
+		for(auto const& instruction : block.lirs) {
+			std::string where = "LIR instruction " + std::to_string(instruction.id) + " in block " + std::to_string(block.index);
+
+			if(instruction.id <= previous) {
+				throw std::runtime_error(where + " does not follow " + std::to_string(previous));
+			}
+			previous = instruction.id;
+
+			if((instruction.operation == lir::JMP || instruction.operation == lir::JNZ || instruction.operation == lir::JCC) &&
+			   instruction.jump.target >= blocks.size()) {
+				throw std::runtime_error(where + " jumps to block " + std::to_string(instruction.jump.target) + " which does not exist");
+			}
+
+			// the flags of the comparison are all a JCC reads
+			if(instruction.operation == lir::JCC && (&instruction == &block.lirs.front() ||
+			   ((&instruction - 1)->operation != lir::CMP && (&instruction - 1)->operation != lir::CMP_IMM))) {
+				throw std::runtime_error(where + " does not follow a comparison");
+			}
+
+			if(instruction.operation == lir::PHI) {
+				for(auto const& edge : instruction.phi.edges) {
+					if(edge.block >= blocks.size()) {
+						throw std::runtime_error(where + " has an edge from block " + std::to_string(edge.block) + " which does not exist");
+					}
+				}
+			}
+
+			std::vector<lir::vr> registers = instruction.inputs();
+			for(lir::vr vr : instruction.dst()) {
+				registers.push_back(vr);
+			}
+
+			for(lir::vr vr : registers) {
+				if(!lir.vrTypes.count(vr)) {
+					throw std::runtime_error(where + " uses virtual register " + std::to_string(vr) + " which has no type");
+				}
+			}
+		}
+	}
+}
+
+}}
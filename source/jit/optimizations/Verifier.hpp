@@ -0,0 +1,21 @@
+#pragma once
+
+#include <jit/optimizations/Pass.hpp>
+
+namespace am2017s { namespace jit {
+
+/**
+ * Checks the invariants of a function in SSA form the passes and the LIR compiler rely on: blocks with
+ * instructions and consistent edges, jumps to successors, phis at the start of their block with one edge per
+ * predecessor, and every temporary defined once and before it is read. Throws a std::runtime_error
+ * describing the first violation.
+ */
+void verify(bytecode::Function const& function);
+
+/**
+ * Checks that the LIR of a function has ascending instruction ids, jumps to existing blocks and a type for
+ * every virtual register. Throws a std::runtime_error describing the first violation.
+ */
+void verify(LIRCompiler<AMD64>& lir);
+
+}}
@@ -1,6 +1,5 @@
-#include "Logger.hpp"
 
-#include <set>
+#include "Logger.hpp"
 
 namespace am2017s {
 
@@ -10,13 +9,27 @@ std::ostream* Logger::cerr = &std::cerr;
 NullBuffer nullBuffer;
 std::ostream Logger::nullstream(&nullBuffer);
 
-std::set<Topic> Logger::topics{};
+TopicSet Logger::topics{};
+
+std::mutex LineBuffer::mutex;
+
+int LineBuffer::sync() {
+	std::lock_guard<std::mutex> lock(mutex);
+	*Logger::cout << str();
+	Logger::cout->flush();
+	str("");
+	return 0;
+}
 
 std::ostream& Logger::log(Topic l) {
 	if(topics.count(l)) {
-		return *cout;
+		thread_local LineBuffer buffer;
+		thread_local std::ostream stream(&buffer);
+		return stream;
 	} else {
-		return nullstream;
+		thread_local NullBuffer buffer;
+		thread_local std::ostream stream(&buffer);
+		return stream;
 	}
 }
 
@@ -24,4 +37,4 @@ std::ostream& Logger::err() {
 	return *cerr;
 }
 
-}
\ No newline at end of file
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
-#include <set>
+#include <mutex>
+#include <sstream>
 
 namespace am2017s {
 
@@ -70,6 +72,48 @@ enum Topic {
 	 * Output of the target programm
 	 */
 	RESULT,
+
+	/**
+	 * Frame sizes of the interpreter
+	 */
+	FRAMES,
+
+	/**
+	 * Optimization passes run by the JIT and their wall time
+	 */
+	PASSES,
+
+	/**
+	 * Calls the JIT inlines and why it leaves the others
+	 */
+	INLINE,
+};
+
+/**
+ * The enabled topics, one bit each. Read by the compiler threads without locking.
+ */
+class TopicSet {
+	std::atomic<unsigned> bits{0};
+
+public:
+	void insert(Topic topic) {
+		bits.fetch_or(1u << topic, std::memory_order_relaxed);
+	}
+
+	std::size_t count(Topic topic) const {
+		return bits.load(std::memory_order_relaxed) >> topic & 1;
+	}
+};
+
+/**
+ * Collects the output of one thread until it is flushed (std::endl), then writes it to Logger::cout at once,
+ * so the lines of compiler threads logging at the same time do not interleave
+ */
+class LineBuffer : public std::stringbuf {
+public:
+	static std::mutex mutex;
+
+	int sync() override;
 };
 
 class Logger {
@@ -78,7 +122,7 @@ public:
 	static std::ostream *cerr;
 	static std::ostream nullstream;
 
-	static std::set<Topic> topics;
+	static TopicSet topics;
 
 	static std::ostream& log(Topic l);
 	static std::ostream& err();
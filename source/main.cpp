@@ -3,10 +3,14 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 #include <bytecode.hpp>
+#include <MappedFile.hpp>
 #include <Options.hpp>
+#include <TieredEngine.hpp>
+#include <jit/AotCompiler.hpp>
 #include <jit/CodeBuilder.hpp>
 #include <jit/FunctionManager.hpp>
 #include <jit/JitEngine.hpp>
@@ -18,7 +22,13 @@ using namespace jit;
 
 void usage(std::string const& command)
 {
-	std::cout << "Usage: " << command << " (jit | version) [-d] [--log (logfile | -)] file\n";
+	std::cout << "Usage: " << command << " (jit | interpreter | tiered | version) [-d] [--no-quicken] [--no-superinstructions]\n"
+	          << "       " << std::string(command.size(), ' ') << " [--no-compact-frames] [--stack-size bytes] [--tier-threshold count] [--bounds-check]\n"
+	          << "       " << std::string(command.size(), ' ') << " [--eager] [-jthreads] [--code-cache directory] [-Olevel] [--pass=[-]name,...]\n"
+	          << "       " << std::string(command.size(), ' ') << " [--verify] [--time-passes] [--log (logfile | -)] file\n";
+	std::cout << "       " << command << " aot [-d] [-jthreads] [-Olevel] [--pass=[-]name,...] [--bounds-check] [--runtime library] input -o output\n";
+	std::cout << "       " << command << " pack input output\n";
+	std::cout << "       " << command << " profile file...\n";
 }
 
 bytecode::Program parseFile(std::vector<std::string> const& args, std::string const& file)
@@ -51,6 +61,9 @@ void configureLogger(std::vector<std::string> const& args) {
 	auto address = std::find(args.begin(), args.end(), "--log-address") != args.end();
 	auto compile = std::find(args.begin(), args.end(), "--log-compile") != args.end();
 	auto result  = std::find(args.begin(), args.end(), "--log-result") != args.end();
+	auto frames  = std::find(args.begin(), args.end(), "--log-frames") != args.end();
+	auto passes  = std::find(args.begin(), args.end(), "--log-passes") != args.end();
+	auto inlining = std::find(args.begin(), args.end(), "--log-inline") != args.end();
 
 	if(all || lir) {
 		Logger::topics.insert(Topic::LIR_INSTRUCTIONS);
@@ -99,6 +112,62 @@ void configureLogger(std::vector<std::string> const& args) {
 	if(all || result) {
 		Logger::topics.insert(Topic::RESULT);
 	}
+
+	if(all || frames) {
+		Logger::topics.insert(Topic::FRAMES);
+	}
+
+	if(all || passes) {
+		Logger::topics.insert(Topic::PASSES);
+	}
+
+	if(all || inlining) {
+		Logger::topics.insert(Topic::INLINE);
+	}
+}
+
+/**
+ * Prints the most frequent sequences of quickened interpreter handlers, the candidates for SUPERINSTRUCTIONS
+ */
+void profileSequences(std::vector<std::string> const& files)
+{
+	interpreter::SequenceProfile profile;
+
+	for(auto& file : files)
+	{
+		auto program = bytecode::loadBytecode(file);
+
+		for(u16 i = 0; i != program.functions.size(); ++i)
+		{
+			auto decoded = interpreter::Decoder(program, program.function(i)).run();
+			interpreter::quicken(decoded);
+			profile.add(decoded);
+		}
+	}
+
+	for(std::size_t length = 2; length <= 3; ++length)
+	{
+		std::cout << (length == 2 ? "pairs" : "triples") << ":\n";
+
+		for(auto& entry : profile.mostFrequent(length, 20))
+		{
+			auto& sequence = entry.first;
+
+			// a triple is covered when its tail is fused and the head fuses with that
+			auto superinstruction = sequence.back();
+			for(std::size_t i = sequence.size() - 1; i-- != 0 && superinstruction != interpreter::Handler::COUNT;)
+				superinstruction = interpreter::fused(sequence[i], superinstruction);
+
+			std::cout << "  " << entry.second;
+			for(auto handler : sequence)
+				std::cout << " " << interpreter::nameOf(handler);
+
+			if(superinstruction != interpreter::Handler::COUNT)
+				std::cout << " (" << interpreter::nameOf(superinstruction) << ")";
+
+			std::cout << "\n";
+		}
+	}
 }
 
 int main(int argc, char** argv)
@@ -117,6 +186,13 @@ int main(int argc, char** argv)
 
 	auto& mode = args[1];
 	auto debug = std::find(args.begin(), args.end(), "-d") != args.end();
+	auto noQuicken = std::find(args.begin(), args.end(), "--no-quicken") != args.end();
+	auto noSuperinstructions = std::find(args.begin(), args.end(), "--no-superinstructions") != args.end();
+	auto noCompactFrames = std::find(args.begin(), args.end(), "--no-compact-frames") != args.end();
+	auto eager = std::find(args.begin(), args.end(), "--eager") != args.end();
+	auto verifyPasses = std::find(args.begin(), args.end(), "--verify") != args.end();
+	auto timePasses = std::find(args.begin(), args.end(), "--time-passes") != args.end();
+	auto boundsChecks = std::find(args.begin(), args.end(), "--bounds-check") != args.end();
 
 	auto log = std::find(args.begin(), args.end(), "--log");
 	if(log != args.end()) {
@@ -141,9 +217,77 @@ int main(int argc, char** argv)
 
 	Options options;
 	options.debug = debug;
+	options.quicken = !noQuicken;
+	options.superinstructions = !noSuperinstructions;
+	options.compactFrames = !noCompactFrames;
+	options.eager = eager;
+	options.verifyPasses = verifyPasses;
+	options.timePasses = timePasses;
+	options.boundsChecks = boundsChecks;
+
+	auto stackSize = std::find(args.begin(), args.end(), "--stack-size");
+	if(stackSize != args.end()) {
+		if(stackSize + 1 == args.end()) {
+			usage(args[0]);
+			return 2;
+		}
+
+		try {
+			options.stackSize = std::stoull(*(stackSize + 1));
+		} catch(std::exception const&) {
+			usage(args[0]);
+			return 2;
+		}
+	}
+
+	auto tierThreshold = std::find(args.begin(), args.end(), "--tier-threshold");
+	if(tierThreshold != args.end()) {
+		if(tierThreshold + 1 == args.end()) {
+			usage(args[0]);
+			return 2;
+		}
+
+		try {
+			options.tierThreshold = std::stoul(*(tierThreshold + 1));
+		} catch(std::exception const&) {
+			usage(args[0]);
+			return 2;
+		}
+	}
+
+	auto codeCache = std::find(args.begin(), args.end(), "--code-cache");
+	if(codeCache != args.end()) {
+		if(codeCache + 1 == args.end()) {
+			usage(args[0]);
+			return 2;
+		}
+
+		options.codeCache = *(codeCache + 1);
+	}
+
+	auto threads = std::find_if(args.begin() + 2, args.end(), [](std::string const& arg) { return startsWith(arg, "-j"); });
+	if(threads != args.end()) {
+		try {
+			options.compileThreads = std::stoul(threads->substr(2));
+		} catch(std::exception const&) {
+			usage(args[0]);
+			return 2;
+		}
+	}
+
+	for(auto const& arg : args) {
+		if(startsWith(arg, "-O") && arg.size() == 3 && arg[2] >= '0' && arg[2] <= '2') {
+			options.optimizationLevel = arg[2] - '0';
+		} else if(startsWith(arg, "--pass=")) {
+			std::stringstream list(arg.substr(7));
+			for(std::string pass; std::getline(list, pass, ',');) {
+				options.passes.push_back(pass);
+			}
+		}
+	}
 
 	// "interpreter" starts with mode => start up interpreter
-	if(startsWith("jit", mode) || startsWith("interpreter", mode))
+	if(startsWith("jit", mode) || startsWith("interpreter", mode) || startsWith("tiered", mode))
 	{
 		try
 		{
@@ -152,6 +296,8 @@ int main(int argc, char** argv)
 			std::unique_ptr<Engine> engine;
 			if(startsWith("jit", mode)) {
 				engine = std::make_unique<JitEngine>(std::move(program), options);
+			} else if(startsWith("tiered", mode)) {
+				engine = std::make_unique<TieredEngine>(std::move(program), options);
 			} else {
 				engine = std::make_unique<interpreter::InterpretEngine>(program, options);
 			}
@@ -163,6 +309,86 @@ int main(int argc, char** argv)
 			return 1;
 		}
 	}
+	else if(mode == "aot")
+	{
+		std::string input;
+		std::string output;
+		std::string runtime = VM_RUNTIME;
+
+		for(std::size_t i = 2; i != args.size(); ++i)
+		{
+			if(args[i] == "-o" && i + 1 != args.size())
+				output = args[++i];
+			else if(args[i] == "--runtime" && i + 1 != args.size())
+				runtime = args[++i];
+			else if(args[i] != "-d" && args[i] != "--bounds-check" && !startsWith(args[i], "-j") && !startsWith(args[i], "-O")
+			        && !startsWith(args[i], "--pass="))
+				input = args[i];
+		}
+
+		if(input.empty() || output.empty())
+		{
+			usage(args[0]);
+			return 2;
+		}
+
+		try
+		{
+			AotCompiler(input, options).writeExecutable(output, runtime);
+			return 0;
+		}
+		catch(std::exception const& e)
+		{
+			std::cerr << "error: " << e.what() << "\n";
+			return 1;
+		}
+	}
+	else if(mode == "pack")
+	{
+		if(args.size() != 4)
+		{
+			usage(args[0]);
+			return 2;
+		}
+
+		try
+		{
+			MappedFile input(args[2]);
+			auto packed = bytecode::packBytecode(input.data(), input.size());
+
+			std::ofstream output(args[3], std::ios::binary);
+			output.write(packed.data(), packed.size());
+
+			if(!output)
+				throw std::runtime_error("failed to write '" + args[3] + "'");
+
+			return 0;
+		}
+		catch(std::exception const& e)
+		{
+			std::cerr << "error: " << e.what() << "\n";
+			return 1;
+		}
+	}
+	else if(mode == "profile")
+	{
+		if(args.size() < 3)
+		{
+			usage(args[0]);
+			return 2;
+		}
+
+		try
+		{
+			profileSequences(std::vector<std::string>(args.begin() + 2, args.end()));
+			return 0;
+		}
+		catch(std::exception const& e)
+		{
+			std::cerr << "error: " << e.what() << "\n";
+			return 1;
+		}
+	}
 	else if(startsWith("version", mode))
 	{
 		std::cout << argv[0] << " 0.1.0\n";
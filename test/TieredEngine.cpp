@@ -0,0 +1,111 @@
+#include <catch2/catch.hpp>
+
+#include <assemble.hpp>
+#include <TieredEngine.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::interpreter;
+using namespace am2017s::tests::assemble;
+
+TEST_CASE("tiered engine compiles hot functions", "[tiered]")
+{
+	ProgramWriter writer;
+	writer.global(5);
+	sumFunction(writer);
+
+	// remember(x) = x + global
+	writer.function("remember", {int_()}, int_())
+		.block({})
+			.glob_load(0)                         // t1
+			.binary(Opcode::ADD, 0, 1)            // t2
+			.ret(2);
+
+	// outer(n) counts to n and returns remember(sum(n)) with n in the global
+	writer.function("outer", {int_()}, int_())
+		.block({1})
+			.call(0, {0})                         // t1
+			.const_(int_(), 0)                    // t2
+			.const_(int_(), 1)                    // t3
+		.block({3, 2})
+			.phi({{2, 0}, {6, 2}})                // t4
+			.binary(Opcode::GTE, 4, 0)            // t5
+			.if_goto(5, 3)
+		.block({1})
+			.binary(Opcode::ADD, 4, 3)            // t6
+			.goto_(1)
+		.block({})
+			.glob_store(0, 0)
+			.call(1, {1})                         // t7
+			.ret(7);
+
+	// the first call makes outer hot, the second one runs compiled and calls back into the interpreter
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 100)                  // t0
+			.call(2, {0})                         // t1
+			.const_(int_(), 0)                    // t2
+			.glob_store(0, 2)
+			.call(2, {0})                         // t3
+			.ret(3);
+
+	Options options;
+	options.tierThreshold = 50;
+
+	TieredEngine engine(load(writer.bytes()), options);
+	REQUIRE(engine.execute() == 5050);
+
+	auto& tiering = engine._interpreter.tiering;
+	REQUIRE(tiering[0] == Tiering::NATIVE);
+	REQUIRE(tiering[1] == Tiering::COUNTING);
+	REQUIRE(tiering[2] == Tiering::NATIVE);
+
+	SECTION("without compiling")
+	{
+		options.tierThreshold = 1000;
+		REQUIRE(TieredEngine(load(writer.bytes()), options).execute() == 5050);
+	}
+
+	SECTION("compiling in the background")
+	{
+		// the functions stay interpreted until their code is published, the result does not change
+		options.compileThreads = 2;
+		REQUIRE(TieredEngine(load(writer.bytes()), options).execute() == 5050);
+	}
+}
+
+TEST_CASE("tiered engine enters hot loops of running functions", "[tiered]")
+{
+	// main is only called once, it has to leave the interpreter in the middle of its loop
+	ProgramWriter writer;
+	writer.function("main", {}, int_())
+		.block({1})
+			.const_(int_(), 100000)               // t0
+			.const_(int_(), 0)                    // t1
+			.const_(int_(), 1)                    // t2
+		.block({3, 2})
+			.phi({{1, 0}, {7, 2}})                // t3 = i
+			.phi({{1, 0}, {6, 2}})                // t4 = sum
+			.binary(Opcode::GTE, 3, 0)            // t5
+			.if_goto(5, 3)
+		.block({1})
+			.binary(Opcode::ADD, 4, 3)            // t6
+			.binary(Opcode::ADD, 3, 2)            // t7
+			.goto_(1)
+		.block({})
+			.ret(4);
+
+	Options options;
+	options.tierThreshold = 50;
+
+	// the sum overflows, both tiers wrap around
+	TieredEngine engine(load(writer.bytes()), options);
+	REQUIRE(engine.execute() == 704982704);
+
+	REQUIRE(engine._loopEntries.size() == 1);
+	auto& entry = engine._loopEntries.begin()->second;
+	REQUIRE(entry.code.get() != nullptr);
+
+	// the limit and the step are live into the loop, the phi inputs come from its latch
+	REQUIRE(entry.arguments == std::vector<u16>{0, 2, 7, 6});
+}
@@ -0,0 +1,390 @@
+#include "assemble.hpp"
+
+#include <TieredEngine.hpp>
+
+namespace am2017s { namespace tests { namespace assemble {
+
+	Writer& Writer::byte(u8 value)
+	{
+		_bytes.push_back((char) value);
+		return *this;
+	}
+
+	Writer& Writer::word(u16 value)
+	{
+		return byte(value).byte(value >> 8);
+	}
+
+	Writer& Writer::dword(u32 value)
+	{
+		return word(value).word(value >> 16);
+	}
+
+	Writer& Writer::qword(u64 value)
+	{
+		return dword(value).dword(value >> 32);
+	}
+
+	Writer& Writer::string(std::string const& value)
+	{
+		word(value.size());
+		_bytes += value;
+		return *this;
+	}
+
+	Writer& Writer::type(Type type)
+	{
+		return byte((type.isArray << 7) | type.baseType);
+	}
+
+	Writer& Writer::indices(std::vector<u16> const& values)
+	{
+		word(values.size());
+		for(u16 value : values)
+			word(value);
+		return *this;
+	}
+
+	Writer& Writer::raw(std::string const& bytes)
+	{
+		_bytes += bytes;
+		return *this;
+	}
+
+	FunctionWriter::FunctionWriter(std::string name, std::vector<Type> parameters, Type returnType)
+		: _name(std::move(name)), _parameters(std::move(parameters)), _returnType(returnType)
+	{}
+
+	Writer& FunctionWriter::instruction(Opcode opcode)
+	{
+		_blocks.back().instructionCount++;
+		return _code.byte((u8) opcode);
+	}
+
+	FunctionWriter& FunctionWriter::block(std::vector<u16> const& successors)
+	{
+		_blocks.push_back({successors, 0});
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::const_(Type type, i64 value)
+	{
+		instruction(Opcode::CONST).type(type);
+
+		switch((bytecode::BaseType) type.baseType)
+		{
+		case bytecode::BaseType::VOID: break;
+		case bytecode::BaseType::BOOL:
+		case bytecode::BaseType::INT8: _code.byte(value); break;
+		case bytecode::BaseType::CHAR:
+		case bytecode::BaseType::INT16: _code.word(value); break;
+		case bytecode::BaseType::INT32:
+		case bytecode::BaseType::FLP32: _code.dword(value); break;
+		default: _code.qword(value); break;
+		}
+
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::binary(Opcode opcode, u16 lsrcIdx, u16 rsrcIdx)
+	{
+		instruction(opcode).word(lsrcIdx).word(rsrcIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::unary(Opcode opcode, u16 srcIdx)
+	{
+		instruction(opcode).word(srcIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::goto_(u16 blockIdx)
+	{
+		instruction(Opcode::GOTO).word(blockIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::if_goto(u16 conditionIdx, u16 blockIdx)
+	{
+		instruction(Opcode::IF_GOTO).word(conditionIdx).word(blockIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::phi(std::vector<bytecode::PhiEdge> const& edges)
+	{
+		instruction(Opcode::PHI).word(edges.size());
+		for(auto edge : edges)
+			_code.word(edge.temp).word(edge.block);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::call(u16 functionIdx, std::vector<u16> const& args)
+	{
+		instruction(Opcode::CALL).word(functionIdx).indices(args);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::call_void(u16 functionIdx, std::vector<u16> const& args)
+	{
+		instruction(Opcode::CALL_VOID).word(functionIdx).indices(args);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::special_void(u8 builtin, std::vector<u16> const& args)
+	{
+		instruction(Opcode::SPECIAL_VOID).byte(builtin).indices(args);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::member_call(u8 vTableIdx, std::vector<u16> const& args)
+	{
+		instruction(Opcode::MEMBER_CALL).byte(vTableIdx).indices(args);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::ret(u16 srcIdx)
+	{
+		return unary(Opcode::RETURN, srcIdx);
+	}
+
+	FunctionWriter& FunctionWriter::ret_void()
+	{
+		instruction(Opcode::RET_VOID);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::new_(Type elementType, u16 sizeIdx)
+	{
+		instruction(Opcode::NEW).type(elementType).word(sizeIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::length(u16 arrayIdx)
+	{
+		instruction(Opcode::LENGTH).word(arrayIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::load_idx(u16 arrayIdx, u16 indexIdx)
+	{
+		instruction(Opcode::LOAD_IDX).word(arrayIdx).word(indexIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::store_idx(u16 arrayIdx, u16 indexIdx, u16 valueIdx)
+	{
+		instruction(Opcode::STORE_IDX).word(arrayIdx).word(indexIdx).word(valueIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::allocate(u8 typeId)
+	{
+		instruction(Opcode::ALLOCATE).byte(typeId);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::obj_load(u16 ptrIdx, u8 typeId, u8 fieldIdx)
+	{
+		instruction(Opcode::OBJ_LOAD).word(ptrIdx).byte(typeId).byte(fieldIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::obj_store(u16 ptrIdx, u8 typeId, u8 fieldIdx, u16 valueIdx)
+	{
+		instruction(Opcode::OBJ_STORE).word(ptrIdx).byte(typeId).byte(fieldIdx).word(valueIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::glob_load(u16 globalIdx)
+	{
+		instruction(Opcode::GLOB_LOAD).word(globalIdx);
+		return *this;
+	}
+
+	FunctionWriter& FunctionWriter::glob_store(u16 globalIdx, u16 valueIdx)
+	{
+		instruction(Opcode::GLOB_STORE).word(globalIdx).word(valueIdx);
+		return *this;
+	}
+
+	void FunctionWriter::write(Writer& into) const
+	{
+		into.string(_name);
+
+		into.word(_parameters.size());
+		for(u16 i = 0; i != _parameters.size(); ++i)
+			into.type(_parameters[i]).string("p" + std::to_string(i));
+
+		into.type(_returnType);
+
+		into.word(_blocks.size());
+		for(auto& block : _blocks)
+			into.word(block.instructionCount).indices(block.successors);
+
+		u16 instructionCount = 0;
+		for(auto& block : _blocks)
+			instructionCount += block.instructionCount;
+
+		into.word(instructionCount).raw(_code.bytes());
+	}
+
+	ProgramWriter& ProgramWriter::global(u8 typeId)
+	{
+		_globals.push_back(typeId);
+		return *this;
+	}
+
+	ProgramWriter& ProgramWriter::structType(u8 id, std::string const& name, std::vector<u8> const& fields,
+	                                         std::vector<u16> const& vTable)
+	{
+		_types.push_back({id, name, fields, vTable});
+		return *this;
+	}
+
+	FunctionWriter& ProgramWriter::function(std::string const& name, std::vector<Type> const& parameters, Type returnType)
+	{
+		_functions.emplace_back(name, parameters, returnType);
+		return _functions.back();
+	}
+
+	std::string ProgramWriter::bytes(bool shebang) const
+	{
+		Writer out;
+
+		if(shebang)
+			out.raw("#!/usr/bin/env vm jit\n");
+
+		out.word(1706);
+
+		out.word(_globals.size());
+		for(u16 i = 0; i != _globals.size(); ++i)
+			out.byte(_globals[i]).string("g" + std::to_string(i));
+
+		out.word(_types.size());
+		for(auto& type : _types)
+		{
+			out.byte(type.id).string(type.name);
+
+			out.word(type.fields.size());
+			for(u16 i = 0; i != type.fields.size(); ++i)
+				out.byte(type.fields[i]).string("f" + std::to_string(i));
+
+			out.indices(type.vTable);
+		}
+
+		out.word(_functions.size());
+		for(auto& function : _functions)
+			function.write(out);
+
+		return out.bytes();
+	}
+
+	Type int_()
+	{
+		return {bytecode::BaseType::INT32};
+	}
+
+	Type long_()
+	{
+		return {bytecode::BaseType::INT64};
+	}
+
+	Type bool_()
+	{
+		return {bytecode::BaseType::BOOL};
+	}
+
+	Type float_()
+	{
+		return {bytecode::BaseType::FLP32};
+	}
+
+	Type double_()
+	{
+		return {bytecode::BaseType::FLP64};
+	}
+
+	Type array(Type t)
+	{
+		return {true, t.baseType};
+	}
+
+	bytecode::Program load(std::string const& bytes)
+	{
+		return bytecode::loadBytecode((u8 const*) bytes.data(), bytes.size());
+	}
+
+	void sumFunction(ProgramWriter& program, std::string const& name)
+	{
+		program.function(name, {int_()}, int_())
+			.block({1})
+				.const_(int_(), 0)                    // t1
+				.const_(int_(), 1)                    // t2
+			.block({3, 2})
+				.phi({{1, 0}, {7, 2}})                // t3 = i
+				.phi({{1, 0}, {6, 2}})                // t4 = sum
+				.binary(Opcode::GTE, 3, 0)            // t5
+				.if_goto(5, 3)
+			.block({1})
+				.binary(Opcode::ADD, 4, 3)            // t6
+				.binary(Opcode::ADD, 3, 2)            // t7
+				.goto_(1)
+			.block({})
+				.ret(4);
+	}
+
+	std::string boxedSumProgram(i64 limit)
+	{
+		ProgramWriter writer;
+		writer.structType(0, "Box", {(u8) bytecode::BaseType::INT32}, {});
+		sumFunction(writer);
+
+		writer.function("main", {}, int_())
+			.block({})
+				.allocate(0)                          // t0
+				.const_(int_(), limit)                // t1
+				.call(0, {1})                         // t2
+				.obj_store(0, 0, 0, 2)
+				.obj_load(0, 0, 0)                    // t3
+				.ret(3);
+
+		return writer.bytes();
+	}
+
+	std::vector<std::string> mismatches(ProgramWriter const& writer,
+	                                    std::function<std::vector<std::vector<i64>>(u16 index)> const& arguments,
+	                                    std::function<std::string(Call const& call)> const& mismatch)
+	{
+		// functions are compiled on request only
+		Options options;
+		options.tierThreshold = 0xffffffff;
+
+		interpreter::InterpretEngine interpreter(load(writer.bytes()), options);
+		interpreter.reset();
+		TieredEngine engine(load(writer.bytes()), options);
+
+		std::vector<std::string> result;
+		for(u16 idx = 0; idx != engine._program.functions.size(); ++idx)
+		{
+			void* code = engine.compile(idx);
+			bytecode::Function const& prototype = engine._program.functions.at(idx);
+
+			for(auto const& list : arguments(idx))
+			{
+				std::vector<interpreter::Value> values(list.size());
+				for(std::size_t i = 0; i != list.size(); ++i)
+					values[i].l = list[i];
+
+				Call call{idx, prototype.name, list, interpreter.call(idx, values.data()).l,
+				          engine.invoke(prototype, code, values.data()).l};
+
+				auto description = mismatch(call);
+				if(!description.empty() && result.size() < 20)
+					result.push_back(description);
+			}
+		}
+
+		return result;
+	}
+
+}}}
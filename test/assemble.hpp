@@ -0,0 +1,154 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <types.hpp>
+#include <bytecode.hpp>
+
+namespace am2017s { namespace tests { namespace assemble {
+
+	using bytecode::Opcode;
+	using bytecode::Type;
+
+	/**
+	 * Little-endian byte sink matching the layout `bytecode::internal::read` expects
+	 */
+	class Writer
+	{
+		std::string _bytes;
+
+	public:
+		Writer& byte(u8 value);
+		Writer& word(u16 value);
+		Writer& dword(u32 value);
+		Writer& qword(u64 value);
+		Writer& string(std::string const& value);
+		Writer& type(Type type);
+		Writer& indices(std::vector<u16> const& values);
+		Writer& raw(std::string const& bytes);
+
+		std::string const& bytes() const
+		{
+			return _bytes;
+		}
+	};
+
+	/**
+	 * Assembles a single function block by block. Every instruction is appended to the block that was
+	 * opened last.
+	 */
+	class FunctionWriter
+	{
+		struct BlockInfo
+		{
+			std::vector<u16> successors;
+			u16 instructionCount;
+		};
+
+		std::string _name;
+		std::vector<Type> _parameters;
+		Type _returnType;
+
+		std::vector<BlockInfo> _blocks;
+		Writer _code;
+
+		Writer& instruction(Opcode opcode);
+
+	public:
+		FunctionWriter(std::string name, std::vector<Type> parameters, Type returnType);
+
+		FunctionWriter& block(std::vector<u16> const& successors);
+
+		FunctionWriter& const_(Type type, i64 value);
+		FunctionWriter& binary(Opcode opcode, u16 lsrcIdx, u16 rsrcIdx);
+		FunctionWriter& unary(Opcode opcode, u16 srcIdx);
+		FunctionWriter& goto_(u16 blockIdx);
+		FunctionWriter& if_goto(u16 conditionIdx, u16 blockIdx);
+		FunctionWriter& phi(std::vector<bytecode::PhiEdge> const& edges);
+		FunctionWriter& call(u16 functionIdx, std::vector<u16> const& args);
+		FunctionWriter& call_void(u16 functionIdx, std::vector<u16> const& args);
+		FunctionWriter& special_void(u8 builtin, std::vector<u16> const& args);
+		FunctionWriter& member_call(u8 vTableIdx, std::vector<u16> const& args);
+		FunctionWriter& ret(u16 srcIdx);
+		FunctionWriter& ret_void();
+		FunctionWriter& new_(Type elementType, u16 sizeIdx);
+		FunctionWriter& length(u16 arrayIdx);
+		FunctionWriter& load_idx(u16 arrayIdx, u16 indexIdx);
+		FunctionWriter& store_idx(u16 arrayIdx, u16 indexIdx, u16 valueIdx);
+		FunctionWriter& allocate(u8 typeId);
+		FunctionWriter& obj_load(u16 ptrIdx, u8 typeId, u8 fieldIdx);
+		FunctionWriter& obj_store(u16 ptrIdx, u8 typeId, u8 fieldIdx, u16 valueIdx);
+		FunctionWriter& glob_load(u16 globalIdx);
+		FunctionWriter& glob_store(u16 globalIdx, u16 valueIdx);
+
+		void write(Writer& into) const;
+	};
+
+	class ProgramWriter
+	{
+		struct StructInfo
+		{
+			u8 id;
+			std::string name;
+			std::vector<u8> fields;
+			std::vector<u16> vTable;
+		};
+
+		std::vector<u8> _globals;
+		std::vector<StructInfo> _types;
+		std::deque<FunctionWriter> _functions;
+
+	public:
+		ProgramWriter& global(u8 typeId);
+		ProgramWriter& structType(u8 id, std::string const& name, std::vector<u8> const& fields, std::vector<u16> const& vTable);
+		FunctionWriter& function(std::string const& name, std::vector<Type> const& parameters, Type returnType);
+
+		std::string bytes(bool shebang = false) const;
+	};
+
+	Type int_();
+	Type long_();
+	Type bool_();
+	Type float_();
+	Type double_();
+	Type array(Type t);
+
+	bytecode::Program load(std::string const& bytes);
+
+	/**
+	 * Adds `name`(n) = 0 + 1 + ... + (n - 1), a counting loop with two phis in its header
+	 */
+	void sumFunction(ProgramWriter& program, std::string const& name = "sum");
+
+	/**
+	 * A program whose main stores sum(`limit`) in a new object and returns it from there. Compiled code refers
+	 * to the vTable of the object, so it needs a relocation.
+	 */
+	std::string boxedSumProgram(i64 limit);
+
+	/**
+	 * A call of function `index` with `arguments`, which returned `expected` in the interpreter and `actual` in
+	 * compiled code
+	 */
+	struct Call
+	{
+		u16 index;
+		std::string name;
+		std::vector<i64> arguments;
+		i64 expected;
+		i64 actual;
+	};
+
+	/**
+	 * Calls every function of `writer` with each argument list `arguments` returns for it, interpreted and
+	 * compiled by the tiered engine. `mismatch` describes a call whose results differ and returns an empty
+	 * string for one whose results agree. At most 20 descriptions are returned.
+	 */
+	std::vector<std::string> mismatches(ProgramWriter const& writer,
+	                                    std::function<std::vector<std::vector<i64>>(u16 index)> const& arguments,
+	                                    std::function<std::string(Call const& call)> const& mismatch);
+
+}}}
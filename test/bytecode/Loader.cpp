@@ -0,0 +1,262 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <catch2/catch.hpp>
+
+#include <assemble.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::tests::assemble;
+
+static
+void requireSamePrograms(Program const& a, Program const& b)
+{
+	REQUIRE(a.globals.size() == b.globals.size());
+	REQUIRE(a.types.size() == b.types.size());
+	REQUIRE(a.functions.size() == b.functions.size());
+
+	for(std::size_t i = 0; i != a.functions.size(); ++i)
+	{
+		auto& fa = a.functions[i];
+		auto& fb = b.functions[i];
+
+		REQUIRE(fa.name == fb.name);
+		REQUIRE(fa.parameters.size() == fb.parameters.size());
+		REQUIRE(fa.blocks.size() == fb.blocks.size());
+		REQUIRE(fa.instructions.size() == fb.instructions.size());
+		REQUIRE(fa.temporyCount == fb.temporyCount);
+
+		for(std::size_t j = 0; j != fa.blocks.size(); ++j)
+		{
+			REQUIRE(fa.blocks[j].instructionCount == fb.blocks[j].instructionCount);
+			REQUIRE(fa.blocks[j].successors == fb.blocks[j].successors);
+		}
+
+		for(std::size_t j = 0; j != fa.instructions.size(); ++j)
+			REQUIRE(fa.instructions[j].opcode == fb.instructions[j].opcode);
+	}
+}
+
+TEST_CASE("mapped and streamed bytecode decode identically", "[bytecode][loader]")
+{
+	ProgramWriter writer;
+	writer.global(5).global(6);
+	writer.structType(9, "Point", {5, 5}, {});
+	sumFunction(writer, "main");
+	sumFunction(writer, "other");
+
+	auto bytes = writer.bytes();
+
+	std::istringstream stream(bytes);
+	auto streamed = loadBytecode(stream);
+	auto mapped = load(bytes);
+
+	REQUIRE(mapped.functions.size() == 2);
+	REQUIRE(mapped.globals.size() == 2);
+	REQUIRE(mapped.types.count(9) == 1);
+	requireSamePrograms(mapped, streamed);
+}
+
+TEST_CASE("bytecode loader skips the shebang line", "[bytecode][loader]")
+{
+	ProgramWriter writer;
+	sumFunction(writer, "main");
+
+	auto bytes = writer.bytes(true);
+
+	std::istringstream stream(bytes);
+	REQUIRE(loadBytecode(stream).functions.size() == 1);
+	REQUIRE(load(bytes).functions.size() == 1);
+}
+
+TEST_CASE("bytecode loader rejects malformed input", "[bytecode][loader]")
+{
+	ProgramWriter writer;
+	sumFunction(writer, "main");
+
+	auto bytes = writer.bytes();
+
+	SECTION("truncated")
+	{
+		REQUIRE_THROWS_AS(load(bytes.substr(0, bytes.size() - 3)), BytecodeLoaderException);
+	}
+
+	SECTION("trailing bytes")
+	{
+		REQUIRE_THROWS_AS(load(bytes + "xx"), BytecodeLoaderException);
+	}
+
+	SECTION("wrong magic")
+	{
+		bytes[0] = 0;
+		REQUIRE_THROWS_AS(load(bytes), BytecodeLoaderException);
+	}
+}
+
+TEST_CASE("variable length operands are stored in the operand pool", "[bytecode][loader]")
+{
+	ProgramWriter writer;
+	sumFunction(writer, "sum");
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 10)                   // t0
+			.call(0, {0})                         // t1
+			.call(0, {1})                         // t2
+			.ret(2);
+
+	auto program = load(writer.bytes());
+
+	auto& sum = program.functions[0];
+	auto& phi = sum.instructions[2].phi;
+	REQUIRE(phi.edges.count == 2);
+	REQUIRE(phi.edge(sum.operands, 1).temp == 7);
+	REQUIRE(phi.edge(sum.operands, 1).block == 2);
+	REQUIRE(phi.inputOf(sum.operands, 0) == 1);
+	REQUIRE(sum.operands.size() == 8);
+
+	auto& main = program.functions[1];
+	REQUIRE(main.operands == std::vector<u16>{0, 1});
+
+	auto args = main.operandsOf(main.instructions[2].call.args);
+	REQUIRE(args.size() == 1);
+	REQUIRE(args[0] == 1);
+	REQUIRE(main.instructions[2].call.dstIdx == 2);
+}
+
+static
+std::string pack(std::string const& bytes)
+{
+	return packBytecode(reinterpret_cast<u8 const*>(bytes.data()), bytes.size());
+}
+
+TEST_CASE("indexed images decode function bodies lazily", "[bytecode][loader]")
+{
+	ProgramWriter writer;
+	writer.global(5);
+	sumFunction(writer, "main");
+	sumFunction(writer, "other");
+
+	auto plain = load(writer.bytes());
+	auto indexed = load(pack(writer.bytes()));
+
+	REQUIRE(indexed.functions.size() == 2);
+	REQUIRE(indexed.functions[1].name == "other");
+	REQUIRE(indexed.functions[1].returnType == int_());
+	REQUIRE_FALSE(indexed.functions[0].isDecoded());
+	REQUIRE_FALSE(indexed.functions[1].isDecoded());
+
+	indexed.function(1);
+	REQUIRE_FALSE(indexed.functions[0].isDecoded());
+	REQUIRE(indexed.functions[1].isDecoded());
+
+	indexed.function(0);
+	requireSamePrograms(indexed, plain);
+	REQUIRE(indexed.functions[0].temporaryTypes == plain.functions[0].temporaryTypes);
+
+	SECTION("streamed")
+	{
+		std::istringstream stream(pack(writer.bytes(true)));
+		auto streamed = loadBytecode(stream);
+
+		REQUIRE_FALSE(streamed.functions[0].isDecoded());
+		streamed.function(0);
+		streamed.function(1);
+		requireSamePrograms(streamed, plain);
+	}
+}
+
+TEST_CASE("call sites are known before any body is decoded", "[bytecode][loader]")
+{
+	ProgramWriter writer;
+	sumFunction(writer, "sum");
+	sumFunction(writer, "unused");
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 10)                   // t0
+			.call(0, {0})                         // t1
+			.call(0, {1})                         // t2
+			.ret(2);
+
+	auto plain = load(writer.bytes());
+	auto indexed = load(pack(writer.bytes()));
+
+	REQUIRE(plain.callSites == std::vector<u32>{2, 0, 0});
+	REQUIRE(indexed.callSites == plain.callSites);
+	REQUIRE_FALSE(indexed.functions[2].isDecoded());
+}
+
+TEST_CASE("indexed images reject bodies outside of the image", "[bytecode][loader]")
+{
+	ProgramWriter writer;
+	sumFunction(writer, "main");
+
+	auto bytes = pack(writer.bytes());
+
+	SECTION("truncated body section")
+	{
+		REQUIRE_THROWS_AS(load(bytes.substr(0, bytes.size() - 1)), BytecodeLoaderException);
+	}
+
+	SECTION("call to a function that does not exist")
+	{
+		ProgramWriter calling;
+		sumFunction(calling);
+		calling.function("main", {}, int_())
+			.block({})
+				.const_(int_(), 10)                   // t0
+				.call(0, {0})                         // t1
+				.ret(1);
+
+		// CALL of function 0 with t0 as its only argument, patched to call function 7
+		auto packed = pack(calling.bytes());
+		auto call = packed.rfind(std::string("\x1c\x00\x00\x01\x00\x00\x00", 7));
+		REQUIRE(call != std::string::npos);
+		packed[call + 1] = 7;
+
+		auto indexed = load(packed);
+		REQUIRE_THROWS_AS(indexed.function(1), BytecodeLoaderException);
+	}
+
+	SECTION("packing twice")
+	{
+		REQUIRE_THROWS_AS(pack(bytes), BytecodeLoaderException);
+	}
+}
+
+TEST_CASE("bytecode loading", "[.][benchmark]")
+{
+	ProgramWriter writer;
+	for(int i = 0; i != 2000; ++i)
+		sumFunction(writer, "f" + std::to_string(i));
+
+	std::string path = "loader-benchmark.bc";
+	std::string indexedPath = "loader-benchmark-indexed.bc";
+	{
+		std::ofstream out(path, std::ios::binary);
+		out << writer.bytes();
+
+		std::ofstream indexed(indexedPath, std::ios::binary);
+		indexed << pack(writer.bytes());
+	}
+
+	BENCHMARK("istream")
+	{
+		std::ifstream in(path, std::ios::binary);
+		REQUIRE(loadBytecode(in).functions.size() == 2000);
+	}
+
+	BENCHMARK("mmap")
+	{
+		REQUIRE(loadBytecode(path).functions.size() == 2000);
+	}
+
+	BENCHMARK("mmap indexed")
+	{
+		REQUIRE(loadBytecode(indexedPath).functions.size() == 2000);
+	}
+
+	std::remove(path.c_str());
+	std::remove(indexedPath.c_str());
+}
@@ -0,0 +1,380 @@
+#include <catch2/catch.hpp>
+
+#include <assemble.hpp>
+#include <interpreter/Decoder.hpp>
+#include <interpreter/InterpretEngine.hpp>
+#include <interpreter/SlotAllocator.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::interpreter;
+using namespace am2017s::tests::assemble;
+
+static
+int run(ProgramWriter const& writer, bool quicken = true, bool superinstructions = true, bool compactFrames = true)
+{
+	Options options;
+	options.quicken = quicken;
+	options.superinstructions = superinstructions;
+	options.compactFrames = compactFrames;
+
+	InterpretEngine engine(load(writer.bytes()), options);
+	return engine.execute();
+}
+
+TEST_CASE("decoder resolves jumps and phi edges", "[interpreter]")
+{
+	ProgramWriter writer;
+	sumFunction(writer);
+
+	auto program = load(writer.bytes());
+	auto decoded = Decoder(program, program.function(0)).run();
+
+	REQUIRE(decoded.blockStarts == std::vector<u32>{0, 3, 7, 10});
+
+	// block 0 falls through into the phis of block 1 and has to announce its slot
+	auto& fallthrough = decoded.code[2];
+	REQUIRE(fallthrough.kind == Handler::GOTO);
+	REQUIRE(fallthrough.target == &decoded.code[3]);
+	REQUIRE(fallthrough.b == 0);
+
+	auto& loop = decoded.code[9];
+	REQUIRE(loop.kind == Handler::GOTO);
+	REQUIRE(loop.target == &decoded.code[3]);
+	REQUIRE(loop.b == 1);
+
+	auto& i = decoded.code[3];
+	REQUIRE(i.kind == Handler::PHI);
+	REQUIRE(i.operands[0] == 1);
+	REQUIRE(i.operands[1] == 7);
+
+	auto& exit = decoded.code[6];
+	REQUIRE(exit.kind == Handler::IF_GOTO);
+	REQUIRE(exit.target == &decoded.code[10]);
+
+	REQUIRE(decoded.code.back().kind == Handler::RET_VOID);
+}
+
+TEST_CASE("quickening picks handlers by operand type", "[interpreter]")
+{
+	ProgramWriter writer;
+	sumFunction(writer);
+
+	auto program = load(writer.bytes());
+	auto decoded = Decoder(program, program.function(0)).run();
+	quicken(decoded);
+
+	REQUIRE(decoded.code[0].kind == Handler::CONST);
+	REQUIRE(decoded.code[3].kind == Handler::PHI);
+	REQUIRE(decoded.code[5].kind == Handler::GTE_I32);
+	REQUIRE(decoded.code[6].kind == Handler::IF_GOTO);
+	REQUIRE(decoded.code[7].kind == Handler::ADD_I32);
+	REQUIRE(decoded.code[8].kind == Handler::ADD_I32);
+}
+
+TEST_CASE("superinstructions fuse sequences within a block", "[interpreter]")
+{
+	ProgramWriter writer;
+	writer.function("count", {int_()}, int_())
+		.block({1})
+			.const_(int_(), 0)                    // t1
+		.block({1, 2})
+			.phi({{1, 0}, {4, 1}})                // t2
+			.const_(int_(), 1)                    // t3
+			.binary(Opcode::ADD, 2, 3)            // t4
+			.const_(int_(), 9)                    // t5
+			.binary(Opcode::LT, 4, 5)             // t6
+			.if_goto(6, 1)
+		.block({})
+			.ret(4);
+
+	auto program = load(writer.bytes());
+	auto decoded = Decoder(program, program.function(0)).run();
+	quicken(decoded);
+	fuse(decoded);
+
+	// block 0 ends with the inserted GOTO, which must not be fused into block 1
+	REQUIRE(decoded.code[0].kind == Handler::CONST);
+	REQUIRE(decoded.code[1].kind == Handler::GOTO);
+	REQUIRE(decoded.code[2].kind == Handler::PHI);
+	REQUIRE(decoded.code[3].kind == Handler::CONST_ADD_I32);
+	REQUIRE(decoded.code[4].kind == Handler::ADD_I32);
+	REQUIRE(decoded.code[5].kind == Handler::CONST_LT_I32_IF_GOTO);
+	REQUIRE(decoded.code[6].kind == Handler::LT_I32_IF_GOTO);
+	REQUIRE(decoded.code[7].kind == Handler::IF_GOTO);
+
+	SequenceProfile profile;
+	profile.add(decoded);
+	REQUIRE(profile.mostFrequent(3, 1)[0].second == 1);
+
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 0)
+			.call(0, {0})
+			.ret(1);
+
+	REQUIRE(run(writer) == 9);
+}
+
+TEST_CASE("temporaries with disjoint lifetimes share frame slots", "[interpreter]")
+{
+	ProgramWriter writer;
+
+	// fibonacci(n), the phis of the loop header read each other's destinations
+	writer.function("fibonacci", {int_()}, int_())
+		.block({1})
+			.const_(int_(), 0)                    // t1
+			.const_(int_(), 1)                    // t2
+		.block({3, 2})
+			.phi({{1, 0}, {4, 2}})                // t3 = a
+			.phi({{2, 0}, {7, 2}})                // t4 = b
+			.phi({{1, 0}, {8, 2}})                // t5 = i
+			.binary(Opcode::GTE, 5, 0)            // t6
+			.if_goto(6, 3)
+		.block({1})
+			.binary(Opcode::ADD, 3, 4)            // t7
+			.binary(Opcode::ADD, 5, 2)            // t8
+			.goto_(1)
+		.block({})
+			.ret(3);
+
+	auto program = load(writer.bytes());
+	auto& function = program.function(0);
+	auto slots = SlotAllocator(function).run();
+
+	REQUIRE(slots[0] == 0);
+	REQUIRE(Decoder(program, function, true).run().frameSize < Decoder(program, function).run().frameSize);
+
+	// the phi destinations may not overwrite inputs of the phis after them
+	for(u16 phi : {3, 4, 5})
+		for(u16 input : {1, 2, 7, 8})
+			if(phi != input)
+				REQUIRE(slots[phi] != slots[input]);
+
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 20)
+			.call(0, {0})
+			.ret(1);
+
+	REQUIRE(run(writer) == 6765);
+	REQUIRE(run(writer, true, true, false) == 6765);
+}
+
+TEST_CASE("interpreter executes loops and calls", "[interpreter]")
+{
+	ProgramWriter writer;
+	sumFunction(writer);
+
+	// fib(n) = n < 2 ? n : fib(n - 1) + fib(n - 2)
+	writer.function("fib", {int_()}, int_())
+		.block({2, 1})
+			.const_(int_(), 2)                    // t1
+			.binary(Opcode::LT, 0, 1)             // t2
+			.if_goto(2, 2)
+		.block({})
+			.const_(int_(), 1)                    // t3
+			.binary(Opcode::SUB, 0, 3)            // t4
+			.call(1, {4})                         // t5
+			.binary(Opcode::SUB, 4, 3)            // t6
+			.call(1, {6})                         // t7
+			.binary(Opcode::ADD, 5, 7)            // t8
+			.ret(8)
+		.block({})
+			.ret(0);
+
+	SECTION("loop")
+	{
+		writer.function("main", {}, int_())
+			.block({})
+				.const_(int_(), 10)
+				.call(0, {0})
+				.ret(1);
+
+		REQUIRE(run(writer) == 45);
+		REQUIRE(run(writer, false) == 45);
+		REQUIRE(run(writer, true, false) == 45);
+	}
+
+	SECTION("recursion")
+	{
+		writer.function("main", {}, int_())
+			.block({})
+				.const_(int_(), 15)
+				.call(1, {0})
+				.ret(1);
+
+		REQUIRE(run(writer) == 610);
+		REQUIRE(run(writer, false) == 610);
+		REQUIRE(run(writer, true, false) == 610);
+	}
+}
+
+TEST_CASE("interpreter frames live on a bounded stack", "[interpreter]")
+{
+	ProgramWriter writer;
+	sumFunction(writer);
+
+	// down(n) = n == 0 ? 0 : down(n - 1)
+	writer.function("down", {int_()}, int_())
+		.block({2, 1})
+			.const_(int_(), 0)                    // t1
+			.binary(Opcode::EQ, 0, 1)             // t2
+			.if_goto(2, 2)
+		.block({})
+			.const_(int_(), 1)                    // t3
+			.binary(Opcode::SUB, 0, 3)            // t4
+			.call(1, {4})                         // t5
+			.ret(5)
+		.block({})
+			.ret(1);
+
+	auto recursive = [&](int depth) {
+		ProgramWriter program = writer;
+		program.function("main", {}, int_())
+			.block({})
+				.const_(int_(), depth)
+				.call(1, {0})
+				.ret(1);
+		return program;
+	};
+
+	// calls sum 1000 times, each frame has to be released again
+	ProgramWriter repeated = writer;
+	repeated.function("main", {}, int_())
+		.block({1})
+			.const_(int_(), 0)                    // t0
+			.const_(int_(), 1)                    // t1
+			.const_(int_(), 1000)                 // t2
+		.block({1, 2})
+			.phi({{0, 0}, {5, 1}})                // t3
+			.call(0, {2})                         // t4
+			.binary(Opcode::ADD, 3, 1)            // t5
+			.binary(Opcode::LT, 5, 2)             // t6
+			.if_goto(6, 1)
+		.block({})
+			.ret(4);
+
+	Options options;
+	options.stackSize = 1024;
+
+	REQUIRE(InterpretEngine(load(repeated.bytes()), options).execute() == 499500);
+
+	REQUIRE(InterpretEngine(load(recursive(10).bytes()), options).execute() == 0);
+	REQUIRE_THROWS_AS(InterpretEngine(load(recursive(1000).bytes()), options).execute(), StackOverflowException);
+
+	// deeper than the native stack would allow
+	REQUIRE(InterpretEngine(load(recursive(500000).bytes()), {}).execute() == 0);
+}
+
+TEST_CASE("interpreter accesses memory", "[interpreter]")
+{
+	ProgramWriter writer;
+
+	SECTION("objects")
+	{
+		writer.structType(9, "Pair", {6, 5}, {});
+		writer.function("main", {}, int_())
+			.block({})
+				.allocate(9)                      // t0
+				.const_(long_(), 1l << 40)        // t1
+				.obj_store(0, 9, 0, 1)
+				.const_(int_(), 7)                // t2
+				.obj_store(0, 9, 1, 2)
+				.obj_load(0, 9, 1)                // t3
+				.ret(3);
+
+		REQUIRE(run(writer) == 7);
+		REQUIRE(run(writer, false) == 7);
+		REQUIRE(run(writer, true, false) == 7);
+	}
+
+	SECTION("arrays")
+	{
+		writer.function("main", {}, int_())
+			.block({})
+				.const_(int_(), 5)                // t0
+				.new_(int_(), 0)                  // t1
+				.const_(int_(), 3)                // t2
+				.const_(int_(), 42)               // t3
+				.store_idx(1, 2, 3)
+				.load_idx(1, 2)                   // t4
+				.length(1)                        // t5
+				.binary(Opcode::ADD, 4, 5)        // t6
+				.ret(6);
+
+		REQUIRE(run(writer) == 47);
+		REQUIRE(run(writer, false) == 47);
+		REQUIRE(run(writer, true, false) == 47);
+	}
+
+	SECTION("globals")
+	{
+		// packed like the JIT does, the int lives at offset 8
+		writer.global(6);
+		writer.global(5);
+		writer.function("main", {}, int_())
+			.block({})
+				.const_(int_(), 11)               // t0
+				.glob_store(1, 0)
+				.const_(long_(), -1)              // t1
+				.glob_store(0, 1)
+				.glob_load(1)                     // t2
+				.ret(2);
+
+		REQUIRE(run(writer) == 11);
+	}
+}
+
+TEST_CASE("interpreter dispatch", "[.][benchmark]")
+{
+	ProgramWriter writer;
+
+	// poly(n) = sum of (i * i - i) / 3 + i % 7 for i < n
+	writer.function("poly", {long_()}, long_())
+		.block({1})
+			.const_(long_(), 0)                   // t1
+			.const_(long_(), 1)                   // t2
+			.const_(long_(), 3)                   // t3
+			.const_(long_(), 7)                   // t4
+		.block({3, 2})
+			.phi({{1, 0}, {14, 2}})               // t5 = i
+			.phi({{1, 0}, {13, 2}})               // t6 = sum
+			.binary(Opcode::GTE, 5, 0)            // t7
+			.if_goto(7, 3)
+		.block({1})
+			.binary(Opcode::MUL, 5, 5)            // t8
+			.binary(Opcode::SUB, 8, 5)            // t9
+			.binary(Opcode::DIV, 9, 3)            // t10
+			.binary(Opcode::MOD, 5, 4)            // t11
+			.binary(Opcode::ADD, 10, 11)          // t12
+			.binary(Opcode::ADD, 6, 12)           // t13
+			.binary(Opcode::ADD, 5, 2)            // t14
+			.goto_(1)
+		.block({})
+			.ret(6);
+
+	writer.function("main", {}, long_())
+		.block({})
+			.const_(long_(), 1000000)             // t0
+			.call(0, {0})                         // t1
+			.ret(1);
+
+	int expected = run(writer, false);
+	REQUIRE(run(writer) == expected);
+
+	BENCHMARK("generic handlers")
+	{
+		run(writer, false);
+	}
+
+	BENCHMARK("quickened handlers")
+	{
+		run(writer, true, false);
+	}
+
+	BENCHMARK("superinstructions")
+	{
+		run(writer);
+	}
+}
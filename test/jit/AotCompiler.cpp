@@ -0,0 +1,58 @@
+#include <catch2/catch.hpp>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <assemble.hpp>
+#include <jit/AotCompiler.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::tests::assemble;
+
+TEST_CASE("ahead of time compilation builds an executable", "[jit]")
+{
+	auto directory = std::filesystem::temp_directory_path() / ("vm-aot-" + std::to_string(getpid()));
+	std::filesystem::create_directories(directory);
+
+	auto input = (directory / "program.bc").string();
+	std::ofstream(input, std::ios::binary) << boxedSumProgram(10);
+
+	jit::AotCompiler compiler(input, Options());
+
+	// the object's vTable is a relocation, it refers to the copy in the executable
+	auto assembly = compiler.assembly();
+	REQUIRE(assembly.find("\t.quad aot_vtable_0\n") != std::string::npos);
+	REQUIRE(assembly.find("aot_functions:\n\t.quad aot_function_0\n\t.quad aot_function_1\n") != std::string::npos);
+
+	SECTION("functions left to the jit are compiled with the same options")
+	{
+		Options options;
+		options.boundsChecks = true;
+		options.optimizationLevel = 1;
+		options.passes = {"-dce", "inline"};
+
+		auto withOptions = jit::AotCompiler(input, options).assembly();
+		REQUIRE(assembly.find("aot_bounds_checks:\n\t.byte 0\n") != std::string::npos);
+		REQUIRE(withOptions.find("aot_bounds_checks:\n\t.byte 1\n") != std::string::npos);
+		REQUIRE(withOptions.find("aot_optimization_level:\n\t.long 1\n") != std::string::npos);
+		REQUIRE(withOptions.find("aot_passes:\n\t.asciz \"-dce,inline\"\n") != std::string::npos);
+	}
+
+	SECTION("the executable behaves like the jit")
+	{
+		auto output = (directory / "program").string();
+		compiler.writeExecutable(output, VM_RUNTIME);
+
+		int status = std::system(output.c_str());
+		REQUIRE(WIFEXITED(status));
+		REQUIRE(WEXITSTATUS(status) == 45);
+	}
+
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,259 @@
+#include <limits>
+#include <set>
+#include <sstream>
+
+#include <catch2/catch.hpp>
+
+#include <assemble.hpp>
+#include <jit/lir/Arithmetic.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::tests::assemble;
+
+namespace {
+
+/**
+ * A function of the test program: `x op constant`, `constant op x` or `x op y`
+ */
+struct Case {
+	Opcode opcode;
+	u8 width;
+	i64 constant;
+	bool constantFirst;
+	bool variable;
+};
+
+i64 truncated(i64 value, u8 width) {
+	return width == 32 ? (i64) (i32) value : value;
+}
+
+std::set<i64> divisors(u8 width) {
+	i64 min = width == 32 ? std::numeric_limits<i32>::min() : std::numeric_limits<i64>::min();
+	i64 max = width == 32 ? std::numeric_limits<i32>::max() : std::numeric_limits<i64>::max();
+
+	std::set<i64> values{min, min + 1, max, max - 1, 641, 1000, 1000000007, 0x55555555, 0x7fffffff / 7};
+	if(width == 64) {
+		values.insert({(i64) 1 << 32 | 1, 1000000000000, 0x5555555555555555, max / 3, 6700417});
+	}
+
+	for(i64 d = 1; d <= 64; ++d) {
+		values.insert(d);
+	}
+
+	// every power of two, and the odd factors that make up multiplications for some of them
+	for(u8 k = 1; k != width - 1; ++k) {
+		i64 power = (i64) 1 << k;
+		values.insert(power);
+		if(k % 5 == 0) {
+			values.insert({power - 1, power + 1});
+			for(u64 odd : {3, 5, 9}) {
+				values.insert((i64) (odd * (u64) power));
+			}
+		}
+	}
+
+	std::set<i64> result;
+	for(i64 d : values) {
+		result.insert(truncated(d, width));
+		result.insert(truncated((i64) (0 - (u64) d), width));
+	}
+
+	result.erase(0);
+	return result;
+}
+
+std::set<i64> dividends(u8 width, i64 divisor) {
+	i64 min = width == 32 ? std::numeric_limits<i32>::min() : std::numeric_limits<i64>::min();
+	i64 max = width == 32 ? std::numeric_limits<i32>::max() : std::numeric_limits<i64>::max();
+
+	std::set<i64> values{min, min + 1, min + 2, max, max - 1, max - 2};
+	for(i64 x = -100; x <= 100; ++x) {
+		values.insert(x);
+	}
+
+	for(u8 k = 8; k < width - 1; k += 3) {
+		i64 power = (i64) 1 << k;
+		values.insert({power - 1, power, power + 1, -power - 1, -power, -power + 1});
+	}
+
+	// multiples of the divisor and their neighbours are where rounding goes wrong
+	for(i64 q : {(i64) 1, (i64) 2, (i64) 3, (i64) 7, (i64) 1000, max / 2, max}) {
+		for(i64 r = -1; r <= 1; ++r) {
+			values.insert(truncated((i64) ((u64) divisor * (u64) q + (u64) r), width));
+			values.insert(truncated((i64) ((0 - (u64) divisor) * (u64) q + (u64) r), width));
+		}
+	}
+
+	return values;
+}
+
+}
+
+TEST_CASE("magic numbers of divisions by constants", "[jit]")
+{
+	using jit::lir::signedMagic;
+
+	// Hacker's Delight, table 10-1 and 10-2
+	REQUIRE(signedMagic(3, 32).multiplier == 0x55555556);
+	REQUIRE(signedMagic(3, 32).shift == 0);
+	REQUIRE(signedMagic(5, 32).multiplier == 0x66666667);
+	REQUIRE(signedMagic(5, 32).shift == 1);
+	REQUIRE(signedMagic(7, 32).multiplier == (i32) 0x92492493);
+	REQUIRE(signedMagic(7, 32).shift == 2);
+	REQUIRE(signedMagic(-5, 32).multiplier == (i32) 0x99999999);
+	REQUIRE(signedMagic(-5, 32).shift == 1);
+	REQUIRE(signedMagic(-7, 32).multiplier == 0x6DB6DB6D);
+	REQUIRE(signedMagic(-7, 32).shift == 2);
+	REQUIRE(signedMagic(3, 64).multiplier == 0x5555555555555556);
+	REQUIRE(signedMagic(3, 64).shift == 0);
+	REQUIRE(signedMagic(7, 64).multiplier == 0x4924924924924925);
+	REQUIRE(signedMagic(7, 64).shift == 1);
+
+	REQUIRE_THROWS(signedMagic(-1, 32));
+	REQUIRE_THROWS(signedMagic(1, 64));
+}
+
+TEST_CASE("arithmetic with constants computes what the interpreter computes", "[jit]")
+{
+	std::vector<Case> cases;
+	for(u8 width : {32, 64}) {
+		for(i64 d : divisors(width)) {
+			cases.push_back({Opcode::DIV, width, d, false, false});
+			cases.push_back({Opcode::MOD, width, d, false, false});
+			cases.push_back({Opcode::MUL, width, d, false, false});
+		}
+
+		for(i64 d : {-9, -1, 0, 2, 3, 7, 10, 1 << 20}) {
+			cases.push_back({Opcode::MUL, width, d, true, false});
+		}
+
+		for(i64 d : {-1000000007, -7, -1, 1, 2, 3, 1 << 20}) {
+			cases.push_back({Opcode::DIV, width, d, false, true});
+			cases.push_back({Opcode::MOD, width, d, false, true});
+		}
+	}
+
+	ProgramWriter writer;
+	for(Case const& c : cases) {
+		Type type = c.width == 32 ? int_() : long_();
+		std::vector<Type> parameters{type};
+		if(c.variable) {
+			parameters.push_back(type);
+		}
+
+		FunctionWriter& f = writer.function("f" + std::to_string(&c - cases.data()), parameters, type).block({});
+		if(c.variable) {
+			f.binary(c.opcode, 0, 1)                  // t2
+				.ret(2);
+		} else {
+			f.const_(type, c.constant);                // t1
+			if(c.constantFirst) {
+				f.binary(c.opcode, 1, 0);             // t2
+			} else {
+				f.binary(c.opcode, 0, 1);             // t2
+			}
+			f.ret(2);
+		}
+	}
+
+	auto arguments = [&](u16 idx) {
+		Case const& c = cases[idx];
+		std::vector<std::vector<i64>> result;
+
+		for(i64 x : dividends(c.width, c.constant)) {
+			// idiv traps on these just like the interpreter does
+			i64 divisor = c.opcode == Opcode::MUL ? 1 : c.constant;
+			i64 min = c.width == 32 ? std::numeric_limits<i32>::min() : std::numeric_limits<i64>::min();
+			if(divisor != -1 || x != min) {
+				result.push_back({x, c.constant});
+			}
+		}
+		return result;
+	};
+
+	auto mismatch = [&](Call const& call) -> std::string {
+		Case const& c = cases[call.index];
+		i64 x = call.arguments[0];
+		i64 expected = truncated(call.expected, c.width);
+		i64 actual = truncated(call.actual, c.width);
+		if(expected == actual) {
+			return "";
+		}
+
+		char const* operation = c.opcode == Opcode::MUL ? " * " : c.opcode == Opcode::DIV ? " / " : " % ";
+		std::ostringstream description;
+		description << "i" << (int) c.width << ": " << (c.constantFirst ? c.constant : x) << operation
+		            << (c.constantFirst ? x : c.constant) << " = " << actual << " instead of " << expected;
+		return description.str();
+	};
+
+	REQUIRE(mismatches(writer, arguments, mismatch) == std::vector<std::string>{});
+}
+
+TEST_CASE("comparisons branch like the interpreter branches", "[jit]")
+{
+	std::vector<Opcode> opcodes{Opcode::LT, Opcode::LTE, Opcode::EQ, Opcode::NEQ, Opcode::GTE, Opcode::GT};
+
+	ProgramWriter writer;
+	for(Opcode opcode : opcodes) {
+		// the comparison only feeds the branch, the taken edge swaps the arguments on its way to the phis
+		writer.function("fused", {int_(), int_()}, int_())
+			.block({2, 1})
+				.binary(Opcode::MUL, 0, 1)            // t2
+				.binary(opcode, 0, 1)                 // t3
+				.if_goto(3, 2)
+			.block({2})
+				.const_(int_(), 1)                    // t4
+				.binary(Opcode::ADD, 0, 4)            // t5
+				.goto_(2)
+			.block({})
+				.phi({{1, 0}, {5, 1}})                // t6
+				.phi({{0, 0}, {1, 1}})                // t7
+				.const_(int_(), 3)                    // t8
+				.binary(Opcode::MUL, 7, 8)            // t9
+				.binary(Opcode::SUB, 6, 9)            // t10
+				.binary(Opcode::ADD, 10, 2)           // t11
+				.ret(11);
+
+		// the boolean is used twice and stays in a register
+		writer.function("materialized", {int_(), int_()}, int_())
+			.block({2, 1})
+				.binary(opcode, 0, 1)                 // t2
+				.if_goto(2, 2)
+			.block({})
+				.const_(int_(), 1)                    // t3
+				.ret(3)
+			.block({4, 3})
+				.if_goto(2, 4)
+			.block({})
+				.const_(int_(), 2)                    // t4
+				.ret(4)
+			.block({})
+				.const_(int_(), 3)                    // t5
+				.ret(5);
+	}
+
+	std::vector<i64> values{std::numeric_limits<i32>::min(), -2, -1, 0, 1, 2, std::numeric_limits<i32>::max()};
+	std::vector<std::vector<i64>> pairs;
+	for(i64 x : values) {
+		for(i64 y : values) {
+			pairs.push_back({x, y});
+		}
+	}
+
+	auto mismatch = [](Call const& call) -> std::string {
+		i64 expected = truncated(call.expected, 32);
+		i64 actual = truncated(call.actual, 32);
+		if(expected == actual) {
+			return "";
+		}
+
+		std::ostringstream description;
+		description << call.name << " #" << call.index / 2 << "(" << call.arguments[0] << ", " << call.arguments[1]
+		            << ") = " << actual << " instead of " << expected;
+		return description.str();
+	};
+
+	REQUIRE(mismatches(writer, [&](u16) { return pairs; }, mismatch) == std::vector<std::string>{});
+}
@@ -165,3 +165,67 @@ TEST_CASE("CodeBuilder - memory operands", "[jit]")
 		REQUIRE(encodeStore(R15, MemOp(R15, R15, 8, 13371337)) == CodePiece({0x4f, 0x89, 0xbc, 0xff, 0xc9, 0x07, 0xcc, 0x00}));
 	}
 }
+
+template <class Emit>
+static
+CodePiece encode(Emit emit)
+{
+	CodeBuilder builder;
+	emit(builder);
+
+	auto code = builder.build();
+	// remove ud2
+	code.erase(code.end() - 2, code.end());
+
+	return CodePiece(std::move(code));
+}
+
+TEST_CASE("CodeBuilder - immediate operands", "[jit]")
+{
+	SECTION("add, sub and cmp with an immediate")
+	{
+		REQUIRE(encode([](CodeBuilder& b) { b.add(RSP, 8); }) == CodePiece({0x48, 0x83, 0xc4, 0x08}));
+		REQUIRE(encode([](CodeBuilder& b) { b.sub(RSP, 0x8000); }) == CodePiece({0x48, 0x81, 0xec, 0x00, 0x80, 0x00, 0x00}));
+		REQUIRE(encode([](CodeBuilder& b) { b.add(R9, -1, DWORD); }) == CodePiece({0x41, 0x83, 0xc1, 0xff}));
+		REQUIRE(encode([](CodeBuilder& b) { b.cmp(RegMemOp(R12), 1000); }) == CodePiece({0x49, 0x81, 0xfc, 0xe8, 0x03, 0x00, 0x00}));
+		REQUIRE(encode([](CodeBuilder& b) { b.cmp(MemOp(RSP, 16), 0); }) == CodePiece({0x48, 0x83, 0x7c, 0x24, 0x10, 0x00}));
+	}
+
+	SECTION("mov [mem], imm")
+	{
+		REQUIRE(encode([](CodeBuilder& b) { b.movimm(-1, MemOp(RAX, 8), QWORD); }) == CodePiece({0x48, 0xc7, 0x40, 0x08, 0xff, 0xff, 0xff, 0xff}));
+		REQUIRE(encode([](CodeBuilder& b) { b.movimm(7, MemOp(R8, RCX, 4), DWORD); }) == CodePiece({0x41, 0xc7, 0x04, 0x88, 0x07, 0x00, 0x00, 0x00}));
+		REQUIRE(encode([](CodeBuilder& b) { b.movimm(7, MemOp(RDX), WORD); }) == CodePiece({0x66, 0xc7, 0x02, 0x07, 0x00}));
+		REQUIRE(encode([](CodeBuilder& b) { b.movimm(7, MemOp(R13), BYTE); }) == CodePiece({0x41, 0xc6, 0x45, 0x00, 0x07}));
+	}
+
+	SECTION("setcc and test on memory")
+	{
+		REQUIRE(encode([](CodeBuilder& b) { b.set(internal::Comparison::LT, MemOp(RSP, 8)); }) == CodePiece({0x0f, 0x9c, 0x44, 0x24, 0x08}));
+		REQUIRE(encode([](CodeBuilder& b) { b.test(MemOp(R15, 8)); }) == CodePiece({0x41, 0xf6, 0x47, 0x08, 0x01}));
+	}
+}
+
+TEST_CASE("CodeBuilder - scalar SSE", "[jit]")
+{
+	SECTION("arithmetic on registers and memory")
+	{
+		REQUIRE(encode([](CodeBuilder& b) { b.addf(XMM9, XMM1, QWORD); }) == CodePiece({0xf2, 0x41, 0x0f, 0x58, 0xc9}));
+		REQUIRE(encode([](CodeBuilder& b) { b.subf(MemOp(RSP, 8), XMM10, DWORD); }) == CodePiece({0xf3, 0x44, 0x0f, 0x5c, 0x54, 0x24, 0x08}));
+		REQUIRE(encode([](CodeBuilder& b) { b.mulf(MemOp(R8, RCX, 8, 16), XMM0, QWORD); }) == CodePiece({0xf2, 0x41, 0x0f, 0x59, 0x44, 0xc8, 0x10}));
+		REQUIRE(encode([](CodeBuilder& b) { b.divf(MemOp(RBP, -24), XMM3, QWORD); }) == CodePiece({0xf2, 0x0f, 0x5e, 0x5d, 0xe8}));
+		REQUIRE(encode([](CodeBuilder& b) { b.xorf(XMM12, XMM2); }) == CodePiece({0x41, 0x0f, 0x57, 0xd4}));
+	}
+
+	SECTION("comparisons")
+	{
+		REQUIRE(encode([](CodeBuilder& b) { b.ucomis(XMM1, XMM2, QWORD); }) == CodePiece({0x66, 0x0f, 0x2e, 0xca}));
+		REQUIRE(encode([](CodeBuilder& b) { b.ucomis(XMM9, MemOp(RAX), DWORD); }) == CodePiece({0x44, 0x0f, 0x2e, 0x08}));
+	}
+
+	SECTION("loads relative to the instruction pointer")
+	{
+		REQUIRE(encode([](CodeBuilder& b) { REQUIRE(b.movf_riprel(XMM11, QWORD) == 5); }) == CodePiece({0xf2, 0x44, 0x0f, 0x10, 0x1d, 0x00, 0x00, 0x00, 0x00}));
+		REQUIRE(encode([](CodeBuilder& b) { b.movf_riprel(XMM2, DWORD); }) == CodePiece({0xf3, 0x0f, 0x10, 0x15, 0x00, 0x00, 0x00, 0x00}));
+	}
+}
@@ -0,0 +1,59 @@
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include <assemble.hpp>
+#include <jit/CodeCache.hpp>
+#include <jit/JitEngine.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::tests::assemble;
+
+TEST_CASE("code cache reuses code of earlier runs", "[jit]")
+{
+	auto directory = std::filesystem::temp_directory_path() / ("vm-code-cache-" + std::to_string(getpid()));
+
+	Options options;
+	options.codeCache = directory.string();
+
+	auto entries = [&]() {
+		return std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator());
+	};
+
+	// sum() is inlined into main() and never compiled on its own
+	REQUIRE(jit::JitEngine(load(boxedSumProgram(100)), options).execute() == 4950);
+	REQUIRE(entries() == 1);
+
+	SECTION("unchanged functions are loaded")
+	{
+		auto loaded = load(boxedSumProgram(100));
+		jit::PassManager passes(options);
+		jit::CodeCache cache(options.codeCache, loaded, passes.pipeline(), passes.inlineDepth());
+
+		// the key covers the callees, which the engine decodes before it compiles
+		loaded.function(0);
+		jit::CompiledCode code;
+		REQUIRE(cache.load(cache.keyOf(loaded.function(1)), code));
+		REQUIRE(code.relocations.size() == 1);
+
+		u64 address;
+		std::memcpy(&address, code.bytes.data() + code.relocations[0].offset, sizeof address);
+		REQUIRE(address == (u64) loaded.types.at(0).vTable.data());
+
+		REQUIRE(jit::JitEngine(std::move(loaded), options).execute() == 4950);
+		REQUIRE(entries() == 1);
+	}
+
+	SECTION("changed functions are compiled again")
+	{
+		REQUIRE(jit::JitEngine(load(boxedSumProgram(10)), options).execute() == 45);
+		REQUIRE(entries() == 2);
+	}
+
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,169 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <catch2/catch.hpp>
+
+#include <assemble.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::tests::assemble;
+
+namespace {
+
+i64 bits(double value, bool single) {
+	if(single) {
+		float f = (float) value;
+		u32 result;
+		std::memcpy(&result, &f, sizeof result);
+		return result;
+	}
+
+	i64 result;
+	std::memcpy(&result, &value, sizeof result);
+	return result;
+}
+
+std::string show(i64 value, bool single, bool floating) {
+	std::ostringstream os;
+	if(!floating) {
+		os << (i32) value;
+	} else if(single) {
+		u32 raw = (u32) value;
+		float f;
+		std::memcpy(&f, &raw, sizeof f);
+		os << f;
+	} else {
+		double d;
+		std::memcpy(&d, &value, sizeof d);
+		os << d;
+	}
+	return os.str();
+}
+
+/**
+ * Results are equal if they have the same bits, any two NaNs are equal
+ */
+bool same(i64 expected, i64 actual, bool single, bool floating) {
+	if(!floating) {
+		return (i32) expected == (i32) actual;
+	}
+
+	if(single) {
+		u32 e = (u32) expected, a = (u32) actual;
+		bool nans = (e & 0x7fffffff) > 0x7f800000 && (a & 0x7fffffff) > 0x7f800000;
+		return e == a || nans;
+	}
+
+	u64 e = (u64) expected, a = (u64) actual;
+	bool nans = (e & 0x7fffffffffffffff) > 0x7ff0000000000000 && (a & 0x7fffffffffffffff) > 0x7ff0000000000000;
+	return e == a || nans;
+}
+
+}
+
+TEST_CASE("floating point arithmetic computes what the interpreter computes", "[jit]")
+{
+	std::vector<Opcode> arithmetic{Opcode::ADD, Opcode::SUB, Opcode::MUL, Opcode::DIV};
+	std::vector<Opcode> comparisons{Opcode::LT, Opcode::LTE, Opcode::EQ, Opcode::NEQ, Opcode::GTE, Opcode::GT};
+
+	ProgramWriter writer;
+	std::vector<bool> returnsFloat;
+	std::vector<bool> isSingle;
+
+	for(bool single : {false, true}) {
+		Type type = single ? float_() : double_();
+		auto function = [&](std::string const& name, bool floating) -> FunctionWriter& {
+			returnsFloat.push_back(floating);
+			isSingle.push_back(single);
+			return writer.function(name, {type, type}, floating ? type : int_());
+		};
+
+		for(Opcode opcode : arithmetic) {
+			function("arithmetic", true)
+				.block({})
+					.binary(opcode, 0, 1)                 // t2
+					.ret(2);
+		}
+
+		function("negation", true)
+			.block({})
+				.unary(Opcode::NEG, 0)                    // t2
+				.ret(2);
+
+		// the same constant twice shares its slot in the constant pool
+		function("constants", true)
+			.block({})
+				.const_(type, bits(0.1, single))          // t2
+				.binary(Opcode::ADD, 0, 2)                // t3
+				.const_(type, bits(-3.0, single))         // t4
+				.binary(Opcode::MUL, 3, 4)                // t5
+				.const_(type, bits(0.1, single))          // t6
+				.binary(Opcode::SUB, 5, 6)                // t7
+				.ret(7);
+
+		// x + x + x, the sum is a phi of a float that lives across the back edge
+		function("loop", true)
+			.block({1})
+				.const_(type, 0)                          // t2
+				.const_(int_(), 0)                        // t3
+				.const_(int_(), 1)                        // t4
+				.const_(int_(), 3)                        // t5
+			.block({3, 2})
+				.phi({{2, 0}, {9, 2}})                    // t6 = sum
+				.phi({{3, 0}, {10, 2}})                   // t7 = i
+				.binary(Opcode::GTE, 7, 5)                // t8
+				.if_goto(8, 3)
+			.block({1})
+				.binary(Opcode::ADD, 6, 0)                // t9
+				.binary(Opcode::ADD, 7, 4)                // t10
+				.goto_(1)
+			.block({})
+				.ret(6);
+
+		for(Opcode opcode : comparisons) {
+			function("comparison", false)
+				.block({2, 1})
+					.binary(opcode, 0, 1)                 // t2
+					.if_goto(2, 2)
+				.block({})
+					.const_(int_(), 0)                    // t3
+					.ret(3)
+				.block({})
+					.const_(int_(), 1)                    // t4
+					.ret(4);
+		}
+	}
+
+	double infinity = std::numeric_limits<double>::infinity();
+	std::vector<double> values{0.0, -0.0, 1.0, -1.5, 3.0, 0.1, 1e30, infinity, -infinity,
+	                           std::numeric_limits<double>::quiet_NaN()};
+
+	auto arguments = [&](u16 idx) {
+		std::vector<std::vector<i64>> result;
+		for(double x : values) {
+			for(double y : values) {
+				result.push_back({bits(x, isSingle[idx]), bits(y, isSingle[idx])});
+			}
+		}
+		return result;
+	};
+
+	auto mismatch = [&](Call const& call) -> std::string {
+		bool single = isSingle[call.index];
+		bool floating = returnsFloat[call.index];
+		if(same(call.expected, call.actual, single, floating)) {
+			return "";
+		}
+
+		std::ostringstream description;
+		description << (single ? "f32 " : "f64 ") << call.name << " #" << call.index << "("
+		            << show(call.arguments[0], single, true) << ", " << show(call.arguments[1], single, true) << ") = "
+		            << show(call.actual, single, floating) << " instead of " << show(call.expected, single, floating);
+		return description.str();
+	};
+
+	REQUIRE(mismatches(writer, arguments, mismatch) == std::vector<std::string>{});
+}
@@ -0,0 +1,44 @@
+#include <catch2/catch.hpp>
+
+#include <assemble.hpp>
+#include <jit/JitEngine.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::tests::assemble;
+
+extern "C"
+[[gnu::sysv_abi]]
+void jit_stub() asm("jit_stub");
+
+TEST_CASE("eager compilation compiles everything main reaches", "[jit]")
+{
+	ProgramWriter writer;
+	sumFunction(writer);
+
+	writer.function("unused", {}, int_())
+		.block({})
+			.const_(int_(), 1)                    // t0
+			.ret(0);
+
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 100)                  // t0
+			.call(0, {0})                         // t1
+			.ret(1);
+
+	Options options;
+	options.eager = true;
+	options.compileThreads = 2;
+
+	jit::JitEngine engine(load(writer.bytes()), options);
+	engine.compileAll(2);
+
+	// the table holds the final addresses before main runs
+	auto table = engine.functionTable();
+	REQUIRE(table[0] != (void*) &jit_stub);
+	REQUIRE(table[1] == (void*) &jit_stub);
+	REQUIRE(table[2] != (void*) &jit_stub);
+
+	REQUIRE(engine.execute() == 4950);
+}
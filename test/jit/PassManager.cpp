@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <set>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+
+#include <assemble.hpp>
+#include <interpreter/InterpretEngine.hpp>
+#include <jit/JitEngine.hpp>
+#include <jit/lir/LIRCompiler.hpp>
+#include <jit/optimizations/BoundsCheckElimination.hpp>
+#include <jit/optimizations/PassManager.hpp>
+#include <jit/optimizations/Verifier.hpp>
+
+using namespace am2017s;
+using namespace am2017s::bytecode;
+using namespace am2017s::tests::assemble;
+
+namespace {
+
+std::string program() {
+	ProgramWriter writer;
+	writer.structType(0, "Pair", {(u8) BaseType::INT32, (u8) BaseType::INT32}, {});
+
+	writer.function("folded", {int_()}, int_())
+		.block({2, 1})
+			.const_(int_(), 2)                    // t1
+			.const_(int_(), 3)                    // t2
+			.binary(Opcode::MUL, 1, 2)            // t3
+			.binary(Opcode::GT, 3, 1)             // t4
+			.binary(Opcode::ADD, 0, 0)            // t5
+			.if_goto(4, 2)
+		.block({2})
+			.const_(int_(), 100)                  // t6
+			.goto_(2)
+		.block({})
+			.phi({{3, 0}, {6, 1}})                // t7
+			.binary(Opcode::ADD, 7, 0)            // t8
+			.ret(8);
+
+	// sums up 0 ... n - 1, the counter in t5 is never read
+	writer.function("loop", {int_()}, int_())
+		.block({1})
+			.const_(int_(), 0)                    // t1
+			.const_(int_(), 1)                    // t2
+		.block({3, 2})
+			.phi({{1, 0}, {8, 2}})                // t3
+			.phi({{1, 0}, {7, 2}})                // t4
+			.phi({{1, 0}, {9, 2}})                // t5
+			.binary(Opcode::GTE, 3, 0)            // t6
+			.if_goto(6, 3)
+		.block({1})
+			.binary(Opcode::ADD, 4, 3)            // t7
+			.binary(Opcode::ADD, 3, 2)            // t8
+			.binary(Opcode::ADD, 5, 2)            // t9
+			.goto_(1)
+		.block({})
+			.ret(4);
+
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 10)                   // t0
+			.call(0, {0})                         // t1
+			.call(1, {0})                         // t2
+			.binary(Opcode::ADD, 1, 2)            // t3
+			.call(3, {0})                         // t4
+			.binary(Opcode::ADD, 3, 4)            // t5
+			.ret(5);
+
+	// loads and computations that are repeated where their result is still known
+	writer.function("redundant", {int_()}, int_())
+		.block({2, 1})
+			.allocate(0)                          // t1
+			.const_(int_(), 4)                    // t2
+			.new_(int_(), 2)                      // t3
+			.obj_store(1, 0, 0, 0)
+			.obj_load(1, 0, 0)                    // t4 = t0
+			.binary(Opcode::ADD, 0, 4)            // t5
+			.binary(Opcode::ADD, 4, 0)            // t6 = t5
+			.obj_store(1, 0, 1, 5)
+			.obj_load(1, 0, 0)                    // t7 = t0
+			.length(3)                            // t8
+			.binary(Opcode::GT, 8, 7)             // t9
+			.if_goto(9, 2)
+		.block({3})
+			.length(3)                            // t10 = t8
+			.obj_load(1, 0, 1)                    // t11 = t5
+			.binary(Opcode::ADD, 10, 11)          // t12
+			.goto_(3)
+		.block({3})
+			.call_void(4, {})
+			.obj_load(1, 0, 1)                    // t13, the call may have changed it
+			.goto_(3)
+		.block({})
+			.phi({{12, 1}, {13, 2}})              // t14
+			.obj_load(1, 0, 0)                    // t15, block 2 changes memory
+			.binary(Opcode::ADD, 14, 15)          // t16
+			.ret(16);
+
+	writer.function("nothing", {}, Type(BaseType::VOID))
+		.block({})
+			.ret_void();
+
+	// sums up k * k n times, the square does not change inside the loop
+	writer.function("invariant", {int_(), int_()}, int_())
+		.block({1})
+			.allocate(0)                          // t2
+			.obj_store(2, 0, 0, 1)
+			.const_(int_(), 0)                    // t3
+			.const_(int_(), 1)                    // t4
+		.block({3, 2})
+			.phi({{3, 0}, {11, 2}})               // t5
+			.phi({{3, 0}, {10, 2}})               // t6
+			.binary(Opcode::GTE, 5, 0)            // t7
+			.if_goto(7, 3)
+		.block({1})
+			.obj_load(2, 0, 0)                    // t8
+			.binary(Opcode::MUL, 8, 8)            // t9
+			.binary(Opcode::ADD, 6, 9)            // t10
+			.binary(Opcode::ADD, 5, 4)            // t11
+			.goto_(1)
+		.block({})
+			.ret(6);
+
+	return writer.bytes();
+}
+
+// sums up the elements of arrays filled with their indices
+std::string arrays() {
+	ProgramWriter writer;
+
+	// walks the whole array
+	writer.function("walk", {int_()}, int_())
+		.block({1})
+			.const_(int_(), 0)                    // t1
+			.const_(int_(), 1)                    // t2
+			.new_(int_(), 0)                      // t3
+		.block({3, 2})
+			.phi({{1, 0}, {10, 2}})               // t4
+			.phi({{1, 0}, {9, 2}})                // t5
+			.length(3)                            // t6
+			.binary(Opcode::GTE, 4, 6)            // t7
+			.if_goto(7, 3)
+		.block({1})
+			.store_idx(3, 4, 4)
+			.load_idx(3, 4)                       // t8
+			.binary(Opcode::ADD, 5, 8)            // t9
+			.binary(Opcode::ADD, 4, 2)            // t10
+			.goto_(1)
+		.block({})
+			.ret(5);
+
+	// walks the first n of m elements
+	writer.function("prefix", {int_(), int_()}, int_())
+		.block({1})
+			.const_(int_(), 0)                    // t2
+			.const_(int_(), 1)                    // t3
+			.new_(int_(), 1)                      // t4
+		.block({3, 2})
+			.phi({{2, 0}, {10, 2}})               // t5
+			.phi({{2, 0}, {9, 2}})                // t6
+			.binary(Opcode::GTE, 5, 0)            // t7
+			.if_goto(7, 3)
+		.block({1})
+			.store_idx(4, 5, 5)
+			.load_idx(4, 5)                       // t8
+			.binary(Opcode::ADD, 6, 8)            // t9
+			.binary(Opcode::ADD, 5, 3)            // t10
+			.goto_(1)
+		.block({})
+			.ret(6);
+
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 10)                   // t0
+			.call(0, {0})                         // t1
+			.call(1, {0, 0})                      // t2
+			.binary(Opcode::ADD, 1, 2)            // t3
+			.ret(3);
+
+	return writer.bytes();
+}
+
+// reads one element past the end of the array, the last read happens when the loop exits
+std::string outOfBounds() {
+	ProgramWriter writer;
+
+	writer.function("header", {int_()}, int_())
+		.block({1})
+			.const_(int_(), 0)                    // t1
+			.const_(int_(), 1)                    // t2
+			.new_(int_(), 0)                      // t3
+		.block({3, 2})
+			.phi({{1, 0}, {9, 2}})                // t4
+			.phi({{1, 0}, {8, 2}})                // t5
+			.load_idx(3, 4)                       // t6
+			.binary(Opcode::GTE, 4, 0)            // t7
+			.if_goto(7, 3)
+		.block({1})
+			.binary(Opcode::ADD, 5, 6)            // t8
+			.binary(Opcode::ADD, 4, 2)            // t9
+			.goto_(1)
+		.block({})
+			.ret(5);
+
+	writer.function("main", {}, int_())
+		.block({})
+			.const_(int_(), 5)                    // t0
+			.call(0, {0})                         // t1
+			.ret(1);
+
+	return writer.bytes();
+}
+
+std::size_t countChecks(Function const& function) {
+	return std::count_if(function.instructions.begin(), function.instructions.end(), [](Instruction const& i) {
+		return i.opcode == Opcode::BOUNDS_CHECK;
+	});
+}
+
+Function optimized(Program const& program, Function function, Options const& options) {
+	jit::PassManager(options).run(program, function);
+	return function;
+}
+
+}
+
+TEST_CASE("optimization passes fold constants and remove dead code", "[jit]")
+{
+	Program p = load(program());
+
+	Options options;
+	options.verifyPasses = true;
+
+	SECTION("constant branches drop the blocks they skip") {
+		Function f = optimized(p, p.function(0), options);
+
+		REQUIRE(f.blocks.size() == 2);
+		REQUIRE(f.instructions.size() == 4);
+
+		// the phi only sees 2 * 3, everything else of the first block is gone
+		REQUIRE(f.instructions[0].opcode == Opcode::GOTO);
+		REQUIRE(f.instructions[0].jump.branchIdx == 1);
+		REQUIRE(f.instructions[1].opcode == Opcode::CONST);
+		REQUIRE(f.instructions[1].constant.dstIdx == 7);
+		REQUIRE(f.instructions[1].constant.value == 6);
+		REQUIRE(f.instructions[2].opcode == Opcode::ADD);
+		REQUIRE(f.instructions[2].binary.lsrcIdx == 7);
+		REQUIRE(f.blocks[1].predecessors == std::vector<u16>{0});
+	}
+
+	SECTION("values only used around a loop are dead") {
+		Function f = optimized(p, p.function(1), options);
+
+		REQUIRE(f.blocks.size() == 4);
+		REQUIRE(std::count_if(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::PHI;
+		}) == 2);
+		REQUIRE(std::none_of(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.dstIdx() && (i.dstIdx().value() == 5 || i.dstIdx().value() == 9);
+		}));
+	}
+
+	SECTION("repeated computations and loads are removed") {
+		// the call to nothing() has to stay, it clobbers memory
+		options.passes = {"-inline"};
+		Function f = optimized(p, p.function(3), options);
+
+		REQUIRE(std::none_of(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.dstIdx() && std::set<u16>{4, 6, 7, 10, 11}.count(i.dstIdx().value());
+		}));
+		REQUIRE(std::count_if(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::OBJ_LOAD;
+		}) == 2);
+		REQUIRE(std::count_if(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::LENGTH;
+		}) == 1);
+	}
+
+	SECTION("invariant computations move in front of the loop") {
+		Function f = optimized(p, p.function(5), options);
+
+		jit::Dominators dominators(f);
+		jit::Loops loops(f, dominators);
+		REQUIRE(loops.depth == std::vector<u16>{0, 0, 1, 1, 0});
+		REQUIRE(loops.loops.at(0).header == 2);
+
+		// the preheader loads the field and squares it
+		REQUIRE(f.blocks[1].predecessors == std::vector<u16>{0});
+		REQUIRE(f.blocks[1].successors == std::vector<u16>{2});
+		jit::DefUse defUse(f);
+		u32 start = defUse.blockStarts[1];
+		REQUIRE(f.instructions[start].opcode == Opcode::OBJ_LOAD);
+		REQUIRE(f.instructions[start + 1].opcode == Opcode::MUL);
+		REQUIRE(std::none_of(f.instructions.begin() + defUse.blockStarts[2], f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::OBJ_LOAD || i.opcode == Opcode::MUL;
+		}));
+
+		Program moved = load(program());
+		moved.functions[5] = f;
+		interpreter::Value arguments[2];
+		arguments[0].l = 10;
+		arguments[1].l = 3;
+		interpreter::InterpretEngine interpreter(moved, options);
+		interpreter.reset();
+		REQUIRE(interpreter.call(5, arguments).i == 90);
+	}
+
+	SECTION("small callees are copied into their callers") {
+		for(u16 i = 0; i != p.functions.size(); ++i)
+			p.function(i);
+
+		jit::PassManager passes(options);
+		Function f = p.function(2);
+		passes.run(p, f);
+
+		// nothing() is inlined into redundant() in the second round
+		REQUIRE(std::none_of(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::CALL || i.opcode == Opcode::CALL_VOID;
+		}));
+		REQUIRE(jit::Loops(f, jit::Dominators(f)).loops.size() == 1);
+
+		Program inlined = load(program());
+		inlined.functions[2] = f;
+		interpreter::InterpretEngine interpreter(inlined, options);
+		interpreter.reset();
+		REQUIRE(interpreter.call(2, nullptr).i == 95);
+	}
+
+	SECTION("passes are selected by level and by name") {
+		options.optimizationLevel = 0;
+		REQUIRE(optimized(p, p.function(0), options).instructions.size() == p.function(0).instructions.size());
+
+		options.optimizationLevel = 1;
+		options.passes = {"-dce"};
+		REQUIRE(jit::PassManager(options).pipeline() == "sccp,copy-propagation,lir:isel,");
+
+		// the unused t0 + t0 stays
+		Function f = optimized(p, p.function(0), options);
+		REQUIRE(std::any_of(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::ADD && i.binary.dstIdx == 5;
+		}));
+
+		options.passes = {"no-such-pass"};
+		REQUIRE_THROWS(jit::PassManager(options));
+	}
+
+	SECTION("constants become immediates of the instructions using them") {
+		Function f = optimized(p, p.function(1), options);
+		jit::JitEngine engine(p, options);
+		jit::LIRCompiler<jit::AMD64> lir(&engine, p, p.types, f);
+		lir.run();
+		jit::PassManager(options).run(lir, f);
+
+		// the counter is incremented by an immediate, the 1 is not loaded into a register anymore
+		std::vector<jit::lir::Instruction> lirs;
+		for(auto const& block : lir.blocks) {
+			lirs.insert(lirs.end(), block.lirs.begin(), block.lirs.end());
+		}
+		REQUIRE(std::any_of(lirs.begin(), lirs.end(), [](jit::lir::Instruction const& i) {
+			return i.operation == jit::lir::ADD_IMM && i.immediate.imm == 1;
+		}));
+		REQUIRE(std::none_of(lirs.begin(), lirs.end(), [](jit::lir::Instruction const& i) {
+			return i.operation == jit::lir::MOV && i.mov.isImm && i.mov.imm == 1;
+		}));
+	}
+
+	SECTION("the verifier rejects broken functions") {
+		Function f = p.function(0);
+		f.instructions[4].binary.lsrcIdx = 42;
+		REQUIRE_THROWS(jit::verify(f));
+	}
+
+	SECTION("compiled code computes the same result") {
+		jit::JitEngine engine(load(program()), options);
+		REQUIRE(engine.execute() == 95);
+	}
+}
+
+TEST_CASE("bounds checks are removed where they cannot fail", "[jit]")
+{
+	Program p = load(arrays());
+
+	Options options;
+	options.verifyPasses = true;
+	options.boundsChecks = true;
+
+	SECTION("every access gets a check") {
+		Function f = p.function(0);
+		jit::insertBoundsChecks(f);
+		REQUIRE(countChecks(f) == 2);
+		REQUIRE(f.blocks[2].instructionCount == 7);
+		REQUIRE_NOTHROW(jit::verify(f));
+
+		options.passes = {"-bce"};
+		REQUIRE(countChecks(optimized(p, p.function(0), options)) == 2);
+	}
+
+	SECTION("indices below the length need no check") {
+		REQUIRE(countChecks(optimized(p, p.function(0), options)) == 0);
+	}
+
+	SECTION("checks of a counter move in front of the loop") {
+		Function f = optimized(p, p.function(1), options);
+		REQUIRE(countChecks(f) == 1);
+
+		jit::DefUse defUse(f);
+		jit::Loops loops(f, jit::Dominators(f));
+		u32 check = std::find_if(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::BOUNDS_CHECK;
+		}) - f.instructions.begin();
+		REQUIRE(loops.innermost[defUse.blockOf[check]] == jit::Loops::NONE);
+		REQUIRE(f.instructions[check].check.limitIdx == 0);
+	}
+
+	SECTION("checks in the loop header stay in the loop") {
+		// the header also runs with the counter at the end of the range
+		Function f = optimized(p, load(outOfBounds()).function(0), options);
+		REQUIRE(countChecks(f) == 1);
+
+		jit::DefUse defUse(f);
+		jit::Loops loops(f, jit::Dominators(f));
+		u32 check = std::find_if(f.instructions.begin(), f.instructions.end(), [](Instruction const& i) {
+			return i.opcode == Opcode::BOUNDS_CHECK;
+		}) - f.instructions.begin();
+		REQUIRE(loops.innermost[defUse.blockOf[check]] != jit::Loops::NONE);
+	}
+
+	SECTION("the interpreter stops at the first index out of bounds") {
+		interpreter::InterpretEngine interpreter(p, options);
+		interpreter.reset();
+
+		interpreter::Value arguments[2];
+		arguments[0].l = 10;
+		arguments[1].l = 10;
+		REQUIRE(interpreter.call(1, arguments).i == 45);
+
+		arguments[0].l = 11;
+		REQUIRE_THROWS(interpreter.call(1, arguments));
+
+		arguments[0].l = 0;
+		arguments[1].l = 0;
+		REQUIRE(interpreter.call(1, arguments).i == 0);
+	}
+
+	SECTION("compiled code computes the same result") {
+		jit::JitEngine engine(load(arrays()), options);
+		REQUIRE(engine.execute() == 90);
+	}
+
+	SECTION("compiled code exits at the first index out of bounds") {
+		// bounds_error ends the process
+		pid_t child = fork();
+		REQUIRE(child != -1);
+		if(child == 0) {
+			jit::JitEngine engine(load(outOfBounds()), options);
+			engine.execute();
+			_exit(0);
+		}
+
+		int status;
+		REQUIRE(waitpid(child, &status, 0) == child);
+		REQUIRE(WIFEXITED(status));
+		REQUIRE(WEXITSTATUS(status) == 1);
+	}
+}
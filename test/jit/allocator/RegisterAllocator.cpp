@@ -49,14 +49,28 @@ using namespace am2017s::jit;
 //	REQUIRE(allocator.handled.size() == 5);
 //}
 
-TEST_CASE("topological sorting (connected)", "") {
-	std::vector<std::pair<RegMemOp, RegMemOp>> input;
-	input.push_back({RegMemOp(RegOp::RDX), RegMemOp(RegOp::RAX)});
-	input.push_back({RegMemOp(RegOp::RAX), RegMemOp(RegOp::R8)});
-	input.push_back({RegMemOp(RegOp::R8), RegMemOp(RegOp::R10)});
+namespace {
 
+/**
+ * A MachineCompiler without any code, together with the inputs it refers to
+ */
+struct EmptyMachine {
+	std::vector<Block> blocks;
+	std::vector<Interval> intervals;
+	StackAllocator stack;
+	std::map<lir::vr, am2017s::bytecode::Type> vrTypes;
+	std::vector<StackSpillMovOp> stackFrameSpills;
+	MachineCompiler machine{blocks, intervals, stack, vrTypes, stackFrameSpills};
+};
+
+}
+
+TEST_CASE_METHOD(EmptyMachine, "topological sorting (connected)", "") {
+	std::vector<SpillMovOp> input;
+	input.push_back({RegMemOp(RegOp::RDX), RegMemOp(RegOp::RAX), QWORD});
+	input.push_back({RegMemOp(RegOp::RAX), RegMemOp(RegOp::R8), QWORD});
+	input.push_back({RegMemOp(RegOp::R8), RegMemOp(RegOp::R10), QWORD});
 
-	auto machine = MachineCompiler({}, {});
 	auto sort = machine.topologicallySort(input);
 	REQUIRE(sort.size() == 3);
 	REQUIRE(sort[0].first.reg() == R8);
@@ -64,23 +78,21 @@ TEST_CASE("topological sorting (connected)", "") {
 	REQUIRE(sort[2].first.reg() == RDX);
 }
 
-TEST_CASE("topological sorting (independent)", "") {
-	std::vector<std::pair<RegMemOp, RegMemOp>> input;
-	input.push_back({RegMemOp(RegOp::RDX), RegMemOp(RegOp::RAX)});
-	input.push_back({RegMemOp(RegOp::R8), RegMemOp(RegOp::R10)});
+TEST_CASE_METHOD(EmptyMachine, "topological sorting (independent)", "") {
+	std::vector<SpillMovOp> input;
+	input.push_back({RegMemOp(RegOp::RDX), RegMemOp(RegOp::RAX), QWORD});
+	input.push_back({RegMemOp(RegOp::R8), RegMemOp(RegOp::R10), QWORD});
 
-	auto machine = MachineCompiler({}, {});
 	auto sort = machine.topologicallySort(input);
 
 	REQUIRE(sort.size() == 2);
 }
 
-TEST_CASE("topological sorting (cyclic)", "") {
-	std::vector<std::pair<RegMemOp, RegMemOp>> input;
-	input.push_back({RegMemOp(RegOp::RDX), RegMemOp(RegOp::RAX)});
-	input.push_back({RegMemOp(RegOp::RAX), RegMemOp(RegOp::RDX)});
+TEST_CASE_METHOD(EmptyMachine, "topological sorting (cyclic)", "") {
+	std::vector<SpillMovOp> input;
+	input.push_back({RegMemOp(RegOp::RDX), RegMemOp(RegOp::RAX), QWORD});
+	input.push_back({RegMemOp(RegOp::RAX), RegMemOp(RegOp::RDX), QWORD});
 
-	auto machine = MachineCompiler({}, {});
 	auto sort = machine.topologicallySort(input);
 
 	REQUIRE(sort.size() == 0);
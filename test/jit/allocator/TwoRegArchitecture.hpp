@@ -6,9 +6,36 @@ using namespace am2017s::jit;
 
 class TwoRegArchitecture : public Architecture {
 public:
-	static std::vector<RegOp> registers() {
+	template<typename RegisterType>
+	static std::vector<RegisterType> registers();
+
+	static std::vector<RegOp> calleeSaved() {
+		return {};
+	}
+
+	static std::vector<RegOp> parameters() {
 		return {RAX,
 		        RCX,
 		};
 	}
-};
\ No newline at end of file
+
+	static std::vector<XMMOp> parametersFloat() {
+		return {XMM0,
+		        XMM1,
+		};
+	}
+};
+
+template<>
+inline std::vector<RegOp> TwoRegArchitecture::registers() {
+	return {RAX,
+	        RCX,
+	};
+}
+
+template<>
+inline std::vector<XMMOp> TwoRegArchitecture::registers() {
+	return {XMM0,
+	        XMM1,
+	};
+}
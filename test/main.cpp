@@ -1,2 +1,4 @@
 #define CATCH_CONFIG_MAIN
+// catch 2.2 uses a non-constant SIGSTKSZ which newer glibc versions no longer provide
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
 #include <catch2/catch.hpp>